@@ -0,0 +1,95 @@
+/**
+ * @file host_main.c
+ * @brief Linux entry point that runs the controller core against the ESP-IDF shims in host/shim.
+ *
+ * Starts the same services as app_main() minus Wi-Fi: the station TCP server on TCP_SERVER_PORT, the HTTP server
+ * with the dashboard, /data, /update, /history, /metrics, /rules and /ws, the rule engine, the storage task, the Shelly
+ * workers and the uplink, which talk plain HTTP to whatever listens at the given addresses. Stations, ingest_bench and browsers connect to the host as they
+ * would to the board, so the real handshake, parsing and server code can be load-tested and profiled.
+ *
+ * Usage:
+ *   controller_host [http-port] [store-image] [heater-addr] [dehumidifier-addr] [uplink-url]
+ *
+ * Defaults: HTTP on port 8000, telemetry log in controller_host.img (created blank if missing), the plugs
+ * at 127.0.0.1:8081 and 127.0.0.1:8082, and no uplink; uplink_sink stands in for the upstream.
+ *
+ * Dependencies:
+ * - host/shim: FreeRTOS, esp_log, esp_http_client, esp_http_server, esp_partition and nvs on POSIX.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_http_server.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "tcp_server.h"
+#include "http_server.h"
+#include "shelly_control.h"
+#include "rules.h"
+#include "uplink.h"
+#include "history.h"
+#include "bus.h"
+#include "storage.h"
+#include "json_arena.h"
+#include "metrics.h"
+#include "dlog.h"
+
+
+int main(int argc, char **argv) {
+    if (argc > 1 && argv[1][0] == '-') {
+        fprintf(stderr, "usage: %s [http-port] [store-image] [heater-addr] [dehumidifier-addr] [uplink-url]\n",
+                argv[0]);
+        return 1;
+    }
+    host_httpd_default_port = (uint16_t)(argc > 1 ? atoi(argv[1]) : 8000);
+    host_partition_set_image(argc > 2 ? argv[2] : "controller_host.img");
+    heaterIP = argc > 3 ? argv[3] : "127.0.0.1:8081";
+    humidifierIP = argc > 4 ? argv[4] : "127.0.0.1:8082";
+    if (argc > 5) uplinkURL = argv[5];
+
+    // Stations that vanish mid-send must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+
+    metrics_heap_checkpoint(NULL);
+    dlog_start();
+    metrics_heap_checkpoint("dlog");
+
+    history_init();
+    bus_init();
+    json_arena_init();
+    metrics_heap_checkpoint("core");
+
+    ESP_LOGI("MAIN", "Starting Shelly actuators (heater %s, dehumidifier %s)...", heaterIP, humidifierIP);
+    shelly_control_start();
+    metrics_heap_checkpoint("shelly");
+
+    ESP_LOGI("MAIN", "Loading automation rules...");
+    rules_init();
+    metrics_heap_checkpoint("rules");
+
+    ESP_LOGI("MAIN", "Mounting the telemetry log...");
+    storage_start();
+    metrics_heap_checkpoint("storage");
+
+    ESP_LOGI("MAIN", "Starting TCP server...");
+    tcp_server_start();
+    metrics_heap_checkpoint("tcp_server");
+
+    ESP_LOGI("MAIN", "Starting uplink...");
+    uplink_start();
+    metrics_heap_checkpoint("uplink");
+
+    ESP_LOGI("MAIN", "Starting HTTP server on port %u...", host_httpd_default_port);
+    start_http_server();
+    metrics_heap_checkpoint("http_server");
+
+    for (;;) {
+        pause();
+    }
+}
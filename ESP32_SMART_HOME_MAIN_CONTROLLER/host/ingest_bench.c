@@ -0,0 +1,284 @@
+/**
+ * @file ingest_bench.c
+ * @brief Host benchmark for the TCP ingest path of the ESP32 Smart Home Main Controller.
+ *
+ * The benchmark connects a growing number of simulated stations to the controller's TCP server,
+ * performs the HANDSHAKE:ARDUINO_READY exchange on each of them and then streams DATA: frames in
+ * a closed loop (one frame in flight per station). For every station count it reports the ingest
+ * rate in messages per second and the p50/p99 latency between sending a frame and receiving its ACK.
+ *
+ * Usage:
+ *   ingest_bench <controller-ip> [port] [max-stations] [seconds-per-step]
+ *
+ * The station count doubles from 1 up to max-stations (default 32).
+ *
+ * Dependencies:
+ * - POSIX sockets and poll().
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define BENCH_MAX_STATIONS 256
+#define BENCH_LINE_SIZE 256
+#define HANDSHAKE_TIMEOUT_MS 10000
+
+typedef struct {
+    int sock;
+    char line[BENCH_LINE_SIZE];
+    size_t line_len;
+    bool ready;
+    uint64_t sent_at_ns;
+    uint32_t seq;
+} bench_station_t;
+
+typedef struct {
+    uint64_t *samples;
+    size_t count;
+    size_t capacity;
+} latency_log_t;
+
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+
+static void latency_add(latency_log_t *log, uint64_t value) {
+    if (log->count == log->capacity) {
+        log->capacity = log->capacity ? log->capacity * 2 : 4096;
+        log->samples = realloc(log->samples, log->capacity * sizeof(uint64_t));
+        if (!log->samples) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    log->samples[log->count++] = value;
+}
+
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+static double percentile_ms(latency_log_t *log, double pct) {
+    if (log->count == 0) return 0.0;
+    size_t index = (size_t)(pct / 100.0 * (double)(log->count - 1) + 0.5);
+    return log->samples[index] / 1e6;
+}
+
+
+static int connect_station(const struct sockaddr_storage *addr, socklen_t addr_len) {
+    int sock = socket(addr->ss_family, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+    if (connect(sock, (const struct sockaddr *)addr, addr_len) != 0) {
+        close(sock);
+        return -1;
+    }
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    return sock;
+}
+
+
+static bool send_line(int sock, const char *line) {
+    size_t total = strlen(line), sent = 0;
+    while (sent < total) {
+        ssize_t n = send(sock, line + sent, total - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd = {.fd = sock, .events = POLLOUT};
+                poll(&pfd, 1, 100);
+                continue;
+            }
+            return false;
+        }
+        sent += (size_t)n;
+    }
+    return true;
+}
+
+
+static bool send_frame(bench_station_t *st, int index) {
+    char frame[BENCH_LINE_SIZE];
+    st->seq++;
+    snprintf(frame, sizeof(frame),
+        "DATA:{\"temperature\":%d.%02d,\"humidity\":%d.%02d,\"lux\":%u,\"heater\":%s,\"dehumidifier\":false,"
+        "\"sp_temperature\":22.00,\"sp_humidity\":50.00}\n",
+        20 + index % 5, (int)(st->seq % 100), 40 + index % 10, (int)((st->seq * 7) % 100),
+        (unsigned)(300 + st->seq % 50), (st->seq & 1) ? "true" : "false");
+    st->sent_at_ns = now_ns();
+    return send_line(st->sock, frame);
+}
+
+
+/**
+ * Reads whatever is available on the station socket and returns the number of complete
+ * lines whose first token, up to an optional ";options" suffix, is @p expected. Returns -1
+ * if the connection was closed.
+ */
+static int read_lines(bench_station_t *st, const char *expected) {
+    char chunk[512];
+    size_t len = strlen(expected);
+    int matches = 0;
+
+    for (;;) {
+        ssize_t n = recv(st->sock, chunk, sizeof(chunk), 0);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            if (chunk[i] == '\n') {
+                st->line[st->line_len] = '\0';
+                // "SETPOINTS_ACK:<id>" must not count as a telemetry "ACK"
+                if (strncmp(st->line, expected, len) == 0 && (st->line[len] == '\0' || st->line[len] == ';')) {
+                    matches++;
+                }
+                st->line_len = 0;
+            } else if (st->line_len < BENCH_LINE_SIZE - 1) {
+                st->line[st->line_len++] = chunk[i];
+            }
+        }
+    }
+    return matches;
+}
+
+
+static void run_step(const struct sockaddr_storage *addr, socklen_t addr_len, int count, int seconds) {
+    bench_station_t *stations = calloc((size_t)count, sizeof(bench_station_t));
+    struct pollfd *pfds = calloc((size_t)count, sizeof(struct pollfd));
+    latency_log_t latencies = {0};
+    int connected = 0, ready = 0, lost = 0;
+
+    for (int i = 0; i < count; i++) {
+        stations[i].sock = connect_station(addr, addr_len);
+        if (stations[i].sock < 0) continue;
+        connected++;
+        send_line(stations[i].sock, "HANDSHAKE:ARDUINO_READY\n");
+    }
+
+    uint64_t deadline = now_ns() + (uint64_t)HANDSHAKE_TIMEOUT_MS * 1000000ull;
+    while (ready < connected && now_ns() < deadline) {
+        for (int i = 0; i < count; i++) {
+            pfds[i].fd = (stations[i].sock >= 0 && !stations[i].ready) ? stations[i].sock : -1;
+            pfds[i].events = POLLIN;
+        }
+        if (poll(pfds, (nfds_t)count, 100) <= 0) continue;
+        for (int i = 0; i < count; i++) {
+            if (pfds[i].fd < 0 || !(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            int matched = read_lines(&stations[i], "HANDSHAKE:ESP32_READY");
+            if (matched < 0) {
+                close(stations[i].sock);
+                stations[i].sock = -1;
+                connected--;
+            } else if (matched > 0) {
+                stations[i].ready = true;
+                ready++;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (stations[i].ready) send_frame(&stations[i], i);
+    }
+
+    uint64_t start = now_ns();
+    uint64_t end = start + (uint64_t)seconds * 1000000000ull;
+    while (now_ns() < end) {
+        for (int i = 0; i < count; i++) {
+            pfds[i].fd = stations[i].ready ? stations[i].sock : -1;
+            pfds[i].events = POLLIN;
+        }
+        if (poll(pfds, (nfds_t)count, 50) <= 0) continue;
+        for (int i = 0; i < count; i++) {
+            if (pfds[i].fd < 0 || !(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            int acks = read_lines(&stations[i], "ACK");
+            if (acks < 0) {
+                stations[i].ready = false;
+                lost++;
+                continue;
+            }
+            if (acks > 0) {
+                latency_add(&latencies, now_ns() - stations[i].sent_at_ns);
+                if (!send_frame(&stations[i], i)) {
+                    stations[i].ready = false;
+                    lost++;
+                }
+            }
+        }
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    qsort(latencies.samples, latencies.count, sizeof(uint64_t), compare_u64);
+    printf("%8d %8d %12.1f %10.2f %10.2f %6d\n",
+           count, ready, latencies.count / elapsed,
+           percentile_ms(&latencies, 50.0), percentile_ms(&latencies, 99.0), lost);
+    fflush(stdout);
+
+    for (int i = 0; i < count; i++) {
+        if (stations[i].sock >= 0) close(stations[i].sock);
+    }
+    free(latencies.samples);
+    free(pfds);
+    free(stations);
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <controller-ip> [port] [max-stations] [seconds-per-step]\n", argv[0]);
+        return 2;
+    }
+    const char *host = argv[1];
+    const char *port = argc > 2 ? argv[2] : "8080";
+    int max_stations = argc > 3 ? atoi(argv[3]) : 32;
+    int seconds = argc > 4 ? atoi(argv[4]) : 5;
+    if (max_stations < 1 || max_stations > BENCH_MAX_STATIONS || seconds < 1) {
+        fprintf(stderr, "max-stations must be 1..%d and seconds >= 1\n", BENCH_MAX_STATIONS);
+        return 2;
+    }
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *res = NULL;
+    int rc = getaddrinfo(host, port, &hints, &res);
+    if (rc != 0) {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rc));
+        return 1;
+    }
+    struct sockaddr_storage addr;
+    socklen_t addr_len = (socklen_t)res->ai_addrlen;
+    memcpy(&addr, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+
+    printf("%8s %8s %12s %10s %10s %6s\n", "stations", "ready", "msgs/sec", "p50 ms", "p99 ms", "lost");
+    for (int count = 1; count <= max_stations; count *= 2) {
+        run_step(&addr, addr_len, count, seconds);
+        if (count < max_stations && count * 2 > max_stations) {
+            run_step(&addr, addr_len, max_stations, seconds);
+        }
+    }
+    return 0;
+}
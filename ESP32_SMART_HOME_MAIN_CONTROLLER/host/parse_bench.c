@@ -0,0 +1,175 @@
+/**
+ * @file parse_bench.c
+ * @brief Host benchmark comparing the cJSON and jsmn telemetry parse paths.
+ *
+ * Every station DATA: frame used to go through cJSON_Parse, cJSON_GetObjectItem and cJSON_Delete.
+ * The controller now parses with parse_telemetry(), which tokenizes with jsmn into a stack array.
+ * This benchmark feeds the same corpus of station frames through both paths and reports time and
+ * cycles per message together with the number of heap allocations and bytes each path requests.
+ *
+ * Allocations are counted by wrapping malloc/calloc/realloc/free at link time, so the counts cover
+ * cJSON, jsmn and the controller parser alike.
+ *
+ * Usage:
+ *   parse_bench [iterations]
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "cJSON.h"
+#include "json_parser.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER 1
+static inline uint64_t read_cycles(void) { return __rdtsc(); }
+#else
+#define HAVE_CYCLE_COUNTER 0
+static inline uint64_t read_cycles(void) { return 0; }
+#endif
+
+#define CORPUS_SIZE 64
+#define FRAME_SIZE 192
+
+static char corpus[CORPUS_SIZE][FRAME_SIZE];
+static size_t corpus_len[CORPUS_SIZE];
+
+static uint64_t alloc_calls;
+static uint64_t alloc_bytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size) {
+    alloc_calls++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    alloc_calls++;
+    alloc_bytes += count * size;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    alloc_calls++;
+    alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+    __real_free(ptr);
+}
+
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+
+static void build_corpus(void) {
+    for (int i = 0; i < CORPUS_SIZE; i++) {
+        int n = snprintf(corpus[i], FRAME_SIZE,
+            "{\"temperature\":%d.%02d,\"humidity\":%d.%02d,\"lux\":%d,\"heater\":%s,\"dehumidifier\":%s,"
+            "\"sp_temperature\":22.00,\"sp_humidity\":50.00}",
+            18 + i % 8, (i * 37) % 100, 35 + i % 30, (i * 53) % 100, 100 + i * 13,
+            (i & 1) ? "true" : "false", (i & 2) ? "true" : "false");
+        corpus_len[i] = (size_t)n;
+    }
+}
+
+
+static int to_centi(double value) {
+    return (int)(value * 100 + (value < 0 ? -0.5 : 0.5));
+}
+
+
+/** The parse path handle_received_data used before switching to jsmn. */
+static int parse_with_cjson(const char *json, size_t len) {
+    cJSON *root = cJSON_ParseWithLength(json, len);
+    if (!root) return 0;
+
+    int checksum = 0;
+    cJSON *temp = cJSON_GetObjectItem(root, "temperature");
+    cJSON *hum = cJSON_GetObjectItem(root, "humidity");
+    cJSON *lux_item = cJSON_GetObjectItem(root, "lux");
+    cJSON *heater_item = cJSON_GetObjectItem(root, "heater");
+    cJSON *dehumidifier_item = cJSON_GetObjectItem(root, "dehumidifier");
+    cJSON *sp_temp_item = cJSON_GetObjectItem(root, "sp_temperature");
+    cJSON *sp_hum_item = cJSON_GetObjectItem(root, "sp_humidity");
+
+    if (cJSON_IsNumber(temp)) checksum += to_centi(temp->valuedouble);
+    if (cJSON_IsNumber(hum)) checksum += to_centi(hum->valuedouble);
+    if (cJSON_IsNumber(lux_item)) checksum += lux_item->valueint;
+    if (cJSON_IsBool(heater_item)) checksum += cJSON_IsTrue(heater_item);
+    if (cJSON_IsBool(dehumidifier_item)) checksum += cJSON_IsTrue(dehumidifier_item);
+    if (cJSON_IsNumber(sp_temp_item)) checksum += to_centi(sp_temp_item->valuedouble);
+    if (cJSON_IsNumber(sp_hum_item)) checksum += to_centi(sp_hum_item->valuedouble);
+
+    cJSON_Delete(root);
+    return checksum;
+}
+
+
+static int parse_with_jsmn(const char *json, size_t len) {
+    telemetry_t telemetry;
+    if (!parse_telemetry(json, len, &telemetry)) return 0;
+    return telemetry.temperature + telemetry.humidity + telemetry.lux + telemetry.heater +
+           telemetry.dehumidifier + telemetry.sp_temperature + telemetry.sp_humidity;
+}
+
+
+static void run(const char *name, int (*parse)(const char *, size_t), long iterations) {
+    long checksum = 0;
+    alloc_calls = 0;
+    alloc_bytes = 0;
+
+    uint64_t start_ns = now_ns();
+    uint64_t start_cycles = read_cycles();
+    for (long i = 0; i < iterations; i++) {
+        int k = (int)(i % CORPUS_SIZE);
+        checksum += parse(corpus[k], corpus_len[k]);
+    }
+    uint64_t cycles = read_cycles() - start_cycles;
+    uint64_t elapsed = now_ns() - start_ns;
+
+    printf("%-6s %10.1f %12.1f %12.2f %12.1f %14ld\n", name,
+           (double)elapsed / iterations,
+           HAVE_CYCLE_COUNTER ? (double)cycles / iterations : 0.0,
+           (double)alloc_calls / iterations,
+           (double)alloc_bytes / iterations,
+           checksum);
+}
+
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    if (iterations < 1) iterations = 1;
+
+    build_corpus();
+
+    // Cross-check both paths on the corpus before timing them
+    for (int i = 0; i < CORPUS_SIZE; i++) {
+        if (parse_with_cjson(corpus[i], corpus_len[i]) != parse_with_jsmn(corpus[i], corpus_len[i])) {
+            fprintf(stderr, "mismatch on frame %d: %s\n", i, corpus[i]);
+            return 1;
+        }
+    }
+
+    printf("%-6s %10s %12s %12s %12s %14s\n", "parser", "ns/msg", "cycles/msg", "allocs/msg", "bytes/msg", "checksum");
+    run("cjson", parse_with_cjson, iterations);
+    run("jsmn", parse_with_jsmn, iterations);
+    return 0;
+}
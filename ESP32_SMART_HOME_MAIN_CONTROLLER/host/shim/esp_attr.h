@@ -0,0 +1,11 @@
+/**
+ * @file esp_attr.h
+ * @brief Host shim for the ESP-IDF placement attributes; the host has no IRAM, so they expand to nothing.
+ */
+
+#ifndef HOST_SHIM_ESP_ATTR_H
+#define HOST_SHIM_ESP_ATTR_H
+
+#define IRAM_ATTR
+
+#endif // HOST_SHIM_ESP_ATTR_H
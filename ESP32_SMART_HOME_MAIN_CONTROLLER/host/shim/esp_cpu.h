@@ -0,0 +1,24 @@
+/**
+ * @file esp_cpu.h
+ * @brief Host shim for the CPU cycle counter.
+ *
+ * Counts CLOCK_MONOTONIC time in cycles of a CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ clock, wrapping at 32 bits like CCOUNT.
+ */
+
+#ifndef HOST_SHIM_ESP_CPU_H
+#define HOST_SHIM_ESP_CPU_H
+
+#include <stdint.h>
+#include <time.h>
+#include "sdkconfig.h"
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+static inline esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    return (esp_cpu_cycle_count_t)(ns * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ / 1000);
+}
+
+#endif // HOST_SHIM_ESP_CPU_H
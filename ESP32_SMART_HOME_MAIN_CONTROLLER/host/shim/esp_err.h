@@ -0,0 +1,61 @@
+/**
+ * @file esp_err.h
+ * @brief Host shim for the ESP-IDF error codes used by the controller sources.
+ */
+
+#ifndef HOST_SHIM_ESP_ERR_H
+#define HOST_SHIM_ESP_ERR_H
+
+typedef int esp_err_t;
+
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_NO_MEM          0x101
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_INVALID_STATE   0x103
+#define ESP_ERR_INVALID_SIZE    0x104
+#define ESP_ERR_NOT_FOUND       0x105
+#define ESP_ERR_TIMEOUT         0x107
+
+#define ESP_ERR_NVS_NOT_FOUND           0x1102
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE    0x1105
+#define ESP_ERR_NVS_KEY_TOO_LONG        0x1109
+#define ESP_ERR_NVS_INVALID_LENGTH      0x110c
+
+#define ESP_ERR_HTTP_CONNECT        0x7002
+#define ESP_ERR_HTTP_WRITE_DATA     0x7003
+#define ESP_ERR_HTTP_FETCH_HEADER   0x7004
+
+#define ESP_ERR_HTTPD_HANDLERS_FULL 0xb001
+#define ESP_ERR_HTTPD_INVALID_REQ   0xb003
+#define ESP_ERR_HTTPD_RESULT_TRUNC  0xb004
+#define ESP_ERR_HTTPD_RESP_SEND     0xb006
+#define ESP_ERR_HTTPD_TASK          0xb008
+
+static inline const char *esp_err_to_name(esp_err_t err) {
+    switch (err) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_NOT_ENOUGH_SPACE: return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+    case ESP_ERR_NVS_KEY_TOO_LONG: return "ESP_ERR_NVS_KEY_TOO_LONG";
+    case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+    case ESP_ERR_HTTP_CONNECT: return "ESP_ERR_HTTP_CONNECT";
+    case ESP_ERR_HTTP_WRITE_DATA: return "ESP_ERR_HTTP_WRITE_DATA";
+    case ESP_ERR_HTTP_FETCH_HEADER: return "ESP_ERR_HTTP_FETCH_HEADER";
+    case ESP_ERR_HTTPD_HANDLERS_FULL: return "ESP_ERR_HTTPD_HANDLERS_FULL";
+    case ESP_ERR_HTTPD_INVALID_REQ: return "ESP_ERR_HTTPD_INVALID_REQ";
+    case ESP_ERR_HTTPD_RESULT_TRUNC: return "ESP_ERR_HTTPD_RESULT_TRUNC";
+    case ESP_ERR_HTTPD_RESP_SEND: return "ESP_ERR_HTTPD_RESP_SEND";
+    case ESP_ERR_HTTPD_TASK: return "ESP_ERR_HTTPD_TASK";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+#endif // HOST_SHIM_ESP_ERR_H
@@ -0,0 +1,39 @@
+/**
+ * @file esp_heap_caps.h
+ * @brief Host shim for the ESP-IDF heap statistics, on the allocator wrapper in heap.c.
+ */
+
+#ifndef HOST_SHIM_ESP_HEAP_CAPS_H
+#define HOST_SHIM_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+typedef struct {
+    size_t total_free_bytes;
+    size_t total_allocated_bytes;
+    size_t largest_free_block;      ///< The notional heap does not fragment, so this is total_free_bytes.
+    size_t minimum_free_bytes;
+    size_t allocated_blocks;
+    size_t free_blocks;
+    size_t total_blocks;
+} multi_heap_info_t;
+
+/**
+ * @brief Fills in the statistics of the notional heap; @p caps is ignored.
+ */
+void heap_caps_get_info(multi_heap_info_t *info, uint32_t caps);
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+/**
+ * @brief Allocator hooks, defined by the application; called after every successful allocation and every free.
+ */
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps);
+void esp_heap_trace_free_hook(void *ptr);
+#endif
+
+#endif // HOST_SHIM_ESP_HEAP_CAPS_H
@@ -0,0 +1,352 @@
+/**
+ * @file esp_http_client.c
+ * @brief Host implementation of the esp_http_client shim on blocking sockets.
+ */
+
+#include "esp_http_client.h"
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define HTTP_CLIENT_HOST_LEN 64
+#define HTTP_CLIENT_PATH_LEN 192
+#define HTTP_CLIENT_BUFFER_LEN 1024
+#define HTTP_CLIENT_HEADERS_LEN 256
+
+struct esp_http_client {
+    char host[HTTP_CLIENT_HOST_LEN];
+    char port[8];
+    char path[HTTP_CLIENT_PATH_LEN];
+    esp_http_client_method_t method;
+    int timeout_ms;
+    bool keep_alive;
+    http_event_handle_cb event_handler;
+    void *user_data;
+    const char *post_data;
+    int post_len;
+    char headers[HTTP_CLIENT_HEADERS_LEN];      ///< Extra header lines, each ending in CRLF.
+    bool content_type_set;                      ///< headers carries a Content-Type.
+    int sock;
+    int status;
+    int64_t content_length;
+};
+
+static const char *const method_names[] = {
+    [HTTP_METHOD_GET] = "GET",
+    [HTTP_METHOD_POST] = "POST",
+    [HTTP_METHOD_PUT] = "PUT",
+    [HTTP_METHOD_PATCH] = "PATCH",
+    [HTTP_METHOD_DELETE] = "DELETE",
+    [HTTP_METHOD_HEAD] = "HEAD",
+};
+
+
+/** Splits http://host[:port]/path; only plain http is supported. */
+static esp_err_t parse_url(esp_http_client_handle_t client, const char *url) {
+    const char *scheme = "http://";
+    if (strncmp(url, scheme, strlen(scheme)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const char *host = url + strlen(scheme);
+    const char *path = strchr(host, '/');
+    size_t authority_len = path ? (size_t)(path - host) : strlen(host);
+    const char *colon = memchr(host, ':', authority_len);
+    size_t host_len = colon ? (size_t)(colon - host) : authority_len;
+    if (host_len == 0 || host_len >= sizeof(client->host)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char new_host[HTTP_CLIENT_HOST_LEN];
+    char new_port[sizeof(client->port)] = "80";
+    memcpy(new_host, host, host_len);
+    new_host[host_len] = '\0';
+    if (colon) {
+        size_t port_len = authority_len - host_len - 1;
+        if (port_len == 0 || port_len >= sizeof(new_port)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        memcpy(new_port, colon + 1, port_len);
+        new_port[port_len] = '\0';
+    }
+    if (snprintf(client->path, sizeof(client->path), "%s", path ? path : "/") >= (int)sizeof(client->path)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // A different server cannot reuse the open connection
+    if (strcmp(new_host, client->host) != 0 || strcmp(new_port, client->port) != 0) {
+        esp_http_client_close(client);
+        strcpy(client->host, new_host);
+        strcpy(client->port, new_port);
+    }
+    return ESP_OK;
+}
+
+
+static void dispatch(esp_http_client_handle_t client, esp_http_client_event_id_t id, void *data, int len) {
+    if (client->event_handler) {
+        esp_http_client_event_t evt = {
+            .event_id = id,
+            .client = client,
+            .data = data,
+            .data_len = len,
+            .user_data = client->user_data,
+        };
+        client->event_handler(&evt);
+    }
+}
+
+
+static esp_err_t client_connect(esp_http_client_handle_t client) {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *addrs;
+    if (getaddrinfo(client->host, client->port, &hints, &addrs) != 0) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    struct timeval timeout = { .tv_sec = client->timeout_ms / 1000, .tv_usec = (client->timeout_ms % 1000) * 1000 };
+    for (struct addrinfo *addr = addrs; addr; addr = addr->ai_next) {
+        int sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (sock < 0) continue;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (connect(sock, addr->ai_addr, addr->ai_addrlen) == 0) {
+            client->sock = sock;
+            break;
+        }
+        close(sock);
+    }
+    freeaddrinfo(addrs);
+    if (client->sock < 0) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    dispatch(client, HTTP_EVENT_ON_CONNECTED, NULL, 0);
+    return ESP_OK;
+}
+
+
+static bool send_all(int sock, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t sent = send(sock, data, len, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        data += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+
+static esp_err_t send_request(esp_http_client_handle_t client) {
+    char head[HTTP_CLIENT_BUFFER_LEN];
+    int len = snprintf(head, sizeof(head),
+                       "%s %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32 HTTP Client/1.0\r\nConnection: %s\r\n",
+                       method_names[client->method], client->path, client->host,
+                       client->keep_alive ? "keep-alive" : "close");
+    len += snprintf(head + len, sizeof(head) - len, "%s", client->headers);
+    if (client->post_data) {
+        if (!client->content_type_set) {
+            len += snprintf(head + len, sizeof(head) - len, "Content-Type: application/x-www-form-urlencoded\r\n");
+        }
+        len += snprintf(head + len, sizeof(head) - len, "Content-Length: %d\r\n", client->post_len);
+    }
+    len += snprintf(head + len, sizeof(head) - len, "\r\n");
+    if (len >= (int)sizeof(head) || !send_all(client->sock, head, len) ||
+        (client->post_data && !send_all(client->sock, client->post_data, client->post_len))) {
+        return ESP_ERR_HTTP_WRITE_DATA;
+    }
+    dispatch(client, HTTP_EVENT_HEADERS_SENT, NULL, 0);
+    return ESP_OK;
+}
+
+
+/** Reads the status line and headers; @p buffer keeps any body bytes that arrived with them. */
+static esp_err_t read_head(esp_http_client_handle_t client, char *buffer, size_t *len, size_t *body_start,
+                           bool *server_closes) {
+    *len = 0;
+    char *end = NULL;
+    while (!end) {
+        if (*len == HTTP_CLIENT_BUFFER_LEN - 1) return ESP_ERR_HTTP_FETCH_HEADER;
+        ssize_t n = recv(client->sock, buffer + *len, HTTP_CLIENT_BUFFER_LEN - 1 - *len, 0);
+        if (n <= 0) return ESP_ERR_HTTP_FETCH_HEADER;
+        *len += n;
+        buffer[*len] = '\0';
+        end = strstr(buffer, "\r\n\r\n");
+    }
+    *body_start = end + 4 - buffer;
+    *end = '\0';
+
+    if (sscanf(buffer, "HTTP/1.%*d %d", &client->status) != 1) {
+        return ESP_ERR_HTTP_FETCH_HEADER;
+    }
+    client->content_length = -1;
+    *server_closes = strncmp(buffer, "HTTP/1.0", 8) == 0;
+    for (char *line = strstr(buffer, "\r\n"); line; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            client->content_length = strtoll(line + 15, NULL, 10);
+        } else if (strncasecmp(line, "Connection:", 11) == 0) {
+            *server_closes = strncasecmp(line + 11 + strspn(line + 11, " "), "close", 5) == 0;
+        }
+    }
+    return ESP_OK;
+}
+
+
+static esp_err_t read_response(esp_http_client_handle_t client) {
+    char buffer[HTTP_CLIENT_BUFFER_LEN];
+    size_t len, body_start;
+    bool server_closes;
+    esp_err_t err = read_head(client, buffer, &len, &body_start, &server_closes);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    int64_t remaining = client->method == HTTP_METHOD_HEAD || client->status == 204 || client->status == 304
+                        ? 0 : client->content_length;
+    size_t chunk = len - body_start;
+    if (remaining >= 0 && (int64_t)chunk > remaining) {
+        chunk = remaining;
+    }
+    if (chunk > 0) {
+        dispatch(client, HTTP_EVENT_ON_DATA, buffer + body_start, chunk);
+        if (remaining > 0) remaining -= chunk;
+    }
+
+    // Without a Content-Length the body runs until the server closes the connection
+    while (remaining != 0) {
+        size_t want = remaining > 0 && remaining < (int64_t)sizeof(buffer) ? (size_t)remaining : sizeof(buffer);
+        ssize_t n = recv(client->sock, buffer, want, 0);
+        if (n <= 0) {
+            if (remaining < 0 && n == 0) break;
+            return ESP_ERR_HTTP_FETCH_HEADER;
+        }
+        dispatch(client, HTTP_EVENT_ON_DATA, buffer, n);
+        if (remaining > 0) remaining -= n;
+    }
+
+    dispatch(client, HTTP_EVENT_ON_FINISH, NULL, 0);
+    if (!client->keep_alive || server_closes || client->content_length < 0) {
+        esp_http_client_close(client);
+    }
+    return ESP_OK;
+}
+
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config) {
+    esp_http_client_handle_t client = calloc(1, sizeof(*client));
+    if (!client) {
+        return NULL;
+    }
+    client->sock = -1;
+    client->method = config->method;
+    client->timeout_ms = config->timeout_ms > 0 ? config->timeout_ms : 5000;
+    client->keep_alive = config->keep_alive_enable;
+    client->event_handler = config->event_handler;
+    client->user_data = config->user_data;
+    client->content_length = -1;
+    if (parse_url(client, config->url) != ESP_OK) {
+        free(client);
+        return NULL;
+    }
+    return client;
+}
+
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url) {
+    return parse_url(client, url);
+}
+
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method) {
+    client->method = method;
+    return ESP_OK;
+}
+
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len) {
+    client->post_data = data;
+    client->post_len = len;
+    if (data && client->method == HTTP_METHOD_GET) {
+        client->method = HTTP_METHOD_POST;
+    }
+    return ESP_OK;
+}
+
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value) {
+    // Drop an earlier line of the same header
+    size_t key_len = strlen(key);
+    for (char *line = client->headers; *line;) {
+        char *next = strstr(line, "\r\n") + 2;
+        if (strncasecmp(line, key, key_len) == 0 && line[key_len] == ':') {
+            memmove(line, next, strlen(next) + 1);
+        } else {
+            line = next;
+        }
+    }
+
+    size_t used = strlen(client->headers);
+    int len = snprintf(client->headers + used, sizeof(client->headers) - used, "%s: %s\r\n", key, value);
+    if (len < 0 || (size_t)len >= sizeof(client->headers) - used) {
+        client->headers[used] = '\0';
+        return ESP_ERR_NO_MEM;
+    }
+    if (strcasecmp(key, "Content-Type") == 0) {
+        client->content_type_set = true;
+    }
+    return ESP_OK;
+}
+
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client) {
+    client->status = -1;
+    client->content_length = -1;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = client->sock >= 0;
+        esp_err_t err = reused ? ESP_OK : client_connect(client);
+        if (err == ESP_OK) err = send_request(client);
+        if (err == ESP_OK) err = read_response(client);
+        if (err == ESP_OK) {
+            return ESP_OK;
+        }
+        esp_http_client_close(client);
+        if (!reused) {
+            dispatch(client, HTTP_EVENT_ERROR, NULL, 0);
+            return err;
+        }
+        // The server may have dropped an idle keep-alive connection; retry once on a fresh one
+    }
+    return ESP_ERR_HTTP_CONNECT;
+}
+
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return client->status;
+}
+
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client) {
+    return client->content_length;
+}
+
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    if (client->sock >= 0) {
+        close(client->sock);
+        client->sock = -1;
+        dispatch(client, HTTP_EVENT_DISCONNECTED, NULL, 0);
+    }
+    return ESP_OK;
+}
+
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    esp_http_client_close(client);
+    free(client);
+    return ESP_OK;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file esp_http_client.h
+ * @brief Host shim for the subset of esp_http_client used by the controller sources.
+ *
+ * Plain HTTP/1.1 over a blocking socket: keep-alive connections are reused across requests, bodies are delivered
+ * through HTTP_EVENT_ON_DATA and responses must carry a Content-Length or close the connection.
+ */
+
+#ifndef HOST_SHIM_ESP_HTTP_CLIENT_H
+#define HOST_SHIM_ESP_HTTP_CLIENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef enum {
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+    HTTP_METHOD_PUT,
+    HTTP_METHOD_PATCH,
+    HTTP_METHOD_DELETE,
+    HTTP_METHOD_HEAD,
+} esp_http_client_method_t;
+
+typedef enum {
+    HTTP_EVENT_ERROR = 0,
+    HTTP_EVENT_ON_CONNECTED,
+    HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_ON_HEADER,
+    HTTP_EVENT_ON_DATA,
+    HTTP_EVENT_ON_FINISH,
+    HTTP_EVENT_DISCONNECTED,
+} esp_http_client_event_id_t;
+
+typedef struct {
+    esp_http_client_event_id_t event_id;
+    esp_http_client_handle_t client;
+    void *data;
+    int data_len;
+    void *user_data;
+    char *header_key;
+    char *header_value;
+} esp_http_client_event_t;
+
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *evt);
+
+typedef struct {
+    const char *url;
+    esp_http_client_method_t method;
+    int timeout_ms;
+    bool keep_alive_enable;
+    http_event_handle_cb event_handler;
+    void *user_data;
+} esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url);
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method);
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len);
+
+/**
+ * @brief Adds a request header sent with every following request, replacing an earlier value of the same header.
+ */
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+
+/**
+ * @brief Sends the request and reads the whole response, reconnecting once if a kept-alive socket went stale.
+ *
+ * @return ESP_OK once a response was read, ESP_ERR_HTTP_CONNECT, ESP_ERR_HTTP_WRITE_DATA or ESP_ERR_HTTP_FETCH_HEADER.
+ */
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client);
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
+
+#endif // HOST_SHIM_ESP_HTTP_CLIENT_H
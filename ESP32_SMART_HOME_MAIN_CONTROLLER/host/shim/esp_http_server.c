@@ -0,0 +1,965 @@
+/**
+ * @file esp_http_server.c
+ * @brief Host implementation of the esp_http_server shim: one select() thread serving HTTP/1.1 and WebSockets.
+ */
+
+#include "esp_http_server.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define HTTPD_BUFFER_LEN 2048       ///< Longest request head; also holds bytes read ahead of the current request.
+#define HTTPD_WORK_QUEUE_LEN 16
+
+#define RESUME_NONE 0
+#define RESUME_SERVE 1              ///< The detached request completed; serve the next one.
+#define RESUME_CLOSE 2              ///< The detached request failed to send; close the connection.
+
+uint16_t host_httpd_default_port = 80;
+
+typedef struct {
+    int fd;
+    bool websocket;
+    bool async;                 ///< A detached request owns the connection; not polled until it completes.
+    bool keep_alive;            ///< Keep-alive of the detached request.
+    int resume;                 ///< RESUME_* set by httpd_req_async_handler_complete() for the server thread.
+    const httpd_uri_t *ws_uri;
+    char buffer[HTTPD_BUFFER_LEN];
+    size_t len;
+} httpd_client_t;
+
+typedef struct {
+    httpd_work_fn_t fn;
+    void *arg;
+} httpd_work_t;
+
+typedef struct {
+    httpd_config_t config;
+    int listen_fd;
+    int wake[2];
+    pthread_t thread;
+    bool stopping;
+    httpd_uri_t *uris;
+    size_t uri_count;
+    pthread_mutex_t clients_lock;
+    httpd_client_t *clients;
+    pthread_mutex_t work_lock;
+    httpd_work_t work[HTTPD_WORK_QUEUE_LEN];
+    size_t work_head;
+    size_t work_count;
+} httpd_server_t;
+
+/** State behind httpd_req_t.aux for the request or WebSocket frame being handled. */
+typedef struct {
+    httpd_server_t *server;
+    httpd_client_t *client;
+    const char *headers;
+    size_t body_remaining;
+    const char *status;
+    const char *type;
+    const char *hdr_fields[16];
+    const char *hdr_values[16];
+    size_t hdr_count;
+    bool head_sent;
+    bool failed;
+    bool detached;              ///< httpd_req_async_handler_begin() was called for this request.
+    httpd_ws_type_t ws_type;
+    bool ws_final;
+    size_t ws_remaining;
+    uint8_t ws_mask[4];
+} httpd_ctx_t;
+
+
+/* ---------- Socket I/O ---------- */
+
+static bool send_all(int fd, const void *data, size_t len) {
+    const uint8_t *p = data;
+    while (len > 0) {
+        ssize_t sent = send(fd, p, len, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        p += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+
+/** Reads up to @p len bytes, from the read-ahead buffer first. Returns 0 on close, -1 on error or timeout. */
+static ssize_t client_read(httpd_client_t *client, void *dst, size_t len) {
+    if (client->len > 0) {
+        size_t n = len < client->len ? len : client->len;
+        memcpy(dst, client->buffer, n);
+        memmove(client->buffer, client->buffer + n, client->len - n);
+        client->len -= n;
+        return n;
+    }
+    return recv(client->fd, dst, len, 0);
+}
+
+
+static bool client_read_exact(httpd_client_t *client, void *dst, size_t len) {
+    uint8_t *p = dst;
+    while (len > 0) {
+        ssize_t n = client_read(client, p, len);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+
+static bool client_skip(httpd_client_t *client, size_t len) {
+    uint8_t discard[256];
+    while (len > 0) {
+        ssize_t n = client_read(client, discard, len < sizeof(discard) ? len : sizeof(discard));
+        if (n <= 0) return false;
+        len -= n;
+    }
+    return true;
+}
+
+
+/* ---------- Responses ---------- */
+
+static esp_err_t send_head(httpd_req_t *req, ssize_t content_length) {
+    httpd_ctx_t *ctx = req->aux;
+    char head[1024];
+    int len = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: %s\r\n", ctx->status, ctx->type);
+    for (size_t i = 0; i < ctx->hdr_count && len < (int)sizeof(head); i++) {
+        len += snprintf(head + len, sizeof(head) - len, "%s: %s\r\n", ctx->hdr_fields[i], ctx->hdr_values[i]);
+    }
+    if (len < (int)sizeof(head)) {
+        len += content_length >= 0
+               ? snprintf(head + len, sizeof(head) - len, "Content-Length: %zd\r\n\r\n", content_length)
+               : snprintf(head + len, sizeof(head) - len, "Transfer-Encoding: chunked\r\n\r\n");
+    }
+    if (len >= (int)sizeof(head)) {
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+
+    ctx->head_sent = true;
+    if (!send_all(ctx->client->fd, head, len)) {
+        ctx->failed = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status) {
+    ((httpd_ctx_t *)req->aux)->status = status;
+    return ESP_OK;
+}
+
+
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type) {
+    ((httpd_ctx_t *)req->aux)->type = type;
+    return ESP_OK;
+}
+
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value) {
+    httpd_ctx_t *ctx = req->aux;
+    if (ctx->hdr_count >= ctx->server->config.max_resp_headers ||
+        ctx->hdr_count >= sizeof(ctx->hdr_fields) / sizeof(ctx->hdr_fields[0])) {
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    ctx->hdr_fields[ctx->hdr_count] = field;
+    ctx->hdr_values[ctx->hdr_count] = value;
+    ctx->hdr_count++;
+    return ESP_OK;
+}
+
+
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len) {
+    httpd_ctx_t *ctx = req->aux;
+    if (buf_len == HTTPD_RESP_USE_STRLEN) {
+        buf_len = buf ? (ssize_t)strlen(buf) : 0;
+    }
+    esp_err_t err = send_head(req, buf_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (buf_len > 0 && !send_all(ctx->client->fd, buf, buf_len)) {
+        ctx->failed = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t buf_len) {
+    httpd_ctx_t *ctx = req->aux;
+    if (buf_len == HTTPD_RESP_USE_STRLEN) {
+        buf_len = buf ? (ssize_t)strlen(buf) : 0;
+    }
+    if (!ctx->head_sent && send_head(req, -1) != ESP_OK) {
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+
+    char size[16];
+    int len = snprintf(size, sizeof(size), "%zx\r\n", buf_len);
+    bool ok = send_all(ctx->client->fd, size, len) &&
+              (buf_len == 0 || send_all(ctx->client->fd, buf, buf_len)) &&
+              send_all(ctx->client->fd, "\r\n", 2);
+    if (!ok) {
+        ctx->failed = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *message) {
+    static const struct {
+        const char *status;
+        const char *message;
+    } errors[] = {
+        [HTTPD_400_BAD_REQUEST] = { "400 Bad Request", "Bad request syntax" },
+        [HTTPD_404_NOT_FOUND] = { "404 Not Found", "This URI does not exist" },
+        [HTTPD_405_METHOD_NOT_ALLOWED] = { "405 Method Not Allowed", "Request method for this URI is not handled by server" },
+        [HTTPD_408_REQ_TIMEOUT] = { "408 Request Timeout", "Server closed this connection" },
+        [HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE] = { "431 Request Header Fields Too Large", "Header fields are too long" },
+        [HTTPD_500_INTERNAL_SERVER_ERROR] = { "500 Internal Server Error", "Server has encountered an unexpected error" },
+    };
+    httpd_resp_set_status(req, errors[error].status);
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_send(req, message ? message : errors[error].message, HTTPD_RESP_USE_STRLEN);
+}
+
+
+/* ---------- Requests ---------- */
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out) {
+    httpd_ctx_t *ctx = r->aux;
+    httpd_req_t *copy = malloc(sizeof(*copy));
+    httpd_ctx_t *copy_ctx = malloc(sizeof(*copy_ctx));
+    if (!copy || !copy_ctx) {
+        free(copy);
+        free(copy_ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    *copy_ctx = *ctx;
+    copy_ctx->headers = NULL;   // They live on the server thread's stack
+    *copy = *r;
+    copy->aux = copy_ctx;
+
+    ctx->detached = true;
+    ctx->client->async = true;
+    *out = copy;
+    return ESP_OK;
+}
+
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r) {
+    httpd_ctx_t *ctx = r->aux;
+    httpd_server_t *server = ctx->server;
+    httpd_client_t *client = ctx->client;
+    int resume = ctx->failed ? RESUME_CLOSE : RESUME_SERVE;
+    free(ctx);
+    free(r);
+
+    __atomic_store_n(&client->resume, resume, __ATOMIC_RELEASE);
+    char wake = 'a';
+    (void)!write(server->wake[1], &wake, 1);
+    return ESP_OK;
+}
+
+
+int httpd_req_to_sockfd(httpd_req_t *req) {
+    return ((httpd_ctx_t *)req->aux)->client->fd;
+}
+
+
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t buf_len) {
+    httpd_ctx_t *ctx = req->aux;
+    if (ctx->body_remaining == 0) {
+        return 0;
+    }
+    ssize_t n = client_read(ctx->client, buf, buf_len < ctx->body_remaining ? buf_len : ctx->body_remaining);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL;
+    }
+    if (n == 0) {
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+    ctx->body_remaining -= n;
+    return n;
+}
+
+
+static esp_err_t copy_value(const char *value, size_t len, char *val, size_t val_size) {
+    if (val_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t n = len < val_size - 1 ? len : val_size - 1;
+    memcpy(val, value, n);
+    val[n] = '\0';
+    return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+
+size_t httpd_req_get_url_query_len(httpd_req_t *req) {
+    const char *query = strchr(req->uri, '?');
+    return query ? strlen(query + 1) : 0;
+}
+
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *req, char *buf, size_t buf_len) {
+    const char *query = strchr(req->uri, '?');
+    if (!query) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return copy_value(query + 1, strlen(query + 1), buf, buf_len);
+}
+
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size) {
+    size_t key_len = strlen(key);
+    for (const char *pair = qry; pair && *pair; pair = strchr(pair, '&') ? strchr(pair, '&') + 1 : NULL) {
+        if (strncmp(pair, key, key_len) == 0 && pair[key_len] == '=') {
+            const char *value = pair + key_len + 1;
+            return copy_value(value, strcspn(value, "&"), val, val_size);
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+
+static const char *find_header(httpd_req_t *req, const char *field, size_t *len) {
+    httpd_ctx_t *ctx = req->aux;
+    size_t field_len = strlen(field);
+    if (!ctx->headers) {
+        return NULL;
+    }
+    for (const char *line = ctx->headers; *line; ) {
+        const char *end = strstr(line, "\r\n");
+        size_t line_len = end ? (size_t)(end - line) : strlen(line);
+        if (line_len > field_len && strncasecmp(line, field, field_len) == 0 && line[field_len] == ':') {
+            const char *value = line + field_len + 1;
+            value += strspn(value, " \t");
+            *len = line + line_len - value;
+            return value;
+        }
+        line += line_len + (end ? 2 : 0);
+    }
+    return NULL;
+}
+
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *req, const char *field) {
+    size_t len;
+    return find_header(req, field, &len) ? len : 0;
+}
+
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size) {
+    size_t len;
+    const char *value = find_header(req, field, &len);
+    if (!value) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return copy_value(value, len, val, val_size);
+}
+
+
+/* ---------- WebSocket ---------- */
+
+static uint32_t rol(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+
+/** SHA-1 of a message shorter than 120 bytes (at most two blocks), which covers the Sec-WebSocket-Accept input. */
+static void sha1_short(const uint8_t *msg, size_t len, uint8_t digest[20]) {
+    uint8_t blocks[128] = { 0 };
+    size_t block_count = len + 9 <= 64 ? 1 : 2;
+    memcpy(blocks, msg, len);
+    blocks[len] = 0x80;
+    uint64_t bits = (uint64_t)len * 8;
+    for (int i = 0; i < 8; i++) {
+        blocks[block_count * 64 - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    for (size_t block = 0; block < block_count; block++) {
+        const uint8_t *p = blocks + block * 64;
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    for (int i = 0; i < 20; i++) {
+        digest[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+}
+
+
+static void base64_encode(const uint8_t *in, size_t len, char *out) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < len ? (uint32_t)in[i + 1] << 8 : 0) | (i + 2 < len ? in[i + 2] : 0);
+        *out++ = alphabet[(v >> 18) & 63];
+        *out++ = alphabet[(v >> 12) & 63];
+        *out++ = i + 1 < len ? alphabet[(v >> 6) & 63] : '=';
+        *out++ = i + 2 < len ? alphabet[v & 63] : '=';
+    }
+    *out = '\0';
+}
+
+
+static bool ws_upgrade(httpd_req_t *req) {
+    static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    char key[32];
+    if (httpd_req_get_hdr_value_str(req, "Sec-WebSocket-Key", key, sizeof(key)) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Not a WebSocket upgrade");
+        return false;
+    }
+
+    uint8_t input[sizeof(key) + sizeof(guid)];
+    uint8_t digest[20];
+    char accept[32];
+    size_t key_len = strlen(key);
+    memcpy(input, key, key_len);
+    memcpy(input + key_len, guid, sizeof(guid) - 1);
+    sha1_short(input, key_len + sizeof(guid) - 1, digest);
+    base64_encode(digest, sizeof(digest), accept);
+
+    char response[160];
+    int len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                       "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+    return send_all(httpd_req_to_sockfd(req), response, len);
+}
+
+
+static bool ws_send(int fd, bool final, httpd_ws_type_t type, const uint8_t *payload, size_t len) {
+    uint8_t header[10];
+    size_t header_len = 2;
+    header[0] = (final ? 0x80 : 0) | type;
+    if (len < 126) {
+        header[1] = (uint8_t)len;
+    } else if (len <= UINT16_MAX) {
+        header[1] = 126;
+        header[2] = (uint8_t)(len >> 8);
+        header[3] = (uint8_t)len;
+        header_len = 4;
+    } else {
+        header[1] = 127;
+        for (int i = 0; i < 8; i++) {
+            header[2 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+        }
+        header_len = 10;
+    }
+    return send_all(fd, header, header_len) && (len == 0 || send_all(fd, payload, len));
+}
+
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len) {
+    httpd_ctx_t *ctx = req->aux;
+    frame->type = ctx->ws_type;
+    frame->final = ctx->ws_final;
+    frame->fragmented = !ctx->ws_final;
+    frame->len = ctx->ws_remaining;
+    if (max_len == 0) {
+        return ESP_OK;
+    }
+    if (max_len < ctx->ws_remaining) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (!client_read_exact(ctx->client, frame->payload, ctx->ws_remaining)) {
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < ctx->ws_remaining; i++) {
+        frame->payload[i] ^= ctx->ws_mask[i % 4];
+    }
+    ctx->ws_remaining = 0;
+    return ESP_OK;
+}
+
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t handle, int fd, httpd_ws_frame_t *frame) {
+    if (httpd_ws_get_fd_info(handle, fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ws_send(fd, frame->final, frame->type, frame->payload, frame->len) ? ESP_OK : ESP_FAIL;
+}
+
+
+/* ---------- Sessions ---------- */
+
+static httpd_client_t *find_client(httpd_server_t *server, int fd) {
+    for (size_t i = 0; i < server->config.max_open_sockets; i++) {
+        if (server->clients[i].fd == fd) {
+            return &server->clients[i];
+        }
+    }
+    return NULL;
+}
+
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds, int *client_fds) {
+    httpd_server_t *server = handle;
+    size_t count = 0;
+
+    pthread_mutex_lock(&server->clients_lock);
+    for (size_t i = 0; i < server->config.max_open_sockets; i++) {
+        if (server->clients[i].fd >= 0) {
+            if (count == *fds) {
+                pthread_mutex_unlock(&server->clients_lock);
+                return ESP_ERR_INVALID_ARG;
+            }
+            client_fds[count++] = server->clients[i].fd;
+        }
+    }
+    pthread_mutex_unlock(&server->clients_lock);
+    *fds = count;
+    return ESP_OK;
+}
+
+
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t handle, int sockfd) {
+    httpd_server_t *server = handle;
+    httpd_ws_client_info_t info = HTTPD_WS_CLIENT_INVALID;
+
+    pthread_mutex_lock(&server->clients_lock);
+    httpd_client_t *client = find_client(server, sockfd);
+    if (client) {
+        info = client->websocket ? HTTPD_WS_CLIENT_WEBSOCKET : HTTPD_WS_CLIENT_HTTP;
+    }
+    pthread_mutex_unlock(&server->clients_lock);
+    return info;
+}
+
+
+static void client_close(httpd_server_t *server, httpd_client_t *client) {
+    pthread_mutex_lock(&server->clients_lock);
+    close(client->fd);
+    client->fd = -1;
+    client->websocket = false;
+    client->async = false;
+    client->resume = RESUME_NONE;
+    client->ws_uri = NULL;
+    client->len = 0;
+    pthread_mutex_unlock(&server->clients_lock);
+}
+
+
+static void client_accept(httpd_server_t *server) {
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+
+    struct timeval recv_timeout = { .tv_sec = server->config.recv_wait_timeout };
+    struct timeval send_timeout = { .tv_sec = server->config.send_wait_timeout };
+    int nodelay = 1;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &recv_timeout, sizeof(recv_timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    pthread_mutex_lock(&server->clients_lock);
+    httpd_client_t *client = find_client(server, -1);
+    if (client) {
+        client->fd = fd;
+        client->len = 0;
+    }
+    pthread_mutex_unlock(&server->clients_lock);
+    if (!client) {
+        close(fd);  // Over max_open_sockets
+    }
+}
+
+
+static const httpd_uri_t *find_uri(httpd_server_t *server, const char *uri, int method, bool *path_found) {
+    size_t path_len = strcspn(uri, "?");
+    *path_found = false;
+    for (size_t i = 0; i < server->uri_count; i++) {
+        const httpd_uri_t *entry = &server->uris[i];
+        if (strlen(entry->uri) == path_len && strncmp(entry->uri, uri, path_len) == 0) {
+            *path_found = true;
+            if ((int)entry->method == method) {
+                return entry;
+            }
+        }
+    }
+    return NULL;
+}
+
+
+static int parse_method(const char *name, size_t len) {
+    static const struct {
+        const char *name;
+        httpd_method_t method;
+    } methods[] = {
+        { "DELETE", HTTP_DELETE }, { "GET", HTTP_GET }, { "HEAD", HTTP_HEAD }, { "POST", HTTP_POST }, { "PUT", HTTP_PUT },
+    };
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        if (strlen(methods[i].name) == len && strncmp(methods[i].name, name, len) == 0) {
+            return methods[i].method;
+        }
+    }
+    return -1;
+}
+
+
+/** Serves the request at the front of the client buffer. Returns false when the connection must be closed. */
+static bool serve_request(httpd_server_t *server, httpd_client_t *client, size_t head_len) {
+    char head[HTTPD_BUFFER_LEN];
+    memcpy(head, client->buffer, head_len);
+    head[head_len - 2] = '\0';  // Keep the last header's CRLF so every header line ends in one
+    memmove(client->buffer, client->buffer + head_len, client->len - head_len);
+    client->len -= head_len;
+
+    httpd_ctx_t ctx = { .server = server, .client = client, .status = "200 OK", .type = "text/html" };
+    httpd_req_t req = { .handle = server, .aux = &ctx };
+
+    // Request line: METHOD SP target SP HTTP/1.x
+    char *target = strchr(head, ' ');
+    char *version = target ? strchr(target + 1, ' ') : NULL;
+    char *line_end = strstr(head, "\r\n");
+    if (!target || !version || !line_end || version > line_end || (size_t)(version - target - 1) >= sizeof(req.uri)) {
+        httpd_resp_send_err(&req, HTTPD_400_BAD_REQUEST, NULL);
+        return false;
+    }
+    req.method = parse_method(head, target - head);
+    memcpy(req.uri, target + 1, version - target - 1);
+    req.uri[version - target - 1] = '\0';
+    ctx.headers = line_end + 2;
+
+    char value[32];
+    if (httpd_req_get_hdr_value_str(&req, "Content-Length", value, sizeof(value)) == ESP_OK) {
+        req.content_len = strtoul(value, NULL, 10);
+    }
+    ctx.body_remaining = req.content_len;
+    bool keep_alive = !(httpd_req_get_hdr_value_str(&req, "Connection", value, sizeof(value)) == ESP_OK &&
+                        strcasecmp(value, "close") == 0);
+
+    bool path_found;
+    const httpd_uri_t *uri = find_uri(server, req.uri, req.method, &path_found);
+    esp_err_t err;
+    if (!uri) {
+        err = httpd_resp_send_err(&req, path_found ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND, NULL);
+    } else if (uri->is_websocket) {
+        if (!ws_upgrade(&req)) {
+            return false;
+        }
+        pthread_mutex_lock(&server->clients_lock);
+        client->websocket = true;
+        client->ws_uri = uri;
+        pthread_mutex_unlock(&server->clients_lock);
+        req.user_ctx = uri->user_ctx;
+        return uri->handler(&req) == ESP_OK;
+    } else {
+        req.user_ctx = uri->user_ctx;
+        err = uri->handler(&req);
+    }
+
+    // Whatever the handler left of the body is not part of the next request
+    if (err != ESP_OK || ctx.failed || !client_skip(client, ctx.body_remaining)) {
+        return false;
+    }
+    if (ctx.detached) {
+        client->keep_alive = keep_alive;
+        return true;
+    }
+    return keep_alive;
+}
+
+
+/** Reads one frame header and dispatches the frame. Returns false when the connection must be closed. */
+static bool serve_frame(httpd_server_t *server, httpd_client_t *client) {
+    uint8_t header[2];
+    if (!client_read_exact(client, header, sizeof(header))) {
+        return false;
+    }
+
+    httpd_ctx_t ctx = { .server = server, .client = client };
+    ctx.ws_final = (header[0] & 0x80) != 0;
+    ctx.ws_type = header[0] & 0x0f;
+    uint64_t len = header[1] & 0x7f;
+    if (len >= 126) {
+        uint8_t ext[8];
+        size_t ext_len = len == 126 ? 2 : 8;
+        if (!client_read_exact(client, ext, ext_len)) return false;
+        len = 0;
+        for (size_t i = 0; i < ext_len; i++) len = len << 8 | ext[i];
+    }
+    if (!(header[1] & 0x80) || !client_read_exact(client, ctx.ws_mask, sizeof(ctx.ws_mask))) {
+        return false;  // Client frames must be masked
+    }
+    ctx.ws_remaining = len;
+
+    httpd_req_t req = { .handle = server, .method = 0, .aux = &ctx, .user_ctx = client->ws_uri->user_ctx };
+    strcpy(req.uri, client->ws_uri->uri);
+
+    if (ctx.ws_type == HTTPD_WS_TYPE_CLOSE || ctx.ws_type == HTTPD_WS_TYPE_PING) {
+        uint8_t payload[125];
+        httpd_ws_frame_t frame = { .payload = payload };
+        if (len > sizeof(payload) || httpd_ws_recv_frame(&req, &frame, sizeof(payload)) != ESP_OK) {
+            return false;
+        }
+        if (ctx.ws_type == HTTPD_WS_TYPE_CLOSE) {
+            ws_send(client->fd, true, HTTPD_WS_TYPE_CLOSE, payload, len < 2 ? len : 2);
+            return false;
+        }
+        return ws_send(client->fd, true, HTTPD_WS_TYPE_PONG, payload, len);
+    }
+    if (ctx.ws_type == HTTPD_WS_TYPE_PONG) {
+        return client_skip(client, len);
+    }
+
+    if (client->ws_uri->handler(&req) != ESP_OK) {
+        return false;
+    }
+    return client_skip(client, ctx.ws_remaining);
+}
+
+
+static bool serve_buffered(httpd_server_t *server, httpd_client_t *client);
+
+
+static bool serve_client(httpd_server_t *server, httpd_client_t *client) {
+    if (client->websocket) {
+        // The frames arrive straight from the socket; only bytes read along with the upgrade sit in the buffer
+        do {
+            if (!serve_frame(server, client)) return false;
+        } while (client->len > 0);
+        return true;
+    }
+
+    ssize_t n = recv(client->fd, client->buffer + client->len, sizeof(client->buffer) - 1 - client->len, 0);
+    if (n <= 0) {
+        return false;
+    }
+    client->len += n;
+    return serve_buffered(server, client);
+}
+
+
+/** Serves every complete request in the buffer; pipelined requests do not wake select() again. */
+static bool serve_buffered(httpd_server_t *server, httpd_client_t *client) {
+    client->buffer[client->len] = '\0';
+    char *end;
+    while (!client->websocket && !client->async && (end = strstr(client->buffer, "\r\n\r\n")) != NULL) {
+        if (!serve_request(server, client, end + 4 - client->buffer)) {
+            return false;
+        }
+        client->buffer[client->len] = '\0';
+    }
+    if (client->websocket) {
+        return client->len == 0 || serve_client(server, client);
+    }
+    if (!client->async && client->len == sizeof(client->buffer) - 1) {
+        httpd_ctx_t ctx = { .server = server, .client = client, .status = "200 OK", .type = "text/html" };
+        httpd_req_t req = { .handle = server, .aux = &ctx };
+        httpd_resp_send_err(&req, HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE, NULL);
+        return false;
+    }
+    return true;
+}
+
+
+/* ---------- Server ---------- */
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg) {
+    httpd_server_t *server = handle;
+
+    pthread_mutex_lock(&server->work_lock);
+    if (server->work_count == HTTPD_WORK_QUEUE_LEN) {
+        pthread_mutex_unlock(&server->work_lock);
+        return ESP_FAIL;
+    }
+    server->work[(server->work_head + server->work_count) % HTTPD_WORK_QUEUE_LEN] = (httpd_work_t){ work, arg };
+    server->work_count++;
+    pthread_mutex_unlock(&server->work_lock);
+
+    // A full pipe already wakes the server, so a failed write loses nothing
+    char wake = 'w';
+    (void)!write(server->wake[1], &wake, 1);
+    return ESP_OK;
+}
+
+
+static void run_work(httpd_server_t *server) {
+    char drain[64];
+    while (read(server->wake[0], drain, sizeof(drain)) > 0) {
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&server->work_lock);
+        if (server->work_count == 0) {
+            pthread_mutex_unlock(&server->work_lock);
+            return;
+        }
+        httpd_work_t work = server->work[server->work_head];
+        server->work_head = (server->work_head + 1) % HTTPD_WORK_QUEUE_LEN;
+        server->work_count--;
+        pthread_mutex_unlock(&server->work_lock);
+        work.fn(work.arg);
+    }
+}
+
+
+static void *server_thread(void *arg) {
+    httpd_server_t *server = arg;
+
+    while (!__atomic_load_n(&server->stopping, __ATOMIC_ACQUIRE)) {
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(server->listen_fd, &read_fds);
+        FD_SET(server->wake[0], &read_fds);
+        int max_fd = server->listen_fd > server->wake[0] ? server->listen_fd : server->wake[0];
+        for (size_t i = 0; i < server->config.max_open_sockets; i++) {
+            int fd = server->clients[i].fd;
+            if (fd >= 0 && !server->clients[i].async) {
+                FD_SET(fd, &read_fds);
+                if (fd > max_fd) max_fd = fd;
+            }
+        }
+
+        if (select(max_fd + 1, &read_fds, NULL, NULL, NULL) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (FD_ISSET(server->wake[0], &read_fds)) {
+            run_work(server);
+            for (size_t i = 0; i < server->config.max_open_sockets; i++) {
+                httpd_client_t *client = &server->clients[i];
+                int resume = client->fd >= 0 ? __atomic_exchange_n(&client->resume, RESUME_NONE, __ATOMIC_ACQ_REL)
+                                             : RESUME_NONE;
+                if (resume == RESUME_NONE) continue;
+                client->async = false;
+                if (resume == RESUME_CLOSE || !client->keep_alive || !serve_buffered(server, client)) {
+                    client_close(server, client);
+                }
+            }
+        }
+        if (FD_ISSET(server->listen_fd, &read_fds)) {
+            client_accept(server);
+        }
+        for (size_t i = 0; i < server->config.max_open_sockets; i++) {
+            httpd_client_t *client = &server->clients[i];
+            if (client->fd >= 0 && !client->async && FD_ISSET(client->fd, &read_fds) &&
+                !serve_client(server, client)) {
+                client_close(server, client);
+            }
+        }
+    }
+    return NULL;
+}
+
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+    httpd_server_t *server = calloc(1, sizeof(*server));
+    if (!server) {
+        return ESP_ERR_NO_MEM;
+    }
+    server->config = *config;
+    server->uris = calloc(config->max_uri_handlers, sizeof(*server->uris));
+    server->clients = calloc(config->max_open_sockets, sizeof(*server->clients));
+    if (!server->uris || !server->clients) {
+        free(server->uris);
+        free(server->clients);
+        free(server);
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < config->max_open_sockets; i++) {
+        server->clients[i].fd = -1;
+    }
+    pthread_mutex_init(&server->clients_lock, NULL);
+    pthread_mutex_init(&server->work_lock, NULL);
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(config->server_port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    int reuse = 1;
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->listen_fd < 0 ||
+        setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, config->max_open_sockets) != 0 ||
+        pipe2(server->wake, O_NONBLOCK) != 0) {
+        if (server->listen_fd >= 0) close(server->listen_fd);
+        free(server->uris);
+        free(server->clients);
+        free(server);
+        return ESP_ERR_HTTPD_TASK;
+    }
+
+    if (pthread_create(&server->thread, NULL, server_thread, server) != 0) {
+        close(server->listen_fd);
+        close(server->wake[0]);
+        close(server->wake[1]);
+        free(server->uris);
+        free(server->clients);
+        free(server);
+        return ESP_ERR_HTTPD_TASK;
+    }
+    *handle = server;
+    return ESP_OK;
+}
+
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+    httpd_server_t *server = handle;
+    __atomic_store_n(&server->stopping, true, __ATOMIC_RELEASE);
+    char wake = 's';
+    (void)!write(server->wake[1], &wake, 1);
+    pthread_join(server->thread, NULL);
+
+    for (size_t i = 0; i < server->config.max_open_sockets; i++) {
+        if (server->clients[i].fd >= 0) close(server->clients[i].fd);
+    }
+    close(server->listen_fd);
+    close(server->wake[0]);
+    close(server->wake[1]);
+    free(server->uris);
+    free(server->clients);
+    free(server);
+    return ESP_OK;
+}
+
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler) {
+    httpd_server_t *server = handle;
+    bool path_found;
+    if (find_uri(server, uri_handler->uri, uri_handler->method, &path_found)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (server->uri_count == server->config.max_uri_handlers) {
+        fprintf(stderr, "E (httpd_uri) No slots left for registering handler %s\n", uri_handler->uri);
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+    server->uris[server->uri_count++] = *uri_handler;
+    return ESP_OK;
+}
@@ -0,0 +1,182 @@
+/**
+ * @file esp_http_server.h
+ * @brief Host shim for the subset of esp_http_server used by the controller sources.
+ *
+ * One server thread multiplexes the listening socket, the open connections and httpd_queue_work with select(),
+ * and runs every handler and queued work item, like the single httpd task on the device. URIs are matched
+ * exactly; WebSocket endpoints answer the upgrade themselves and handle close and ping frames internally.
+ * A request detached with httpd_req_async_handler_begin() parks its connection until another thread completes it.
+ */
+
+#ifndef HOST_SHIM_ESP_HTTP_SERVER_H
+#define HOST_SHIM_ESP_HTTP_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+typedef void *httpd_handle_t;
+typedef void (*httpd_work_fn_t)(void *arg);
+
+/** Same numbering as the http_parser methods the IDF uses. */
+typedef enum {
+    HTTP_DELETE = 0,
+    HTTP_GET = 1,
+    HTTP_HEAD = 2,
+    HTTP_POST = 3,
+    HTTP_PUT = 4,
+} httpd_method_t;
+
+typedef enum {
+    HTTPD_400_BAD_REQUEST,
+    HTTPD_404_NOT_FOUND,
+    HTTPD_405_METHOD_NOT_ALLOWED,
+    HTTPD_408_REQ_TIMEOUT,
+    HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE,
+    HTTPD_500_INTERNAL_SERVER_ERROR,
+} httpd_err_code_t;
+
+#define HTTPD_SOCK_ERR_FAIL     -1
+#define HTTPD_SOCK_ERR_INVALID  -2
+#define HTTPD_SOCK_ERR_TIMEOUT  -3
+
+#define HTTPD_RESP_USE_STRLEN   -1
+
+typedef struct {
+    uint16_t server_port;
+    uint16_t max_open_sockets;
+    uint16_t max_uri_handlers;
+    uint16_t max_resp_headers;
+    uint16_t recv_wait_timeout;     ///< Seconds.
+    uint16_t send_wait_timeout;     ///< Seconds.
+    size_t stack_size;              ///< Ignored.
+    unsigned task_priority;         ///< Ignored.
+    bool lru_purge_enable;          ///< Ignored; connections beyond max_open_sockets are refused.
+} httpd_config_t;
+
+/**
+ * @brief Port HTTPD_DEFAULT_CONFIG() listens on. Defaults to 80 like the device; host_main changes it.
+ */
+extern uint16_t host_httpd_default_port;
+
+#define HTTPD_DEFAULT_CONFIG() {                    \
+        .server_port = host_httpd_default_port,     \
+        .max_open_sockets = 7,                      \
+        .max_uri_handlers = 8,                      \
+        .max_resp_headers = 8,                      \
+        .recv_wait_timeout = 5,                     \
+        .send_wait_timeout = 5,                     \
+        .stack_size = 4096,                         \
+        .task_priority = 5,                         \
+        .lru_purge_enable = false,                  \
+    }
+
+typedef struct httpd_req {
+    httpd_handle_t handle;
+    int method;                     ///< httpd_method_t, or 0 for a frame on an open WebSocket.
+    char uri[512];
+    size_t content_len;
+    void *user_ctx;
+    void *aux;                      ///< Connection state private to the shim.
+} httpd_req_t;
+
+typedef struct {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *req);
+    void *user_ctx;
+    bool is_websocket;
+} httpd_uri_t;
+
+typedef enum {
+    HTTPD_WS_TYPE_CONTINUE = 0x0,
+    HTTPD_WS_TYPE_TEXT = 0x1,
+    HTTPD_WS_TYPE_BINARY = 0x2,
+    HTTPD_WS_TYPE_CLOSE = 0x8,
+    HTTPD_WS_TYPE_PING = 0x9,
+    HTTPD_WS_TYPE_PONG = 0xA,
+} httpd_ws_type_t;
+
+typedef enum {
+    HTTPD_WS_CLIENT_INVALID = 0x0,
+    HTTPD_WS_CLIENT_HTTP = 0x1,
+    HTTPD_WS_CLIENT_WEBSOCKET = 0x2,
+} httpd_ws_client_info_t;
+
+typedef struct {
+    bool final;
+    bool fragmented;
+    httpd_ws_type_t type;
+    uint8_t *payload;
+    size_t len;
+} httpd_ws_frame_t;
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler);
+
+/**
+ * @brief Runs @p work on the server thread. Never blocks; fails if the work queue is full.
+ */
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg);
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds, int *client_fds);
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t handle, int sockfd);
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t handle, int fd, httpd_ws_frame_t *frame);
+
+/**
+ * @brief Reads the current frame: with @p max_len 0 only fills in its type and length, otherwise also the payload.
+ */
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len);
+
+/**
+ * @brief Copies the request so another task can send its response; the connection serves nothing else until then.
+ *
+ * Headers cannot be read from the copy, and the body must be read before the handler returns.
+ */
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out);
+
+/**
+ * @brief Frees a request copied by httpd_req_async_handler_begin() and lets its connection serve the next request.
+ */
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r);
+
+int httpd_req_to_sockfd(httpd_req_t *req);
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t buf_len);
+size_t httpd_req_get_url_query_len(httpd_req_t *req);
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *req, char *buf, size_t buf_len);
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size);
+size_t httpd_req_get_hdr_value_len(httpd_req_t *req, const char *field);
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size);
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status);
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value);
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t buf_len);
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *message);
+
+static inline esp_err_t httpd_resp_sendstr(httpd_req_t *req, const char *str) {
+    return httpd_resp_send(req, str, str ? (ssize_t)strlen(str) : 0);
+}
+
+static inline esp_err_t httpd_resp_sendstr_chunk(httpd_req_t *req, const char *str) {
+    return httpd_resp_send_chunk(req, str, str ? (ssize_t)strlen(str) : 0);
+}
+
+static inline esp_err_t httpd_resp_send_404(httpd_req_t *req) {
+    return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+}
+
+static inline esp_err_t httpd_resp_send_408(httpd_req_t *req) {
+    return httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, NULL);
+}
+
+static inline esp_err_t httpd_resp_send_500(httpd_req_t *req) {
+    return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+}
+
+#endif // HOST_SHIM_ESP_HTTP_SERVER_H
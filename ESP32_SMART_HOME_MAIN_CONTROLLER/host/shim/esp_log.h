@@ -0,0 +1,50 @@
+/**
+ * @file esp_log.h
+ * @brief Host shim for the ESP-IDF logging macros.
+ *
+ * Maps ESP_LOGx and esp_log_write onto stderr so controller sources compile unchanged on Linux.
+ */
+
+#ifndef HOST_SHIM_ESP_LOG_H
+#define HOST_SHIM_ESP_LOG_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_timer.h"
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) fprintf(stderr, "I (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do { } while (0)
+#define ESP_LOGV(tag, format, ...) do { } while (0)
+
+/**
+ * @brief Milliseconds since the process started.
+ */
+static inline uint32_t esp_log_timestamp(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static inline void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static inline void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    (void)level;
+    (void)tag;
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+#endif // HOST_SHIM_ESP_LOG_H
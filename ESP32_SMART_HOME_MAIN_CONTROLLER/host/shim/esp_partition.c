@@ -0,0 +1,69 @@
+/**
+ * @file esp_partition.c
+ * @brief Host implementation of the esp_partition shim on store_file.c.
+ */
+
+#include <string.h>
+#include "esp_partition.h"
+#include "store_file.h"
+
+static const esp_partition_t telemetry_partition = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = TELEMETRY_STORE_PARTITION_SUBTYPE,
+    .address = 0x110000,
+    .size = 0x80000,
+    .erase_size = 4096,
+    .label = "telemetry",
+};
+
+static const char *image_path = NULL;
+static store_file_t image;
+static telemetry_store_flash_t image_flash;
+static bool image_open = false;
+
+
+void host_partition_set_image(const char *path) {
+    image_path = path;
+}
+
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    if (type != telemetry_partition.type || subtype != telemetry_partition.subtype ||
+        (label && strcmp(label, telemetry_partition.label) != 0) || !image_path) {
+        return NULL;
+    }
+    if (!image_open) {
+        if (store_file_open(&image, &image_flash, image_path, telemetry_partition.size,
+                            telemetry_partition.erase_size) != ESP_OK) {
+            return NULL;
+        }
+        image_open = true;
+    }
+    return &telemetry_partition;
+}
+
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size) {
+    if (partition != &telemetry_partition || src_offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return image_flash.read(image_flash.ctx, src_offset, dst, size);
+}
+
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) {
+    if (partition != &telemetry_partition || dst_offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return image_flash.write(image_flash.ctx, dst_offset, src, size);
+}
+
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    if (partition != &telemetry_partition || offset + size > partition->size ||
+        offset % partition->erase_size != 0 || size % partition->erase_size != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return image_flash.erase(image_flash.ctx, offset, size);
+}
@@ -0,0 +1,43 @@
+/**
+ * @file esp_partition.h
+ * @brief Host shim for the esp_partition API, backed by a flash image file.
+ *
+ * The host has a single partition, "telemetry", sized like the entry in partitions.csv and stored in the file
+ * given to host_partition_set_image() with the NOR semantics of store_file.c.
+ */
+
+#ifndef HOST_SHIM_ESP_PARTITION_H
+#define HOST_SHIM_ESP_PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef int esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+} esp_partition_t;
+
+/**
+ * @brief Sets the image file the telemetry partition lives in; without one the partition is not found.
+ */
+void host_partition_set_image(const char *path);
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+
+#endif // HOST_SHIM_ESP_PARTITION_H
@@ -0,0 +1,18 @@
+/**
+ * @file esp_random.h
+ * @brief Host shim for the ESP-IDF hardware random number generator, on the kernel's getrandom().
+ */
+
+#ifndef HOST_SHIM_ESP_RANDOM_H
+#define HOST_SHIM_ESP_RANDOM_H
+
+#include <stdint.h>
+#include <sys/random.h>
+
+static inline uint32_t esp_random(void) {
+    uint32_t value = 0;
+    getrandom(&value, sizeof(value), 0);
+    return value;
+}
+
+#endif // HOST_SHIM_ESP_RANDOM_H
@@ -0,0 +1,25 @@
+/**
+ * @file esp_rom_crc.h
+ * @brief Host shim for the ROM CRC32 routine.
+ */
+
+#ifndef HOST_SHIM_ESP_ROM_CRC_H
+#define HOST_SHIM_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+/**
+ * @brief Little-endian (reflected) CRC32 with the same conventions as the ROM: pass 0 to start a new checksum.
+ */
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+#endif // HOST_SHIM_ESP_ROM_CRC_H
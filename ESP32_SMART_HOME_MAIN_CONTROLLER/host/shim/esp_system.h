@@ -0,0 +1,19 @@
+/**
+ * @file esp_system.h
+ * @brief Host shim for the ESP-IDF heap size queries.
+ *
+ * heap.c wraps the C allocator of controller_host and reports every block the controller holds against a
+ * notional heap of HOST_HEAP_SIZE bytes, so the gauges move like the board's would.
+ */
+
+#ifndef HOST_SHIM_ESP_SYSTEM_H
+#define HOST_SHIM_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+#define HOST_HEAP_SIZE (320 * 1024)     ///< Notional heap, about what an ESP32 has free after Wi-Fi is up.
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+#endif // HOST_SHIM_ESP_SYSTEM_H
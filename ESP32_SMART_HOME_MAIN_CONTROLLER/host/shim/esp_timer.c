@@ -0,0 +1,26 @@
+/**
+ * @file esp_timer.c
+ * @brief Host implementation of esp_timer_get_time on CLOCK_MONOTONIC.
+ */
+
+#include <time.h>
+#include "esp_timer.h"
+
+static int64_t boot_us;
+
+
+static int64_t monotonic_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+
+__attribute__((constructor)) static void esp_timer_boot(void) {
+    boot_us = monotonic_us();
+}
+
+
+int64_t esp_timer_get_time(void) {
+    return monotonic_us() - boot_us;
+}
@@ -0,0 +1,16 @@
+/**
+ * @file esp_timer.h
+ * @brief Host shim for esp_timer_get_time.
+ */
+
+#ifndef HOST_SHIM_ESP_TIMER_H
+#define HOST_SHIM_ESP_TIMER_H
+
+#include <stdint.h>
+
+/**
+ * @brief Microseconds since the process started, standing in for microseconds since boot.
+ */
+int64_t esp_timer_get_time(void);
+
+#endif // HOST_SHIM_ESP_TIMER_H
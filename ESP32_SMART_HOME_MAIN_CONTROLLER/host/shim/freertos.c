@@ -0,0 +1,340 @@
+/**
+ * @file freertos.c
+ * @brief Host implementation of the FreeRTOS shim on pthreads.
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static __thread struct host_task *current_task = NULL;
+static __thread struct host_task adopted_task;     ///< Handle of a thread not started with xTaskCreate.
+static uint32_t next_core = 0;
+
+
+struct timespec host_deadline(TickType_t ticks) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += ticks / 1000;
+    deadline.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+
+static void cond_init(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+
+/** Waits on @p cond until woken or the tick timeout expires; returns false on timeout. */
+static bool cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks, const struct timespec *deadline) {
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) == 0;
+}
+
+
+static struct host_task *task_init(struct host_task *task, const char *name) {
+    memset(task, 0, sizeof(*task));
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->core = __atomic_fetch_add(&next_core, 1, __ATOMIC_RELAXED) % portNUM_PROCESSORS;
+    pthread_mutex_init(&task->lock, NULL);
+    cond_init(&task->notified);
+    return task;
+}
+
+
+static struct host_task *task_new(const char *name) {
+    struct host_task *task = malloc(sizeof(*task));
+    if (!task) abort();
+    return task_init(task, name);
+}
+
+
+static void *task_main(void *arg) {
+    current_task = arg;
+    current_task->fn(current_task->arg);
+    return NULL;
+}
+
+
+static BaseType_t task_start(struct host_task *task, TaskFunction_t fn, void *arg) {
+    task->fn = fn;
+    task->arg = arg;
+    if (pthread_create(&task->thread, NULL, task_main, task) != 0) {
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+    (void)stack_depth;
+    (void)priority;
+    struct host_task *task = task_new(name);
+    if (handle) *handle = task;
+    return task_start(task, fn, arg);
+}
+
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                               UBaseType_t priority, StackType_t *stack, StaticTask_t *buffer) {
+    (void)stack_depth;
+    (void)priority;
+    (void)stack;
+    struct host_task *task = task_init(buffer, name);
+    return task_start(task, fn, arg) == pdPASS ? task : NULL;
+}
+
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    (void)task;
+    return 0;
+}
+
+
+char *pcTaskGetName(TaskHandle_t task) {
+    return (task ? task : xTaskGetCurrentTaskHandle())->name;
+}
+
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+    (void)core;
+    return xTaskCreate(fn, name, stack_depth, arg, priority, handle);
+}
+
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == current_task) {
+        pthread_exit(NULL);
+    }
+    abort();  // Deleting another task is not used by the controller
+}
+
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec delay = { .tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000 };
+    nanosleep(&delay, NULL);
+}
+
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (!current_task) {
+        // Not allocated: the allocator hooks ask for the current task on every allocation
+        current_task = task_init(&adopted_task, "thread");
+        current_task->thread = pthread_self();
+    }
+    return current_task;
+}
+
+
+BaseType_t xPortGetCoreID(void) {
+    return xTaskGetCurrentTaskHandle()->core;
+}
+
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    BaseType_t result = pdPASS;
+
+    pthread_mutex_lock(&task->lock);
+    switch (action) {
+    case eSetBits: task->notify_value |= value; break;
+    case eIncrement: task->notify_value++; break;
+    case eSetValueWithOverwrite: task->notify_value = value; break;
+    case eSetValueWithoutOverwrite:
+        if (task->notify_pending) result = pdFAIL;
+        else task->notify_value = value;
+        break;
+    case eNoAction: break;
+    }
+    task->notify_pending = true;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    return result;
+}
+
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks) {
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline = host_deadline(ticks);
+    BaseType_t result = pdTRUE;
+
+    pthread_mutex_lock(&task->lock);
+    if (!task->notify_pending) {
+        task->notify_value &= ~clear_on_entry;
+    }
+    while (!task->notify_pending) {
+        if (ticks == 0 || !cond_wait(&task->notified, &task->lock, ticks, &deadline)) {
+            result = task->notify_pending ? pdTRUE : pdFALSE;
+            break;
+        }
+    }
+    if (value) *value = task->notify_value;
+    if (result == pdTRUE) {
+        task->notify_value &= ~clear_on_exit;
+        task->notify_pending = false;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return result;
+}
+
+
+static QueueHandle_t queue_init(StaticQueue_t *queue, UBaseType_t length, UBaseType_t item_size, uint8_t *storage) {
+    pthread_mutex_init(&queue->lock, NULL);
+    cond_init(&queue->changed);
+    queue->item_size = item_size;
+    queue->length = length;
+    queue->count = 0;
+    queue->head = 0;
+    queue->storage = storage;
+    return queue;
+}
+
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    StaticQueue_t *queue = malloc(sizeof(*queue));
+    return queue ? queue_init(queue, length, item_size, item_size ? calloc(length, item_size) : NULL) : NULL;
+}
+
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage, StaticQueue_t *buffer) {
+    return queue_init(buffer, length, item_size, storage);
+}
+
+
+static void queue_push(QueueHandle_t queue, const void *item) {
+    if (queue->item_size) {
+        memcpy(queue->storage + ((queue->head + queue->count) % queue->length) * queue->item_size,
+               item, queue->item_size);
+    }
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+}
+
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    struct timespec deadline = host_deadline(ticks);
+    BaseType_t result = pdTRUE;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length) {
+        if (ticks == 0 || !cond_wait(&queue->changed, &queue->lock, ticks, &deadline)) {
+            result = queue->count < queue->length ? pdTRUE : pdFALSE;
+            break;
+        }
+    }
+    if (result == pdTRUE) {
+        queue_push(queue, item);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return result;
+}
+
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    struct timespec deadline = host_deadline(ticks);
+    BaseType_t result = pdTRUE;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length) {
+        if (ticks == 0 || !cond_wait(&queue->changed, &queue->lock, ticks, &deadline)) {
+            result = queue->count < queue->length ? pdTRUE : pdFALSE;
+            break;
+        }
+    }
+    if (result == pdTRUE) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        if (queue->item_size) {
+            memcpy(queue->storage + queue->head * queue->item_size, item, queue->item_size);
+        }
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return result;
+}
+
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+    pthread_mutex_lock(&queue->lock);
+    queue->count = 0;  // Only used on queues of length one
+    queue_push(queue, item);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    struct timespec deadline = host_deadline(ticks);
+    BaseType_t result = pdTRUE;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        if (ticks == 0 || !cond_wait(&queue->changed, &queue->lock, ticks, &deadline)) {
+            result = queue->count > 0 ? pdTRUE : pdFALSE;
+            break;
+        }
+    }
+    if (result == pdTRUE) {
+        if (queue->item_size) {
+            memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+        }
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return result;
+}
+
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+
+void vQueueDelete(QueueHandle_t queue) {
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->storage);
+    free(queue);
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer) {
+    queue_init(buffer, 1, 0, NULL);
+    buffer->count = 1;  // A mutex starts out available
+    return buffer;
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    StaticSemaphore_t *buffer = malloc(sizeof(*buffer));
+    return buffer ? xSemaphoreCreateMutexStatic(buffer) : NULL;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host shim for the FreeRTOS types, ticks and critical sections used by the controller sources.
+ *
+ * Ticks are milliseconds since start. portENTER_CRITICAL/portEXIT_CRITICAL map onto a test-and-set spinlock;
+ * tasks, queues and semaphores are implemented on pthreads in freertos.c.
+ */
+
+#ifndef HOST_SHIM_FREERTOS_H
+#define HOST_SHIM_FREERTOS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;
+
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY 0xffffffffu
+#define portNUM_PROCESSORS 2
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTICKS_TO_MS(ticks) ((uint32_t)(ticks))
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define tskNO_AFFINITY 0x7fffffff
+
+typedef struct {
+    volatile int owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+
+#define portENTER_CRITICAL(mux) \
+    do { \
+        while (__atomic_exchange_n(&(mux)->owner, 1, __ATOMIC_ACQUIRE)) { \
+        } \
+    } while (0)
+
+#define portEXIT_CRITICAL(mux) __atomic_store_n(&(mux)->owner, 0, __ATOMIC_RELEASE)
+
+/**
+ * @brief Queue storage; also used for semaphores, which are queues of zero-sized items.
+ */
+typedef struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint8_t *storage;
+    size_t item_size;
+    size_t length;
+    size_t count;
+    size_t head;
+} StaticQueue_t;
+
+typedef StaticQueue_t StaticSemaphore_t;
+typedef struct host_queue *QueueHandle_t;
+typedef struct host_queue *SemaphoreHandle_t;
+
+/**
+ * @brief Task control block, so xTaskCreateStatic() can take it from the caller like on the target.
+ */
+typedef struct host_task {
+    pthread_t thread;
+    void (*fn)(void *);
+    void *arg;
+    char name[16];
+    uint32_t core;
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notify_value;
+    bool notify_pending;
+} StaticTask_t;
+
+typedef struct host_task *TaskHandle_t;
+
+/**
+ * @brief Returns the core the caller runs on; the host reports threads as alternating between two cores.
+ */
+BaseType_t xPortGetCoreID(void);
+
+/**
+ * @brief Converts a tick timeout into an absolute CLOCK_MONOTONIC deadline for pthread_cond_timedwait.
+ */
+struct timespec host_deadline(TickType_t ticks);
+
+#endif // HOST_SHIM_FREERTOS_H
@@ -0,0 +1,22 @@
+/**
+ * @file queue.h
+ * @brief Host shim for the FreeRTOS queue functions, on a mutex and a condition variable.
+ */
+
+#ifndef HOST_SHIM_FREERTOS_QUEUE_H
+#define HOST_SHIM_FREERTOS_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage, StaticQueue_t *buffer);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+void vQueueDelete(QueueHandle_t queue);
+
+#define xQueueSendToBack xQueueSend
+
+#endif // HOST_SHIM_FREERTOS_QUEUE_H
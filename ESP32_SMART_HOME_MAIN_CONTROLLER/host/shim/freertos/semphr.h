@@ -0,0 +1,17 @@
+/**
+ * @file semphr.h
+ * @brief Host shim for the FreeRTOS mutexes: queues of one zero-sized item that start full.
+ */
+
+#ifndef HOST_SHIM_FREERTOS_SEMPHR_H
+#define HOST_SHIM_FREERTOS_SEMPHR_H
+
+#include "freertos/queue.h"
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer);
+
+#define xSemaphoreTake(sem, ticks) xQueueReceive((sem), NULL, (ticks))
+#define xSemaphoreGive(sem) xQueueSend((sem), NULL, 0)
+
+#endif // HOST_SHIM_FREERTOS_SEMPHR_H
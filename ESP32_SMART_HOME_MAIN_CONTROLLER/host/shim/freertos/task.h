@@ -0,0 +1,61 @@
+/**
+ * @file task.h
+ * @brief Host shim for the FreeRTOS task functions: every task is a detached pthread.
+ */
+
+#ifndef HOST_SHIM_FREERTOS_TASK_H
+#define HOST_SHIM_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+/**
+ * @brief Starts a task on a new thread. Stack depth and priority are ignored.
+ */
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle);
+
+/**
+ * @brief Starts a task whose control block is @p buffer. The thread runs on its own stack, so @p stack is unused.
+ */
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                               UBaseType_t priority, StackType_t *stack, StaticTask_t *buffer);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+
+/**
+ * @brief Ends the calling task; deleting other tasks is not supported.
+ */
+void vTaskDelete(TaskHandle_t task);
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+/**
+ * @brief Returns the calling task; threads not started by xTaskCreate get a handle on first use.
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+/**
+ * @brief Host threads do not report their stack use; always 0.
+ */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+char *pcTaskGetName(TaskHandle_t task);
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks);
+
+#define xTaskNotifyGive(task) xTaskNotify((task), 0, eIncrement)
+
+#endif // HOST_SHIM_FREERTOS_TASK_H
@@ -0,0 +1,103 @@
+/**
+ * @file heap.c
+ * @brief Host accounting of the controller's heap, wrapping malloc, calloc, realloc and free.
+ *
+ * controller_host links with -Wl,--wrap for the four allocator functions, so every allocation made by the
+ * controller sources, the shims and cJSON passes through here, while the C library's own allocations do not.
+ * Live blocks and their usable sizes are counted and subtracted from HOST_HEAP_SIZE, and every allocation and free
+ * is passed to the application's allocator hooks like the IDF allocator does with CONFIG_HEAP_USE_HOOKS, which lets
+ * /metrics show whether anything allocates once the controller has started, even a block freed right away.
+ */
+
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static size_t live_blocks = 0;
+static size_t live_bytes = 0;
+static size_t peak_bytes = 0;
+
+
+static void account_alloc(void *ptr) {
+    if (!ptr) return;
+    esp_heap_trace_alloc_hook(ptr, malloc_usable_size(ptr), MALLOC_CAP_DEFAULT);
+    size_t bytes = __atomic_add_fetch(&live_bytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&live_blocks, 1, __ATOMIC_RELAXED);
+
+    size_t peak = __atomic_load_n(&peak_bytes, __ATOMIC_RELAXED);
+    while (bytes > peak &&
+           !__atomic_compare_exchange_n(&peak_bytes, &peak, bytes, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+
+static void account_free(void *ptr) {
+    if (!ptr) return;
+    esp_heap_trace_free_hook(ptr);
+    __atomic_fetch_sub(&live_bytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&live_blocks, 1, __ATOMIC_RELAXED);
+}
+
+
+void *__wrap_malloc(size_t size) {
+    void *ptr = __real_malloc(size);
+    account_alloc(ptr);
+    return ptr;
+}
+
+
+void *__wrap_calloc(size_t count, size_t size) {
+    void *ptr = __real_calloc(count, size);
+    account_alloc(ptr);
+    return ptr;
+}
+
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    // The old block is accounted as freed up front; on failure it is still live and counted again
+    account_free(ptr);
+    void *moved = __real_realloc(ptr, size);
+    account_alloc(moved ? moved : (size ? ptr : NULL));
+    return moved;
+}
+
+
+void __wrap_free(void *ptr) {
+    account_free(ptr);
+    __real_free(ptr);
+}
+
+
+static uint32_t free_of(size_t bytes) {
+    return bytes < HOST_HEAP_SIZE ? (uint32_t)(HOST_HEAP_SIZE - bytes) : 0;
+}
+
+
+uint32_t esp_get_free_heap_size(void) {
+    return free_of(__atomic_load_n(&live_bytes, __ATOMIC_RELAXED));
+}
+
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    return free_of(__atomic_load_n(&peak_bytes, __ATOMIC_RELAXED));
+}
+
+
+void heap_caps_get_info(multi_heap_info_t *info, uint32_t caps) {
+    (void)caps;
+    size_t bytes = __atomic_load_n(&live_bytes, __ATOMIC_RELAXED);
+    info->total_free_bytes = free_of(bytes);
+    info->total_allocated_bytes = bytes;
+    info->largest_free_block = info->total_free_bytes;
+    info->minimum_free_bytes = esp_get_minimum_free_heap_size();
+    info->allocated_blocks = __atomic_load_n(&live_blocks, __ATOMIC_RELAXED);
+    info->free_blocks = 0;
+    info->total_blocks = info->allocated_blocks;
+}
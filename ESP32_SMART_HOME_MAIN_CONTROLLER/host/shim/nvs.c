@@ -0,0 +1,118 @@
+/**
+ * @file nvs.c
+ * @brief Host shim for the ESP-IDF non-volatile storage blob functions, on an in-memory table.
+ *
+ * A handle is the index of its namespace in a small fixed table; entries are looked up by namespace and key.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvs.h"
+
+#define NVS_MAX_NAMESPACES 4
+#define NVS_MAX_ENTRIES 16
+#define NVS_NAME_MAX 16         ///< Namespace and key length limit of the IDF, including the terminator.
+
+typedef struct {
+    nvs_handle_t ns;            ///< Handle of the namespace, or 0 if the slot is free.
+    char key[NVS_NAME_MAX];
+    void *value;
+    size_t length;
+} nvs_entry_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static char namespaces[NVS_MAX_NAMESPACES][NVS_NAME_MAX];
+static nvs_entry_t entries[NVS_MAX_ENTRIES];
+
+
+static nvs_entry_t *entry_find(nvs_handle_t handle, const char *key) {
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        if (entries[i].ns == handle && strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    if (strlen(namespace_name) >= NVS_NAME_MAX) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < NVS_MAX_NAMESPACES; i++) {
+        if (strcmp(namespaces[i], namespace_name) == 0 ||
+            (namespaces[i][0] == '\0' && open_mode == NVS_READWRITE)) {
+            strcpy(namespaces[i], namespace_name);
+            *out_handle = i + 1;
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&lock);
+    nvs_entry_t *entry = entry_find(handle, key);
+    if (!entry) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (!out_value) {
+        *length = entry->length;
+    } else if (*length < entry->length) {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out_value, entry->value, entry->length);
+        *length = entry->length;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    if (strlen(key) >= NVS_NAME_MAX) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&lock);
+    nvs_entry_t *entry = entry_find(handle, key);
+    if (!entry) {
+        entry = entry_find(0, "");
+    }
+    void *copy = malloc(length ? length : 1);
+    if (!entry) {
+        err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    } else if (!copy) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        free(entry->value);
+        memcpy(copy, value, length);
+        entry->ns = handle;
+        strcpy(entry->key, key);
+        entry->value = copy;
+        entry->length = length;
+        copy = NULL;
+    }
+    pthread_mutex_unlock(&lock);
+    free(copy);
+    return err;
+}
+
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    (void)handle;
+    return ESP_OK;
+}
+
+
+void nvs_close(nvs_handle_t handle) {
+    (void)handle;
+}
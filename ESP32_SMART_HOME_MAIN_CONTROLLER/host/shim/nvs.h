@@ -0,0 +1,28 @@
+/**
+ * @file nvs.h
+ * @brief Host shim for the ESP-IDF non-volatile storage blob functions.
+ *
+ * Entries are kept in memory for the lifetime of the process, so stored settings start over on every run.
+ */
+
+#ifndef HOST_SHIM_NVS_H
+#define HOST_SHIM_NVS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+esp_err_t nvs_commit(nvs_handle_t handle);
+void nvs_close(nvs_handle_t handle);
+
+#endif // HOST_SHIM_NVS_H
@@ -0,0 +1,22 @@
+/**
+ * @file sdkconfig.h
+ * @brief Host stand-in for the generated sdkconfig.h.
+ *
+ * Mirrors the values in sdkconfig.esp32thing that the controller sources read. Tracing is enabled by configuring
+ * the host build with -DSMARTHOME_TRACE=ON, which defines CONFIG_SMARTHOME_TRACE on the command line.
+ */
+
+#ifndef HOST_SHIM_SDKCONFIG_H
+#define HOST_SHIM_SDKCONFIG_H
+
+#define CONFIG_LOG_MAXIMUM_LEVEL 3
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 160
+#define CONFIG_SMARTHOME_UPLINK_URL ""      // controller_host takes the uplink URL on the command line
+#define CONFIG_SMARTHOME_UPLINK_INTERVAL_S 60
+#define CONFIG_HEAP_USE_HOOKS 1             // shim/heap.c calls esp_heap_trace_alloc_hook() like the IDF allocator
+
+#if defined(CONFIG_SMARTHOME_TRACE) && !defined(CONFIG_SMARTHOME_TRACE_EVENTS)
+#define CONFIG_SMARTHOME_TRACE_EVENTS 512
+#endif
+
+#endif // HOST_SHIM_SDKCONFIG_H
@@ -0,0 +1,428 @@
+/**
+ * @file station_fleet.c
+ * @brief Simulated station fleet for load-testing the ESP32 Smart Home Main Controller.
+ *
+ * Every simulated station behaves like TempHumLightStation: it connects to the controller's TCP port,
+ * performs the HANDSHAKE:ARDUINO_READY exchange under its own station ID ("fleet<n>", reporting temperature,
+ * humidity and lux without plugs of its own), then streams DATA: frames at a fixed rate whether or not
+ * the previous frame was acknowledged, and answers temp=..&humidity=.. setpoint pushes with SETPOINTS_ACK.
+ * Unlike ingest_bench, which keeps one frame in flight per station, the offered load here does not back off
+ * when the controller slows down, so the fleet finds the point where ACK latency and drops start to grow.
+ *
+ * At the end the tool reports handshake times, throughput, ACK latency percentiles, frames that were never
+ * acknowledged (dropped), lost connections and setpoint pushes answered. ACKs carry no ID, so they are
+ * matched to frames in order per station.
+ *
+ * Usage:
+ *   station_fleet <controller-ip> [-p port] [-n stations] [-r frames-per-second-per-station] [-d seconds]
+ *
+ * Defaults: port 8080, 16 stations, 1 frame per second, 10 seconds.
+ *
+ * Dependencies:
+ * - POSIX sockets and poll().
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define FLEET_MAX_STATIONS 1024
+#define FLEET_LINE_SIZE 256
+#define FLEET_IN_FLIGHT 1024            ///< Unacknowledged frames remembered per station.
+#define HANDSHAKE_TIMEOUT_MS 30000
+#define DRAIN_MS 2000                   ///< Wait for late ACKs before counting frames as dropped.
+
+typedef enum {
+    STATION_CONNECTING,
+    STATION_HANDSHAKE,
+    STATION_STREAMING,
+    STATION_CLOSED,
+} station_phase_t;
+
+typedef struct {
+    int sock;
+    station_phase_t phase;
+    char hello[64];                         ///< Handshake message, carrying the station ID.
+    char line[FLEET_LINE_SIZE];
+    size_t line_len;
+    uint64_t connect_started_ns;
+    uint64_t next_send_ns;
+    uint64_t in_flight[FLEET_IN_FLIGHT];    ///< Send times of unacknowledged frames, oldest at head.
+    size_t in_flight_head;
+    size_t in_flight_count;
+    uint32_t seq;
+} fleet_station_t;
+
+typedef struct {
+    uint64_t *samples;
+    size_t count;
+    size_t capacity;
+} sample_log_t;
+
+typedef struct {
+    uint64_t frames_sent;
+    uint64_t frames_acked;
+    uint64_t frames_overrun;        ///< Forgotten because more than FLEET_IN_FLIGHT were unacknowledged.
+    uint64_t pushes_answered;
+    uint64_t rejected;              ///< ERROR:SERVER_FULL answers.
+    uint64_t lost;                  ///< Connections closed by the controller after the handshake.
+    sample_log_t handshake_ns;
+    sample_log_t ack_ns;
+} fleet_stats_t;
+
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+
+static void sample_add(sample_log_t *log, uint64_t value) {
+    if (log->count == log->capacity) {
+        log->capacity = log->capacity ? log->capacity * 2 : 4096;
+        log->samples = realloc(log->samples, log->capacity * sizeof(uint64_t));
+        if (!log->samples) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    log->samples[log->count++] = value;
+}
+
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+/** Expects @p log to be sorted. */
+static double percentile_ms(const sample_log_t *log, double pct) {
+    if (log->count == 0) return 0.0;
+    size_t index = (size_t)(pct / 100.0 * (double)(log->count - 1) + 0.5);
+    return log->samples[index] / 1e6;
+}
+
+
+static bool send_line(int sock, const char *line) {
+    size_t total = strlen(line), sent = 0;
+    while (sent < total) {
+        ssize_t n = send(sock, line + sent, total - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd = {.fd = sock, .events = POLLOUT};
+                poll(&pfd, 1, 100);
+                continue;
+            }
+            return false;
+        }
+        sent += (size_t)n;
+    }
+    return true;
+}
+
+
+static void station_close(fleet_station_t *st) {
+    if (st->sock >= 0) close(st->sock);
+    st->sock = -1;
+    st->phase = STATION_CLOSED;
+}
+
+
+static void station_connect(fleet_station_t *st, const struct sockaddr_storage *addr, socklen_t addr_len) {
+    st->sock = socket(addr->ss_family, SOCK_STREAM, 0);
+    if (st->sock < 0) {
+        st->phase = STATION_CLOSED;
+        return;
+    }
+    int nodelay = 1;
+    setsockopt(st->sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    fcntl(st->sock, F_SETFL, fcntl(st->sock, F_GETFL, 0) | O_NONBLOCK);
+
+    st->connect_started_ns = now_ns();
+    if (connect(st->sock, (const struct sockaddr *)addr, addr_len) == 0) {
+        st->phase = STATION_HANDSHAKE;
+        send_line(st->sock, st->hello);
+    } else if (errno == EINPROGRESS) {
+        st->phase = STATION_CONNECTING;
+    } else {
+        station_close(st);
+    }
+}
+
+
+static bool send_frame(fleet_station_t *st, int index, fleet_stats_t *stats) {
+    char frame[FLEET_LINE_SIZE];
+    st->seq++;
+    snprintf(frame, sizeof(frame),
+        "DATA:{\"temperature\":%d.%02d,\"humidity\":%d.%02d,\"lux\":%u,\"heater\":%s,\"dehumidifier\":false,"
+        "\"sp_temperature\":22.00,\"sp_humidity\":50.00}\n",
+        20 + index % 5, (int)(st->seq % 100), 40 + index % 10, (int)((st->seq * 7) % 100),
+        (unsigned)(300 + st->seq % 50), (st->seq & 1) ? "true" : "false");
+
+    if (st->in_flight_count == FLEET_IN_FLIGHT) {
+        st->in_flight_head = (st->in_flight_head + 1) % FLEET_IN_FLIGHT;
+        st->in_flight_count--;
+        stats->frames_overrun++;
+    }
+    st->in_flight[(st->in_flight_head + st->in_flight_count) % FLEET_IN_FLIGHT] = now_ns();
+    st->in_flight_count++;
+    stats->frames_sent++;
+    return send_line(st->sock, frame);
+}
+
+
+static void handle_line(fleet_station_t *st, const char *line, fleet_stats_t *stats) {
+    if (strcmp(line, "ACK") == 0) {
+        if (st->in_flight_count > 0) {
+            sample_add(&stats->ack_ns, now_ns() - st->in_flight[st->in_flight_head]);
+            st->in_flight_head = (st->in_flight_head + 1) % FLEET_IN_FLIGHT;
+            st->in_flight_count--;
+            stats->frames_acked++;
+        }
+    } else if (strncmp(line, "temp=", 5) == 0) {
+        // Setpoint push; answer with its ID like the station firmware does
+        char ack[48];
+        const char *id = strstr(line, "&id=");
+        snprintf(ack, sizeof(ack), id ? "SETPOINTS_ACK:%s\n" : "SETPOINTS_ACK\n", id ? id + 4 : "");
+        if (send_line(st->sock, ack)) stats->pushes_answered++;
+    } else if (strncmp(line, "HANDSHAKE:ESP32_READY", 21) == 0 && (line[21] == '\0' || line[21] == ';') &&
+               st->phase == STATION_HANDSHAKE) {
+        sample_add(&stats->handshake_ns, now_ns() - st->connect_started_ns);
+        st->phase = STATION_STREAMING;
+    } else if (strcmp(line, "ERROR:SERVER_FULL") == 0) {
+        stats->rejected++;
+    }
+}
+
+
+/** Reads what is available and handles complete lines. Returns false once the connection is gone. */
+static bool station_read(fleet_station_t *st, fleet_stats_t *stats) {
+    char chunk[512];
+    for (;;) {
+        ssize_t n = recv(st->sock, chunk, sizeof(chunk), 0);
+        if (n == 0) return false;
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+        for (ssize_t i = 0; i < n; i++) {
+            if (chunk[i] == '\n') {
+                if (st->line_len > 0 && st->line[st->line_len - 1] == '\r') st->line_len--;
+                st->line[st->line_len] = '\0';
+                handle_line(st, st->line, stats);
+                st->line_len = 0;
+            } else if (st->line_len < FLEET_LINE_SIZE - 1) {
+                st->line[st->line_len++] = chunk[i];
+            }
+        }
+    }
+}
+
+
+/** Services every socket once, waiting at most @p timeout_ms. */
+static void poll_stations(fleet_station_t *stations, struct pollfd *pfds, int count, int timeout_ms,
+                          fleet_stats_t *stats) {
+    for (int i = 0; i < count; i++) {
+        pfds[i].fd = stations[i].sock;
+        pfds[i].events = stations[i].phase == STATION_CONNECTING ? POLLOUT : POLLIN;
+    }
+    if (poll(pfds, (nfds_t)count, timeout_ms) <= 0) return;
+
+    for (int i = 0; i < count; i++) {
+        fleet_station_t *st = &stations[i];
+        if (pfds[i].fd < 0 || pfds[i].revents == 0) continue;
+
+        if (st->phase == STATION_CONNECTING) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(st->sock, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err != 0 || !send_line(st->sock, st->hello)) {
+                station_close(st);
+            } else {
+                st->phase = STATION_HANDSHAKE;
+            }
+            continue;
+        }
+        if (!station_read(st, stats)) {
+            if (st->phase == STATION_STREAMING) stats->lost++;
+            station_close(st);
+        }
+    }
+}
+
+
+static void print_progress(double elapsed, const fleet_stats_t *now, const fleet_stats_t *before,
+                           const fleet_station_t *stations, int count) {
+    uint64_t in_flight = 0;
+    int streaming = 0;
+    for (int i = 0; i < count; i++) {
+        in_flight += stations[i].in_flight_count;
+        if (stations[i].phase == STATION_STREAMING) streaming++;
+    }
+    printf("%7.1f %9d %10llu %10llu %10llu\n", elapsed, streaming,
+           (unsigned long long)(now->frames_sent - before->frames_sent),
+           (unsigned long long)(now->frames_acked - before->frames_acked), (unsigned long long)in_flight);
+    fflush(stdout);
+}
+
+
+static void print_summary(fleet_stats_t *stats, const fleet_station_t *stations, int count, double elapsed) {
+    uint64_t unacked = 0;
+    int streaming = 0;
+    for (int i = 0; i < count; i++) {
+        unacked += stations[i].in_flight_count;
+        if (stations[i].phase == STATION_STREAMING) streaming++;
+    }
+    qsort(stats->handshake_ns.samples, stats->handshake_ns.count, sizeof(uint64_t), compare_u64);
+    qsort(stats->ack_ns.samples, stats->ack_ns.count, sizeof(uint64_t), compare_u64);
+
+    printf("\nstations      %d requested, %zu handshaked, %d streaming at end, %llu rejected, %llu lost\n",
+           count, stats->handshake_ns.count, streaming,
+           (unsigned long long)stats->rejected, (unsigned long long)stats->lost);
+    printf("handshake ms  p50 %.1f  p99 %.1f  max %.1f\n",
+           percentile_ms(&stats->handshake_ns, 50.0), percentile_ms(&stats->handshake_ns, 99.0),
+           percentile_ms(&stats->handshake_ns, 100.0));
+    printf("frames        %llu sent, %llu acked, %llu dropped (%.3f%%)\n",
+           (unsigned long long)stats->frames_sent, (unsigned long long)stats->frames_acked,
+           (unsigned long long)(unacked + stats->frames_overrun),
+           stats->frames_sent ? 100.0 * (unacked + stats->frames_overrun) / stats->frames_sent : 0.0);
+    printf("throughput    %.1f frames/s acked\n", stats->frames_acked / elapsed);
+    printf("ack ms        p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n",
+           percentile_ms(&stats->ack_ns, 50.0), percentile_ms(&stats->ack_ns, 90.0),
+           percentile_ms(&stats->ack_ns, 99.0), percentile_ms(&stats->ack_ns, 99.9),
+           percentile_ms(&stats->ack_ns, 100.0));
+    printf("setpoints     %llu pushes answered\n", (unsigned long long)stats->pushes_answered);
+}
+
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s <controller-ip> [-p port] [-n stations] [-r frames-per-second] [-d seconds]\n", name);
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argv[1][0] == '-') {
+        usage(argv[0]);
+        return 2;
+    }
+    const char *host = argv[1];
+    const char *port = "8080";
+    int count = 16;
+    double rate = 1.0;
+    int seconds = 10;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-p") == 0) port = argv[i + 1];
+        else if (strcmp(argv[i], "-n") == 0) count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-r") == 0) rate = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-d") == 0) seconds = atoi(argv[i + 1]);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (count < 1 || count > FLEET_MAX_STATIONS || rate <= 0.0 || seconds < 1) {
+        fprintf(stderr, "stations must be 1..%d, rate > 0 and seconds >= 1\n", FLEET_MAX_STATIONS);
+        return 2;
+    }
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *res = NULL;
+    int rc = getaddrinfo(host, port, &hints, &res);
+    if (rc != 0) {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rc));
+        return 1;
+    }
+    struct sockaddr_storage addr;
+    socklen_t addr_len = (socklen_t)res->ai_addrlen;
+    memcpy(&addr, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+
+    fleet_station_t *stations = calloc((size_t)count, sizeof(fleet_station_t));
+    struct pollfd *pfds = calloc((size_t)count, sizeof(struct pollfd));
+    fleet_stats_t stats = {0};
+    if (!stations || !pfds) {
+        perror("calloc");
+        return 1;
+    }
+
+    // Connect everything at once, like a fleet coming back after the controller reboots
+    for (int i = 0; i < count; i++) {
+        snprintf(stations[i].hello, sizeof(stations[i].hello),
+                 "HANDSHAKE:ARDUINO_READY;id=fleet%d;caps=temp,hum,lux\n", i);
+        station_connect(&stations[i], &addr, addr_len);
+    }
+
+    uint64_t period_ns = (uint64_t)(1e9 / rate);
+    uint64_t start = now_ns();
+    uint64_t handshake_deadline = start + (uint64_t)HANDSHAKE_TIMEOUT_MS * 1000000ull;
+    uint64_t end = start + (uint64_t)seconds * 1000000000ull;
+    uint64_t next_report = start + 1000000000ull;
+    fleet_stats_t reported = stats;
+
+    printf("%7s %9s %10s %10s %10s\n", "time s", "streaming", "sent", "acked", "in flight");
+    for (uint64_t now = start; now < end; now = now_ns()) {
+        uint64_t wake = next_report;
+        for (int i = 0; i < count; i++) {
+            fleet_station_t *st = &stations[i];
+            if (st->phase == STATION_HANDSHAKE && now > handshake_deadline) {
+                station_close(st);
+            }
+            if (st->phase != STATION_STREAMING) continue;
+
+            if (st->next_send_ns == 0) {
+                // Spread the first frames over one period so the fleet does not send in lockstep
+                st->next_send_ns = now + period_ns * (uint64_t)i / (uint64_t)count;
+            }
+            while (st->next_send_ns <= now) {
+                if (!send_frame(st, i, &stats)) {
+                    stats.lost++;
+                    station_close(st);
+                    break;
+                }
+                st->next_send_ns += period_ns;
+            }
+            if (st->phase == STATION_STREAMING && st->next_send_ns < wake) wake = st->next_send_ns;
+        }
+
+        int timeout_ms = wake > now ? (int)((wake - now) / 1000000ull) : 0;
+        poll_stations(stations, pfds, count, timeout_ms, &stats);
+
+        if (now_ns() >= next_report) {
+            print_progress((now_ns() - start) / 1e9, &stats, &reported, stations, count);
+            reported = stats;
+            next_report += 1000000000ull;
+        }
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    // Late ACKs still count; whatever is unacknowledged after the drain was dropped
+    uint64_t drain_end = now_ns() + (uint64_t)DRAIN_MS * 1000000ull;
+    while (now_ns() < drain_end) {
+        poll_stations(stations, pfds, count, 50, &stats);
+    }
+
+    print_summary(&stats, stations, count, elapsed);
+
+    for (int i = 0; i < count; i++) {
+        station_close(&stations[i]);
+    }
+    free(stats.handshake_ns.samples);
+    free(stats.ack_ns.samples);
+    free(pfds);
+    free(stations);
+    return 0;
+}
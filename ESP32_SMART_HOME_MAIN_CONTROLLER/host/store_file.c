@@ -0,0 +1,92 @@
+/**
+ * @file store_file.c
+ * @brief File-backed flash emulation for running the telemetry store on the host.
+ */
+
+#include "store_file.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static esp_err_t file_read(void *ctx, size_t offset, void *buf, size_t len) {
+    store_file_t *file = ctx;
+    file->reads++;
+    file->bytes_read += len;
+    return pread(file->fd, buf, len, offset) == (ssize_t)len ? ESP_OK : ESP_FAIL;
+}
+
+
+static esp_err_t file_write(void *ctx, size_t offset, const void *buf, size_t len) {
+    store_file_t *file = ctx;
+    uint8_t current[4096];
+    const uint8_t *src = buf;
+
+    file->writes++;
+    file->bytes_written += len;
+    for (size_t done = 0; done < len; ) {
+        size_t chunk = len - done < sizeof(current) ? len - done : sizeof(current);
+        if (pread(file->fd, current, chunk, offset + done) != (ssize_t)chunk) return ESP_FAIL;
+        for (size_t i = 0; i < chunk; i++) {
+            current[i] &= src[done + i];    // NOR flash can only clear bits
+        }
+        if (pwrite(file->fd, current, chunk, offset + done) != (ssize_t)chunk) return ESP_FAIL;
+        done += chunk;
+    }
+    return ESP_OK;
+}
+
+
+static esp_err_t file_erase(void *ctx, size_t offset, size_t len) {
+    store_file_t *file = ctx;
+    uint8_t blank[4096];
+    memset(blank, 0xFF, sizeof(blank));
+
+    file->erases++;
+    for (size_t done = 0; done < len; done += sizeof(blank)) {
+        size_t chunk = len - done < sizeof(blank) ? len - done : sizeof(blank);
+        if (pwrite(file->fd, blank, chunk, offset + done) != (ssize_t)chunk) return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+
+esp_err_t store_file_open(store_file_t *file, telemetry_store_flash_t *flash, const char *path,
+                          size_t size, size_t sector_size) {
+    memset(file, 0, sizeof(*file));
+    file->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (file->fd < 0) {
+        return ESP_FAIL;
+    }
+
+    struct stat st;
+    if (fstat(file->fd, &st) != 0) {
+        close(file->fd);
+        return ESP_FAIL;
+    }
+    if ((size_t)st.st_size < size) {
+        // Extend a new or short image with erased sectors
+        if (file_erase(file, st.st_size - st.st_size % sector_size, size - (st.st_size - st.st_size % sector_size)) != ESP_OK) {
+            close(file->fd);
+            return ESP_FAIL;
+        }
+        file->erases = 0;
+    }
+
+    flash->ctx = file;
+    flash->size = size;
+    flash->sector_size = sector_size;
+    flash->read = file_read;
+    flash->write = file_write;
+    flash->erase = file_erase;
+    return ESP_OK;
+}
+
+
+void store_file_close(store_file_t *file) {
+    if (file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+}
@@ -0,0 +1,47 @@
+/**
+ * @file store_file.h
+ * @brief File-backed flash emulation for running the telemetry store on the host.
+ *
+ * Writes can only clear bits and erases set whole sectors to 0xFF, like the NOR flash behind an esp_partition,
+ * so recovery after torn writes behaves the same as on the device.
+ */
+
+#ifndef STORE_FILE_H
+#define STORE_FILE_H
+
+#include <stdint.h>
+#include "telemetry_store.h"
+
+/**
+ * @brief Backend state and I/O counters.
+ */
+typedef struct {
+    int fd;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t erases;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+} store_file_t;
+
+/**
+ * @brief Opens or creates a flash image file and fills @p flash with a backend for it.
+ *
+ * A new file is created blank (all 0xFF).
+ *
+ * @param file Receives the backend state.
+ * @param flash Receives the backend.
+ * @param path Path of the image file.
+ * @param size Size of the emulated partition in bytes.
+ * @param sector_size Erase unit in bytes.
+ * @return ESP_OK on success, ESP_FAIL if the file cannot be opened.
+ */
+esp_err_t store_file_open(store_file_t *file, telemetry_store_flash_t *flash, const char *path,
+                          size_t size, size_t sector_size);
+
+/**
+ * @brief Closes the image file.
+ */
+void store_file_close(store_file_t *file);
+
+#endif // STORE_FILE_H
@@ -0,0 +1,313 @@
+/**
+ * @file uplink_sink.c
+ * @brief Stand-in upstream for testing the uplink of the ESP32 Smart Home Main Controller.
+ *
+ * Accepts the uplink's sample batches on any path, decodes them with the controller's own codec and answers
+ * 204, so a controller_host started with the sink's URL forwards to it like the board forwards to the real web
+ * server. The sink can be made slow (-d), flaky (-f) or unavailable: SIGUSR1 closes the listening socket and
+ * every connection, so posts are refused as if the server were down, and the next SIGUSR1 opens it again.
+ *
+ * Every sample is identified by its boot, uptime and values; a sample seen before is counted as a duplicate,
+ * which is what a replay after a failed post produces. Totals are printed on SIGUSR2 and on exit (SIGINT).
+ *
+ * Usage:
+ *   uplink_sink [-p port] [-d delay-ms] [-f fail-percent] [-q]
+ *
+ * Defaults: port 8090, no delay, no failures, one line per batch.
+ *
+ * Dependencies:
+ * - POSIX sockets and poll().
+ * - uplink_codec.c: Batch decoder.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "uplink_codec.h"
+
+#define SINK_MAX_CONNS 16
+#define SINK_BUFFER_SIZE 8192
+#define SINK_SEEN_SLOTS (1u << 20)      ///< Sample identities remembered for duplicate detection.
+#define SINK_MAX_RECORDS 1024
+
+typedef struct {
+    int sock;
+    char buffer[SINK_BUFFER_SIZE];
+    size_t len;
+    size_t request_len;     ///< Length of the complete request at the head of buffer, or 0.
+    uint64_t respond_at_ns; ///< Time the answer to that request is due.
+    int status;
+} sink_conn_t;
+
+typedef struct {
+    uint64_t batches;
+    uint64_t rejected;      ///< Requests answered with 503 by -f.
+    uint64_t malformed;
+    uint64_t bytes;
+    uint64_t samples;
+    uint64_t duplicates;
+} sink_stats_t;
+
+static volatile sig_atomic_t toggle_requested = 0;
+static volatile sig_atomic_t report_requested = 0;
+static volatile sig_atomic_t stop_requested = 0;
+static uint64_t *seen;
+
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+
+static void on_signal(int sig) {
+    if (sig == SIGUSR1) toggle_requested = 1;
+    else if (sig == SIGUSR2) report_requested = 1;
+    else stop_requested = 1;
+}
+
+
+static int open_listener(int port) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons((uint16_t)port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(sock, 8) != 0) {
+        perror("listen");
+        exit(1);
+    }
+    return sock;
+}
+
+
+/** Returns true if the sample was not seen before. */
+static bool remember(const telemetry_record_t *record) {
+    uint64_t key = ((uint64_t)record->boot << 48) ^ ((uint64_t)record->uptime << 16) ^
+                   ((uint64_t)(uint16_t)record->temperature * 0x9E3779B97F4A7C15ull) ^
+                   ((uint64_t)(uint16_t)record->humidity << 32) ^ ((uint64_t)record->lux << 8) ^ record->flags;
+    key |= 1;  // 0 marks a free slot
+    for (uint32_t slot = (uint32_t)(key * 0x9E3779B97F4A7C15ull >> 44);; slot = (slot + 1) & (SINK_SEEN_SLOTS - 1)) {
+        if (seen[slot] == key) return false;
+        if (seen[slot] == 0) {
+            seen[slot] = key;
+            return true;
+        }
+    }
+}
+
+
+static void handle_batch(const uint8_t *body, size_t len, sink_stats_t *stats, bool quiet) {
+    static telemetry_record_t records[SINK_MAX_RECORDS];
+    size_t count;
+    if (!uplink_decode(body, len, records, SINK_MAX_RECORDS, &count)) {
+        stats->malformed++;
+        printf("malformed batch of %zu bytes\n", len);
+        return;
+    }
+
+    size_t fresh = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (remember(&records[i])) fresh++;
+    }
+    stats->batches++;
+    stats->bytes += len;
+    stats->samples += count;
+    stats->duplicates += count - fresh;
+    if (!quiet && count > 0) {
+        printf("batch %4zu samples %5zu bytes  boot %u uptime %lu..%lu  %zu new\n", count, len,
+               records[0].boot, (unsigned long)records[0].uptime, (unsigned long)records[count - 1].uptime, fresh);
+        fflush(stdout);
+    }
+}
+
+
+/** Checks whether the buffer starts with a complete request and handles it. */
+static void parse_request(sink_conn_t *conn, int delay_ms, int fail_percent, sink_stats_t *stats, bool quiet) {
+    if (conn->request_len > 0 || conn->len == 0) return;
+
+    conn->buffer[conn->len < SINK_BUFFER_SIZE ? conn->len : SINK_BUFFER_SIZE - 1] = '\0';
+    char *end = strstr(conn->buffer, "\r\n\r\n");
+    if (!end) return;
+
+    size_t head_len = (size_t)(end + 4 - conn->buffer);
+    size_t body_len = 0;
+    for (char *line = strstr(conn->buffer, "\r\n"); line && line < end; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+            body_len = strtoul(line + 17, NULL, 10);
+        }
+    }
+    if (head_len + body_len > SINK_BUFFER_SIZE) {
+        conn->request_len = conn->len;
+        conn->status = 413;
+    } else if (conn->len < head_len + body_len) {
+        return;
+    } else {
+        conn->request_len = head_len + body_len;
+        if (fail_percent > 0 && rand() % 100 < fail_percent) {
+            conn->status = 503;
+            stats->rejected++;
+        } else {
+            conn->status = 204;
+            handle_batch((const uint8_t *)conn->buffer + head_len, body_len, stats, quiet);
+        }
+    }
+    conn->respond_at_ns = now_ns() + (uint64_t)delay_ms * 1000000ull;
+}
+
+
+static void respond(sink_conn_t *conn) {
+    char response[128];
+    int len = snprintf(response, sizeof(response), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\n\r\n", conn->status,
+                       conn->status == 204 ? "No Content" : conn->status == 503 ? "Service Unavailable"
+                                                                                : "Payload Too Large");
+    if (send(conn->sock, response, (size_t)len, MSG_NOSIGNAL) != len) {
+        close(conn->sock);
+        conn->sock = -1;
+        return;
+    }
+    memmove(conn->buffer, conn->buffer + conn->request_len, conn->len - conn->request_len);
+    conn->len -= conn->request_len;
+    conn->request_len = 0;
+}
+
+
+static void report(const sink_stats_t *stats) {
+    printf("batches       %llu accepted, %llu rejected, %llu malformed\n", (unsigned long long)stats->batches,
+           (unsigned long long)stats->rejected, (unsigned long long)stats->malformed);
+    printf("samples       %llu received, %llu unique, %llu duplicates\n", (unsigned long long)stats->samples,
+           (unsigned long long)(stats->samples - stats->duplicates), (unsigned long long)stats->duplicates);
+    printf("bytes         %llu (%.1f per sample)\n", (unsigned long long)stats->bytes,
+           stats->samples ? (double)stats->bytes / stats->samples : 0.0);
+    fflush(stdout);
+}
+
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-p port] [-d delay-ms] [-f fail-percent] [-q]\n", name);
+}
+
+
+int main(int argc, char **argv) {
+    int port = 8090, delay_ms = 0, fail_percent = 0;
+    bool quiet = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) quiet = true;
+        else if (i + 1 < argc && strcmp(argv[i], "-p") == 0) port = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-d") == 0) delay_ms = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-f") == 0) fail_percent = atoi(argv[++i]);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    seen = calloc(SINK_SEEN_SLOTS, sizeof(uint64_t));
+    if (!seen) {
+        perror("calloc");
+        return 1;
+    }
+    struct sigaction action = { .sa_handler = on_signal };
+    sigaction(SIGUSR1, &action, NULL);
+    sigaction(SIGUSR2, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    sink_conn_t conns[SINK_MAX_CONNS];
+    for (int i = 0; i < SINK_MAX_CONNS; i++) conns[i].sock = -1;
+    int listener = open_listener(port);
+    sink_stats_t stats = {0};
+    printf("listening on 127.0.0.1:%d (delay %d ms, %d%% failures)\n", port, delay_ms, fail_percent);
+    fflush(stdout);
+
+    while (!stop_requested) {
+        if (toggle_requested) {
+            toggle_requested = 0;
+            if (listener >= 0) {
+                close(listener);
+                listener = -1;
+                for (int i = 0; i < SINK_MAX_CONNS; i++) {
+                    if (conns[i].sock >= 0) close(conns[i].sock);
+                    conns[i].sock = -1;
+                }
+                printf("unavailable\n");
+            } else {
+                listener = open_listener(port);
+                printf("available\n");
+            }
+            fflush(stdout);
+        }
+        if (report_requested) {
+            report_requested = 0;
+            report(&stats);
+        }
+
+        // Answer due requests and work out how long to wait for the next one
+        struct pollfd pfds[SINK_MAX_CONNS + 1];
+        int timeout_ms = 1000;
+        uint64_t now = now_ns();
+        for (int i = 0; i < SINK_MAX_CONNS; i++) {
+            sink_conn_t *conn = &conns[i];
+            if (conn->sock >= 0 && conn->request_len > 0) {
+                if (conn->respond_at_ns <= now) {
+                    respond(conn);
+                    if (conn->sock >= 0) parse_request(conn, delay_ms, fail_percent, &stats, quiet);
+                } else if ((int)((conn->respond_at_ns - now) / 1000000) + 1 < timeout_ms) {
+                    timeout_ms = (int)((conn->respond_at_ns - now) / 1000000) + 1;
+                }
+            }
+            pfds[i].fd = conn->sock >= 0 && conn->request_len == 0 ? conn->sock : -1;
+            pfds[i].events = POLLIN;
+        }
+        pfds[SINK_MAX_CONNS].fd = listener;
+        pfds[SINK_MAX_CONNS].events = POLLIN;
+
+        if (poll(pfds, SINK_MAX_CONNS + 1, timeout_ms) <= 0) continue;
+
+        if (listener >= 0 && (pfds[SINK_MAX_CONNS].revents & POLLIN)) {
+            int sock = accept(listener, NULL, NULL);
+            int slot = -1;
+            for (int i = 0; i < SINK_MAX_CONNS && slot < 0; i++) {
+                if (conns[i].sock < 0) slot = i;
+            }
+            if (slot < 0) {
+                close(sock);
+            } else if (sock >= 0) {
+                conns[slot] = (sink_conn_t){ .sock = sock };
+            }
+        }
+        for (int i = 0; i < SINK_MAX_CONNS; i++) {
+            sink_conn_t *conn = &conns[i];
+            if (pfds[i].fd < 0 || !(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ssize_t n = recv(conn->sock, conn->buffer + conn->len, SINK_BUFFER_SIZE - 1 - conn->len, 0);
+            if (n <= 0) {
+                close(conn->sock);
+                conn->sock = -1;
+                continue;
+            }
+            conn->len += (size_t)n;
+            parse_request(conn, delay_ms, fail_percent, &stats, quiet);
+        }
+    }
+
+    report(&stats);
+    return 0;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file bus.h
+ * @brief Header file for the in-process publish/subscribe bus of the ESP32 Smart Home Main Controller.
+ *
+ * Modules hand data to each other by topic instead of calling each other: the TCP server publishes samples,
+ * the HTTP server setpoints and the rule engine actuator commands, and every task interested in a topic
+ * subscribes with a FreeRTOS queue of its own.
+ *
+ * Messages come from a fixed pool and are never copied: a publisher takes a message with bus_alloc(), fills
+ * in its payload and passes it to bus_publish(), which queues a pointer to it for every subscriber. Each
+ * subscriber treats the message as read-only and calls bus_release() when done with it; the last release
+ * returns it to the pool. Publishing never blocks. A message that finds the pool empty or a subscriber queue
+ * full is dropped for that subscriber and counted, so a slow consumer only loses its own messages and never
+ * holds up the publisher or the other subscribers.
+ */
+
+#ifndef BUS_H
+#define BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "json_parser.h"
+#include "shelly_control.h"
+
+#define BUS_POOL_SIZE 48            ///< Messages in flight across all topics; covers every subscriber queue but the Shelly ones.
+#define BUS_MAX_SUBSCRIBERS 4       ///< Subscribers per topic.
+#define BUS_QUEUE_SLOTS 64          ///< Subscriber queue entries across all topics; the depths passed to bus_subscribe() add up to 48.
+
+/**
+ * @brief Topics of the bus.
+ */
+typedef enum {
+    BUS_TOPIC_SAMPLE,       ///< A station reading was accepted. Published by the TCP server task.
+    BUS_TOPIC_SETPOINT,     ///< New setpoints for a station. Published by the HTTP server.
+    BUS_TOPIC_ACTUATOR,     ///< A plug is to be switched. Published by the rule engine.
+    BUS_TOPIC_COUNT
+} bus_topic_t;
+
+/**
+ * @brief Payload of BUS_TOPIC_SAMPLE.
+ */
+typedef struct {
+    int station;            ///< Registry slot of the reporting station.
+    bool owner;             ///< The station owned the controller state when it reported (registry_owner()).
+    uint32_t uptime;        ///< Time of the reading, as history_now().
+    telemetry_t telemetry;
+} bus_sample_t;
+
+/**
+ * @brief Payload of BUS_TOPIC_SETPOINT. The message ID is the request ID of the command sent to the station.
+ *
+ * The TCP server task sends the setpoints to the station, resends them if the station does not acknowledge them in
+ * time, and matches the station's "SETPOINTS_ACK:<id>" reply by request ID. Setpoints for a station that is not
+ * connected wait for it up to TCP_COMMAND_HOLD_MS (tcp_server.h), as long as its session stays resumable; newer
+ * setpoints for the same station replace them.
+ */
+typedef struct {
+    int station;            ///< Registry slot of the station, or -1 for the station behind client_sock.
+    int16_t sp_temperature; ///< Temperature setpoint in hundredths of degrees Celsius.
+    int16_t sp_humidity;    ///< Humidity setpoint in hundredths of percent RH.
+    QueueHandle_t ack_queue; ///< Queue of uint32_t sent the message ID once the station acknowledged, or NULL.
+} bus_setpoint_t;
+
+/**
+ * @brief Payload of BUS_TOPIC_ACTUATOR.
+ */
+typedef struct {
+    shelly_plug_t plug;
+    bool on;
+} bus_actuator_t;
+
+/**
+ * @brief A pooled message. Read-only once published.
+ */
+typedef struct {
+    bus_topic_t topic;
+    uint32_t id;            ///< Sequence number assigned by bus_publish(); never 0.
+    uint32_t refs;          ///< Subscribers that have not released the message yet.
+    union {
+        bus_sample_t sample;
+        bus_setpoint_t setpoint;
+        bus_actuator_t actuator;
+    };
+} bus_msg_t;
+
+/**
+ * @brief Fills the message pool. Must be called before any other bus function.
+ */
+void bus_init(void);
+
+/**
+ * @brief Subscribes to a topic.
+ *
+ * Call while starting up, before the topic's publisher runs. The returned queue carries `const bus_msg_t *`
+ * items; every message received from it must be handed to bus_release(). Its storage is taken from a static
+ * array of BUS_QUEUE_SLOTS entries shared by all subscribers, so subscribing never touches the heap.
+ *
+ * @param topic The topic.
+ * @param name Name of the subscriber in metrics.
+ * @param depth Messages the subscriber can fall behind before it loses some.
+ * @return The subscriber's queue, or NULL if the topic has no room for another subscriber or the queue slots are used up.
+ */
+QueueHandle_t bus_subscribe(bus_topic_t topic, const char *name, UBaseType_t depth);
+
+/**
+ * @brief Takes a message from the pool without blocking.
+ *
+ * @param topic Topic the message will be published on.
+ * @return The message with a zeroed payload, or NULL if the pool is empty; the drop is counted.
+ */
+bus_msg_t *bus_alloc(bus_topic_t topic);
+
+/**
+ * @brief Queues a message for every subscriber of its topic without blocking.
+ *
+ * The publisher gives up the message; it must not touch it afterwards.
+ *
+ * @param msg Message taken with bus_alloc().
+ * @return The message ID if every subscriber took the message, 0 if any of them missed it.
+ */
+uint32_t bus_publish(bus_msg_t *msg);
+
+/**
+ * @brief Releases a received message; the last release returns it to the pool.
+ */
+void bus_release(const bus_msg_t *msg);
+
+/**
+ * @brief Statistics of one subscriber, for the metrics.
+ */
+typedef struct {
+    bus_topic_t topic;
+    const char *name;
+    uint32_t depth;         ///< Messages waiting in the subscriber's queue.
+    uint32_t dropped;       ///< Messages the subscriber lost to a full queue or an empty pool.
+} bus_subscriber_stats_t;
+
+/**
+ * @brief Reads the statistics of a subscriber.
+ *
+ * @param index Index of the subscriber, counting across all topics from 0.
+ * @param out Receives the statistics.
+ * @return True if there is such a subscriber, false otherwise.
+ */
+bool bus_subscriber_stats(size_t index, bus_subscriber_stats_t *out);
+
+/**
+ * @brief Returns the number of messages left in the pool.
+ */
+uint32_t bus_pool_free(void);
+
+/**
+ * @brief Returns the name of a topic, as used in metrics.
+ */
+const char *bus_topic_name(bus_topic_t topic);
+
+#endif // BUS_H
@@ -0,0 +1,85 @@
+/**
+ * @file dlog.h
+ * @brief Header file for the deferred logger in the ESP32 Smart Home Main Controller.
+ *
+ * DLOGE/DLOGW/DLOGI/DLOGD do not format anything on the calling task. They store a pointer to a static call-site
+ * descriptor, which identifies the format string, together with the tag and the raw arguments in a lock-free ring. A low-priority
+ * task formats the records and writes them to the console, suppressing identical messages that repeat within a short
+ * window, so logging adds neither formatting nor UART time to the ingest path.
+ *
+ * Arguments are stored as machine words, so formats may only use integer, character and pointer conversions
+ * (%d, %u, %x, %c, %p, ...), no long long or floating point. %s arguments must point to strings that outlive the
+ * record, such as literals; transient buffers must be logged with ESP_LOGx instead.
+ */
+
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stdint.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#define DLOG_MAX_ARGS 8     ///< Maximum number of arguments per record.
+
+/**
+ * @brief Static description of one logging call site.
+ */
+typedef struct {
+    esp_log_level_t level;
+    const char *format;
+} dlog_site_t;
+
+/**
+ * @brief Starts the task that formats and prints the queued records.
+ */
+void dlog_start(void);
+
+/**
+ * @brief Queues one record. Use the DLOGx macros instead.
+ *
+ * Never blocks; if the ring is full the record is dropped and counted.
+ *
+ * @param site Call site of the record.
+ * @param tag Log tag; must outlive the record.
+ * @param nargs Number of arguments.
+ * @param args The arguments, converted to machine words.
+ */
+void dlog_write(const dlog_site_t *site, const char *tag, uint32_t nargs, const uintptr_t *args);
+
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+
+#define DLOG_WORDS_0()
+#define DLOG_WORDS_1(a) (uintptr_t)(a)
+#define DLOG_WORDS_2(a, ...) (uintptr_t)(a), DLOG_WORDS_1(__VA_ARGS__)
+#define DLOG_WORDS_3(a, ...) (uintptr_t)(a), DLOG_WORDS_2(__VA_ARGS__)
+#define DLOG_WORDS_4(a, ...) (uintptr_t)(a), DLOG_WORDS_3(__VA_ARGS__)
+#define DLOG_WORDS_5(a, ...) (uintptr_t)(a), DLOG_WORDS_4(__VA_ARGS__)
+#define DLOG_WORDS_6(a, ...) (uintptr_t)(a), DLOG_WORDS_5(__VA_ARGS__)
+#define DLOG_WORDS_7(a, ...) (uintptr_t)(a), DLOG_WORDS_6(__VA_ARGS__)
+#define DLOG_WORDS_8(a, ...) (uintptr_t)(a), DLOG_WORDS_7(__VA_ARGS__)
+#define DLOG_WORDS_(n, ...) DLOG_WORDS_##n(__VA_ARGS__)
+#define DLOG_WORDS(n, ...) DLOG_WORDS_(n, ##__VA_ARGS__)
+
+/**
+ * @brief Never called; lets the compiler check DLOG formats against the original argument types.
+ */
+static inline __attribute__((format(printf, 1, 2))) void dlog_check_format(const char *format, ...) {
+    (void)format;
+}
+
+#define DLOG(lvl, tag, fmt, ...) do { \
+        if (0) dlog_check_format(fmt, ##__VA_ARGS__); \
+        if ((lvl) <= CONFIG_LOG_MAXIMUM_LEVEL) { \
+            static const dlog_site_t dlog_site_ = { (lvl), (fmt) }; \
+            const uintptr_t dlog_args_[] = { 0, DLOG_WORDS(DLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__) }; \
+            dlog_write(&dlog_site_, (tag), DLOG_NARGS(__VA_ARGS__), dlog_args_ + 1); \
+        } \
+    } while (0)
+
+#define DLOGE(tag, fmt, ...) DLOG(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) DLOG(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) DLOG(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define DLOGD(tag, fmt, ...) DLOG(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+
+#endif // DLOG_H
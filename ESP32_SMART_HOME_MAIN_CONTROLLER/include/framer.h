@@ -0,0 +1,88 @@
+/**
+ * @file framer.h
+ * @brief Header file for the ring-buffer message framer used on station connections.
+ *
+ * Each station connection owns one framer. The TCP server receives directly into the free space of the
+ * ring and then pulls complete newline-terminated messages out of it. Every byte is scanned exactly once,
+ * several messages in a single recv() are returned one after the other, and a message split across reads
+ * is returned as soon as its terminating newline arrives.
+ *
+ * A message that starts with FRAMER_BINARY_MAGIC is a length-prefixed binary frame instead: the byte at
+ * FRAMER_BINARY_LEN_OFFSET holds the total frame length, and the frame is returned as soon as that many
+ * bytes are buffered, regardless of any newline bytes in its payload.
+ */
+
+#ifndef FRAMER_H
+#define FRAMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAMER_CAPACITY 512    ///< Ring size in bytes; must be a power of two. Also the maximum message length.
+#define FRAMER_BINARY_MAGIC 0xB5       ///< First byte of a length-prefixed binary frame; never starts a text line.
+#define FRAMER_BINARY_LEN_OFFSET 2     ///< Offset of the one-byte total frame length within a binary frame.
+
+/**
+ * @brief Ring buffer and scan state of one connection.
+ */
+typedef struct {
+    char data[FRAMER_CAPACITY];  ///< Ring storage.
+    uint32_t head;               ///< Free-running write position.
+    uint32_t tail;               ///< Free-running start of the oldest unconsumed message.
+    uint32_t scan;               ///< Free-running position up to which bytes were searched for a delimiter.
+    bool discarding;             ///< True while dropping the rest of an oversized message.
+    uint32_t overflows;          ///< Number of messages dropped because they did not fit the ring.
+} framer_t;
+
+/**
+ * @brief One complete message returned by the framer.
+ *
+ * Text messages are null-terminated in place of their delimiter; binary frames are returned as received.
+ * The message stays valid until the next call to framer_write_ptr().
+ */
+typedef struct {
+    char *data;    ///< Message text without the trailing CR/LF, or the binary frame including its magic byte.
+    size_t len;    ///< Message length in bytes.
+    bool binary;   ///< True if this is a length-prefixed binary frame.
+} framer_frame_t;
+
+/**
+ * @brief Resets the framer to an empty state.
+ *
+ * @param framer The framer to reset.
+ */
+void framer_init(framer_t *framer);
+
+/**
+ * @brief Returns the contiguous free space in the ring to receive into.
+ *
+ * @param framer The framer.
+ * @param space Set to the number of bytes that may be written at the returned pointer.
+ * @return Pointer to the write position.
+ */
+char *framer_write_ptr(framer_t *framer, size_t *space);
+
+/**
+ * @brief Marks bytes written at framer_write_ptr() as received.
+ *
+ * @param framer The framer.
+ * @param len Number of bytes written.
+ */
+void framer_commit(framer_t *framer, size_t len);
+
+/**
+ * @brief Extracts the next complete message.
+ *
+ * Messages that wrap around the end of the ring are copied into @p scratch, which must hold at least
+ * FRAMER_CAPACITY bytes; all other messages are returned in place. A message longer than the ring is
+ * dropped up to its delimiter and counted in framer_t::overflows.
+ *
+ * @param framer The framer.
+ * @param scratch Linear buffer used only for messages that wrap around the ring.
+ * @param frame Set to the extracted message.
+ * @return True if a message was extracted, false if no complete message is buffered.
+ */
+bool framer_next(framer_t *framer, char *scratch, framer_frame_t *frame);
+
+#endif // FRAMER_H
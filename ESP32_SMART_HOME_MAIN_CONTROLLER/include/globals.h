@@ -2,8 +2,8 @@
  * @file globals.h
  * @brief This header file contains global variable declarations for the ESP32 Smart Home Main Controller project.
  *
- * The variables declared here are used across multiple source files to manage
- * temperature, humidity, light intensity, and device states, as well as network communication.
+ * The variables declared here are used across multiple source files to manage network communication.
+ * Readings, device states and setpoints are shared through state.h instead.
  *
  * @note Ensure proper synchronization when accessing these variables in a multithreaded environment.
  */
@@ -17,17 +17,7 @@
 extern "C" {
 #endif
 
-extern float temperature;
-extern float humidity;
-extern uint16_t lux;
-extern bool heater;
-extern bool dehumidifier;
-
 extern int client_sock;
-extern bool handshake_done;
-
-extern int16_t SP_TEMP; // Declare the external variables
-extern int16_t SP_HUM;
 
 #ifdef __cplusplus
 }
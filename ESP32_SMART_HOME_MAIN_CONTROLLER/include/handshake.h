@@ -6,16 +6,80 @@
  * @brief Header file for handshake-related functions in the ESP32 Smart Home Main Controller project.
  */
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "tcp_server.h"
+
+#define HANDSHAKE_TIMEOUT_MS 10000      ///< Time a station gets from accept to a completed handshake.
+#define HANDSHAKE_SESSION_TTL_MS 600000 ///< Time a session stays resumable after its connection closed.
+
+/**
+ * @brief Puts a newly accepted connection into the STATION_HANDSHAKE state and starts its deadline.
+ *
+ * @param conn The accepted connection.
+ * @param now esp_timer time of the accept, in microseconds.
+ */
+void handshake_start(station_conn_t *conn, int64_t now);
+
+/**
+ * @brief Processes a handshake message received on a station connection.
+ *
+ * Called by the TCP server event loop for every message received on a connection in the STATION_HANDSHAKE
+ * state. Replies with HANDSHAKE:ESP32_READY as soon as HANDSHAKE:ARDUINO_READY arrives and moves the
+ * connection to STATION_READY. After too many unexpected messages the station is told ERROR:HANDSHAKE_FAILED
+ * and the connection moves to STATION_FAILED, so the station starts over on a fresh connection.
+ *
+ * The station may append options such as ";fmt=bin1" to its ready message. Binary telemetry frames are
+ * enabled on the connection only if offered, and the accepted option is echoed in the response.
+ *
+ * The options ";id=<station ID>" and ";caps=<capability list>" register the station in the registry and bind
+ * the connection to its slot; a station that sends no ID is registered as REGISTRY_LEGACY_ID and one that
+ * sends no capabilities gets all of them. An ID that is invalid or does not fit the registry fails the handshake.
+ *
+ * The response also carries a session token as ";tok=<8 hex digits>". A station that reconnects can present
+ * it in its first message instead of repeating the handshake; see handshake_resume().
+ *
+ * @param conn Connection the message was received on.
+ * @param message Received message; sanitized in place.
+ * @return True if the handshake is completed on this connection, false otherwise.
+ */
+bool performHandshake(station_conn_t *conn, char *message);
+
+/**
+ * @brief Fails the handshake if its deadline has passed.
+ *
+ * Called by the TCP server event loop on every pass, so a station that connects and never completes the
+ * handshake releases its slot after HANDSHAKE_TIMEOUT_MS instead of holding it forever.
+ *
+ * @param conn Connection to check.
+ * @param now Current esp_timer time, in microseconds.
+ * @return True if the connection moved to STATION_FAILED, false otherwise.
+ */
+bool handshake_check_deadline(station_conn_t *conn, int64_t now);
+
 /**
- * @brief Performs the handshake process between devices.
+ * @brief Resumes a suspended session on a connection that has not completed the handshake.
+ *
+ * Called by the TCP server event loop when the first message on a connection is a "DATA;tok=<token>:" frame.
+ * The connection moves straight to STATION_READY with the station, telemetry format and frame sequence state
+ * of the session, so the frame carrying the token is already accepted.
+ *
+ * @param conn Connection in the STATION_HANDSHAKE state.
+ * @param token Session token presented by the station.
+ * @param now Current esp_timer time, in microseconds.
+ * @return True if the session was resumed, false if the token is unknown, expired or held by another connection.
  */
-void performHandshake();
+bool handshake_resume(station_conn_t *conn, uint32_t token, int64_t now);
 
 /**
- * @brief Sanitizes the input string to ensure it is safe for processing.
- * 
- * @param input Pointer to the input string to be sanitized.
+ * @brief Suspends the session held by a connection that is being closed.
+ *
+ * Saves the telemetry format and frame sequence state of the connection and keeps the session resumable
+ * for HANDSHAKE_SESSION_TTL_MS.
+ *
+ * @param conn Connection being closed.
+ * @param now Current esp_timer time, in microseconds.
  */
-void sanitize_input(char *input);
+void handshake_suspend(station_conn_t *conn, int64_t now);
 
-#endif // HANDSHAKE_H
\ No newline at end of file
+#endif // HANDSHAKE_H
@@ -0,0 +1,102 @@
+/**
+ * @file history.h
+ * @brief Header file for the in-RAM time-series history in the ESP32 Smart Home Main Controller.
+ *
+ * Every telemetry sample is kept in three fixed-size tiers: raw samples, 1-minute and 1-hour min/max/avg
+ * rollups. Each tier is a structure-of-arrays ring, the rollups are updated incrementally as samples arrive,
+ * and all storage is static, so recording a sample never allocates. Timestamps are seconds since boot.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_RAW_LEN 240         ///< Raw samples kept.
+#define HISTORY_MINUTE_LEN 720      ///< 1-minute rollups kept (12 hours).
+#define HISTORY_HOUR_LEN 168        ///< 1-hour rollups kept (7 days).
+#define HISTORY_RAM_BUDGET (40 * 1024)  ///< Upper bound on the static storage of all tiers, in bytes.
+
+/**
+ * @brief Recorded metrics.
+ */
+typedef enum {
+    HISTORY_TEMPERATURE,    ///< Hundredths of degrees Celsius.
+    HISTORY_HUMIDITY,       ///< Hundredths of percent RH.
+    HISTORY_LUX,            ///< Lux.
+    HISTORY_METRIC_COUNT
+} history_metric_t;
+
+/**
+ * @brief Resolution tiers.
+ */
+typedef enum {
+    HISTORY_RAW,
+    HISTORY_MINUTE,
+    HISTORY_HOUR,
+    HISTORY_TIER_COUNT
+} history_tier_t;
+
+/**
+ * @brief One point of a tier. Raw samples have min == max == avg.
+ */
+typedef struct {
+    uint32_t timestamp;     ///< Sample time, or start of the rollup period, in seconds since boot.
+    int32_t min;
+    int32_t max;
+    int32_t avg;
+} history_point_t;
+
+/**
+ * @brief Initializes the history. Must be called before the first sample is recorded.
+ */
+void history_init(void);
+
+/**
+ * @brief Records one sample in all tiers.
+ *
+ * @param temperature Temperature in hundredths of degrees Celsius.
+ * @param humidity Humidity in hundredths of percent RH.
+ * @param lux Light intensity in lux.
+ */
+void history_add(int32_t temperature, int32_t humidity, int32_t lux);
+
+/**
+ * @brief Copies points of one metric and tier, oldest first.
+ *
+ * The rollup that is still being accumulated is included as the newest point. Call repeatedly with
+ * @p after set to the timestamp of the last point returned to stream a long range in batches.
+ *
+ * @param metric The metric to read.
+ * @param tier The resolution tier to read.
+ * @param after Only points with a timestamp greater than this are returned.
+ * @param to Only points with a timestamp up to and including this are returned.
+ * @param out Receives the points.
+ * @param max Capacity of @p out.
+ * @return Number of points copied.
+ */
+size_t history_read(history_metric_t metric, history_tier_t tier, int64_t after, uint32_t to,
+                    history_point_t *out, size_t max);
+
+/**
+ * @brief Returns the period of a tier in seconds; 0 for the raw tier.
+ */
+uint32_t history_period(history_tier_t tier);
+
+/**
+ * @brief Returns the timestamp of the oldest point in a tier.
+ *
+ * @param tier The tier.
+ * @param oldest Set to the timestamp.
+ * @return True if the tier holds at least one point, false otherwise.
+ */
+bool history_oldest(history_tier_t tier, uint32_t *oldest);
+
+/**
+ * @brief Returns the current history time in seconds since boot.
+ */
+uint32_t history_now(void);
+
+#endif // HISTORY_H
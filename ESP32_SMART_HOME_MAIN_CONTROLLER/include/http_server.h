@@ -7,15 +7,94 @@
 #define HTTP_SERVER_H
 
 #include "esp_http_server.h"
+#include "sdkconfig.h"
 
 /**
  * @brief Handles HTTP requests for setpoints.
  *
+ * With wait=1 the request is detached with httpd_req_async_handler_begin() and answered by the setpoint wait
+ * task once the station acknowledges or SETPOINTS_ACK_WAIT_MS passes, so other requests are served meanwhile.
+ * Detaching allocates on the heap in steady state: ESP-IDF can only answer a request after its handler returned
+ * through the request copy it mallocs there, which is freed once the request is answered. At most
+ * SETPOINTS_WAITS_MAX copies are live at a time; metrics.h lists the other allocations after startup.
+ *
  * @param req Pointer to the HTTP request structure.
  * @return ESP_OK on success, or an appropriate error code.
  */
 esp_err_t setpoints_handler(httpd_req_t *req);
 
+/**
+ * @brief Handles GET /rules requests.
+ *
+ * Returns the active automation rule set as JSON; see rules.h for the format.
+ *
+ * @param req Pointer to the HTTP request structure.
+ * @return ESP_OK on success, or an appropriate error code.
+ */
+esp_err_t rules_get_handler(httpd_req_t *req);
+
+/**
+ * @brief Handles POST /rules requests.
+ *
+ * Compiles the rule set in the request body, stores it in NVS and activates it. An invalid rule set is answered
+ * with 400 and a description of the first error, and the active rules stay in effect.
+ *
+ * @param req Pointer to the HTTP request structure.
+ * @return ESP_OK on success, or an appropriate error code.
+ */
+esp_err_t rules_post_handler(httpd_req_t *req);
+
+/**
+ * @brief Handles GET /history?metric=&from=&to=&step= requests.
+ *
+ * Streams the points of one metric as chunked JSON. from and to are seconds since boot; step selects the
+ * 1-hour (>= 3600), 1-minute (>= 60) or raw tier. Without step, the finest tier that reaches back to from is used.
+ *
+ * @param req Pointer to the HTTP request structure.
+ * @return ESP_OK on success, or an appropriate error code.
+ */
+esp_err_t history_handler(httpd_req_t *req);
+
+/**
+ * @brief Handles GET /metrics requests.
+ *
+ * Streams the runtime counters, latency histograms and heap gauges in the Prometheus text exposition format.
+ *
+ * @param req Pointer to the HTTP request structure.
+ * @return ESP_OK on success, or an appropriate error code.
+ */
+esp_err_t metrics_handler(httpd_req_t *req);
+
+#ifdef CONFIG_SMARTHOME_TRACE
+/**
+ * @brief Handles GET /trace requests.
+ *
+ * Pauses tracing and streams the per-core trace buffers as Chrome trace_event JSON.
+ *
+ * @param req Pointer to the HTTP request structure.
+ * @return ESP_OK on success, or an appropriate error code.
+ */
+esp_err_t trace_handler(httpd_req_t *req);
+#endif
+
+/**
+ * @brief Handles the /ws WebSocket that pushes state changes to the dashboards.
+ *
+ * A new subscriber first receives the full state as JSON, then only the fields that changed.
+ *
+ * @param req Pointer to the HTTP request structure.
+ * @return ESP_OK on success, or an appropriate error code.
+ */
+esp_err_t ws_handler(httpd_req_t *req);
+
+/**
+ * @brief Tells the WebSocket subscribers that the state changed.
+ *
+ * Safe to call from any task and never blocks: the broadcast runs on the HTTP server task, and updates
+ * arriving while a broadcast is still queued are folded into it.
+ */
+void http_server_notify_update(void);
+
 /**
  * @brief Starts the HTTP server.
  */
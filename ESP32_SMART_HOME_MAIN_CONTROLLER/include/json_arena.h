@@ -0,0 +1,52 @@
+/**
+ * @file json_arena.h
+ * @brief Header file for the cJSON bump arena of the ESP32 Smart Home Main Controller.
+ *
+ * cJSON allocates every node and string of a parsed document separately. The arena takes those allocations from
+ * one static buffer instead of the heap: json_arena_init() installs it with cJSON_InitHooks(), every parse runs
+ * between json_arena_begin() and json_arena_end(), and ending the scope resets the arena in one step. Freeing is a
+ * no-op, so a document that does not fit fails to parse instead of fragmenting the heap.
+ *
+ * cJSON may only be used inside such a scope; scopes of different tasks are serialized by a mutex.
+ */
+
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define JSON_ARENA_SIZE (16 * 1024)     ///< Bytes of the arena; the densest rule set of RULES_JSON_MAX bytes takes about 11 KB, 15.5 KB on a 64-bit host.
+
+/**
+ * @brief Statistics of the arena, for the metrics.
+ */
+typedef struct {
+    uint32_t size;          ///< JSON_ARENA_SIZE.
+    uint32_t high_water;    ///< Most bytes in use at once since boot.
+    uint32_t exhausted;     ///< Allocations refused because the arena was full.
+} json_arena_stats_t;
+
+/**
+ * @brief Routes the cJSON allocations to the arena. Call once at startup, before cJSON is used.
+ */
+void json_arena_init(void);
+
+/**
+ * @brief Takes the arena for the calling task, waiting for another task's scope to end.
+ */
+void json_arena_begin(void);
+
+/**
+ * @brief Resets the arena and releases it. Everything cJSON allocated in the scope is invalid afterwards.
+ *
+ * @return True if every allocation of the scope was served, false if the arena ran out.
+ */
+bool json_arena_end(void);
+
+/**
+ * @brief Reads the statistics of the arena.
+ */
+void json_arena_stats(json_arena_stats_t *out);
+
+#endif // JSON_ARENA_H
@@ -2,22 +2,70 @@
  * @file json_parser.h
  * @brief Header file for JSON parsing functionality in the ESP32 Smart Home Main Controller project.
  *
- * This file contains the declaration of functions used for parsing JSON data.
+ * This file contains the declaration of functions used for parsing telemetry JSON sent by the stations.
+ * Parsing uses the jsmn tokenizer with a fixed token array on the stack, so it never touches the heap.
  */
 
 #ifndef JSON_PARSER_H
 #define JSON_PARSER_H
 
-#include "esp_err.h"
-#include "esp_http_server.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_HAS_TEMPERATURE    (1u << 0)
+#define TELEMETRY_HAS_HUMIDITY       (1u << 1)
+#define TELEMETRY_HAS_LUX            (1u << 2)
+#define TELEMETRY_HAS_HEATER         (1u << 3)
+#define TELEMETRY_HAS_DEHUMIDIFIER   (1u << 4)
+#define TELEMETRY_HAS_SP_TEMPERATURE (1u << 5)
+#define TELEMETRY_HAS_SP_HUMIDITY    (1u << 6)
+
+/** Fields every station frame must carry to be accepted as a reading. */
+#define TELEMETRY_REQUIRED (TELEMETRY_HAS_TEMPERATURE | TELEMETRY_HAS_HUMIDITY | TELEMETRY_HAS_LUX | \
+                            TELEMETRY_HAS_HEATER | TELEMETRY_HAS_DEHUMIDIFIER)
 
 /**
- * @brief Parses the provided JSON data.
+ * @brief One telemetry sample in integer centi-units.
+ */
+typedef struct {
+    int16_t temperature;     ///< Temperature in hundredths of degrees Celsius.
+    int16_t humidity;        ///< Humidity in hundredths of percent relative humidity.
+    uint16_t lux;            ///< Light intensity in lux.
+    bool heater;             ///< Heater state reported by the station.
+    bool dehumidifier;       ///< Dehumidifier state reported by the station.
+    int16_t sp_temperature;  ///< Temperature setpoint in hundredths of degrees Celsius.
+    int16_t sp_humidity;     ///< Humidity setpoint in hundredths of percent relative humidity.
+    uint8_t fields;          ///< Bitmask of TELEMETRY_HAS_* flags for the fields present in the message.
+} telemetry_t;
+
+/**
+ * @brief Parses a telemetry JSON object without allocating.
+ *
+ * Known fields are converted straight to integer centi-units; unknown fields are skipped.
  *
- * This function processes the input JSON string and extracts relevant information.
+ * @param json The JSON text; does not need to be null-terminated.
+ * @param len Length of the JSON text in bytes.
+ * @param out Receives the parsed fields; out->fields tells which ones were present.
+ * @return True if the text is a well-formed JSON object, false otherwise.
+ */
+bool parse_telemetry(const char *json, size_t len, telemetry_t *out);
+
+/**
+ * @brief Copies the fields present in a telemetry sample into the controller state.
+ *
+ * @param telemetry The parsed sample.
+ * @return True if the state changed, false otherwise.
+ */
+bool apply_telemetry(const telemetry_t *telemetry);
+
+/**
+ * @brief Parses the provided JSON data and updates the controller state.
  *
- * @param json_data A pointer to the JSON string to be parsed.
+ * @param json_data A pointer to the JSON text to be parsed.
+ * @param len Length of the JSON text in bytes.
+ * @return True if the data was parsed and applied, false otherwise.
  */
-void parse_json(const char* json_data);
+bool parse_json(const char *json_data, size_t len);
 
-#endif // JSON_PARSER_H
\ No newline at end of file
+#endif // JSON_PARSER_H
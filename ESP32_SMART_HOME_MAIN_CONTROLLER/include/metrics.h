@@ -0,0 +1,123 @@
+/**
+ * @file metrics.h
+ * @brief Header file for the runtime metrics in the ESP32 Smart Home Main Controller.
+ *
+ * Counters and fixed-bucket latency histograms are plain 32-bit words updated with relaxed atomic adds, so
+ * recording a sample takes no lock and costs a handful of cycles on the hot path. The /metrics endpoint
+ * renders them in the Prometheus text exposition format.
+ *
+ * The controller allocates everything it needs while starting up. Startup records how much heap each subsystem
+ * took, the long-lived tasks register their stacks, and /metrics reports both next to the allocator's block
+ * counts. The block count misses an allocation that is freed again before the next scrape, so an allocator hook
+ * also counts the allocations each registered task makes; a subsystem that allocates in steady state shows up as a
+ * moving smarthome_task_heap_allocations_total for its task. Known exceptions: the httpd task for a POST /update
+ * with wait=1, whose detached request copy comes from the heap (see setpoints_handler()), and the Shelly and uplink
+ * tasks, where esp_http_client allocates header strings and resolves the host for every request it sends.
+ *
+ * Allocations on other tasks are not counted. lwIP allocates a pbuf for every TCP segment on its tcpip task, and
+ * the Wi-Fi driver takes its dynamic TX and RX buffers for every frame on its own task; both keep the block count
+ * moving under traffic without the controller allocating anything.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define METRICS_MAX_TASKS 12            ///< Tasks that can register their stacks.
+#define METRICS_MAX_SUBSYSTEMS 12       ///< Startup heap checkpoints.
+
+/**
+ * @brief Monotonic counters.
+ */
+typedef enum {
+    METRIC_FRAMES_PARSED,           ///< Telemetry messages and binary frames accepted.
+    METRIC_PARSE_ERRORS,            ///< Telemetry messages and binary frames rejected.
+    METRIC_FRAMER_OVERFLOWS,        ///< Messages dropped because they did not fit a receive ring.
+    METRIC_HANDSHAKES,              ///< Station handshakes completed.
+    METRIC_SESSION_RESUMES,         ///< Station sessions resumed with a token instead of a handshake.
+    METRIC_RULE_EVALUATIONS,        ///< Automation rules evaluated after one of their inputs changed.
+    METRIC_SETPOINT_ACK_TIMEOUTS,   ///< Setpoint commands given up without an acknowledgment.
+    METRIC_SHELLY_REQUESTS,         ///< HTTP requests sent to Shelly plugs, including retries.
+    METRIC_SHELLY_FAILURES,         ///< Shelly requests that failed or were not answered with HTTP 200.
+    METRIC_WIFI_RECONNECTS,         ///< Wi-Fi reconnect attempts after a disconnect.
+    METRIC_UPLINK_POSTS,            ///< Sample batches posted upstream, including failed posts.
+    METRIC_UPLINK_FAILURES,         ///< Upstream posts that failed or were not answered with a 2xx status.
+    METRIC_UPLINK_SAMPLES,          ///< Samples acknowledged by the upstream, including replayed duplicates.
+    METRIC_UPLINK_BYTES,            ///< Encoded batch bytes acknowledged by the upstream.
+    METRIC_LOG_DROPPED,             ///< Deferred log records dropped because the ring was full.
+    METRIC_LOG_SUPPRESSED,          ///< Deferred log records suppressed as repeats.
+    METRIC_DATA_RENDERS,            ///< /data bodies serialized after the state or the registry changed.
+    METRIC_DATA_NOT_MODIFIED,       ///< /data requests answered with 304 Not Modified.
+    METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+/**
+ * @brief Latency histograms, recorded in milliseconds.
+ */
+typedef enum {
+    METRIC_HANDSHAKE_MS,            ///< From accepting a station to completing its handshake.
+    METRIC_FIRST_FRAME_MS,          ///< From accepting a station to its first accepted telemetry message.
+    METRIC_SETPOINT_RTT_MS,         ///< From first sending a setpoint command to its acknowledgment.
+    METRIC_SHELLY_LATENCY_MS,       ///< Duration of one Shelly HTTP request.
+    METRIC_UPLINK_LATENCY_MS,       ///< Duration of one upstream post.
+    METRIC_HISTOGRAM_COUNT
+} metric_histogram_t;
+
+extern uint32_t metrics_counters[METRIC_COUNTER_COUNT];
+
+/**
+ * @brief Increments a counter.
+ */
+static inline void metrics_inc(metric_counter_t counter) {
+    __atomic_fetch_add(&metrics_counters[counter], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Adds to a counter.
+ */
+static inline void metrics_add(metric_counter_t counter, uint32_t value) {
+    __atomic_fetch_add(&metrics_counters[counter], value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Records one sample in a histogram.
+ *
+ * @param histogram The histogram to record in.
+ * @param ms The sample in milliseconds.
+ */
+void metrics_observe(metric_histogram_t histogram, uint32_t ms);
+
+/**
+ * @brief Registers a task whose stack size, high-water mark and heap allocations are reported.
+ *
+ * Call once per task at startup. Allocations are counted from registration on, with CONFIG_HEAP_USE_HOOKS only.
+ *
+ * @param task The task; its FreeRTOS name labels the gauges. NULL is ignored.
+ * @param stack_bytes Size of the task's stack.
+ */
+void metrics_register_task(TaskHandle_t task, uint32_t stack_bytes);
+
+/**
+ * @brief Attributes the heap allocated since the previous checkpoint to a subsystem. Call during startup only.
+ *
+ * @param subsystem Name of the subsystem just started, which must outlive the controller, or NULL to only take the baseline.
+ */
+void metrics_heap_checkpoint(const char *subsystem);
+
+/**
+ * @brief Renders one metric family in the Prometheus text exposition format.
+ *
+ * Families are numbered from 0; callers render them one after another until -1 is returned.
+ *
+ * @param family Index of the family to render.
+ * @param buffer Output buffer; 1024 bytes fit every family.
+ * @param len Size of the output buffer.
+ * @return Number of characters written, or -1 if there is no such family.
+ */
+int metrics_format(size_t family, char *buffer, size_t len);
+
+#endif // METRICS_H
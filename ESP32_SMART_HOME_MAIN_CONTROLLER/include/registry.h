@@ -0,0 +1,142 @@
+/**
+ * @file registry.h
+ * @brief Header file for the station registry in the ESP32 Smart Home Main Controller.
+ *
+ * Every station announces an ID and its capabilities in the handshake ("HANDSHAKE:ARDUINO_READY;id=attic;caps=
+ * temp,hum,lux,heat,dehum"). The registry maps the ID to the station's zone: its latest reading, its setpoints and
+ * the Shelly plugs it is bound to. It is a fixed table with open addressing and linear probing, so neither lookups
+ * nor registrations touch the heap, and a connection keeps its slot index, so the per-frame lookup is an array index.
+ *
+ * Stations that announce no ID are registered as REGISTRY_LEGACY_ID with every capability, which keeps single-station
+ * setups working unchanged. A station is bound to the plugs matching its capabilities that no other station is bound
+ * to yet, when it registers and again whenever it reports different capabilities. The rules switch each plug on the
+ * reading and setpoints of the station bound to it. Exactly one station, the owner, also feeds the controller state
+ * that history, the telemetry log and the top-level /data fields show: the station bound to the first bound plug in
+ * shelly_plug_t order. Readings of every other station are only recorded in the registry.
+ *
+ * The TCP server task registers stations and records readings; any task may read entries. Entries are protected by
+ * a per-entry sequence counter like the controller state, so readers never block the TCP task. A registry-wide version
+ * is bumped by every write, so consumers can tell cheaply whether any entry changed since they last looked.
+ */
+
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "json_parser.h"
+
+#define REGISTRY_CAPACITY 64            ///< Slots in the table; a power of two.
+#define REGISTRY_MAX_STATIONS 32        ///< Stations registered at most, keeping the load factor at 1/2.
+#define REGISTRY_ID_LEN 16              ///< Longest station ID, including the terminator.
+#define REGISTRY_LEGACY_ID "station"    ///< ID of stations whose handshake carries none.
+
+#define REGISTRY_CAP_TEMPERATURE    (1u << 0)   ///< "temp": reports temperature.
+#define REGISTRY_CAP_HUMIDITY       (1u << 1)   ///< "hum": reports humidity.
+#define REGISTRY_CAP_LUX            (1u << 2)   ///< "lux": reports light intensity.
+#define REGISTRY_CAP_HEATER         (1u << 3)   ///< "heat": its zone has a heater.
+#define REGISTRY_CAP_DEHUMIDIFIER   (1u << 4)   ///< "dehum": its zone has a dehumidifier.
+#define REGISTRY_CAP_ALL            0x1f
+
+/**
+ * @brief Snapshot of one registered station.
+ */
+typedef struct {
+    char id[REGISTRY_ID_LEN];
+    uint8_t caps;               ///< REGISTRY_CAP_* flags announced in the last handshake.
+    uint8_t plugs;              ///< Bit per shelly_plug_t bound to this station's zone.
+    bool online;                ///< A connection of this station has completed the handshake and is open.
+    bool reading_valid;         ///< False until the station reported a reading.
+    telemetry_t reading;        ///< Latest complete reading.
+    uint32_t updated;           ///< history_now() time of the latest reading, in seconds since boot.
+    int16_t sp_temperature;     ///< Temperature setpoint last requested for the zone, in hundredths of degrees.
+    int16_t sp_humidity;        ///< Humidity setpoint last requested for the zone, in hundredths of percent RH.
+} station_record_t;
+
+/**
+ * @brief Parses a comma-separated capability list such as "temp,hum,lux".
+ *
+ * @param caps The list; parsing stops at ';' or the end of the string.
+ * @return REGISTRY_CAP_* flags of the known names.
+ */
+uint8_t registry_parse_caps(const char *caps);
+
+/**
+ * @brief Registers a station or updates the capabilities of a registered one. TCP server task only.
+ *
+ * A registered station that reports different capabilities gives up its plugs and is bound again from the new ones.
+ *
+ * @param id Station ID; at most REGISTRY_ID_LEN - 1 characters.
+ * @param caps REGISTRY_CAP_* flags.
+ * @return Slot of the station, or -1 if the ID is invalid or the registry is full.
+ */
+int registry_register(const char *id, uint8_t caps);
+
+/**
+ * @brief Finds a registered station.
+ *
+ * @param id Station ID.
+ * @return Slot of the station, or -1 if it is not registered.
+ */
+int registry_find(const char *id);
+
+/**
+ * @brief Marks a station as connected or disconnected. TCP server task only.
+ */
+void registry_set_online(int slot, bool online);
+
+/**
+ * @brief Records a complete reading of a station and the setpoints it reports. TCP server task only.
+ *
+ * @param slot Slot of the station.
+ * @param reading The reading.
+ * @param now history_now() time of the reading.
+ */
+void registry_record(int slot, const telemetry_t *reading, uint32_t now);
+
+/**
+ * @brief Records the setpoints requested for a station's zone.
+ */
+void registry_set_setpoints(int slot, int16_t sp_temperature, int16_t sp_humidity);
+
+/**
+ * @brief Returns the plugs bound to a station's zone, one bit per shelly_plug_t.
+ */
+uint8_t registry_plugs(int slot);
+
+/**
+ * @brief Returns the slot of the station bound to a plug, or -1 if the plug is unbound.
+ *
+ * @param plug A shelly_plug_t.
+ */
+int registry_plug_station(int plug);
+
+/**
+ * @brief Returns the slot of the station that owns the controller state, or -1 if no station is bound to a plug.
+ */
+int registry_owner(void);
+
+/**
+ * @brief Returns the number of registered stations.
+ */
+int registry_count(void);
+
+/**
+ * @brief Returns the registry version, which changes whenever a station is registered or an entry is written.
+ *
+ * Read it before scanning the slots: a scan that overlapped a write then carries the older version and is redone.
+ */
+uint32_t registry_version(void);
+
+/**
+ * @brief Copies a consistent snapshot of one slot.
+ *
+ * Scanning every slot from 0 to REGISTRY_CAPACITY - 1 visits every registered station once.
+ *
+ * @param slot Slot to read.
+ * @param out Receives the snapshot.
+ * @return True if the slot holds a station, false if it is free.
+ */
+bool registry_read(int slot, station_record_t *out);
+
+#endif // REGISTRY_H
@@ -0,0 +1,77 @@
+/**
+ * @file rules.h
+ * @brief Header file for the automation rule engine in the ESP32 Smart Home Main Controller.
+ *
+ * Rules switch the Shelly plugs from the zone bound to each plug. Each rule compares one input signal with a threshold
+ * using a hysteresis band, optionally only while conditions such as a lux range or a time window hold:
+ *
+ * @code
+ * {"rules":[
+ *   {"actuator":"heater","signal":"temperature","below":"sp_temperature","hysteresis":1.0,
+ *    "when":[{"signal":"time","from":"06:00","to":"22:00"}]},
+ *   {"actuator":"dehumidifier","signal":"humidity","above":"sp_humidity","hysteresis":2.0},
+ *   {"actuator":"heater","signal":"lux","below":20,"hysteresis":5}
+ * ]}
+ * @endcode
+ *
+ * "below" turns the actuator on under threshold - hysteresis and off over threshold + hysteresis; "above" is the
+ * opposite. The threshold is a constant in the units of the signal, or the name of another signal plus an optional
+ * "offset". A "when" condition holds while its signal lies within "min" and "max", or for "time", while the local
+ * time lies within "from" and "to", which may wrap around midnight. An actuator is on while any of its rules is on.
+ *
+ * Signals: temperature, humidity (°C, %RH), lux, sp_temperature, sp_humidity and time. Actuators: the names of
+ * the Shelly plugs. A rule reads the signals of the station its actuator is bound to in the registry, so two zones
+ * never switch each other's plugs. The rule set is kept as JSON in NVS and compiled into a fixed table; a rule is only
+ * re-evaluated when one of the signals it reads changes.
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define RULES_MAX 32                ///< Rules per rule set; one bit per rule in the dependency masks.
+#define RULES_MAX_CONDITIONS 2      ///< "when" conditions per rule.
+#define RULES_JSON_MAX 2048         ///< Largest rule set accepted, in bytes of JSON.
+
+/**
+ * @brief Loads the rule set from NVS, or the default rules mirroring the station's hysteresis control.
+ *
+ * Must be called before tcp_server_start(), whose task calls rules_poll(), and before start_http_server(), which
+ * serves /rules; it creates the lock both take and loads the set the first poll picks up.
+ */
+void rules_init(void);
+
+/**
+ * @brief Re-evaluates the rules whose input signals changed and switches the affected plugs.
+ *
+ * Called by the TCP server event loop on every pass. Picks up a rule set installed with rules_set_json().
+ * Does nothing but compare versions if neither the registry nor the minute of the day changed. A plug is left alone
+ * until the station bound to it reported since boot.
+ */
+void rules_poll(void);
+
+/**
+ * @brief Compiles a rule set, stores it in NVS and hands it to the evaluating task.
+ *
+ * Safe to call from any task.
+ *
+ * @param json Rule set as JSON, null-terminated.
+ * @param error Receives a description of the first error if the rule set is rejected.
+ * @param error_len Size of @p error.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the rule set is invalid, or the NVS error.
+ */
+esp_err_t rules_set_json(const char *json, char *error, size_t error_len);
+
+/**
+ * @brief Copies the JSON of the active rule set.
+ *
+ * @param buffer Receives the rule set, null-terminated.
+ * @param len Size of @p buffer; RULES_JSON_MAX always suffices.
+ * @return Length of the rule set in bytes.
+ */
+size_t rules_get_json(char *buffer, size_t len);
+
+#endif // RULES_H
@@ -2,18 +2,52 @@
  * @file shelly_control.h
  * @brief Header file for controlling Shelly devices via HTTP requests.
  *
- * This file provides the function declarations and external variables
- * for sending HTTP requests to control Shelly devices such as heaters
- * and humidifiers.
+ * Switch commands are published on BUS_TOPIC_ACTUATOR (see bus.h) and taken by a dedicated worker task per
+ * plug, so the rule engine never waits on the network. Each worker keeps one keep-alive HTTP client to its
+ * plug, and a slow or offline plug only delays its own commands.
+ *
+ * Commands are edge-triggered: a request for the state a plug was already commanded to is not sent again, and
+ * of several commands queued while a worker was busy only the latest is sent.
+ * Idle workers poll the plug now and then and re-assert the commanded state if the plug drifted.
+ */
+
+#ifndef SHELLY_CONTROL_H
+#define SHELLY_CONTROL_H
+
+#include <stdbool.h>
+
+/**
+ * @brief Shelly plugs controlled by the main controller.
  */
+typedef enum {
+    SHELLY_HEATER,          ///< Plug switching the heater.
+    SHELLY_DEHUMIDIFIER,    ///< Plug switching the dehumidifier.
+    SHELLY_PLUG_COUNT
+} shelly_plug_t;
 
 /**
- * @brief Sends an HTTP request to control a Shelly device.
+ * @brief Subscribes the workers to the switch commands and starts one worker task per plug.
  *
- * @param deviceIP The IP address of the Shelly device.
- * @param turnOn A boolean indicating whether to turn the device on (true) or off (false).
+ * Call after bus_init().
  */
-void send_http_request(const char* deviceIP, bool turnOn);
+void shelly_control_start(void);
+
+/**
+ * @brief Returns the state last confirmed by a Shelly plug.
+ *
+ * @param plug The plug to query.
+ * @param on Set to the confirmed state.
+ * @return True if the plug has confirmed a state since startup, false otherwise.
+ */
+bool shelly_get_state(shelly_plug_t plug, bool *on);
+
+/**
+ * @brief Returns the name of a Shelly plug, as used in logs and automation rules.
+ *
+ * @param plug The plug.
+ * @return The name, or NULL if @p plug is out of range.
+ */
+const char *shelly_plug_name(shelly_plug_t plug);
 
 /**
  * @brief The IP address of the heater device.
@@ -23,4 +57,6 @@ extern const char* heaterIP;
 /**
  * @brief The IP address of the humidifier device.
  */
-extern const char* humidifierIP;
\ No newline at end of file
+extern const char* humidifierIP;
+
+#endif // SHELLY_CONTROL_H
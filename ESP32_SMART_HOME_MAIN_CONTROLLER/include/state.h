@@ -0,0 +1,70 @@
+/**
+ * @file state.h
+ * @brief Header file for the shared controller state in the ESP32 Smart Home Main Controller.
+ *
+ * The latest readings, actuator states and setpoints live in one structure behind a seqlock. Writers (the TCP
+ * task for telemetry, the HTTP task for setpoints) serialize on a short critical section; readers never take a
+ * lock and never delay a writer, they simply retry if a write overlapped their copy. Every change bumps a
+ * version number, so consumers can tell cheaply whether anything changed since they last looked.
+ */
+
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Snapshot of the controller state.
+ */
+typedef struct {
+    int16_t temperature;        ///< Hundredths of degrees Celsius.
+    int16_t humidity;           ///< Hundredths of percent RH.
+    uint16_t lux;               ///< Light intensity in lux.
+    bool heater;                ///< Heater state reported by the station.
+    bool dehumidifier;          ///< Dehumidifier state reported by the station.
+    int16_t sp_temperature;     ///< Temperature setpoint in hundredths of degrees Celsius.
+    int16_t sp_humidity;        ///< Humidity setpoint in hundredths of percent RH.
+} controller_state_t;
+
+/**
+ * @brief Modifies a copy of the state; called by state_update().
+ *
+ * Runs inside a critical section, so it must only assign fields.
+ */
+typedef void (*state_update_fn)(controller_state_t *state, const void *arg);
+
+/**
+ * @brief Copies a consistent snapshot of the state.
+ *
+ * @param out Receives the snapshot.
+ * @return Version of the snapshot.
+ */
+uint32_t state_read(controller_state_t *out);
+
+/**
+ * @brief Returns the current version without copying the state.
+ */
+uint32_t state_version(void);
+
+/**
+ * @brief Atomically applies a modification to the state.
+ *
+ * The version is only bumped if the modification actually changed a field.
+ *
+ * @param fn Function that modifies the state.
+ * @param arg Argument passed to @p fn.
+ * @return True if the state changed, false otherwise.
+ */
+bool state_update(state_update_fn fn, const void *arg);
+
+/**
+ * @brief Sets the temperature and humidity setpoints.
+ *
+ * @param sp_temperature Temperature setpoint in hundredths of degrees Celsius.
+ * @param sp_humidity Humidity setpoint in hundredths of percent RH.
+ * @return True if the setpoints changed, false otherwise.
+ */
+bool state_set_setpoints(int16_t sp_temperature, int16_t sp_humidity);
+
+#endif // STATE_H
@@ -0,0 +1,36 @@
+/**
+ * @file storage.h
+ * @brief Header file for the sample storage task in the ESP32 Smart Home Main Controller.
+ *
+ * The storage task subscribes to BUS_TOPIC_SAMPLE and records the readings of the station owning the controller
+ * state (registry_owner()) in the in-RAM history and the telemetry log on flash, telling the uplink about every flush
+ * of the log. Flash writes and erases therefore run off the TCP server task and never hold up ingest.
+ */
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "telemetry_store.h"
+
+#define STORAGE_QUEUE_LEN 32        ///< Samples the storage task can fall behind ingest; one per station and pass.
+
+/**
+ * @brief Mounts the telemetry log, restores the newest sample into the controller state and starts the storage task.
+ *
+ * Call after bus_init() and history_init(), before the TCP server task is created.
+ */
+void storage_start(void);
+
+/**
+ * @brief Reads flushed records of the telemetry log; safe to call from any task.
+ *
+ * @param cursor Log position to read from, as for telemetry_store_read(); updated.
+ * @param out Receives the records.
+ * @param max Capacity of @p out.
+ * @return Number of records read; 0 at the end of the log or while the log is not mounted.
+ */
+size_t telemetry_log_read(uint64_t *cursor, telemetry_record_t *out, size_t max);
+
+#endif // STORAGE_H
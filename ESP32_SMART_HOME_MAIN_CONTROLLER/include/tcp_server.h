@@ -3,7 +3,7 @@
  * @brief Header file for the TCP server functionality in the ESP32 Smart Home Main Controller.
  *
  * This file contains the declarations of functions used for managing TCP server tasks,
- * sending messages, handling received data, and communicating with a web server.
+ * sending messages and handling received data.
  */
 
 #ifndef TCP_SERVER_H
@@ -11,55 +11,76 @@
 
 #include <stdbool.h>  // ✅ Fix: Include the bool type
 #include <stdint.h>   // ✅ Ensures correct type usage in ESP32
+#include <stddef.h>
+#include "framer.h"
 
-/**
- * @brief Task function for the TCP server.
- *
- * This function initializes and manages the TCP server, handling incoming connections
- * and data from clients.
- *
- * @param pvParameters Pointer to task parameters (if any).
- */
-void tcp_server_task(void *pvParameters);
+#define TCP_SERVER_PORT 8080        ///< Port the stations connect to.
+#define TCP_MAX_STATIONS 32         ///< Maximum number of simultaneously connected stations.
+#define TCP_COMMAND_HOLD_MS 600000  ///< Time a command waits for its station to connect or resume; the session TTL.
 
 /**
- * @brief Sends a TCP message to the connected client.
- *
- * @param message The message to be sent as a null-terminated string.
+ * @brief Handshake state of a station connection.
  */
-void send_tcp_message(const char *message);
+typedef enum {
+    STATION_HANDSHAKE,      ///< Accepted; waiting for HANDSHAKE:ARDUINO_READY until handshake_deadline.
+    STATION_READY,          ///< Handshake completed; telemetry is accepted.
+    STATION_FAILED,         ///< Handshake failed or timed out; the connection is closed by the event loop.
+} station_state_t;
 
 /**
- * @brief Sends a TCP message and waits for an acknowledgment.
+ * @brief Connection context of one station.
  *
- * @param message The message to be sent as a null-terminated string.
- * @param ackReceived Pointer to a boolean variable that will be set to true if acknowledgment is received.
+ * Every connected station owns one of these, so the server can multiplex many stations
+ * from a single task without one station's traffic or handshake blocking the others.
  */
-void send_tcp_message_with_ack(const char *message, bool *ackReceived);
+typedef struct {
+    int sock;                               ///< Station socket, or -1 if the slot is free.
+    station_state_t state;                  ///< Handshake progress of this connection.
+    int handshake_retries;                  ///< Unexpected messages received before the handshake completed.
+    int64_t accepted_at;                    ///< esp_timer time at which the connection was accepted, in microseconds.
+    int64_t handshake_deadline;             ///< esp_timer time by which the handshake must complete, in microseconds.
+    bool first_frame_seen;                  ///< True once a telemetry message from this connection was accepted.
+    bool send_broken;                       ///< A message went out only in part; the event loop closes the socket.
+    uint32_t session_token;                 ///< Resumable session held by this connection, or 0.
+    int station;                            ///< Registry slot of the station, or -1 before the handshake.
+    bool binary_frames;                     ///< Station negotiated binary telemetry frames during the handshake.
+    bool seq_valid;                         ///< True once a binary frame was received and last_seq is meaningful.
+    uint16_t last_seq;                      ///< Sequence number of the last binary frame received.
+    framer_t rx;                            ///< Receive ring that splits the stream into messages.
+} station_conn_t;
 
 /**
- * @brief Sends setpoints to the client and waits for an acknowledgment.
+ * @brief Starts the TCP server task.
  *
- * @param setpoints The setpoints to be sent as a null-terminated string.
+ * The task initializes and manages the TCP server, handling incoming connections
+ * and data from clients. Its stack and control block are static.
  */
-void send_setpoints_with_ack(const char *setpoints);
+void tcp_server_start(void);
 
 /**
- * @brief Handles data received from the TCP client.
+ * @brief Sends a TCP message to one station.
  *
- * This function processes the received data and performs appropriate actions based on its content.
+ * The station socket is non-blocking, so a station that stopped reading cannot stall the server;
+ * the message is dropped instead. A message cut off after part of it was sent would corrupt the line framing,
+ * so the connection is marked send_broken, nothing more is sent on it, and the event loop closes it.
  *
- * @param data The received data as a null-terminated string.
+ * @param conn The station connection to send to.
+ * @param message The message to be sent as a null-terminated string.
+ * @return True if the whole message was sent, false otherwise.
  */
-void handle_received_data(const char *data);
+bool send_station_message(station_conn_t *conn, const char *message);
 
 /**
- * @brief Sends data to the web server.
+ * @brief Handles one telemetry message received from a station.
  *
- * This function forwards data to the web server for further processing or storage.
+ * This function processes the received data and performs appropriate actions based on its content.
+ * The framer guarantees that @p data is one complete JSON message.
  *
- * @param data The data to be sent as a null-terminated string.
+ * @param conn The connection the message arrived on; the reading is recorded for its station.
+ * @param data The JSON payload following the DATA: prefix, null-terminated.
+ * @param len Length of the payload in bytes.
+ * @return True if the message was complete telemetry and was applied, false if it was rejected.
  */
-void send_data_to_web_server(const char *data);
+bool handle_received_data(station_conn_t *conn, const char *data, size_t len);
 
 #endif // TCP_SERVER_H
\ No newline at end of file
@@ -0,0 +1,61 @@
+/**
+ * @file telemetry_frame.h
+ * @brief Header file for the compact binary telemetry frame exchanged with the stations.
+ *
+ * Stations that offer "fmt=bin1" during the handshake send their readings as a fixed-size binary frame
+ * instead of the DATA: JSON line. All values are little-endian integers in centi-units:
+ *
+ * | Offset | Size | Field                                         |
+ * |--------|------|-----------------------------------------------|
+ * | 0      | 1    | Magic byte 0xB5                               |
+ * | 1      | 1    | Version (1)                                   |
+ * | 2      | 1    | Frame length in bytes, including magic and CRC |
+ * | 3      | 1    | Flags: bit 0 heater, bit 1 dehumidifier       |
+ * | 4      | 2    | Sequence number                               |
+ * | 6      | 2    | Temperature, hundredths of degrees Celsius    |
+ * | 8      | 2    | Humidity, hundredths of percent RH            |
+ * | 10     | 2    | Light intensity in lux                        |
+ * | 12     | 2    | Temperature setpoint, hundredths of degrees   |
+ * | 14     | 2    | Humidity setpoint, hundredths of percent      |
+ * | 16     | 2    | CRC-16/CCITT-FALSE over bytes 0..15           |
+ *
+ * The magic byte is never the first byte of a text line, which lets the framer tell both formats apart.
+ */
+
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "json_parser.h"
+
+#define TELEMETRY_FRAME_MAGIC 0xB5        ///< First byte of every binary frame.
+#define TELEMETRY_FRAME_VERSION 1         ///< Frame layout version described above.
+#define TELEMETRY_FRAME_SIZE 18           ///< Size of a version 1 frame in bytes.
+#define TELEMETRY_FRAME_OPTION "fmt=bin1" ///< Handshake option that negotiates binary frames.
+
+#define TELEMETRY_FLAG_HEATER       0x01
+#define TELEMETRY_FLAG_DEHUMIDIFIER 0x02
+
+/**
+ * @brief Computes the CRC-16/CCITT-FALSE checksum used by the binary frames.
+ *
+ * @param data Bytes to checksum.
+ * @param len Number of bytes.
+ * @return The checksum (polynomial 0x1021, initial value 0xFFFF).
+ */
+uint16_t telemetry_crc16(const uint8_t *data, size_t len);
+
+/**
+ * @brief Decodes a binary telemetry frame.
+ *
+ * @param frame The frame bytes, starting at the magic byte.
+ * @param len Number of bytes in the frame.
+ * @param out Receives the decoded sample; all fields are marked present.
+ * @param seq Receives the frame sequence number.
+ * @return True if the frame is a valid version 1 frame with a matching CRC, false otherwise.
+ */
+bool telemetry_frame_decode(const uint8_t *frame, size_t len, telemetry_t *out, uint16_t *seq);
+
+#endif // TELEMETRY_FRAME_H
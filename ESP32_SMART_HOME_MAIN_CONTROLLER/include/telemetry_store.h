@@ -0,0 +1,163 @@
+/**
+ * @file telemetry_store.h
+ * @brief Header file for the log-structured telemetry store in the ESP32 Smart Home Main Controller.
+ *
+ * Telemetry records are appended to a log of fixed-size segments, one flash sector each. Every segment starts
+ * with a header carrying its sequence number and erase count, and every record carries a CRC, so a write torn
+ * by a reset is detected and skipped on the next mount. Segments are reused round-robin, which spreads erases
+ * evenly over the partition, and a segment is only erased when the log wraps onto it. Records are collected
+ * in RAM and written in batches, so flash is touched at most once per TELEMETRY_STORE_BATCH samples.
+ *
+ * The store only talks to flash through telemetry_store_flash_t, so the same code runs on an esp_partition
+ * on the ESP32 and on a plain file on the host.
+ */
+
+#ifndef TELEMETRY_STORE_H
+#define TELEMETRY_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define TELEMETRY_STORE_BATCH 16            ///< Records collected in RAM before they are written.
+#define TELEMETRY_STORE_FLUSH_AFTER_S 60    ///< A partial batch is due once its oldest record is this old.
+#define TELEMETRY_STORE_PARTITION_SUBTYPE 0x40  ///< Data partition subtype of the "telemetry" partition.
+
+#define TELEMETRY_RECORD_HEATER       0x01
+#define TELEMETRY_RECORD_DEHUMIDIFIER 0x02
+
+/**
+ * @brief Flash access used by the store.
+ *
+ * Offsets are relative to the start of the storage area. write() may only clear bits, like NOR flash;
+ * erase() sets whole sectors back to 0xFF.
+ */
+typedef struct {
+    void *ctx;                  ///< Backend context passed to every call.
+    size_t size;                ///< Size of the storage area in bytes; a multiple of sector_size.
+    size_t sector_size;         ///< Erase unit in bytes.
+    esp_err_t (*read)(void *ctx, size_t offset, void *buf, size_t len);
+    esp_err_t (*write)(void *ctx, size_t offset, const void *buf, size_t len);
+    esp_err_t (*erase)(void *ctx, size_t offset, size_t len);
+} telemetry_store_flash_t;
+
+/**
+ * @brief One persisted sample, 16 bytes on flash.
+ */
+typedef struct {
+    uint32_t uptime;            ///< Seconds since boot when the sample was recorded.
+    uint16_t boot;              ///< Boot counter, so samples of different boots can be told apart.
+    int16_t temperature;        ///< Hundredths of degrees Celsius.
+    int16_t humidity;           ///< Hundredths of percent RH.
+    uint16_t lux;               ///< Light intensity in lux.
+    uint8_t flags;              ///< TELEMETRY_RECORD_* actuator states.
+    uint8_t reserved;
+    uint16_t crc;               ///< CRC-16 over the preceding bytes.
+} telemetry_record_t;
+
+/**
+ * @brief Counters describing the work done by the store since it was mounted.
+ */
+typedef struct {
+    uint32_t appended;          ///< Records accepted by telemetry_store_append().
+    uint32_t flushes;           ///< Flash writes of record batches.
+    uint32_t erases;            ///< Sectors erased.
+    uint32_t recovered;         ///< Valid records found in the active segment at mount.
+    uint32_t corrupt;           ///< Records skipped because of a CRC mismatch.
+} telemetry_store_stats_t;
+
+/**
+ * @brief State of a mounted store.
+ */
+typedef struct {
+    const telemetry_store_flash_t *flash;
+    uint32_t segment_count;
+    uint32_t records_per_segment;
+    uint32_t active;            ///< Index of the segment being appended to.
+    uint32_t active_seq;        ///< Sequence number of the active segment.
+    uint32_t active_erases;     ///< Erase count of the active segment.
+    uint32_t write_index;       ///< Next free record slot in the active segment.
+    uint16_t boot;              ///< Boot counter stamped into new records.
+    bool has_last;              ///< True if last holds the newest record.
+    telemetry_record_t last;    ///< Newest record, including unflushed ones.
+    telemetry_record_t batch[TELEMETRY_STORE_BATCH];
+    uint32_t batched;           ///< Records waiting in batch.
+    telemetry_store_stats_t stats;
+} telemetry_store_t;
+
+/**
+ * @brief Mounts the store, recovering the log or formatting an empty area.
+ *
+ * Finds the newest segment, resumes appending after its last written slot, and increments the boot counter.
+ *
+ * @param store The store to mount.
+ * @param flash The flash backend; must stay valid while the store is used.
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the area is too small, or the backend error.
+ */
+esp_err_t telemetry_store_mount(telemetry_store_t *store, const telemetry_store_flash_t *flash);
+
+/**
+ * @brief Appends one record to the batch, writing the batch when it is full or old enough.
+ *
+ * The boot counter and CRC are filled in by the store.
+ *
+ * @param store The store.
+ * @param record The record to append.
+ * @return ESP_OK on success, or the backend error of a failed flush.
+ */
+esp_err_t telemetry_store_append(telemetry_store_t *store, const telemetry_record_t *record);
+
+/**
+ * @brief Writes the records collected in RAM.
+ *
+ * @param store The store.
+ * @return ESP_OK on success, or the backend error.
+ */
+esp_err_t telemetry_store_flush(telemetry_store_t *store);
+
+/**
+ * @brief Returns when the records collected in RAM are due to be written.
+ *
+ * telemetry_store_append() only sees the age of the batch when the next record arrives, so the writer
+ * calls telemetry_store_flush() itself once this time has passed without one.
+ *
+ * @param store The store.
+ * @return Uptime in seconds at which the oldest collected record is TELEMETRY_STORE_FLUSH_AFTER_S old, or
+ *         UINT32_MAX if nothing is collected.
+ */
+uint32_t telemetry_store_flush_due(const telemetry_store_t *store);
+
+/**
+ * @brief Reads flushed records in log order.
+ *
+ * A cursor of 0 starts at the oldest record still in the log; on return the cursor points after the
+ * last record read. A cursor whose segment was already reused continues at the oldest record, and so does a
+ * cursor beyond the end of the log, which was taken before the log was formatted.
+ *
+ * @param store The store.
+ * @param cursor Log position to read from; updated.
+ * @param out Receives the records.
+ * @param max Capacity of @p out.
+ * @return Number of records read; 0 at the end of the log.
+ */
+size_t telemetry_store_read(telemetry_store_t *store, uint64_t *cursor, telemetry_record_t *out, size_t max);
+
+/**
+ * @brief Returns the newest record, including records not flushed yet.
+ *
+ * @param store The store.
+ * @param record Set to the newest record.
+ * @return True if the log holds at least one record, false otherwise.
+ */
+bool telemetry_store_last(const telemetry_store_t *store, telemetry_record_t *record);
+
+/**
+ * @brief Sets up a flash backend on the "telemetry" data partition.
+ *
+ * @param flash Receives the backend.
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the partition table has no telemetry partition.
+ */
+esp_err_t telemetry_store_partition_init(telemetry_store_flash_t *flash);
+
+#endif // TELEMETRY_STORE_H
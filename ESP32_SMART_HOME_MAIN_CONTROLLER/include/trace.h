@@ -0,0 +1,86 @@
+/**
+ * @file trace.h
+ * @brief Header file for the cycle-counter trace buffer in the ESP32 Smart Home Main Controller.
+ *
+ * TRACE_BEGIN() and TRACE_END() record CPU cycle and esp_timer timestamps into a lock-free ring buffer per core, which /trace
+ * dumps in the Chrome trace_event JSON format (load it in chrome://tracing or Perfetto). Tracing is enabled with
+ * CONFIG_SMARTHOME_TRACE; otherwise the trace points compile to nothing.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+/**
+ * @brief Traced sections of the ingest-to-actuation path.
+ */
+typedef enum {
+    TRACE_RECV,             ///< recv() of one chunk of station data.
+    TRACE_FRAMER,           ///< Splitting a receive ring into messages.
+    TRACE_PARSE,            ///< Parsing one JSON message or decoding one binary frame.
+    TRACE_TELEMETRY,        ///< Applying, recording and persisting one sample.
+    TRACE_SHELLY,           ///< One Shelly HTTP request.
+    TRACE_POINT_COUNT
+} trace_point_t;
+
+#ifdef CONFIG_SMARTHOME_TRACE
+
+#define TRACE_BEGIN(point) trace_record((point), true)
+#define TRACE_END(point) trace_record((point), false)
+
+/**
+ * @brief Position of an ongoing dump of the trace buffers.
+ */
+typedef struct {
+    uint32_t core;          ///< Core whose buffer is being dumped.
+    uint32_t index;         ///< Next event index within that buffer.
+    uint32_t end;           ///< Event index at which the dump of that buffer stops.
+    int64_t anchor_us;      ///< esp_timer time of the first event of the current buffer.
+    int64_t last_us;        ///< esp_timer time of the previous event.
+    uint32_t last_cycles;   ///< Cycle count of the previous event, to unwrap the 32-bit counter.
+    int64_t cycles;         ///< Cycles from the first event of the current buffer to the previous event.
+    bool started;           ///< An event of the current buffer has been seen, so the fields above are valid.
+    bool opened;            ///< The document header has been written.
+    bool first;             ///< No event has been written yet.
+    bool done;              ///< The closing bracket has been written.
+} trace_cursor_t;
+
+/**
+ * @brief Records a trace event on the calling core. Use TRACE_BEGIN() / TRACE_END() instead.
+ */
+void trace_record(trace_point_t point, bool begin);
+
+/**
+ * @brief Pauses recording and starts dumping the trace buffers.
+ *
+ * @param cursor Cursor to initialize.
+ */
+void trace_dump_begin(trace_cursor_t *cursor);
+
+/**
+ * @brief Writes the next part of the Chrome trace_event JSON document.
+ *
+ * @param cursor Cursor initialized by trace_dump_begin().
+ * @param buffer Output buffer; must hold at least 128 bytes.
+ * @param len Size of the output buffer.
+ * @return Number of characters written, or 0 once the document is complete.
+ */
+size_t trace_dump_next(trace_cursor_t *cursor, char *buffer, size_t len);
+
+/**
+ * @brief Resumes recording after a dump.
+ */
+void trace_dump_end(void);
+
+#else
+
+#define TRACE_BEGIN(point) do { } while (0)
+#define TRACE_END(point) do { } while (0)
+
+#endif // CONFIG_SMARTHOME_TRACE
+
+#endif // TRACE_H
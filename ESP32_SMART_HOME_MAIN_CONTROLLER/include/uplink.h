@@ -0,0 +1,38 @@
+/**
+ * @file uplink.h
+ * @brief Header file for the store-and-forward uplink to the upstream web server.
+ *
+ * Every sample is already persisted in the telemetry log, so the log doubles as the uplink's spill area: the
+ * uplink keeps a cursor into the log and posts everything behind it in batches (see uplink_codec.h) to
+ * uplinkURL. A batch goes out whenever the log flushes, that is every TELEMETRY_STORE_BATCH samples or once the
+ * oldest unwritten sample is TELEMETRY_STORE_FLUSH_AFTER_S old, which the storage task checks on a timer as well
+ * as on every sample. The log is checked every CONFIG_SMARTHOME_UPLINK_INTERVAL_S in any case.
+ *
+ * The cursor only moves past a batch once the upstream answered it with a 2xx status, and it is saved to NVS,
+ * so nothing is lost while the upstream or the controller is down, up to the capacity of the log. After an
+ * outage the backlog is replayed with up to UPLINK_IN_FLIGHT posts in flight. A failed post rewinds to the
+ * oldest unacknowledged batch and retries with exponential backoff; posts that had succeeded after it are
+ * sent again, so the upstream must drop duplicates by boot and uptime.
+ */
+
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#define UPLINK_BATCH_RECORDS 64     ///< Records per post.
+#define UPLINK_IN_FLIGHT 2          ///< Posts in flight at once while a backlog is replayed.
+
+extern const char *uplinkURL;       ///< Upstream endpoint; empty to disable the uplink.
+
+/**
+ * @brief Restores the cursor from NVS and starts the uplink tasks.
+ *
+ * May be called before or after storage_start(); the uplink reads nothing until the telemetry log is mounted.
+ */
+void uplink_start(void);
+
+/**
+ * @brief Tells the uplink that the telemetry log flushed new records. Called by the storage task.
+ */
+void uplink_notify(void);
+
+#endif // UPLINK_H
@@ -0,0 +1,69 @@
+/**
+ * @file uplink_codec.h
+ * @brief Header file for the compact sample batch format posted by the uplink.
+ *
+ * A batch carries consecutive records of the telemetry log. Neighbouring samples differ little, so every
+ * field is stored as the difference to the previous record, zigzag-mapped and written as a LEB128 varint;
+ * a steady sample takes 5 bytes instead of the 16 of a log record or the ~110 of a JSON object:
+ *
+ * | Field       | Encoding                                                                     |
+ * |-------------|------------------------------------------------------------------------------|
+ * | Magic       | 1 byte 0xB6                                                                  |
+ * | Version     | 1 byte (1)                                                                   |
+ * | Count       | varint, number of records                                                    |
+ * | Per record: |                                                                              |
+ * | Tag         | 1 byte: bit 0 heater, bit 1 dehumidifier, bit 7 boot follows                 |
+ * | Boot        | varint, only if bit 7 is set; always set on the first record                 |
+ * | Uptime      | varint: absolute if bit 7 is set, otherwise seconds since the previous record |
+ * | Temperature | zigzag varint, difference to the previous record in hundredths of degrees    |
+ * | Humidity    | zigzag varint, difference to the previous record in hundredths of percent RH |
+ * | Lux         | zigzag varint, difference to the previous record                             |
+ *
+ * The first record is encoded against an all-zero record. Batches are posted with the content type
+ * UPLINK_CODEC_CONTENT_TYPE; a receiver identifies samples by boot and uptime, so it can drop the
+ * duplicates a replay after a failed post may produce.
+ */
+
+#ifndef UPLINK_CODEC_H
+#define UPLINK_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "telemetry_store.h"
+
+#define UPLINK_CODEC_MAGIC 0xB6
+#define UPLINK_CODEC_VERSION 1
+#define UPLINK_CODEC_CONTENT_TYPE "application/vnd.smarthome.samples"
+#define UPLINK_CODEC_RECORD_MAX 20      ///< Longest encoding of one record in bytes.
+#define UPLINK_CODEC_HEADER_MAX 7       ///< Magic, version and the longest count.
+
+/**
+ * @brief Returns the buffer size that fits a batch of @p count records in any case.
+ */
+#define UPLINK_CODEC_SIZE(count) (UPLINK_CODEC_HEADER_MAX + (count) * UPLINK_CODEC_RECORD_MAX)
+
+/**
+ * @brief Encodes records into a batch.
+ *
+ * @param records The records, in log order.
+ * @param count Number of records.
+ * @param out Receives the batch.
+ * @param len Size of @p out; UPLINK_CODEC_SIZE(count) always suffices.
+ * @return Length of the batch in bytes, or 0 if it does not fit.
+ */
+size_t uplink_encode(const telemetry_record_t *records, size_t count, uint8_t *out, size_t len);
+
+/**
+ * @brief Decodes a batch. Only the fields carried by the batch are set; crc and reserved are zero.
+ *
+ * @param in The batch.
+ * @param len Length of the batch in bytes.
+ * @param out Receives the records.
+ * @param max Capacity of @p out.
+ * @param count Set to the number of records decoded.
+ * @return True if the batch is well-formed and fits @p out, false otherwise.
+ */
+bool uplink_decode(const uint8_t *in, size_t len, telemetry_record_t *out, size_t max, size_t *count);
+
+#endif // UPLINK_CODEC_H
@@ -0,0 +1,205 @@
+/**
+ * @file bus.c
+ * @brief This file contains the implementation of the publish/subscribe bus for the ESP32 Smart Home Main Controller project.
+ *
+ * The message pool is a static array whose free entries are kept in a FreeRTOS queue of pointers, so taking and
+ * returning a message is one non-blocking queue operation from any task. A published message carries a reference
+ * count set to the number of subscribers before the first pointer is queued; every subscriber, and every queue that
+ * refused the pointer, drops one reference, and the last one returns the message to the pool.
+ *
+ * Subscriptions are only added at startup. An entry and its queue slots are reserved under a spinlock, the queue is
+ * created outside it, and the topic's subscriber count is then raised over every completed entry with a release
+ * store, so publishers, which read the count with an acquire load, never see a half-made entry.
+ * All queues are created statically, the subscriber queues on slots carved from one shared array, so the bus never
+ * allocates from the heap.
+ *
+ * The main functionalities provided by this file include:
+ * - Allocating and recycling pooled messages.
+ * - Registering subscriber queues per topic.
+ * - Fanning a message out to all subscribers by reference without blocking.
+ * - Counting per-subscriber drops and reporting queue depths for the metrics.
+ *
+ * Dependencies:
+ * - bus.h: Bus declarations.
+ * - freertos/queue.h: FreeRTOS queues carrying the message pointers.
+ * - esp_log.h: ESP32 logging functions.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "bus.h"
+
+static const char *TAG = "BUS";
+
+/**
+ * @brief One subscriber of a topic.
+ */
+typedef struct {
+    const char *name;
+    QueueHandle_t queue;    ///< Carries `const bus_msg_t *`; set once the entry is complete.
+    StaticQueue_t queue_buffer;
+    uint32_t dropped;       ///< Messages lost to a full queue or an empty pool.
+} bus_subscriber_t;
+
+/**
+ * @brief Subscribers of one topic.
+ */
+typedef struct {
+    bus_subscriber_t subscribers[BUS_MAX_SUBSCRIBERS];
+    uint32_t count;         ///< Entries in use; raised with a release store once the entry is complete.
+    uint32_t reserved;      ///< Entries claimed by bus_subscribe(); protected by subscribe_lock.
+} bus_topic_state_t;
+
+static const char *const topic_names[BUS_TOPIC_COUNT] = {
+    [BUS_TOPIC_SAMPLE] = "sample",
+    [BUS_TOPIC_SETPOINT] = "setpoint",
+    [BUS_TOPIC_ACTUATOR] = "actuator",
+};
+
+static bus_msg_t pool[BUS_POOL_SIZE];
+static QueueHandle_t free_list = NULL;      ///< Free pool entries, as pointers.
+static StaticQueue_t free_list_buffer;
+static bus_msg_t *free_list_slots[BUS_POOL_SIZE];
+static bus_topic_state_t topics[BUS_TOPIC_COUNT];
+static const bus_msg_t *queue_slots[BUS_QUEUE_SLOTS];   ///< Storage of the subscriber queues.
+static uint32_t queue_slots_used = 0;                   ///< Protected by subscribe_lock.
+static portMUX_TYPE subscribe_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t next_id = 1;
+
+
+void bus_init(void) {
+    free_list = xQueueCreateStatic(BUS_POOL_SIZE, sizeof(bus_msg_t *), (uint8_t *)free_list_slots, &free_list_buffer);
+    for (int i = 0; i < BUS_POOL_SIZE; i++) {
+        bus_msg_t *msg = &pool[i];
+        xQueueSend(free_list, &msg, 0);
+    }
+}
+
+
+QueueHandle_t bus_subscribe(bus_topic_t topic, const char *name, UBaseType_t depth) {
+    bus_topic_state_t *state = &topics[topic];
+    QueueHandle_t queue = NULL;
+
+    // Reserve the entry and the queue slots; the queue itself is made outside the critical section
+    portENTER_CRITICAL(&subscribe_lock);
+    uint32_t index = state->reserved;
+    uint32_t first_slot = queue_slots_used;
+    bool room = index < BUS_MAX_SUBSCRIBERS && depth <= BUS_QUEUE_SLOTS - queue_slots_used;
+    if (room) {
+        state->reserved++;
+        queue_slots_used += depth;
+    }
+    portEXIT_CRITICAL(&subscribe_lock);
+
+    if (!room) {
+        ESP_LOGE(TAG, "❌ No room for subscriber %s of topic %s", name, topic_names[topic]);
+        return NULL;
+    }
+
+    bus_subscriber_t *subscriber = &state->subscribers[index];
+    subscriber->name = name;
+    subscriber->dropped = 0;
+    queue = xQueueCreateStatic(depth, sizeof(const bus_msg_t *), (uint8_t *)&queue_slots[first_slot],
+                               &subscriber->queue_buffer);
+
+    // Publish in order: the count only passes entries whose queue is set, whichever subscription finished first
+    portENTER_CRITICAL(&subscribe_lock);
+    subscriber->queue = queue;
+    uint32_t count = state->count;
+    while (count < state->reserved && state->subscribers[count].queue) {
+        count++;
+    }
+    __atomic_store_n(&state->count, count, __ATOMIC_RELEASE);
+    portEXIT_CRITICAL(&subscribe_lock);
+
+    ESP_LOGI(TAG, "📬 %s subscribed to %s (%u deep)", name, topic_names[topic], (unsigned)depth);
+    return queue;
+}
+
+
+bus_msg_t *bus_alloc(bus_topic_t topic) {
+    bus_msg_t *msg;
+    if (!free_list || xQueueReceive(free_list, &msg, 0) != pdTRUE) {
+        // Every subscriber misses the message that could not be made
+        bus_topic_state_t *state = &topics[topic];
+        uint32_t count = __atomic_load_n(&state->count, __ATOMIC_ACQUIRE);
+        for (uint32_t i = 0; i < count; i++) {
+            __atomic_fetch_add(&state->subscribers[i].dropped, 1, __ATOMIC_RELAXED);
+        }
+        return NULL;
+    }
+    memset(msg, 0, sizeof(*msg));
+    msg->topic = topic;
+    return msg;
+}
+
+
+uint32_t bus_publish(bus_msg_t *msg) {
+    bus_topic_state_t *state = &topics[msg->topic];
+    uint32_t count = __atomic_load_n(&state->count, __ATOMIC_ACQUIRE);
+    if (count == 0) {
+        xQueueSend(free_list, &msg, 0);
+        return 0;
+    }
+
+    uint32_t id = __atomic_fetch_add(&next_id, 1, __ATOMIC_RELAXED);
+    if (id == 0) {
+        id = __atomic_fetch_add(&next_id, 1, __ATOMIC_RELAXED);  // 0 means not published
+    }
+    msg->id = id;
+    msg->refs = count;
+
+    // The message may be released and reused as soon as the last pointer is queued, so only locals are read below
+    const bus_msg_t *ref = msg;
+    uint32_t delivered = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        bus_subscriber_t *subscriber = &state->subscribers[i];
+        if (xQueueSend(subscriber->queue, &ref, 0) == pdTRUE) {
+            delivered++;
+        } else {
+            __atomic_fetch_add(&subscriber->dropped, 1, __ATOMIC_RELAXED);
+            bus_release(ref);
+        }
+    }
+    return delivered == count ? id : 0;
+}
+
+
+void bus_release(const bus_msg_t *msg) {
+    bus_msg_t *entry = (bus_msg_t *)msg;
+    if (__atomic_sub_fetch(&entry->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        xQueueSend(free_list, &entry, 0);
+    }
+}
+
+
+bool bus_subscriber_stats(size_t index, bus_subscriber_stats_t *out) {
+    for (int topic = 0; topic < BUS_TOPIC_COUNT; topic++) {
+        bus_topic_state_t *state = &topics[topic];
+        uint32_t count = __atomic_load_n(&state->count, __ATOMIC_ACQUIRE);
+        if (index < count) {
+            const bus_subscriber_t *subscriber = &state->subscribers[index];
+            out->topic = topic;
+            out->name = subscriber->name;
+            out->depth = uxQueueMessagesWaiting(subscriber->queue);
+            out->dropped = __atomic_load_n(&subscriber->dropped, __ATOMIC_RELAXED);
+            return true;
+        }
+        index -= count;
+    }
+    return false;
+}
+
+
+uint32_t bus_pool_free(void) {
+    return free_list ? uxQueueMessagesWaiting(free_list) : 0;
+}
+
+
+const char *bus_topic_name(bus_topic_t topic) {
+    return topic < BUS_TOPIC_COUNT ? topic_names[topic] : NULL;
+}
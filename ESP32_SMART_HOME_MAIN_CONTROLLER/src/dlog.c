@@ -0,0 +1,195 @@
+/**
+ * @file dlog.c
+ * @brief This file contains the implementation of the deferred logger for the ESP32 Smart Home Main Controller project.
+ *
+ * Records are queued in a bounded multi-producer ring in which every slot carries a sequence number: a producer
+ * claims a slot with a compare-and-swap on the head and publishes it by advancing the slot's sequence, and the
+ * single consumer frees it the same way. Producers on both cores and in any task therefore never take a lock and
+ * never wait; when the ring is full the record is dropped and counted.
+ *
+ * The consumer task formats the records on its own stack and prints them with their original timestamps. A record
+ * whose call site and arguments hash to the same value as one printed less than DLOG_REPEAT_WINDOW_MS earlier is
+ * suppressed; the number of suppressed repeats is reported when the message is printed again.
+ *
+ * The main functionalities provided by this file include:
+ * - Queueing log records without formatting or locking.
+ * - Formatting and printing queued records on a low-priority task.
+ * - Suppressing repeated messages by hash.
+ *
+ * Dependencies:
+ * - dlog.h: Deferred logger declarations.
+ * - freertos/FreeRTOS.h: FreeRTOS functions.
+ * - freertos/task.h: FreeRTOS task functions.
+ * - esp_log.h: ESP32 logging functions.
+ * - metrics.h: Dropped and suppressed record counters, stack registration.
+ * - stdio.h: Formatting.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "dlog.h"
+#include "metrics.h"
+
+static const char *TAG = "DLOG";
+
+#define DLOG_RING_LEN 64                ///< Queued records; must be a power of two.
+#define DLOG_TASK_STACK 3072
+#define DLOG_TASK_PRIORITY 1            ///< Just above idle: logging never competes with ingest.
+#define DLOG_POLL_MS 50                 ///< Interval at which the consumer drains the ring.
+#define DLOG_REPEAT_SLOTS 32            ///< Recently printed messages remembered for suppression.
+#define DLOG_REPEAT_WINDOW_MS 10000     ///< Identical messages within this window are suppressed.
+
+_Static_assert((DLOG_RING_LEN & (DLOG_RING_LEN - 1)) == 0, "DLOG_RING_LEN must be a power of two");
+
+typedef struct {
+    const dlog_site_t *site;
+    const char *tag;
+    uint32_t timestamp;         ///< esp_log_timestamp() when the record was queued.
+    uint32_t nargs;
+    uintptr_t args[DLOG_MAX_ARGS];
+} dlog_record_t;
+
+typedef struct {
+    uint32_t seq;               ///< Position + 1 when the slot holds a record, position + DLOG_RING_LEN when free.
+    dlog_record_t record;
+} dlog_slot_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t printed_at;        ///< Timestamp of the last printed occurrence.
+    uint32_t suppressed;        ///< Occurrences suppressed since then.
+} dlog_repeat_t;
+
+static dlog_slot_t ring[DLOG_RING_LEN];
+static uint32_t ring_head = 0;  ///< Next position to claim; shared by all producers.
+static uint32_t ring_tail = 0;  ///< Next position to consume; only touched by the consumer task.
+static dlog_repeat_t repeats[DLOG_REPEAT_SLOTS];
+static StackType_t task_stack[DLOG_TASK_STACK];
+static StaticTask_t task_buffer;
+
+
+void dlog_write(const dlog_site_t *site, const char *tag, uint32_t nargs, const uintptr_t *args) {
+    uint32_t pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    dlog_slot_t *slot;
+
+    for (;;) {
+        slot = &ring[pos & (DLOG_RING_LEN - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring_head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            metrics_inc(METRIC_LOG_DROPPED);  // Full: the consumer has not freed this slot yet
+            return;
+        } else {
+            pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->record.site = site;
+    slot->record.tag = tag;
+    slot->record.timestamp = esp_log_timestamp();
+    slot->record.nargs = nargs;
+    for (uint32_t i = 0; i < nargs; i++) {
+        slot->record.args[i] = args[i];
+    }
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+
+static uint32_t record_hash(const dlog_record_t *record) {
+    uint32_t hash = 2166136261u;  // FNV-1a over the call site and argument words
+    hash = (hash ^ (uint32_t)(uintptr_t)record->site) * 16777619u;
+    for (uint32_t i = 0; i < record->nargs; i++) {
+        hash = (hash ^ (uint32_t)record->args[i]) * 16777619u;
+    }
+    return hash;
+}
+
+
+/**
+ * Returns false if the record repeats a message printed within the window. Otherwise remembers it, replacing the
+ * entry in its slot, and returns the number of repeats suppressed since it was last printed in @p suppressed.
+ */
+static bool repeat_check(const dlog_record_t *record, uint32_t *suppressed) {
+    uint32_t hash = record_hash(record);
+    dlog_repeat_t *entry = &repeats[hash % DLOG_REPEAT_SLOTS];
+
+    if (entry->hash == hash && record->timestamp - entry->printed_at < DLOG_REPEAT_WINDOW_MS) {
+        entry->suppressed++;
+        metrics_inc(METRIC_LOG_SUPPRESSED);
+        return false;
+    }
+
+    *suppressed = entry->hash == hash ? entry->suppressed : 0;
+    entry->hash = hash;
+    entry->printed_at = record->timestamp;
+    entry->suppressed = 0;
+    return true;
+}
+
+
+static void dlog_print(const dlog_record_t *record) {
+    static const char letters[] = { 'N', 'E', 'W', 'I', 'D', 'V' };
+    const dlog_site_t *site = record->site;
+    const uintptr_t *a = record->args;
+    char text[192];
+
+    uint32_t suppressed;
+    if (!repeat_check(record, &suppressed)) {
+        return;
+    }
+
+    // Unused trailing words are ignored by snprintf; every argument is one word wide
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat-security"
+    snprintf(text, sizeof(text), site->format, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+#pragma GCC diagnostic pop
+
+    char level = site->level < sizeof(letters) ? letters[site->level] : '?';
+    if (suppressed) {
+        esp_log_write(site->level, record->tag, "%c (%lu) %s: %s (%lu repeats suppressed)\n", level,
+                      (unsigned long)record->timestamp, record->tag, text, (unsigned long)suppressed);
+    } else {
+        esp_log_write(site->level, record->tag, "%c (%lu) %s: %s\n", level,
+                      (unsigned long)record->timestamp, record->tag, text);
+    }
+}
+
+
+static void dlog_task(void *pvParameters) {
+    dlog_record_t record;
+
+    while (1) {
+        for (;;) {
+            dlog_slot_t *slot = &ring[ring_tail & (DLOG_RING_LEN - 1)];
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring_tail + 1) {
+                break;
+            }
+            record = slot->record;
+            __atomic_store_n(&slot->seq, ring_tail + DLOG_RING_LEN, __ATOMIC_RELEASE);
+            ring_tail++;
+            dlog_print(&record);
+        }
+        vTaskDelay(pdMS_TO_TICKS(DLOG_POLL_MS));
+    }
+}
+
+
+void dlog_start(void) {
+    for (uint32_t i = 0; i < DLOG_RING_LEN; i++) {
+        ring[i].seq = i;
+    }
+    TaskHandle_t task = xTaskCreateStatic(dlog_task, "dlog", DLOG_TASK_STACK, NULL, DLOG_TASK_PRIORITY,
+                                          task_stack, &task_buffer);
+    if (!task) {
+        ESP_LOGE(TAG, "❌ Unable to start the deferred logger");
+    }
+    metrics_register_task(task, DLOG_TASK_STACK);
+}
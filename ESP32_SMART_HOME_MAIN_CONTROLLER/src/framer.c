@@ -0,0 +1,137 @@
+/**
+ * @file framer.c
+ * @brief This file contains the implementation of the ring-buffer message framer for the ESP32 Smart Home Main Controller project.
+ *
+ * The framer splits the byte stream of a station connection into newline-terminated messages. Data is received
+ * straight into the ring, each byte is examined once while searching for delimiters, and complete messages are
+ * handed out in place without copying unless they wrap around the end of the ring.
+ *
+ * The main functionalities provided by this file include:
+ * - Exposing the free space of the ring for zero-copy receives.
+ * - Extracting complete messages, including several per receive and messages split across receives.
+ * - Extracting length-prefixed binary frames that may contain newline bytes.
+ * - Dropping and counting messages that are larger than the ring instead of silently resetting.
+ *
+ * Dependencies:
+ * - framer.h: Framer type and function declarations.
+ * - string.h: String manipulation functions.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include "framer.h"
+#include <string.h>
+
+#define FRAMER_MASK (FRAMER_CAPACITY - 1)
+
+_Static_assert((FRAMER_CAPACITY & FRAMER_MASK) == 0, "FRAMER_CAPACITY must be a power of two");
+
+
+void framer_init(framer_t *framer) {
+    framer->head = 0;
+    framer->tail = 0;
+    framer->scan = 0;
+    framer->discarding = false;
+    framer->overflows = 0;
+}
+
+
+char *framer_write_ptr(framer_t *framer, size_t *space) {
+    uint32_t free_bytes = FRAMER_CAPACITY - (framer->head - framer->tail);
+    uint32_t index = framer->head & FRAMER_MASK;
+    uint32_t to_end = FRAMER_CAPACITY - index;
+
+    *space = free_bytes < to_end ? free_bytes : to_end;
+    return &framer->data[index];
+}
+
+
+void framer_commit(framer_t *framer, size_t len) {
+    framer->head += (uint32_t)len;
+}
+
+
+static char *framer_linearize(framer_t *framer, uint32_t start, uint32_t len, char *scratch) {
+    uint32_t index = start & FRAMER_MASK;
+    if (index + len < FRAMER_CAPACITY) {
+        return &framer->data[index];
+    }
+
+    uint32_t first = FRAMER_CAPACITY - index;
+    memcpy(scratch, &framer->data[index], first);
+    memcpy(scratch + first, framer->data, len - first);
+    return scratch;
+}
+
+
+bool framer_next(framer_t *framer, char *scratch, framer_frame_t *frame) {
+    while (1) {
+        uint32_t pending = framer->head - framer->tail;
+
+        if (framer->scan == framer->tail && pending > 0 && !framer->discarding &&
+            (uint8_t)framer->data[framer->tail & FRAMER_MASK] == FRAMER_BINARY_MAGIC) {
+            if (pending <= FRAMER_BINARY_LEN_OFFSET) {
+                break;
+            }
+            uint32_t len = (uint8_t)framer->data[(framer->tail + FRAMER_BINARY_LEN_OFFSET) & FRAMER_MASK];
+            if (len <= FRAMER_BINARY_LEN_OFFSET) {
+                // Not a valid frame header: drop the stray magic byte and resynchronize
+                framer->tail++;
+                framer->scan++;
+                continue;
+            }
+            if (pending < len) {
+                break;
+            }
+
+            frame->data = framer_linearize(framer, framer->tail, len, scratch);
+            frame->len = len;
+            frame->binary = true;
+            framer->tail += len;
+            framer->scan = framer->tail;
+            return true;
+        }
+
+        if (framer->scan == framer->head) {
+            break;
+        }
+
+        char c = framer->data[framer->scan & FRAMER_MASK];
+        framer->scan++;
+        if (c != '\n') {
+            continue;
+        }
+
+        uint32_t start = framer->tail;
+        uint32_t len = framer->scan - 1 - start;
+        framer->tail = framer->scan;
+
+        if (framer->discarding) {
+            // End of a message that did not fit; resume with the next one
+            framer->discarding = false;
+            continue;
+        }
+
+        char *text = framer_linearize(framer, start, len, scratch);
+        if (len > 0 && text[len - 1] == '\r') {
+            len--;
+        }
+        text[len] = '\0';
+
+        frame->data = text;
+        frame->len = len;
+        frame->binary = false;
+        return true;
+    }
+
+    if (framer->head - framer->tail == FRAMER_CAPACITY) {
+        // Ring is full without a delimiter: drop what we have and skip to the next message
+        if (!framer->discarding) {
+            framer->overflows++;
+            framer->discarding = true;
+        }
+        framer->tail = framer->head;
+        framer->scan = framer->head;
+    }
+    return false;
+}
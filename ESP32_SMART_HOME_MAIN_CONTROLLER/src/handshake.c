@@ -3,17 +3,31 @@
  * @brief This file contains the implementation of the handshake functions for the ESP32 Smart Home Main Controller project.
  *
  * The functions provided in this file allow for performing a handshake with the Arduino to establish a reliable connection.
+ * The handshake is a per-connection state driven by the TCP server event loop: every message received on a connection
+ * that has not completed the handshake yet is passed to performHandshake(), and the time limit is a deadline checked on
+ * every pass of the loop rather than a blocking wait, so a slow station never blocks the other stations.
+ *
+ * A completed handshake also opens a session identified by a random token that is sent to the station. When the
+ * connection closes, the session keeps the telemetry format and frame sequence state for a while, and a station that
+ * reconnects resumes it by presenting the token in its first data frame instead of repeating the handshake.
  *
  * The main functionalities provided by this file include:
  * - Sanitizing handshake input to remove extra characters.
  * - Performing the handshake process with the Arduino.
+ * - Failing connections whose handshake deadline has passed.
+ * - Negotiating the telemetry format from the options appended to the handshake message.
+ * - Registering the station named in the handshake and binding the connection to its registry slot.
+ * - Issuing session tokens and resuming suspended sessions on reconnect.
  *
  * Dependencies:
  * - tcp_server.h: TCP server function declarations.
  * - globals.h: Global variables and definitions.
  * - esp_log.h: ESP32 logging functions.
- * - sys/socket.h: Socket functions.
- * - errno.h: Error handling functions.
+ * - telemetry_frame.h: Binary telemetry frame option name.
+ * - metrics.h: Handshake duration histogram.
+ * - esp_timer.h: Microsecond timestamps.
+ * - esp_random.h: Hardware random numbers for the session tokens.
+ * - registry.h: Station registry.
  *
  * @note This file is part of the ESP32 Smart Home Main Controller project.
  */
@@ -21,13 +35,36 @@
 #include "handshake.h"
 #include "tcp_server.h"
 #include "globals.h"
+#include "telemetry_frame.h"
+#include "metrics.h"
+#include "registry.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include <stdio.h>
 #include <string.h>
-#include <sys/socket.h>
-#include <errno.h>
 
 static const char *TAG = "HANDSHAKE";
 
+#define HANDSHAKE_MAX_RETRIES 6
+#define HANDSHAKE_READY "HANDSHAKE:ARDUINO_READY"
+
+/**
+ * @brief Session of one station, kept across its connections. Only touched by the TCP server task.
+ */
+typedef struct {
+    uint32_t token;         ///< Token issued to the station, or 0 if the slot is free.
+    bool held;              ///< A connection currently holds the session.
+    int64_t expires_at;     ///< esp_timer time at which a suspended session is forgotten, in microseconds.
+    int station;            ///< Registry slot of the station.
+    bool binary_frames;     ///< Telemetry format negotiated by the handshake that opened the session.
+    bool seq_valid;         ///< Frame sequence state of the last connection.
+    uint16_t last_seq;
+} handshake_session_t;
+
+// Every connection holds at most one session, so a slot that is free or only suspended always exists
+static handshake_session_t sessions[TCP_MAX_STATIONS];
+
 
 void sanitize_handshake(char *input) {
     char *newline = strchr(input, '\n');
@@ -38,65 +75,220 @@ void sanitize_handshake(char *input) {
 }
 
 
-void performHandshake() {
-    if (handshake_done) {
-        ESP_LOGW(TAG, "⚠️ Handshake already completed. Skipping...");
-        return;
+static bool has_handshake_option(const char *options, const char *option) {
+    size_t len = strlen(option);
+    while (*options == ';') {
+        options++;
+        if (strncmp(options, option, len) == 0 && (options[len] == ';' || options[len] == '\0')) {
+            return true;
+        }
+        options += strcspn(options, ";");
     }
+    return false;
+}
 
-    handshake_done = false;
-    int handshakeRetries = 0;
-    const int maxRetries = 6;  
 
-    ESP_LOGI(TAG, "🕐 Waiting 3s before first handshake attempt...");
-    vTaskDelay(pdMS_TO_TICKS(3000));
+/**
+ * Copies the value of a ";key=value" option into @p value. Returns false if the option is absent or too long.
+ */
+static bool get_handshake_option(const char *options, const char *key, char *value, size_t value_len) {
+    size_t len = strlen(key);
+    while (*options == ';') {
+        options++;
+        size_t option_len = strcspn(options, ";");
+        if (strncmp(options, key, len) == 0 && options[len] == '=') {
+            size_t n = option_len - len - 1;
+            if (n >= value_len) return false;
+            memcpy(value, options + len + 1, n);
+            value[n] = '\0';
+            return true;
+        }
+        options += option_len;
+    }
+    return false;
+}
+
 
-    while (!handshake_done && handshakeRetries < maxRetries) {
-        char ack_buffer[128] = {0};  
-        int total_received = 0;
+static bool valid_station_id(const char *id) {
+    if (*id == '\0') return false;
+    for (; *id; id++) {
+        if (!((*id >= 'a' && *id <= 'z') || (*id >= '0' && *id <= '9') || *id == '_' || *id == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * Registers the station named by the handshake options and binds the connection to it.
+ */
+static bool handshake_register(station_conn_t *conn, const char *options) {
+    char id[REGISTRY_ID_LEN] = REGISTRY_LEGACY_ID;
+    char caps[48];
+    bool has_id = strstr(options, ";id=") != NULL;
+
+    if (has_id && (!get_handshake_option(options, "id", id, sizeof(id)) || !valid_station_id(id))) {
+        ESP_LOGE(TAG, "❌ Invalid station ID in handshake on socket %d", conn->sock);
+        return false;
+    }
+    uint8_t flags = get_handshake_option(options, "caps", caps, sizeof(caps)) ? registry_parse_caps(caps)
+                                                                             : REGISTRY_CAP_ALL;
+
+    conn->station = registry_register(id, flags);
+    if (conn->station < 0) {
+        return false;
+    }
+    registry_set_online(conn->station, true);
+    return true;
+}
+
+
+void handshake_start(station_conn_t *conn, int64_t now) {
+    conn->state = STATION_HANDSHAKE;
+    conn->handshake_retries = 0;
+    conn->accepted_at = now;
+    conn->handshake_deadline = now + (int64_t)HANDSHAKE_TIMEOUT_MS * 1000;
+    conn->binary_frames = false;
+    conn->session_token = 0;
+    conn->station = -1;
+}
 
-        struct timeval timeout = {.tv_sec = 10, .tv_usec = 0};
-        setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
 
-        ESP_LOGI(TAG, "📨 Waiting for handshake response...");
+static handshake_session_t *session_find(uint32_t token) {
+    if (token == 0) return NULL;
+    for (int i = 0; i < TCP_MAX_STATIONS; i++) {
+        if (sessions[i].token == token) {
+            return &sessions[i];
+        }
+    }
+    return NULL;
+}
 
-        while (total_received < sizeof(ack_buffer) - 1) {
-            int bytes_received = recv(client_sock, ack_buffer + total_received, sizeof(ack_buffer) - total_received - 1, 0);
-            if (bytes_received <= 0) {
-                break;
-            }
-            total_received += bytes_received;
 
-            if (ack_buffer[total_received - 1] == '\n') {
-                break;  // Stop if full handshake message received
-            }
+/**
+ * Opens a session for a connection that just completed the handshake. A free or expired slot is preferred;
+ * otherwise the suspended session closest to expiry is replaced.
+ */
+static uint32_t session_open(station_conn_t *conn, int64_t now) {
+    handshake_session_t *slot = NULL;
+    for (int i = 0; i < TCP_MAX_STATIONS; i++) {
+        handshake_session_t *session = &sessions[i];
+        if (session->held) continue;
+        if (session->token == 0 || now >= session->expires_at) {
+            slot = session;
+            break;
+        }
+        if (!slot || session->expires_at < slot->expires_at) {
+            slot = session;
         }
-        ack_buffer[total_received] = '\0';
+    }
 
-        if (total_received > 0) {
-            sanitize_handshake(ack_buffer);
+    uint32_t token;
+    do {
+        token = esp_random();
+    } while (token == 0 || session_find(token));
 
-            ESP_LOGI(TAG, "📩 Received clean handshake: '%s'", ack_buffer);
+    *slot = (handshake_session_t){
+        .token = token, .held = true, .station = conn->station, .binary_frames = conn->binary_frames,
+    };
+    conn->session_token = token;
+    return token;
+}
 
-            if (strcmp(ack_buffer, "HANDSHAKE:ARDUINO_READY") == 0) {
-                ESP_LOGI(TAG, "✅ Handshake received from Arduino. Sending response...");
-                send_tcp_message("HANDSHAKE:ESP32_READY\n");
 
-                handshake_done = true;
-                ESP_LOGI(TAG, "🎉 Handshake completed! Connection is ready.");
-                return;
-            } else {
-                ESP_LOGE(TAG, "❌ Unexpected handshake message: '%s'", ack_buffer);
-            }
-        } else {
-            ESP_LOGW(TAG, "⚠️ No valid handshake received. Retrying...");
+bool performHandshake(station_conn_t *conn, char *message) {
+    if (conn->state != STATION_HANDSHAKE) {
+        ESP_LOGW(TAG, "⚠️ Handshake already completed on socket %d. Skipping...", conn->sock);
+        return conn->state == STATION_READY;
+    }
+
+    sanitize_handshake(message);
+    ESP_LOGI(TAG, "📩 Received clean handshake on socket %d: '%s'", conn->sock, message);
+
+    size_t ready_len = strlen(HANDSHAKE_READY);
+    if (strncmp(message, HANDSHAKE_READY, ready_len) == 0 &&
+        (message[ready_len] == '\0' || message[ready_len] == ';')) {
+        // Options follow as ";key=value"; stations that offer none keep sending JSON
+        conn->binary_frames = has_handshake_option(message + ready_len, TELEMETRY_FRAME_OPTION);
+
+        if (!handshake_register(conn, message + ready_len)) {
+            ESP_LOGE(TAG, "🚨 Handshake FAILED, station could not be registered!");
+            send_station_message(conn, "ERROR:HANDSHAKE_FAILED\n");
+            conn->state = STATION_FAILED;
+            return false;
         }
 
-        handshakeRetries++;
-        ESP_LOGW(TAG, "🔁 Retrying handshake in 3s... (%d/%d)", handshakeRetries, maxRetries);
-        vTaskDelay(pdMS_TO_TICKS(3000));
+        ESP_LOGI(TAG, "✅ Handshake received from Arduino. Sending response...");
+        char response[64];
+        snprintf(response, sizeof(response), "HANDSHAKE:ESP32_READY%s;tok=%08lx\n",
+                 conn->binary_frames ? ";" TELEMETRY_FRAME_OPTION : "",
+                 (unsigned long)session_open(conn, esp_timer_get_time()));
+        send_station_message(conn, response);
+
+        conn->state = STATION_READY;
+        metrics_inc(METRIC_HANDSHAKES);
+        metrics_observe(METRIC_HANDSHAKE_MS, (uint32_t)((esp_timer_get_time() - conn->accepted_at) / 1000));
+        ESP_LOGI(TAG, "🎉 Handshake completed on socket %d! Station in slot %d is ready (%s telemetry).",
+                 conn->sock, conn->station, conn->binary_frames ? "binary" : "JSON");
+        return true;
     }
 
-    ESP_LOGE(TAG, "🚨 Handshake FAILED after max retries!");
-    send_tcp_message("ERROR:HANDSHAKE_FAILED\n");
+    conn->handshake_retries++;
+    ESP_LOGE(TAG, "❌ Unexpected handshake message: '%s' (%d/%d)",
+             message, conn->handshake_retries, HANDSHAKE_MAX_RETRIES);
+
+    if (conn->handshake_retries >= HANDSHAKE_MAX_RETRIES) {
+        ESP_LOGE(TAG, "🚨 Handshake FAILED after max retries!");
+        send_station_message(conn, "ERROR:HANDSHAKE_FAILED\n");
+        conn->state = STATION_FAILED;
+    }
+    return false;
+}
+
+
+bool handshake_check_deadline(station_conn_t *conn, int64_t now) {
+    if (conn->state != STATION_HANDSHAKE || now < conn->handshake_deadline) {
+        return false;
+    }
+
+    ESP_LOGE(TAG, "⏰ No handshake on socket %d within %d ms", conn->sock, HANDSHAKE_TIMEOUT_MS);
+    send_station_message(conn, "ERROR:HANDSHAKE_FAILED\n");
+    conn->state = STATION_FAILED;
+    return true;
+}
+
+
+bool handshake_resume(station_conn_t *conn, uint32_t token, int64_t now) {
+    handshake_session_t *session = session_find(token);
+    if (conn->state != STATION_HANDSHAKE || !session || session->held || now >= session->expires_at) {
+        ESP_LOGW(TAG, "⚠️ Unknown or expired session %08lx on socket %d", (unsigned long)token, conn->sock);
+        return false;
+    }
+
+    session->held = true;
+    conn->session_token = token;
+    conn->station = session->station;
+    registry_set_online(conn->station, true);
+    conn->binary_frames = session->binary_frames;
+    conn->seq_valid = session->seq_valid;
+    conn->last_seq = session->last_seq;
+    conn->state = STATION_READY;
+    metrics_inc(METRIC_SESSION_RESUMES);
+    ESP_LOGI(TAG, "🔁 Session %08lx resumed on socket %d (%s telemetry)",
+             (unsigned long)token, conn->sock, conn->binary_frames ? "binary" : "JSON");
+    return true;
+}
+
+
+void handshake_suspend(station_conn_t *conn, int64_t now) {
+    handshake_session_t *session = session_find(conn->session_token);
+    if (session && session->held) {
+        session->held = false;
+        session->expires_at = now + (int64_t)HANDSHAKE_SESSION_TTL_MS * 1000;
+        session->binary_frames = conn->binary_frames;
+        session->seq_valid = conn->seq_valid;
+        session->last_seq = conn->last_seq;
+    }
+    conn->session_token = 0;
 }
@@ -0,0 +1,237 @@
+/**
+ * @file history.c
+ * @brief This file contains the implementation of the in-RAM time-series history for the ESP32 Smart Home Main Controller project.
+ *
+ * Samples are stored in three tiers of structure-of-arrays rings: one timestamp array per tier plus one min, max and
+ * avg array per metric. The raw tier stores samples as they arrive. The minute and hour tiers keep an open bucket
+ * with running min, max and sum that is written to the ring when the first sample of the next period arrives, so
+ * every sample costs a constant amount of work and no memory is allocated after history_init().
+ *
+ * The main functionalities provided by this file include:
+ * - Recording samples in the raw tier and updating the open rollup buckets.
+ * - Reading points of one metric and tier in batches for streaming.
+ * - Keeping all storage within a fixed, compile-time checked RAM budget.
+ *
+ * Dependencies:
+ * - history.h: History types and function declarations.
+ * - freertos/semphr.h: FreeRTOS mutex functions.
+ * - esp_timer.h: Time since boot.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include "history.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+/**
+ * @brief Ring and open bucket of one tier.
+ *
+ * The metric arrays are laid out as [metric][len]. The raw tier points min, max and avg at the same array.
+ */
+typedef struct {
+    uint32_t *timestamp;
+    int32_t *min;
+    int32_t *max;
+    int32_t *avg;
+    uint16_t len;
+    uint16_t head;              ///< Index the next point is written to.
+    uint16_t count;             ///< Number of valid points.
+    uint32_t period;            ///< Bucket length in seconds; 0 for the raw tier.
+    bool open;                  ///< True while a bucket is being accumulated.
+    uint32_t bucket;            ///< Start time of the open bucket.
+    uint32_t samples;           ///< Samples in the open bucket.
+    int32_t acc_min[HISTORY_METRIC_COUNT];
+    int32_t acc_max[HISTORY_METRIC_COUNT];
+    int64_t acc_sum[HISTORY_METRIC_COUNT];
+} history_tier_state_t;
+
+static uint32_t raw_timestamp[HISTORY_RAW_LEN];
+static int32_t raw_value[HISTORY_METRIC_COUNT][HISTORY_RAW_LEN];
+
+static uint32_t minute_timestamp[HISTORY_MINUTE_LEN];
+static int32_t minute_min[HISTORY_METRIC_COUNT][HISTORY_MINUTE_LEN];
+static int32_t minute_max[HISTORY_METRIC_COUNT][HISTORY_MINUTE_LEN];
+static int32_t minute_avg[HISTORY_METRIC_COUNT][HISTORY_MINUTE_LEN];
+
+static uint32_t hour_timestamp[HISTORY_HOUR_LEN];
+static int32_t hour_min[HISTORY_METRIC_COUNT][HISTORY_HOUR_LEN];
+static int32_t hour_max[HISTORY_METRIC_COUNT][HISTORY_HOUR_LEN];
+static int32_t hour_avg[HISTORY_METRIC_COUNT][HISTORY_HOUR_LEN];
+
+_Static_assert(sizeof(raw_timestamp) + sizeof(raw_value) +
+               sizeof(minute_timestamp) + 3 * sizeof(minute_min) +
+               sizeof(hour_timestamp) + 3 * sizeof(hour_min) <= HISTORY_RAM_BUDGET,
+               "history tiers exceed HISTORY_RAM_BUDGET");
+
+static history_tier_state_t tiers[HISTORY_TIER_COUNT] = {
+    [HISTORY_RAW] = {
+        .timestamp = raw_timestamp, .min = &raw_value[0][0], .max = &raw_value[0][0], .avg = &raw_value[0][0],
+        .len = HISTORY_RAW_LEN, .period = 0,
+    },
+    [HISTORY_MINUTE] = {
+        .timestamp = minute_timestamp, .min = &minute_min[0][0], .max = &minute_max[0][0], .avg = &minute_avg[0][0],
+        .len = HISTORY_MINUTE_LEN, .period = 60,
+    },
+    [HISTORY_HOUR] = {
+        .timestamp = hour_timestamp, .min = &hour_min[0][0], .max = &hour_max[0][0], .avg = &hour_avg[0][0],
+        .len = HISTORY_HOUR_LEN, .period = 3600,
+    },
+};
+
+static SemaphoreHandle_t history_mutex;
+static StaticSemaphore_t history_mutex_buffer;
+
+
+uint32_t history_now(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+
+void history_init(void) {
+    history_mutex = xSemaphoreCreateMutexStatic(&history_mutex_buffer);
+}
+
+
+static uint16_t tier_oldest_index(const history_tier_state_t *tier) {
+    return (uint16_t)((tier->head + tier->len - tier->count) % tier->len);
+}
+
+
+static void tier_push(history_tier_state_t *tier, uint32_t timestamp,
+                      const int32_t *min, const int32_t *max, const int32_t *avg) {
+    uint16_t i = tier->head;
+    tier->timestamp[i] = timestamp;
+    for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+        tier->min[m * tier->len + i] = min[m];
+        tier->max[m * tier->len + i] = max[m];
+        tier->avg[m * tier->len + i] = avg[m];
+    }
+    tier->head = (uint16_t)((i + 1) % tier->len);
+    if (tier->count < tier->len) tier->count++;
+}
+
+
+static void tier_bucket_avg(const history_tier_state_t *tier, int32_t *avg) {
+    for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+        avg[m] = (int32_t)(tier->acc_sum[m] / (int64_t)tier->samples);
+    }
+}
+
+
+static void tier_accumulate(history_tier_state_t *tier, uint32_t now, const int32_t *values) {
+    uint32_t bucket = now - now % tier->period;
+
+    if (tier->open && bucket != tier->bucket) {
+        int32_t avg[HISTORY_METRIC_COUNT];
+        tier_bucket_avg(tier, avg);
+        tier_push(tier, tier->bucket, tier->acc_min, tier->acc_max, avg);
+        tier->open = false;
+    }
+
+    if (!tier->open) {
+        tier->open = true;
+        tier->bucket = bucket;
+        tier->samples = 0;
+        for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+            tier->acc_min[m] = values[m];
+            tier->acc_max[m] = values[m];
+            tier->acc_sum[m] = 0;
+        }
+    }
+
+    tier->samples++;
+    for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+        if (values[m] < tier->acc_min[m]) tier->acc_min[m] = values[m];
+        if (values[m] > tier->acc_max[m]) tier->acc_max[m] = values[m];
+        tier->acc_sum[m] += values[m];
+    }
+}
+
+
+void history_add(int32_t temperature, int32_t humidity, int32_t lux) {
+    const int32_t values[HISTORY_METRIC_COUNT] = {
+        [HISTORY_TEMPERATURE] = temperature,
+        [HISTORY_HUMIDITY] = humidity,
+        [HISTORY_LUX] = lux,
+    };
+    uint32_t now = history_now();
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    tier_push(&tiers[HISTORY_RAW], now, values, values, values);
+    tier_accumulate(&tiers[HISTORY_MINUTE], now, values);
+    tier_accumulate(&tiers[HISTORY_HOUR], now, values);
+    xSemaphoreGive(history_mutex);
+}
+
+
+size_t history_read(history_metric_t metric, history_tier_t tier_id, int64_t after, uint32_t to,
+                    history_point_t *out, size_t max) {
+    if (metric >= HISTORY_METRIC_COUNT || tier_id >= HISTORY_TIER_COUNT) {
+        return 0;
+    }
+    const history_tier_state_t *tier = &tiers[tier_id];
+    size_t n = 0;
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+
+    uint16_t i = tier_oldest_index(tier);
+    for (uint16_t k = 0; k < tier->count; k++, i = (uint16_t)((i + 1) % tier->len)) {
+        uint32_t timestamp = tier->timestamp[i];
+        if (timestamp <= after) continue;
+        if (timestamp > to) break;
+
+        if (n == max) {
+            // Raw samples can share a second; never split them across batches, or the next
+            // batch starting after this timestamp would skip the rest
+            size_t keep = n;
+            while (keep > 0 && out[keep - 1].timestamp == timestamp) keep--;
+            if (keep > 0) n = keep;
+            break;
+        }
+
+        out[n].timestamp = timestamp;
+        out[n].min = tier->min[metric * tier->len + i];
+        out[n].max = tier->max[metric * tier->len + i];
+        out[n].avg = tier->avg[metric * tier->len + i];
+        n++;
+    }
+
+    if (tier->open && n < max && tier->bucket > after && tier->bucket <= to &&
+        (n == 0 || out[n - 1].timestamp < tier->bucket)) {
+        out[n].timestamp = tier->bucket;
+        out[n].min = tier->acc_min[metric];
+        out[n].max = tier->acc_max[metric];
+        out[n].avg = (int32_t)(tier->acc_sum[metric] / (int64_t)tier->samples);
+        n++;
+    }
+
+    xSemaphoreGive(history_mutex);
+    return n;
+}
+
+
+uint32_t history_period(history_tier_t tier) {
+    return tier < HISTORY_TIER_COUNT ? tiers[tier].period : 0;
+}
+
+
+bool history_oldest(history_tier_t tier_id, uint32_t *oldest) {
+    if (tier_id >= HISTORY_TIER_COUNT) {
+        return false;
+    }
+    const history_tier_state_t *tier = &tiers[tier_id];
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    bool found = true;
+    if (tier->count > 0) {
+        *oldest = tier->timestamp[tier_oldest_index(tier)];
+    } else if (tier->open) {
+        *oldest = tier->bucket;
+    } else {
+        found = false;
+    }
+    xSemaphoreGive(history_mutex);
+    return found;
+}
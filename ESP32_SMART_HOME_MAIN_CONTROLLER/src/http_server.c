@@ -6,207 +6,686 @@
  * handling HTTP GET and POST requests, and updating setpoints for temperature and humidity.
  *
  * The main functionalities provided by this file include:
- * - Serving a web interface with real-time data updates.
- * - Handling HTTP GET requests to provide sensor data.
- * - Handling HTTP POST requests to update setpoints.
- * - Sending setpoints to the Arduino over TCP and controlling Shelly devices via HTTP requests.
+ * - Serving the prebuilt, gzip-compressed dashboard from flash with ETag/304 revalidation.
+ * - Handling HTTP GET requests to provide sensor data, including every registered station from one registry scan. The
+ *   body is serialized with integer formatting once per change of the state or the registry version, then served from
+ *   a double buffer with an ETag of both versions and a per-boot nonce, so an unchanged poll costs a 304.
+ * - Pushing state changes to every dashboard subscribed to the /ws WebSocket.
+ * - Streaming recorded history as chunked JSON from /history.
+ * - Exposing runtime metrics in the Prometheus text format on /metrics.
+ * - Dumping the trace buffers as Chrome trace_event JSON on /trace, when tracing is enabled.
+ * - Handling HTTP POST requests to update setpoints, for the whole system or one station's zone.
+ * - Publishing setpoints for the Arduino on the bus, for the TCP server task to deliver.
+ * - Answering setpoint requests that wait for the station's ACK from a separate task, so the wait never holds up
+ *   the HTTP server task.
+ * - Serving and replacing the automation rules on /rules.
  *
  * Dependencies:
  * - esp_http_server.h: ESP32 HTTP server functions.
  * - esp_log.h: ESP32 logging functions.
+ * - esp_rom_crc.h: CRC32 used for the dashboard ETag.
+ * - esp_random.h: Per-boot nonce of the /data ETag.
  * - cJSON.h: JSON parsing library.
  * - globals.h: Global variables and definitions.
  * - json_parser.h: JSON parsing helper functions.
- * - tcp_server.h: TCP server function declarations.
- * - shelly_control.h: Shelly device control functions.
+ * - tcp_server.h: TCP server declarations.
+ * - freertos/queue.h, freertos/semphr.h: Acknowledgment queue and the lock of the waiting requests.
+ * - bus.h: Publish/subscribe bus for setpoints.
+ * - rules.h: Automation rule engine.
+ * - registry.h: Station registry.
+ * - shelly_control.h: Plug names.
+ * - history.h: In-RAM time-series history.
+ * - state.h: Shared controller state.
+ * - metrics.h: Runtime counters and histograms.
+ * - trace.h: Cycle-counter trace buffers.
  *
  * @note This file is part of the ESP32 Smart Home Main Controller project.
  */
 
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_random.h"
 #include "cJSON.h"
 #include "globals.h"
 #include "json_parser.h" // Include the header for json_parser
 #include "tcp_server.h" // Include this header
+#include "bus.h"
+#include "rules.h"
+#include "registry.h"
 #include "shelly_control.h"
+#include "history.h"
+#include "state.h"
+#include "metrics.h"
+#include "trace.h"
 
 static const char *TAG = "HTTP_SERVER";
 
-extern int16_t SP_TEMP; // Declare the external variables
-extern int16_t SP_HUM;
+// Dashboard page, gzipped at build time from web/index.html and embedded by src/CMakeLists.txt
+extern const uint8_t dashboard_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t dashboard_gz_end[] asm("_binary_index_html_gz_end");
+
+static char dashboard_etag[12];  ///< Strong ETag: quoted CRC32 of the embedded page.
+
+#define SETPOINTS_ACK_WAIT_MS 10000   ///< Longest time POST /update?wait=1 holds the response for the station's ACK.
+#define SETPOINTS_WAITS_MAX 4         ///< POST /update?wait=1 requests held at once.
+#define SETPOINTS_WAIT_TASK_STACK 3072
+#define SETPOINTS_WAIT_TASK_PRIORITY 5
+#define SETPOINT_TEMP_MIN 0.0f        ///< Lowest temperature setpoint accepted, in °C; the dashboard slider's range.
+#define SETPOINT_TEMP_MAX 50.0f
+#define SETPOINT_HUMIDITY_MIN 0.0f    ///< Lowest humidity setpoint accepted, in %RH.
+#define SETPOINT_HUMIDITY_MAX 100.0f
+#define WS_MAX_CLIENTS 12        ///< Upper bound on sockets inspected per broadcast; matches max_open_sockets.
+#define HTTP_MAX_URI_HANDLERS 12 ///< Registered handlers, with room to spare; the default of 8 is nearly used up.
+
+static httpd_handle_t server_handle = NULL;
+static controller_state_t live_sent;        ///< State as last pushed to subscribers; only touched from the HTTP server task.
+static uint32_t live_sent_version;
+static bool live_sent_valid = false;
+static atomic_bool push_pending = false;    ///< A broadcast is queued; further updates fold into it.
+static char rules_buffer[RULES_JSON_MAX];   ///< Rule set JSON in and out of /rules; only touched from the HTTP server task.
+
+#define DATA_STATION_MAX 232     ///< Longest station object in /data, with its separating comma.
+#define DATA_BODY_SIZE (192 + REGISTRY_MAX_STATIONS * DATA_STATION_MAX)
+
+/**
+ * @brief A serialized /data body and the versions of the state and the registry it was made from.
+ */
+typedef struct {
+    char text[DATA_BODY_SIZE];
+    size_t len;
+    uint32_t state_version;
+    uint32_t registry_version;
+    char etag[28];          ///< Strong ETag: quoted boot nonce, state and registry versions in hex.
+} data_body_t;
+
+static data_body_t data_bodies[2];          ///< Double buffer; a new body is serialized into the one not published.
+static const data_body_t *data_front = NULL;    ///< Published body; only touched from the HTTP server task.
+static uint32_t data_boot_nonce;            ///< Random per boot; the versions restart at 0 after a reset.
 
 esp_err_t get_data_handler(httpd_req_t *req) {
-    char buffer[1536]; // Buffer size
+    httpd_resp_set_hdr(req, "ETag", dashboard_etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");  // Revalidate every time; unchanged pages cost a 304
+
+    char if_none_match[sizeof(dashboard_etag)];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, dashboard_etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
 
-    // Send HTML headers with character encoding
     httpd_resp_set_type(req, "text/html");
-    httpd_resp_set_hdr(req, "Content-Encoding", "utf-8");
-
-    // Send HTML content in smaller chunks
-    snprintf(buffer, sizeof(buffer),
-        "<!DOCTYPE html>"
-        "<html>"
-        "<head>"
-        "<meta charset=\"UTF-8\">"
-        "<title>ESP32 Smart Home</title>"
-        "<style>"
-        "body { font-family: Arial, sans-serif; background-color: #f0f0f0; margin: 0; padding: 0; display: flex; justify-content: center; align-items: center; height: 100vh; }");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    snprintf(buffer, sizeof(buffer),
-        ".container { max-width: 800px; padding: 20px; background-color: #fff; box-shadow: 0 0 10px rgba(0, 0, 0, 0.1); border-radius: 10px; }"
-        "h1 { text-align: center; color: #333; }"
-        "p { font-size: 18px; color: #666; }"
-        ".slider-container { margin: 20px 0; }"
-        ".slider-label { display: block; margin-bottom: 10px; font-weight: bold; }"
-        ".slider { width: 100%; }");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    snprintf(buffer, sizeof(buffer),
-        ".button { display: block; width: 100%; padding: 10px; background-color: #007bff; color: #fff; text-align: center; border: none; border-radius: 5px; cursor: pointer; }"
-        ".button:hover { background-color: #0056b3; }"
-        ".status { display: flex; justify-content: space-between; margin: 10px 0; }"
-        ".status div { flex: 1; text-align: center; padding: 10px; border-radius: 5px; }"
-        ".status .on { background-color: #28a745; color: #fff; }"
-        ".status .off { background-color: #dc3545; color: #fff; }"
-        ".loading { text-align: center; font-size: 18px; color: #666; display: none; }"
-        "</style>"
-        "</head>"
-        "<body>"
-        "<div class=\"container\">"
-        "<h1>ESP32 Smart Home</h1>");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    // Temperature
-    snprintf(buffer, sizeof(buffer), "<p>Temperature: %.2f &#8451; (SP: <span id=\"spTempValue\">%.2f</span> &#8451;)</p>", temperature, SP_TEMP / 100.0);
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    // Humidity
-    snprintf(buffer, sizeof(buffer), "<p>Humidity: %.2f %% (SP: <span id=\"spHumidityValue\">%.2f</span> %%)</p>", humidity, SP_HUM / 100.0);
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    // Lux
-    snprintf(buffer, sizeof(buffer), "<p>Lux: %d</p>", lux);
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    // Heater and Dehumidifier states
-    snprintf(buffer, sizeof(buffer), 
-        "<div class=\"status\">"
-        "<div id=\"heaterStatus\" class=\"%s\">Heater: %s</div>"
-        "<div id=\"dehumidifierStatus\" class=\"%s\">Dehumidifier: %s</div>"
-        "</div>",
-        heater ? "on" : "off", heater ? "ON" : "OFF",
-        dehumidifier ? "on" : "off", dehumidifier ? "ON" : "OFF");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    // Sliders
-    snprintf(buffer, sizeof(buffer),
-        "<div class=\"slider-container\">"
-        "<label for=\"tempSlider\" class=\"slider-label\">Set Temperature (&#8451;): </label>"
-        "<input type=\"range\" id=\"tempSlider\" class=\"slider\" min=\"0\" max=\"50\" step=\"0.1\" value=\"%.2f\" oninput=\"updateTempValue(this.value)\">"
-        "<span id=\"tempValue\">%.2f</span>"
-        "</div>", SP_TEMP / 100.0, SP_TEMP / 100.0);
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    snprintf(buffer, sizeof(buffer),
-        "<div class=\"slider-container\">"
-        "<label for=\"humiditySlider\" class=\"slider-label\">Set Humidity (&#37;): </label>"
-        "<input type=\"range\" id=\"humiditySlider\" class=\"slider\" min=\"0\" max=\"100\" step=\"0.1\" value=\"%.2f\" oninput=\"updateHumidityValue(this.value)\">"
-        "<span id=\"humidityValue\">%.2f</span>"
-        "</div>", SP_HUM / 100.0, SP_HUM / 100.0);
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    // Button and JavaScript
-    snprintf(buffer, sizeof(buffer),
-        "<button class=\"button\" onclick=\"sendData()\">Update Setpoints</button>");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    // Loading message
-    snprintf(buffer, sizeof(buffer),
-        "<div id=\"loading\" class=\"loading\">Please wait...</div>");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    snprintf(buffer, sizeof(buffer),
-        "<script>"
-        "function updateTempValue(val) {"
-        "    document.getElementById('tempValue').innerText = val;"
-        "}"
-        "function updateHumidityValue(val) {"
-        "    document.getElementById('humidityValue').innerText = val;"
-        "}");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    snprintf(buffer, sizeof(buffer),
-        "function sendData() {"
-        "    document.getElementById('loading').style.display = 'block';"
-        "    var temp = document.getElementById('tempSlider').value;"
-        "    var humidity = document.getElementById('humiditySlider').value;"
-        "    var xhr = new XMLHttpRequest();"
-        "    xhr.open('POST', '/update', true);"
-        "    xhr.setRequestHeader('Content-Type', 'application/x-www-form-urlencoded');"
-        "    xhr.send('temp=' + temp + '&humidity=' + humidity);");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    snprintf(buffer, sizeof(buffer),
-        "    xhr.onload = function() {"
-        "        if (xhr.status == 200) {"
-        "            fetchData();"
-        "        }"
-        "    };"
-        "}");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    snprintf(buffer, sizeof(buffer),
-        "</script>");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    snprintf(buffer, sizeof(buffer),
-        "<script>"
-        "function fetchData() {"
-        "    var xhr = new XMLHttpRequest();"
-        "    xhr.open('GET', '/data', true);"
-        "    xhr.onload = function() {"
-        "        document.getElementById('loading').style.display = 'none';"
-        "        if (xhr.status == 200) {"
-        "            var response = JSON.parse(xhr.responseText);"
-        "            document.getElementById('spTempValue').innerText = response.sp_temperature.toFixed(2);"
-        "            document.getElementById('spHumidityValue').innerText = response.sp_humidity.toFixed(2);"
-        "            document.getElementById('heaterStatus').className = response.heater ? 'on' : 'off';"
-        "            document.getElementById('heaterStatus').innerText = 'Heater: ' + (response.heater ? 'ON' : 'OFF');"
-        "            document.getElementById('dehumidifierStatus').className = response.dehumidifier ? 'on' : 'off';"
-        "            document.getElementById('dehumidifierStatus').innerText = 'Dehumidifier: ' + (response.dehumidifier ? 'ON' : 'OFF');"
-        "            document.getElementById('tempValue').innerText = response.temperature.toFixed(2);"
-        "            document.getElementById('humidityValue').innerText = response.humidity.toFixed(2);"
-        "            document.getElementById('luxValue').innerText = response.lux;"
-        "        }"
-        "    };"
-        "    xhr.send();"
-        "}"
-        "setInterval(fetchData, 5000);" // Fetch data every 5 seconds
-        "window.onload = fetchData;" // Fetch data on page load
-        "</script>");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    snprintf(buffer, sizeof(buffer),
-        "</div>"
-        "</body>"
-        "</html>");
-    httpd_resp_send_chunk(req, buffer, strlen(buffer));
-
-    // End the response
-    httpd_resp_send_chunk(req, NULL, 0);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)dashboard_gz_start, dashboard_gz_end - dashboard_gz_start);
+}
 
-    return ESP_OK;
+
+static int live_state_format(char *buffer, size_t len, const controller_state_t *state, const controller_state_t *previous) {
+    int n = snprintf(buffer, len, "{");
+
+#define LIVE_FIELD(field, fmt, value) \
+    if (!previous || previous->field != state->field) { \
+        n += snprintf(buffer + n, len - n, "%s\"" #field "\":" fmt, n > 1 ? "," : "", value); \
+    }
+    LIVE_FIELD(temperature, "%.2f", state->temperature / 100.0);
+    LIVE_FIELD(humidity, "%.2f", state->humidity / 100.0);
+    LIVE_FIELD(lux, "%u", state->lux);
+    LIVE_FIELD(heater, "%s", state->heater ? "true" : "false");
+    LIVE_FIELD(dehumidifier, "%s", state->dehumidifier ? "true" : "false");
+    LIVE_FIELD(sp_temperature, "%.2f", state->sp_temperature / 100.0);
+    LIVE_FIELD(sp_humidity, "%.2f", state->sp_humidity / 100.0);
+#undef LIVE_FIELD
+
+    n += snprintf(buffer + n, len - n, "}");
+    return n > 2 ? n : 0;  // "{}" means nothing changed
+}
+
+
+static void ws_send_text(int fd, char *text, size_t len) {
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)text,
+        .len = len,
+    };
+    if (httpd_ws_send_frame_async(server_handle, fd, &frame) != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ WebSocket push to socket %d failed", fd);
+    }
+}
+
+
+static void ws_send_snapshot(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    controller_state_t state;
+    state_read(&state);
+
+    char message[256];
+    int len = live_state_format(message, sizeof(message), &state, NULL);
+    ws_send_text(fd, message, len);
+}
+
+
+static void ws_broadcast(void *arg) {
+    // Clear first: an update racing with this broadcast queues another one instead of being lost
+    atomic_store(&push_pending, false);
+
+    if (live_sent_valid && state_version() == live_sent_version) {
+        return;
+    }
+    controller_state_t state;
+    uint32_t version = state_read(&state);
+
+    char message[256];
+    int len = live_state_format(message, sizeof(message), &state, live_sent_valid ? &live_sent : NULL);
+    live_sent = state;
+    live_sent_version = version;
+    live_sent_valid = true;
+    if (len == 0) {
+        return;
+    }
+
+    int fds[WS_MAX_CLIENTS];
+    size_t count = WS_MAX_CLIENTS;
+    if (httpd_get_client_list(server_handle, &count, fds) != ESP_OK) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (httpd_ws_get_fd_info(server_handle, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET) {
+            ws_send_text(fds[i], message, len);
+        }
+    }
+}
+
+
+void http_server_notify_update(void) {
+    if (!server_handle || atomic_exchange(&push_pending, true)) {
+        return;
+    }
+    if (httpd_queue_work(server_handle, ws_broadcast, NULL) != ESP_OK) {
+        atomic_store(&push_pending, false);
+    }
+}
+
+
+esp_err_t ws_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) {
+        // Handshake done: start the new subscriber off with the full state
+        int fd = httpd_req_to_sockfd(req);
+        ESP_LOGI(TAG, "🔔 Dashboard subscribed on socket %d", fd);
+        httpd_queue_work(req->handle, ws_send_snapshot, (void *)(intptr_t)fd);
+        return ESP_OK;
+    }
+
+    // Subscribers are not expected to send anything; read and drop whatever arrives
+    httpd_ws_frame_t frame = { 0 };
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK || frame.len == 0) {
+        return err;
+    }
+    uint8_t discard[32];
+    if (frame.len > sizeof(discard)) {
+        return ESP_FAIL;  // Closes the socket; a dashboard has no business sending this much
+    }
+    frame.payload = discard;
+    return httpd_ws_recv_frame(req, &frame, frame.len);
+}
+
+
+/**
+ * @brief Appends to a fixed buffer without formatting; once something does not fit, everything after it is dropped.
+ */
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t len;
+    bool overflow;
+} json_writer_t;
+
+
+static void put_str(json_writer_t *out, const char *text) {
+    size_t len = strlen(text);
+    if (out->overflow || len > out->size - out->len) {
+        out->overflow = true;
+        return;
+    }
+    memcpy(out->buffer + out->len, text, len);
+    out->len += len;
+}
+
+
+static void put_uint(json_writer_t *out, uint32_t value) {
+    char digits[11];
+    char *p = &digits[sizeof(digits) - 1];
+    *p = '\0';
+    do {
+        *--p = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    put_str(out, p);
+}
+
+
+/**
+ * Writes a value in hundredths with two decimals, as "%.2f" of value / 100.0 would.
+ */
+static void put_centi(json_writer_t *out, int32_t value) {
+    uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+    char fraction[4] = { '.', (char)('0' + magnitude % 100 / 10), (char)('0' + magnitude % 10), '\0' };
+    if (value < 0) put_str(out, "-");
+    put_uint(out, magnitude / 100);
+    put_str(out, fraction);
+}
+
+
+static void put_bool(json_writer_t *out, bool value) {
+    put_str(out, value ? "true" : "false");
+}
+
+
+static void data_put_station(json_writer_t *out, const station_record_t *station, bool first) {
+    put_str(out, first ? "{\"id\":\"" : ",{\"id\":\"");
+    put_str(out, station->id);      // IDs are validated at the handshake and need no escaping
+    put_str(out, "\",\"online\":");
+    put_bool(out, station->online);
+    put_str(out, ",\"sp_temperature\":");
+    put_centi(out, station->sp_temperature);
+    put_str(out, ",\"sp_humidity\":");
+    put_centi(out, station->sp_humidity);
+    put_str(out, ",\"plugs\":[");
+    bool first_plug = true;
+    for (int plug = 0; plug < SHELLY_PLUG_COUNT; plug++) {
+        if (station->plugs & (1u << plug)) {
+            put_str(out, first_plug ? "\"" : ",\"");
+            put_str(out, shelly_plug_name(plug));
+            put_str(out, "\"");
+            first_plug = false;
+        }
+    }
+    put_str(out, "]");
+    if (station->reading_valid) {
+        const telemetry_t *reading = &station->reading;
+        put_str(out, ",\"temperature\":");
+        put_centi(out, reading->temperature);
+        put_str(out, ",\"humidity\":");
+        put_centi(out, reading->humidity);
+        put_str(out, ",\"lux\":");
+        put_uint(out, reading->lux);
+        put_str(out, ",\"heater\":");
+        put_bool(out, reading->heater);
+        put_str(out, ",\"dehumidifier\":");
+        put_bool(out, reading->dehumidifier);
+        put_str(out, ",\"updated\":");
+        put_uint(out, station->updated);
+    }
+    put_str(out, "}");
+}
+
+
+/**
+ * Serializes the state and every registered station into @p body, tagged with the versions read before the data.
+ */
+static bool data_render(data_body_t *body) {
+    uint32_t registry = registry_version();
+    controller_state_t state;
+    uint32_t version = state_read(&state);
+
+    json_writer_t out = { .buffer = body->text, .size = sizeof(body->text) };
+    put_str(&out, "{\"temperature\":");
+    put_centi(&out, state.temperature);
+    put_str(&out, ",\"humidity\":");
+    put_centi(&out, state.humidity);
+    put_str(&out, ",\"lux\":");
+    put_uint(&out, state.lux);
+    put_str(&out, ",\"heater\":");
+    put_bool(&out, state.heater);
+    put_str(&out, ",\"dehumidifier\":");
+    put_bool(&out, state.dehumidifier);
+    put_str(&out, ",\"sp_temperature\":");
+    put_centi(&out, state.sp_temperature);
+    put_str(&out, ",\"sp_humidity\":");
+    put_centi(&out, state.sp_humidity);
+    put_str(&out, ",\"stations\":[");
+
+    // One pass over the registry visits every zone
+    bool first = true;
+    station_record_t station;
+    for (int slot = 0; slot < REGISTRY_CAPACITY; slot++) {
+        if (!registry_read(slot, &station)) continue;
+        data_put_station(&out, &station, first);
+        first = false;
+    }
+    put_str(&out, "]}");
+    if (out.overflow) {
+        return false;
+    }
+
+    body->len = out.len;
+    body->state_version = version;
+    body->registry_version = registry;
+    snprintf(body->etag, sizeof(body->etag), "\"%08lx%08lx%08lx\"", (unsigned long)data_boot_nonce,
+             (unsigned long)version, (unsigned long)registry);
+    return true;
+}
+
+
+/**
+ * Returns the published /data body, serializing a new one into the other buffer first if anything changed.
+ */
+static const data_body_t *data_current(void) {
+    if (data_front && data_front->state_version == state_version() &&
+        data_front->registry_version == registry_version()) {
+        return data_front;
+    }
+
+    data_body_t *back = data_front == &data_bodies[0] ? &data_bodies[1] : &data_bodies[0];
+    if (!data_render(back)) {
+        ESP_LOGE(TAG, "❌ /data body larger than %d bytes, serving the previous one", DATA_BODY_SIZE);
+        return data_front;
+    }
+    data_front = back;
+    metrics_inc(METRIC_DATA_RENDERS);
+    return data_front;
 }
 
 
 esp_err_t get_data_api_handler(httpd_req_t *req) {
-    char response[256];
-    snprintf(response, sizeof(response), 
-        "{\"temperature\":%.2f,\"humidity\":%.2f,\"lux\":%d,\"heater\":%s,\"dehumidifier\":%s,\"sp_temperature\":%.2f,\"sp_humidity\":%.2f}", 
-        temperature, humidity, lux, heater ? "true" : "false", dehumidifier ? "true" : "false", SP_TEMP / 100.0, SP_HUM / 100.0);
-    httpd_resp_sendstr(req, response);
+    const data_body_t *body = data_current();
+    if (!body) {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "ETag", body->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");  // Revalidate every time; unchanged data costs a 304
+
+    char if_none_match[sizeof(body->etag)];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, body->etag) == 0) {
+        metrics_inc(METRIC_DATA_NOT_MODIFIED);
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    return httpd_resp_send(req, body->text, body->len);
+}
+
+
+static int format_history_value(char *buffer, size_t len, history_metric_t metric, int32_t value) {
+    if (metric == HISTORY_LUX) {
+        return snprintf(buffer, len, "%ld", (long)value);
+    }
+    long magnitude = value < 0 ? -(long)value : value;
+    return snprintf(buffer, len, "%s%ld.%02ld", value < 0 ? "-" : "", magnitude / 100, magnitude % 100);
+}
+
+
+static bool query_u32(const char *query, const char *key, uint32_t *value) {
+    char text[16];
+    if (httpd_query_key_value(query, key, text, sizeof(text)) != ESP_OK) {
+        return false;
+    }
+    *value = strtoul(text, NULL, 10);
+    return true;
+}
+
+
+esp_err_t history_handler(httpd_req_t *req) {
+    static const char *metric_names[HISTORY_METRIC_COUNT] = {
+        [HISTORY_TEMPERATURE] = "temperature",
+        [HISTORY_HUMIDITY] = "humidity",
+        [HISTORY_LUX] = "lux",
+    };
+
+    char query[96] = "";
+    char name[16];
+    httpd_req_get_url_query_str(req, query, sizeof(query));
+
+    history_metric_t metric = HISTORY_METRIC_COUNT;
+    if (httpd_query_key_value(query, "metric", name, sizeof(name)) == ESP_OK) {
+        for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+            if (strcmp(name, metric_names[m]) == 0) metric = m;
+        }
+    }
+    if (metric == HISTORY_METRIC_COUNT) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "metric must be temperature, humidity or lux");
+    }
+
+    uint32_t now = history_now();
+    uint32_t from = 0, to = now, step;
+    query_u32(query, "from", &from);
+    query_u32(query, "to", &to);
+
+    // step selects the resolution tier; without it, use the finest tier that still reaches back to from
+    history_tier_t tier;
+    if (query_u32(query, "step", &step)) {
+        tier = step >= 3600 ? HISTORY_HOUR : step >= 60 ? HISTORY_MINUTE : HISTORY_RAW;
+    } else {
+        tier = HISTORY_HOUR;
+        for (history_tier_t t = HISTORY_RAW; t < HISTORY_HOUR; t++) {
+            uint32_t oldest;
+            if (history_oldest(t, &oldest) && oldest <= from) {
+                tier = t;
+                break;
+            }
+        }
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    char buffer[768];
+    int n = snprintf(buffer, sizeof(buffer), "{\"metric\":\"%s\",\"step\":%lu,\"now\":%lu,\"points\":[",
+                     metric_names[metric], (unsigned long)history_period(tier), (unsigned long)now);
+
+    history_point_t points[32];
+    int64_t after = (int64_t)from - 1;
+    bool first = true;
+    size_t count;
+    while ((count = history_read(metric, tier, after, to, points, 32)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (sizeof(buffer) - n < 64) {
+                if (httpd_resp_send_chunk(req, buffer, n) != ESP_OK) return ESP_FAIL;
+                n = 0;
+            }
+            n += snprintf(buffer + n, sizeof(buffer) - n, "%s[%lu,", first ? "" : ",", (unsigned long)points[i].timestamp);
+            if (tier == HISTORY_RAW) {
+                n += format_history_value(buffer + n, sizeof(buffer) - n, metric, points[i].avg);
+            } else {
+                n += format_history_value(buffer + n, sizeof(buffer) - n, metric, points[i].min);
+                buffer[n++] = ',';
+                n += format_history_value(buffer + n, sizeof(buffer) - n, metric, points[i].max);
+                buffer[n++] = ',';
+                n += format_history_value(buffer + n, sizeof(buffer) - n, metric, points[i].avg);
+            }
+            buffer[n++] = ']';
+            first = false;
+        }
+        after = points[count - 1].timestamp;
+    }
+
+    n += snprintf(buffer + n, sizeof(buffer) - n, "]}");
+    if (httpd_resp_send_chunk(req, buffer, n) != ESP_OK) return ESP_FAIL;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+
+esp_err_t metrics_handler(httpd_req_t *req) {
+    char buffer[1024];
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    int len;
+    for (size_t family = 0; (len = metrics_format(family, buffer, sizeof(buffer))) >= 0; family++) {
+        if (httpd_resp_send_chunk(req, buffer, len) != ESP_OK) return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+
+#ifdef CONFIG_SMARTHOME_TRACE
+esp_err_t trace_handler(httpd_req_t *req) {
+    char buffer[1024];
+    trace_cursor_t cursor;
+    esp_err_t err = ESP_OK;
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    trace_dump_begin(&cursor);
+    size_t len;
+    while (err == ESP_OK && (len = trace_dump_next(&cursor, buffer, sizeof(buffer))) > 0) {
+        err = httpd_resp_send_chunk(req, buffer, len);
+    }
+    trace_dump_end();
+
+    return err == ESP_OK ? httpd_resp_send_chunk(req, NULL, 0) : ESP_FAIL;
+}
+#endif
+
+
+/**
+ * @brief A POST /update?wait=1 request detached from the HTTP server task until its setpoints are acknowledged.
+ */
+typedef struct {
+    uint32_t id;            ///< Setpoint message ID, or 0 if the slot is free.
+    httpd_req_t *req;       ///< Request copy from httpd_req_async_handler_begin(), on the heap until answered.
+    TickType_t deadline;    ///< Tick count at which the request is answered without the ACK.
+} setpoints_wait_t;
+
+static setpoints_wait_t setpoints_waits[SETPOINTS_WAITS_MAX];   ///< Guarded by setpoints_waits_lock.
+static StaticSemaphore_t setpoints_waits_lock_buffer;
+static SemaphoreHandle_t setpoints_waits_lock = NULL;
+static QueueHandle_t setpoints_acks = NULL;     ///< IDs acknowledged by stations; 0 only wakes the wait task.
+static StaticQueue_t setpoints_acks_buffer;
+static uint32_t setpoints_acks_slots[2 * SETPOINTS_WAITS_MAX];  ///< An ACK and a wake-up per waiting request.
+static StackType_t setpoints_wait_stack[SETPOINTS_WAIT_TASK_STACK];
+static StaticTask_t setpoints_wait_buffer;
+
+
+static esp_err_t setpoints_respond(httpd_req_t *req, uint32_t id, bool wait, bool acked) {
+    controller_state_t state;
+    state_read(&state);
+    char response[128];
+    int len = snprintf(response, sizeof(response), "{\"heater\":%s,\"dehumidifier\":%s,\"id\":%lu",
+                       state.heater ? "true" : "false", state.dehumidifier ? "true" : "false", (unsigned long)id);
+    if (wait) {
+        snprintf(response + len, sizeof(response) - len, ",\"acked\":%s}", acked ? "true" : "false");
+    } else {
+        snprintf(response + len, sizeof(response) - len, "}");
+    }
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, response);
+}
+
+
+/**
+ * Answers every waiting request whose setpoints were acknowledged or whose deadline passed. The response is sent
+ * from this task, so a slow client only holds up the other waiting requests.
+ */
+static void setpoints_wait_task(void *pvParameters) {
+    uint32_t acked_id = 0;
+
+    while (1) {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wait = portMAX_DELAY;
+        setpoints_wait_t done[SETPOINTS_WAITS_MAX];
+        bool acked[SETPOINTS_WAITS_MAX];
+        int count = 0;
+
+        xSemaphoreTake(setpoints_waits_lock, portMAX_DELAY);
+        for (int i = 0; i < SETPOINTS_WAITS_MAX; i++) {
+            setpoints_wait_t *slot = &setpoints_waits[i];
+            if (slot->id == 0) continue;
+            TickType_t left = slot->deadline - now;
+            if (slot->id == acked_id || (int32_t)left <= 0) {
+                acked[count] = slot->id == acked_id;
+                done[count++] = *slot;
+                slot->id = 0;
+            } else if (left < wait) {
+                wait = left;
+            }
+        }
+        xSemaphoreGive(setpoints_waits_lock);
+
+        for (int i = 0; i < count; i++) {
+            setpoints_respond(done[i].req, done[i].id, true, acked[i]);
+            httpd_req_async_handler_complete(done[i].req);
+        }
+
+        if (xQueueReceive(setpoints_acks, &acked_id, wait) != pdTRUE) {
+            acked_id = 0;
+        }
+    }
+}
+
+
+/**
+ * Records queued setpoints in the zone's registry entry, and in the shared state if the zone
+ * owns it. Only called once bus_publish() queued them, so a rejected request leaves no trace the rules would act on.
+ */
+static void setpoints_apply(int station, int16_t sp_temperature, int16_t sp_humidity) {
+    if (station >= 0) {
+        registry_set_setpoints(station, sp_temperature, sp_humidity);
+    }
+    if ((station < 0 || station == registry_owner()) && state_set_setpoints(sp_temperature, sp_humidity)) {
+        http_server_notify_update();
+    }
+}
+
+
+/**
+ * Publishes the setpoints and detaches the request until the station acknowledges them. The wait table stays locked
+ * until the message ID is recorded, so the wait task cannot miss an ACK that arrives first. The detached copy is
+ * malloc'd by the HTTP server, one of the few allocations after startup; the wait slots bound it.
+ */
+static esp_err_t setpoints_wait(httpd_req_t *req, int station, int16_t sp_temperature, int16_t sp_humidity) {
+    xSemaphoreTake(setpoints_waits_lock, portMAX_DELAY);
+    setpoints_wait_t *slot = NULL;
+    for (int i = 0; i < SETPOINTS_WAITS_MAX && !slot; i++) {
+        if (setpoints_waits[i].id == 0) slot = &setpoints_waits[i];
+    }
+    httpd_req_t *async = NULL;
+    if (!slot || httpd_req_async_handler_begin(req, &async) != ESP_OK) {
+        xSemaphoreGive(setpoints_waits_lock);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        return httpd_resp_sendstr(req, "Too many requests waiting for an acknowledgment");
+    }
+
+    uint32_t id = 0;
+    bus_msg_t *msg = bus_alloc(BUS_TOPIC_SETPOINT);
+    if (msg) {
+        msg->setpoint = (bus_setpoint_t){
+            .station = station,
+            .sp_temperature = sp_temperature,
+            .sp_humidity = sp_humidity,
+            .ack_queue = setpoints_acks,
+        };
+        id = bus_publish(msg);
+    }
+    if (id != 0) {
+        slot->id = id;
+        slot->req = async;
+        slot->deadline = xTaskGetTickCount() + pdMS_TO_TICKS(SETPOINTS_ACK_WAIT_MS);
+    }
+    xSemaphoreGive(setpoints_waits_lock);
+
+    if (id == 0) {
+        ESP_LOGW("SETPOINTS", "⚠️ Setpoint queue full, setpoints dropped");
+        httpd_resp_set_status(async, "503 Service Unavailable");
+        httpd_resp_set_hdr(async, "Retry-After", "1");
+        httpd_resp_sendstr(async, "Setpoint queue full");
+        return httpd_req_async_handler_complete(async);
+    }
+    setpoints_apply(station, sp_temperature, sp_humidity);
+    uint32_t wake = 0;
+    xQueueSend(setpoints_acks, &wake, 0);  // A full queue wakes the task anyway
     return ESP_OK;
 }
 
@@ -223,6 +702,23 @@ esp_err_t setpoints_handler(httpd_req_t *req) {
     content[ret] = '\0'; // Null-terminate the received data
 
     ESP_LOGI("SETPOINTS", "Received data: %s", content);
+    char wait_value[4];
+    bool wait = httpd_query_key_value(content, "wait", wait_value, sizeof(wait_value)) == ESP_OK &&
+                strcmp(wait_value, "1") == 0;
+
+    // "&station=<id>" sets the setpoints of one zone; without it they go to the zone owning the controller state,
+    // or before any station registered, to the first station that connects
+    int station = registry_owner();
+    char station_id[REGISTRY_ID_LEN];
+    if (httpd_query_key_value(content, "station", station_id, sizeof(station_id)) == ESP_OK) {
+        station = registry_find(station_id);
+        if (station < 0) {
+            return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown station");
+        }
+    } else if (station < 0 && registry_count() > 0) {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_sendstr(req, "No station is bound to the plugs, name one with station=");
+    }
 
     // Parse the URL-encoded form data
     char *temp_str = strstr(content, "temp=");
@@ -246,33 +742,39 @@ esp_err_t setpoints_handler(httpd_req_t *req) {
 
         ESP_LOGI("SETPOINTS", "Set Temperature: %.2f, Set Humidity: %.2f", set_temp, set_humidity);
 
-        // Update global setpoints
-        SP_TEMP = (int16_t)(set_temp * 100);
-        SP_HUM = (int16_t)(set_humidity * 100);
-
-        // Send response
-        char response[128];
-        snprintf(response, sizeof(response), "{\"heater\":%s,\"dehumidifier\":%s}", heater ? "true" : "false", dehumidifier ? "true" : "false");
-        httpd_resp_sendstr(req, response);
-
-        // Send setpoints to Arduino over TCP and wait for acknowledgment
-        char tcp_message[128];
-        snprintf(tcp_message, sizeof(tcp_message), "temp=%.2f&humidity=%.2f\n", set_temp, set_humidity);
-        ESP_LOGI("SETPOINTS", "Sending TCP message: %s", tcp_message);
-        send_setpoints_with_ack(tcp_message);
-
-        // Control Shelly devices based on setpoints
-        if (set_temp > 25.0) { // Example condition to turn on the heater
-            send_http_request(heaterIP, true);
-        } else {
-            send_http_request(heaterIP, false);
+        // Written this way round, NaN fails the check too
+        if (!(set_temp >= SETPOINT_TEMP_MIN && set_temp <= SETPOINT_TEMP_MAX) ||
+            !(set_humidity >= SETPOINT_HUMIDITY_MIN && set_humidity <= SETPOINT_HUMIDITY_MAX)) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Setpoint out of range");
         }
 
-        if (set_humidity > 50.0) { // Example condition to turn on the dehumidifier
-            send_http_request(humidifierIP, true);
-        } else {
-            send_http_request(humidifierIP, false);
+        int16_t sp_temperature = (int16_t)lroundf(set_temp * 100);
+        int16_t sp_humidity = (int16_t)lroundf(set_humidity * 100);
+
+        // Publish the setpoints for the TCP server task; with wait=1 the response waits for the station's ACK.
+        // The zone and shared setpoints only change once the setpoints are queued.
+        if (wait) {
+            return setpoints_wait(req, station, sp_temperature, sp_humidity);
+        }
+        uint32_t id = 0;
+        bus_msg_t *msg = bus_alloc(BUS_TOPIC_SETPOINT);
+        if (msg) {
+            msg->setpoint = (bus_setpoint_t){
+                .station = station,
+                .sp_temperature = sp_temperature,
+                .sp_humidity = sp_humidity,
+            };
+            id = bus_publish(msg);
         }
+        if (id == 0) {
+            // Never queued, so the client must not mistake this for a missing acknowledgment
+            ESP_LOGW("SETPOINTS", "⚠️ Setpoint queue full, setpoints dropped");
+            httpd_resp_set_status(req, "503 Service Unavailable");
+            httpd_resp_set_hdr(req, "Retry-After", "1");
+            return httpd_resp_sendstr(req, "Setpoint queue full");
+        }
+        setpoints_apply(station, sp_temperature, sp_humidity);
+        setpoints_respond(req, id, false, false);
     } else {
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid data");
     }
@@ -281,9 +783,69 @@ esp_err_t setpoints_handler(httpd_req_t *req) {
 }
 
 
+esp_err_t rules_get_handler(httpd_req_t *req) {
+    size_t len = rules_get_json(rules_buffer, sizeof(rules_buffer));
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, rules_buffer, len);
+}
+
+
+esp_err_t rules_post_handler(httpd_req_t *req) {
+    if (req->content_len >= sizeof(rules_buffer)) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Rule set too large");
+    }
+
+    size_t received = 0;
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, rules_buffer + received, req->content_len - received);
+        if (ret <= 0) {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                httpd_resp_send_408(req);
+            }
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+    rules_buffer[received] = '\0';
+
+    char error[96];
+    esp_err_t err = rules_set_json(rules_buffer, error, sizeof(error));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Rule set rejected: %s", error);
+        return httpd_resp_send_err(req, err == ESP_ERR_INVALID_ARG ? HTTPD_400_BAD_REQUEST
+                                                                   : HTTPD_500_INTERNAL_SERVER_ERROR, error);
+    }
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, "{\"ok\":true}");
+}
+
+
+/**
+ * Registers the httpd task with the metrics; queued as work because esp_http_server does not expose its handle.
+ */
+static void register_httpd_task(void *arg) {
+    metrics_register_task(xTaskGetCurrentTaskHandle(), (uint32_t)(uintptr_t)arg);
+}
+
+
 void start_http_server(void) {
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_open_sockets = WS_MAX_CLIENTS;
+    config.max_uri_handlers = HTTP_MAX_URI_HANDLERS;
+
+    uint32_t crc = esp_rom_crc32_le(0, dashboard_gz_start, dashboard_gz_end - dashboard_gz_start);
+    snprintf(dashboard_etag, sizeof(dashboard_etag), "\"%08lx\"", (unsigned long)crc);
+    data_boot_nonce = esp_random();
+
+    setpoints_waits_lock = xSemaphoreCreateMutexStatic(&setpoints_waits_lock_buffer);
+    setpoints_acks = xQueueCreateStatic(2 * SETPOINTS_WAITS_MAX, sizeof(uint32_t), (uint8_t *)setpoints_acks_slots,
+                                        &setpoints_acks_buffer);
+    TaskHandle_t wait_task = xTaskCreateStatic(setpoints_wait_task, "setpoint_wait", SETPOINTS_WAIT_TASK_STACK, NULL,
+                                               SETPOINTS_WAIT_TASK_PRIORITY, setpoints_wait_stack,
+                                               &setpoints_wait_buffer);
+    metrics_register_task(wait_task, SETPOINTS_WAIT_TASK_STACK);
 
     if (httpd_start(&server, &config) == ESP_OK) {
         ESP_LOGI(TAG, "Starting HTTP server...");
@@ -311,6 +873,60 @@ void start_http_server(void) {
             .user_ctx = NULL
         };
         httpd_register_uri_handler(server, &setpoints_uri);
+
+        httpd_uri_t history_uri = {
+            .uri = "/history",
+            .method = HTTP_GET,
+            .handler = history_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &history_uri);
+
+        httpd_uri_t metrics_uri = {
+            .uri = "/metrics",
+            .method = HTTP_GET,
+            .handler = metrics_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &metrics_uri);
+
+        httpd_uri_t rules_get_uri = {
+            .uri = "/rules",
+            .method = HTTP_GET,
+            .handler = rules_get_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &rules_get_uri);
+
+        httpd_uri_t rules_post_uri = {
+            .uri = "/rules",
+            .method = HTTP_POST,
+            .handler = rules_post_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &rules_post_uri);
+
+#ifdef CONFIG_SMARTHOME_TRACE
+        httpd_uri_t trace_uri = {
+            .uri = "/trace",
+            .method = HTTP_GET,
+            .handler = trace_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &trace_uri);
+#endif
+
+        httpd_uri_t ws_uri = {
+            .uri = "/ws",
+            .method = HTTP_GET,
+            .handler = ws_handler,
+            .user_ctx = NULL,
+            .is_websocket = true
+        };
+        httpd_register_uri_handler(server, &ws_uri);
+
+        server_handle = server;
+        httpd_queue_work(server, register_httpd_task, (void *)(uintptr_t)config.stack_size);
     } else {
         ESP_LOGE(TAG, "Failed to start HTTP server");
     }
@@ -0,0 +1,88 @@
+/**
+ * @file json_arena.c
+ * @brief This file contains the implementation of the cJSON bump arena for the ESP32 Smart Home Main Controller project.
+ *
+ * The arena is a static buffer with a single offset. An allocation rounds the offset up to JSON_ARENA_ALIGN and
+ * moves it past the block; a free does nothing; ending a scope sets the offset back to 0. cJSON only resizes
+ * buffers when the hooks are the C library's own, so with the arena installed every allocation is a plain bump.
+ *
+ * The main functionalities provided by this file include:
+ * - Installing the arena as the cJSON allocator.
+ * - Serializing the parse scopes of different tasks and resetting the arena at the end of each.
+ * - Tracking the high-water mark and refused allocations for the metrics.
+ *
+ * Dependencies:
+ * - json_arena.h: Arena declarations.
+ * - cJSON.h: Allocator hooks.
+ * - freertos/semphr.h: FreeRTOS mutex functions.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "cJSON.h"
+#include "json_arena.h"
+
+#define JSON_ARENA_ALIGN 8
+
+static uint8_t arena[JSON_ARENA_SIZE] __attribute__((aligned(JSON_ARENA_ALIGN)));
+static size_t arena_used = 0;           ///< Protected by arena_mutex.
+static bool arena_failed = false;       ///< An allocation of the current scope was refused.
+static SemaphoreHandle_t arena_mutex = NULL;
+static StaticSemaphore_t arena_mutex_buffer;
+static uint32_t high_water = 0;
+static uint32_t exhausted = 0;
+
+
+static void *arena_malloc(size_t size) {
+    size_t start = (arena_used + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
+    if (size > JSON_ARENA_SIZE - start) {
+        arena_failed = true;
+        __atomic_fetch_add(&exhausted, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    arena_used = start + size;
+    if (arena_used > high_water) {
+        __atomic_store_n(&high_water, (uint32_t)arena_used, __ATOMIC_RELAXED);
+    }
+    return &arena[start];
+}
+
+
+static void arena_free(void *ptr) {
+    (void)ptr;  // Reclaimed by json_arena_end()
+}
+
+
+void json_arena_init(void) {
+    arena_mutex = xSemaphoreCreateMutexStatic(&arena_mutex_buffer);
+    cJSON_Hooks hooks = {
+        .malloc_fn = arena_malloc,
+        .free_fn = arena_free,
+    };
+    cJSON_InitHooks(&hooks);
+}
+
+
+void json_arena_begin(void) {
+    xSemaphoreTake(arena_mutex, portMAX_DELAY);
+    arena_used = 0;
+    arena_failed = false;
+}
+
+
+bool json_arena_end(void) {
+    bool fit = !arena_failed;
+    arena_used = 0;
+    xSemaphoreGive(arena_mutex);
+    return fit;
+}
+
+
+void json_arena_stats(json_arena_stats_t *out) {
+    out->size = JSON_ARENA_SIZE;
+    out->high_water = __atomic_load_n(&high_water, __ATOMIC_RELAXED);
+    out->exhausted = __atomic_load_n(&exhausted, __ATOMIC_RELAXED);
+}
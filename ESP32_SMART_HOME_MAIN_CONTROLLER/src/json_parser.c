@@ -3,6 +3,8 @@
  * @brief This file contains the implementation of JSON parsing functions for the ESP32 Smart Home Main Controller project.
  *
  * The functions provided in this file allow for parsing incoming JSON data to extract sensor readings and control commands.
+ * Messages are tokenized with jsmn into a fixed token array on the stack and numbers are converted directly to
+ * integer centi-units, so a telemetry frame is parsed without a single heap allocation.
  *
  * The main functionalities provided by this file include:
  * - Parsing JSON data to extract temperature, humidity, and light intensity readings.
@@ -10,67 +12,210 @@
  * - Parsing JSON data to extract setpoints for temperature and humidity.
  *
  * Dependencies:
- * - esp_http_server.h: ESP32 HTTP server functions.
+ * - jsmn.h: Minimalistic JSON tokenizer.
  * - esp_log.h: ESP32 logging functions.
- * - cJSON.h: JSON parsing library.
- * - globals.h: Global variables and definitions.
- * - esp_err.h: ESP32 error handling functions.
- * - tcp_server.h: TCP server function declarations.
+ * - state.h: Shared controller state.
+ * - json_parser.h: JSON parsing declarations.
  *
  * @note This file is part of the ESP32 Smart Home Main Controller project.
  */
 
-#include "esp_http_server.h"
+#include <string.h>
+#include "jsmn.h"
 #include "esp_log.h"
-#include "cJSON.h"
-#include "globals.h"
-#include "esp_err.h"
-#include "tcp_server.h"
+#include "state.h"
+#include "json_parser.h"
 
 static const char *TAG = "JSON_PARSER";
 
+#define JSON_MAX_TOKENS 32   ///< Enough for a flat object with 15 key/value pairs.
 
-void parse_json(const char* json_data) {
-    cJSON *root = cJSON_Parse(json_data);
-    if (root == NULL) {
-        ESP_LOGE(TAG, "Error parsing JSON");
-        return;
-    }
+typedef enum {
+    FIELD_CENTI,    ///< Decimal number stored in hundredths.
+    FIELD_UINT,     ///< Non-negative integer.
+    FIELD_BOOL,     ///< true / false.
+} field_kind_t;
 
-    cJSON *temp = cJSON_GetObjectItem(root, "temperature");
-    if (cJSON_IsNumber(temp)) {
-        temperature = temp->valuedouble;
-    }
+typedef struct {
+    const char *key;
+    uint8_t key_len;
+    uint8_t flag;
+    field_kind_t kind;
+    size_t offset;
+} telemetry_field_t;
+
+#define FIELD(name, member, flag, kind) { name, sizeof(name) - 1, flag, kind, offsetof(telemetry_t, member) }
+
+static const telemetry_field_t fields[] = {
+    FIELD("temperature",    temperature,    TELEMETRY_HAS_TEMPERATURE,    FIELD_CENTI),
+    FIELD("humidity",       humidity,       TELEMETRY_HAS_HUMIDITY,       FIELD_CENTI),
+    FIELD("lux",            lux,            TELEMETRY_HAS_LUX,            FIELD_UINT),
+    FIELD("heater",         heater,         TELEMETRY_HAS_HEATER,         FIELD_BOOL),
+    FIELD("dehumidifier",   dehumidifier,   TELEMETRY_HAS_DEHUMIDIFIER,   FIELD_BOOL),
+    FIELD("sp_temperature", sp_temperature, TELEMETRY_HAS_SP_TEMPERATURE, FIELD_CENTI),
+    FIELD("sp_humidity",    sp_humidity,    TELEMETRY_HAS_SP_HUMIDITY,    FIELD_CENTI),
+};
+
+
+/**
+ * Converts a JSON number such as "-21.456" to hundredths, rounding half away from zero.
+ * Exponents are rejected rather than handed to strtod, which allocates in newlib.
+ */
+static bool parse_centi(const char *text, size_t len, int32_t *out) {
+    size_t i = 0;
+    bool negative = false;
+    int32_t whole = 0;
+    int32_t fraction = 0;
+    int digits = 0;
 
-    cJSON *hum = cJSON_GetObjectItem(root, "humidity");
-    if (cJSON_IsNumber(hum)) {
-        humidity = hum->valuedouble;
+    if (i < len && text[i] == '-') {
+        negative = true;
+        i++;
     }
+    if (i >= len || text[i] < '0' || text[i] > '9') {
+        return false;
+    }
+    for (; i < len && text[i] >= '0' && text[i] <= '9'; i++) {
+        whole = whole * 10 + (text[i] - '0');
+        if (whole > 1000000) return false;
+    }
+    if (i < len && text[i] == '.') {
+        i++;
+        for (; i < len && text[i] >= '0' && text[i] <= '9'; i++) {
+            if (digits < 2) {
+                fraction = fraction * 10 + (text[i] - '0');
+            } else if (digits == 2 && text[i] >= '5') {
+                fraction++;
+            }
+            digits++;
+        }
+        if (digits == 0) return false;
+    }
+    if (i != len) {
+        return false;
+    }
+    if (digits == 1) {
+        fraction *= 10;
+    }
+
+    int32_t value = whole * 100 + fraction;
+    *out = negative ? -value : value;
+    return true;
+}
+
+
+static bool store_field(const telemetry_field_t *field, const char *text, size_t len, telemetry_t *out) {
+    uint8_t *member = (uint8_t *)out + field->offset;
+    int32_t value;
 
-    cJSON *lux_item = cJSON_GetObjectItem(root, "lux");
-    if (cJSON_IsNumber(lux_item)) {
-        lux = lux_item->valueint;
+    switch (field->kind) {
+    case FIELD_BOOL:
+        if (len == 4 && memcmp(text, "true", 4) == 0) {
+            *(bool *)member = true;
+        } else if (len == 5 && memcmp(text, "false", 5) == 0) {
+            *(bool *)member = false;
+        } else {
+            return false;
+        }
+        return true;
+
+    case FIELD_UINT:
+        if (!parse_centi(text, len, &value) || value < 0 || value / 100 > UINT16_MAX) {
+            return false;
+        }
+        *(uint16_t *)member = (uint16_t)(value / 100);
+        return true;
+
+    case FIELD_CENTI:
+        if (!parse_centi(text, len, &value) || value < INT16_MIN || value > INT16_MAX) {
+            return false;
+        }
+        *(int16_t *)member = (int16_t)value;
+        return true;
     }
+    return false;
+}
+
 
-    cJSON *heater_item = cJSON_GetObjectItem(root, "heater");
-    if (cJSON_IsBool(heater_item)) {
-        heater = heater_item->valueint;
+bool parse_telemetry(const char *json, size_t len, telemetry_t *out) {
+    jsmn_parser parser;
+    jsmntok_t tokens[JSON_MAX_TOKENS];
+
+    memset(out, 0, sizeof(*out));
+    jsmn_init(&parser);
+    int count = jsmn_parse(&parser, json, len, tokens, JSON_MAX_TOKENS);
+    if (count < 1 || tokens[0].type != JSMN_OBJECT) {
+        return false;
     }
 
-    cJSON *dehumidifier_item = cJSON_GetObjectItem(root, "dehumidifier");
-    if (cJSON_IsBool(dehumidifier_item)) {
-        dehumidifier = dehumidifier_item->valueint;
+    int i = 1;
+    while (i + 1 < count) {
+        const jsmntok_t *key = &tokens[i];
+        const jsmntok_t *value = &tokens[i + 1];
+        if (key->type != JSMN_STRING) {
+            return false;
+        }
+
+        size_t key_len = key->end - key->start;
+        if (value->type == JSMN_PRIMITIVE) {
+            for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+                if (fields[f].key_len == key_len && memcmp(json + key->start, fields[f].key, key_len) == 0) {
+                    if (store_field(&fields[f], json + value->start, value->end - value->start, out)) {
+                        out->fields |= fields[f].flag;
+                    }
+                    break;
+                }
+            }
+        }
+
+        // Skip the value together with any tokens nested inside it
+        i += 2;
+        while (i < count && tokens[i].start < value->end) {
+            i++;
+        }
     }
+    return true;
+}
+
 
-    cJSON *sp_temp_item = cJSON_GetObjectItem(root, "sp_temperature");
-    if (cJSON_IsNumber(sp_temp_item)) {
-        SP_TEMP = (int16_t)(sp_temp_item->valuedouble * 100);
+static void merge_telemetry(controller_state_t *state, const void *arg) {
+    const telemetry_t *telemetry = arg;
+    if (telemetry->fields & TELEMETRY_HAS_TEMPERATURE) {
+        state->temperature = telemetry->temperature;
+    }
+    if (telemetry->fields & TELEMETRY_HAS_HUMIDITY) {
+        state->humidity = telemetry->humidity;
+    }
+    if (telemetry->fields & TELEMETRY_HAS_LUX) {
+        state->lux = telemetry->lux;
     }
+    if (telemetry->fields & TELEMETRY_HAS_HEATER) {
+        state->heater = telemetry->heater;
+    }
+    if (telemetry->fields & TELEMETRY_HAS_DEHUMIDIFIER) {
+        state->dehumidifier = telemetry->dehumidifier;
+    }
+    if (telemetry->fields & TELEMETRY_HAS_SP_TEMPERATURE) {
+        state->sp_temperature = telemetry->sp_temperature;
+    }
+    if (telemetry->fields & TELEMETRY_HAS_SP_HUMIDITY) {
+        state->sp_humidity = telemetry->sp_humidity;
+    }
+}
 
-    cJSON *sp_hum_item = cJSON_GetObjectItem(root, "sp_humidity");
-    if (cJSON_IsNumber(sp_hum_item)) {
-        SP_HUM = (int16_t)(sp_hum_item->valuedouble * 100);
+
+bool apply_telemetry(const telemetry_t *telemetry) {
+    return state_update(merge_telemetry, telemetry);
+}
+
+
+bool parse_json(const char *json_data, size_t len) {
+    telemetry_t telemetry;
+    if (!parse_telemetry(json_data, len, &telemetry)) {
+        ESP_LOGE(TAG, "Error parsing JSON");
+        return false;
     }
 
-    cJSON_Delete(root); // Clean up the JSON object
-}
\ No newline at end of file
+    apply_telemetry(&telemetry);
+    return true;
+}
@@ -2,13 +2,22 @@
  * @file main.c
  * @brief This file contains the main entry point for the ESP32 Smart Home Main Controller project.
  *
- * The main function initializes the Wi-Fi interface, starts the TCP server, and starts the HTTP server.
+ * The main function starts the deferred logger, initializes the Wi-Fi interface, the message bus and the JSON arena, starts the Shelly actuator workers, loads the automation rules, mounts the telemetry log behind the storage task, and starts the TCP server, the uplink and the HTTP server. Everything is allocated here; the heap each step takes is recorded for /metrics.
  *
  * Dependencies:
  * - wifi.h: Wi-Fi initialization and event handling functions.
  * - tcp_server.h: TCP server function declarations.
  * - http_server.h: HTTP server function declarations.
+ * - shelly_control.h: Shelly actuator functions.
+ * - rules.h: Automation rule engine.
+ * - uplink.h: Store-and-forward uplink.
+ * - history.h: In-RAM time-series history.
+ * - bus.h: Publish/subscribe bus.
+ * - storage.h: Sample storage task.
+ * - json_arena.h: cJSON bump arena.
+ * - metrics.h: Startup heap checkpoints.
  * - json_parser.h: JSON parsing helper functions.
+ * - dlog.h: Deferred logger.
  * - esp_log.h: ESP32 logging functions.
  * - freertos/FreeRTOS.h: FreeRTOS functions.
  * - freertos/task.h: FreeRTOS task functions.
@@ -19,7 +28,16 @@
 #include "wifi.h"
 #include "tcp_server.h"
 #include "http_server.h"
+#include "shelly_control.h"
+#include "rules.h"
+#include "uplink.h"
+#include "history.h"
+#include "bus.h"
+#include "storage.h"
+#include "json_arena.h"
+#include "metrics.h"
 #include "json_parser.h"
+#include "dlog.h"
 #include <stddef.h>  // For NULL
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
@@ -27,12 +45,40 @@
 
 
 void app_main(void) {
+    metrics_heap_checkpoint(NULL);
+    dlog_start();
+    metrics_heap_checkpoint("dlog");
+
     ESP_LOGI("MAIN", "Starting Wi-Fi...");
     wifi_init();
+    metrics_heap_checkpoint("wifi");
+
+    history_init();
+    bus_init();
+    json_arena_init();
+    metrics_heap_checkpoint("core");
+
+    ESP_LOGI("MAIN", "Starting Shelly actuators...");
+    shelly_control_start();
+    metrics_heap_checkpoint("shelly");
+
+    ESP_LOGI("MAIN", "Loading automation rules...");
+    rules_init();
+    metrics_heap_checkpoint("rules");
+
+    ESP_LOGI("MAIN", "Mounting the telemetry log...");
+    storage_start();
+    metrics_heap_checkpoint("storage");
 
     ESP_LOGI("MAIN", "Starting TCP server...");
-    xTaskCreate(tcp_server_task, "tcp_server", 4096, NULL, 5, NULL);
+    tcp_server_start();
+    metrics_heap_checkpoint("tcp_server");
+
+    ESP_LOGI("MAIN", "Starting uplink...");
+    uplink_start();
+    metrics_heap_checkpoint("uplink");
 
     ESP_LOGI("MAIN", "Starting HTTP server...");
     start_http_server();
+    metrics_heap_checkpoint("http_server");
 }
@@ -0,0 +1,336 @@
+/**
+ * @file metrics.c
+ * @brief This file contains the implementation of the runtime metrics for the ESP32 Smart Home Main Controller project.
+ *
+ * Histogram buckets are stored individually and only made cumulative when rendered, so recording a sample is a
+ * short bucket search followed by two relaxed atomic adds. Sums are kept in milliseconds in 32 bits, which is
+ * enough for weeks of accumulated latency; Prometheus treats the eventual wrap like a counter reset.
+ *
+ * The main functionalities provided by this file include:
+ * - Holding the counters and histograms.
+ * - Recording histogram samples without locking.
+ * - Recording the heap taken by each subsystem at startup, and the stacks and heap allocations of the long-lived tasks.
+ * - Rendering all metrics, the heap, stack and JSON arena gauges and the bus queue statistics in the Prometheus text
+ *   exposition format.
+ *
+ * Dependencies:
+ * - metrics.h: Metric declarations.
+ * - esp_system.h: Free heap queries.
+ * - esp_heap_caps.h: Allocated blocks and largest free block.
+ * - esp_attr.h: IRAM placement of the allocation hook.
+ * - freertos/task.h: Stack high-water marks.
+ * - bus.h: Subscriber queue depths, drop counters and free pool messages.
+ * - json_arena.h: Arena high-water mark.
+ * - stdio.h: Formatting.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "sdkconfig.h"
+#include "metrics.h"
+#include "bus.h"
+#include "json_arena.h"
+
+#define METRICS_MAX_BUCKETS 10
+
+typedef struct {
+    const char *name;
+    const char *help;
+} metric_info_t;
+
+typedef struct {
+    const char *name;
+    const char *help;
+    uint32_t bounds[METRICS_MAX_BUCKETS];   ///< Upper bucket bounds in milliseconds, ascending; 0 ends the list.
+} histogram_info_t;
+
+typedef struct {
+    uint32_t buckets[METRICS_MAX_BUCKETS + 1];  ///< Per-bucket counts; the last one is +Inf.
+    uint32_t sum_ms;
+} histogram_t;
+
+typedef struct {
+    TaskHandle_t task;
+    uint32_t stack_bytes;
+    uint32_t allocations;   ///< Heap allocations since the task registered, freed or not.
+} task_entry_t;
+
+typedef struct {
+    const char *name;
+    uint32_t bytes;         ///< Heap the subsystem took while starting.
+} subsystem_entry_t;
+
+uint32_t metrics_counters[METRIC_COUNTER_COUNT];
+static histogram_t histograms[METRIC_HISTOGRAM_COUNT];
+static task_entry_t tasks[METRICS_MAX_TASKS];
+static uint32_t task_count = 0;             ///< Raised with a release store once the entry is complete.
+static portMUX_TYPE task_lock = portMUX_INITIALIZER_UNLOCKED;
+static subsystem_entry_t subsystems[METRICS_MAX_SUBSYSTEMS];
+static uint32_t subsystem_count = 0;        ///< Raised with a release store once the entry is complete.
+static uint32_t checkpoint_free = 0;        ///< Free heap at the previous checkpoint; only touched during startup.
+
+static const metric_info_t counter_info[METRIC_COUNTER_COUNT] = {
+    [METRIC_FRAMES_PARSED] = { "smarthome_frames_parsed_total", "Telemetry messages accepted." },
+    [METRIC_PARSE_ERRORS] = { "smarthome_parse_errors_total", "Telemetry messages rejected." },
+    [METRIC_FRAMER_OVERFLOWS] = { "smarthome_framer_overflows_total", "Messages dropped for not fitting the receive ring." },
+    [METRIC_HANDSHAKES] = { "smarthome_handshakes_total", "Station handshakes completed." },
+    [METRIC_SESSION_RESUMES] = { "smarthome_session_resumes_total", "Station sessions resumed without a handshake." },
+    [METRIC_RULE_EVALUATIONS] = { "smarthome_rule_evaluations_total", "Automation rules evaluated." },
+    [METRIC_SETPOINT_ACK_TIMEOUTS] = { "smarthome_setpoint_ack_timeouts_total", "Setpoint commands never acknowledged." },
+    [METRIC_SHELLY_REQUESTS] = { "smarthome_shelly_requests_total", "HTTP requests sent to Shelly plugs." },
+    [METRIC_SHELLY_FAILURES] = { "smarthome_shelly_failures_total", "Shelly requests that failed." },
+    [METRIC_WIFI_RECONNECTS] = { "smarthome_wifi_reconnects_total", "Wi-Fi reconnect attempts." },
+    [METRIC_UPLINK_POSTS] = { "smarthome_uplink_posts_total", "Sample batches posted upstream." },
+    [METRIC_UPLINK_FAILURES] = { "smarthome_uplink_failures_total", "Upstream posts that failed." },
+    [METRIC_UPLINK_SAMPLES] = { "smarthome_uplink_samples_total", "Samples acknowledged by the upstream." },
+    [METRIC_UPLINK_BYTES] = { "smarthome_uplink_bytes_total", "Encoded batch bytes acknowledged by the upstream." },
+    [METRIC_LOG_DROPPED] = { "smarthome_log_dropped_total", "Log records dropped on a full ring." },
+    [METRIC_LOG_SUPPRESSED] = { "smarthome_log_suppressed_total", "Log records suppressed as repeats." },
+    [METRIC_DATA_RENDERS] = { "smarthome_data_renders_total", "/data bodies serialized after a change." },
+    [METRIC_DATA_NOT_MODIFIED] = { "smarthome_data_not_modified_total", "/data requests answered with 304." },
+};
+
+static const histogram_info_t histogram_info[METRIC_HISTOGRAM_COUNT] = {
+    [METRIC_HANDSHAKE_MS] = { "smarthome_handshake_duration_seconds", "Time from accept to completed handshake.",
+                              { 10, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000 } },
+    [METRIC_FIRST_FRAME_MS] = { "smarthome_first_frame_seconds", "Time from accept to first accepted telemetry.",
+                                { 10, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000 } },
+    [METRIC_SETPOINT_RTT_MS] = { "smarthome_setpoint_ack_seconds", "Setpoint command round-trip time.",
+                                 { 50, 100, 250, 500, 1000, 2000, 3000, 5000, 10000 } },
+    [METRIC_SHELLY_LATENCY_MS] = { "smarthome_shelly_request_seconds", "Shelly HTTP request latency.",
+                                   { 5, 10, 25, 50, 100, 250, 500, 1000, 3000 } },
+    [METRIC_UPLINK_LATENCY_MS] = { "smarthome_uplink_post_seconds", "Upstream post latency.",
+                                   { 10, 25, 50, 100, 250, 500, 1000, 2500, 5000 } },
+};
+
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+/**
+ * Called by the allocator after every successful allocation on any task, including lwIP's and the Wi-Fi driver's
+ * per-packet buffers; it must not allocate itself. Only the registered tasks are counted, so a scan of the few
+ * entries is all the cost the other tasks pay.
+ */
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    uint32_t count = __atomic_load_n(&task_count, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < count; i++) {
+        if (tasks[i].task == task) {
+            __atomic_fetch_add(&tasks[i].allocations, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+}
+
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr) {
+}
+#endif
+
+
+void metrics_observe(metric_histogram_t histogram, uint32_t ms) {
+    const uint32_t *bounds = histogram_info[histogram].bounds;
+    size_t bucket = 0;
+    while (bucket < METRICS_MAX_BUCKETS && bounds[bucket] != 0 && ms > bounds[bucket]) {
+        bucket++;
+    }
+    if (bucket < METRICS_MAX_BUCKETS && bounds[bucket] == 0) {
+        bucket = METRICS_MAX_BUCKETS;  // Past the last bound: +Inf
+    }
+
+    __atomic_fetch_add(&histograms[histogram].buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histograms[histogram].sum_ms, ms, __ATOMIC_RELAXED);
+}
+
+
+void metrics_register_task(TaskHandle_t task, uint32_t stack_bytes) {
+    if (!task) {
+        return;
+    }
+    portENTER_CRITICAL(&task_lock);
+    uint32_t count = task_count;
+    if (count < METRICS_MAX_TASKS) {
+        tasks[count] = (task_entry_t){ .task = task, .stack_bytes = stack_bytes };
+        __atomic_store_n(&task_count, count + 1, __ATOMIC_RELEASE);
+    }
+    portEXIT_CRITICAL(&task_lock);
+}
+
+
+void metrics_heap_checkpoint(const char *subsystem) {
+    uint32_t free_now = esp_get_free_heap_size();
+    uint32_t count = subsystem_count;
+    if (subsystem && count < METRICS_MAX_SUBSYSTEMS) {
+        subsystems[count] = (subsystem_entry_t){
+            .name = subsystem,
+            .bytes = checkpoint_free > free_now ? checkpoint_free - free_now : 0,
+        };
+        __atomic_store_n(&subsystem_count, count + 1, __ATOMIC_RELEASE);
+    }
+    checkpoint_free = free_now;
+}
+
+
+static int format_header(char *buffer, size_t len, const char *name, const char *help, const char *type) {
+    return snprintf(buffer, len, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+
+static int format_histogram(char *buffer, size_t len, metric_histogram_t histogram) {
+    const histogram_info_t *info = &histogram_info[histogram];
+    const histogram_t *h = &histograms[histogram];
+    uint32_t cumulative = 0;
+
+    int n = format_header(buffer, len, info->name, info->help, "histogram");
+    for (size_t i = 0; i < METRICS_MAX_BUCKETS && info->bounds[i] != 0 && n < (int)len; i++) {
+        cumulative += __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+        n += snprintf(buffer + n, len - n, "%s_bucket{le=\"%lu.%03lu\"} %lu\n", info->name,
+                      (unsigned long)(info->bounds[i] / 1000), (unsigned long)(info->bounds[i] % 1000),
+                      (unsigned long)cumulative);
+    }
+    if (n < (int)len) {
+        cumulative += __atomic_load_n(&h->buckets[METRICS_MAX_BUCKETS], __ATOMIC_RELAXED);
+        uint32_t sum_ms = __atomic_load_n(&h->sum_ms, __ATOMIC_RELAXED);
+        n += snprintf(buffer + n, len - n, "%s_bucket{le=\"+Inf\"} %lu\n%s_sum %lu.%03lu\n%s_count %lu\n",
+                      info->name, (unsigned long)cumulative,
+                      info->name, (unsigned long)(sum_ms / 1000), (unsigned long)(sum_ms % 1000),
+                      info->name, (unsigned long)cumulative);
+    }
+    return n < (int)len ? n : (int)len - 1;
+}
+
+
+static int format_bus(char *buffer, size_t len, bool dropped) {
+    const char *name = dropped ? "smarthome_bus_dropped_total" : "smarthome_bus_queue_depth";
+    int n = format_header(buffer, len, name,
+                          dropped ? "Bus messages a subscriber lost to a full queue or an empty pool."
+                                  : "Bus messages waiting for a subscriber.",
+                          dropped ? "counter" : "gauge");
+    bus_subscriber_stats_t stats;
+    for (size_t i = 0; n < (int)len && bus_subscriber_stats(i, &stats); i++) {
+        n += snprintf(buffer + n, len - n, "%s{topic=\"%s\",subscriber=\"%s\"} %lu\n", name,
+                      bus_topic_name(stats.topic), stats.name, (unsigned long)(dropped ? stats.dropped : stats.depth));
+    }
+    return n < (int)len ? n : (int)len - 1;
+}
+
+
+static int format_tasks(char *buffer, size_t len, bool free_min) {
+    const char *name = free_min ? "smarthome_task_stack_free_min_bytes" : "smarthome_task_stack_bytes";
+    int n = format_header(buffer, len, name,
+                          free_min ? "Least stack a task has had left since it started." : "Stack size of a task.",
+                          "gauge");
+    uint32_t count = __atomic_load_n(&task_count, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < count && n < (int)len; i++) {
+        uint32_t value = free_min ? (uint32_t)uxTaskGetStackHighWaterMark(tasks[i].task) : tasks[i].stack_bytes;
+        n += snprintf(buffer + n, len - n, "%s{task=\"%s\"} %lu\n", name, pcTaskGetName(tasks[i].task),
+                      (unsigned long)value);
+    }
+    return n < (int)len ? n : (int)len - 1;
+}
+
+
+static int format_task_allocations(char *buffer, size_t len) {
+    const char *name = "smarthome_task_heap_allocations_total";
+    int n = format_header(buffer, len, name, "Heap allocations a task made since it registered, freed or not.",
+                          "counter");
+    uint32_t count = __atomic_load_n(&task_count, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < count && n < (int)len; i++) {
+        n += snprintf(buffer + n, len - n, "%s{task=\"%s\"} %lu\n", name, pcTaskGetName(tasks[i].task),
+                      (unsigned long)__atomic_load_n(&tasks[i].allocations, __ATOMIC_RELAXED));
+    }
+    return n < (int)len ? n : (int)len - 1;
+}
+
+
+static int format_subsystems(char *buffer, size_t len) {
+    const char *name = "smarthome_heap_boot_bytes";
+    int n = format_header(buffer, len, name, "Heap a subsystem allocated while starting.", "gauge");
+    uint32_t count = __atomic_load_n(&subsystem_count, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < count && n < (int)len; i++) {
+        n += snprintf(buffer + n, len - n, "%s{subsystem=\"%s\"} %lu\n", name, subsystems[i].name,
+                      (unsigned long)subsystems[i].bytes);
+    }
+    return n < (int)len ? n : (int)len - 1;
+}
+
+
+int metrics_format(size_t family, char *buffer, size_t len) {
+    if (family < METRIC_COUNTER_COUNT) {
+        const metric_info_t *info = &counter_info[family];
+        int n = format_header(buffer, len, info->name, info->help, "counter");
+        if (n >= (int)len) return (int)len - 1;
+        n += snprintf(buffer + n, len - n, "%s %lu\n", info->name,
+                      (unsigned long)__atomic_load_n(&metrics_counters[family], __ATOMIC_RELAXED));
+        return n < (int)len ? n : (int)len - 1;
+    }
+    family -= METRIC_COUNTER_COUNT;
+
+    if (family < METRIC_HISTOGRAM_COUNT) {
+        return format_histogram(buffer, len, family);
+    }
+    family -= METRIC_HISTOGRAM_COUNT;
+
+    if (family == 0) {
+        return snprintf(buffer, len,
+                        "# HELP smarthome_heap_free_bytes Free heap.\n"
+                        "# TYPE smarthome_heap_free_bytes gauge\n"
+                        "smarthome_heap_free_bytes %lu\n"
+                        "# HELP smarthome_heap_min_free_bytes Lowest free heap since boot.\n"
+                        "# TYPE smarthome_heap_min_free_bytes gauge\n"
+                        "smarthome_heap_min_free_bytes %lu\n",
+                        (unsigned long)esp_get_free_heap_size(), (unsigned long)esp_get_minimum_free_heap_size());
+    }
+    if (family == 1 || family == 2) {
+        return format_bus(buffer, len, family == 2);
+    }
+    if (family == 3) {
+        return snprintf(buffer, len,
+                        "# HELP smarthome_bus_pool_free Bus messages left in the pool.\n"
+                        "# TYPE smarthome_bus_pool_free gauge\n"
+                        "smarthome_bus_pool_free %lu\n",
+                        (unsigned long)bus_pool_free());
+    }
+    if (family == 4 || family == 5) {
+        return format_tasks(buffer, len, family == 5);
+    }
+    if (family == 6) {
+        return format_subsystems(buffer, len);
+    }
+    if (family == 7) {
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+        return snprintf(buffer, len,
+                        "# HELP smarthome_heap_allocated_blocks Blocks allocated on the heap; flat once started.\n"
+                        "# TYPE smarthome_heap_allocated_blocks gauge\n"
+                        "smarthome_heap_allocated_blocks %lu\n"
+                        "# HELP smarthome_heap_largest_free_block_bytes Largest block the heap can still allocate.\n"
+                        "# TYPE smarthome_heap_largest_free_block_bytes gauge\n"
+                        "smarthome_heap_largest_free_block_bytes %lu\n",
+                        (unsigned long)info.allocated_blocks, (unsigned long)info.largest_free_block);
+    }
+    if (family == 8) {
+        json_arena_stats_t arena;
+        json_arena_stats(&arena);
+        return snprintf(buffer, len,
+                        "# HELP smarthome_json_arena_bytes Size of the JSON parser arena.\n"
+                        "# TYPE smarthome_json_arena_bytes gauge\n"
+                        "smarthome_json_arena_bytes %lu\n"
+                        "# HELP smarthome_json_arena_high_water_bytes Most of the JSON parser arena in use at once.\n"
+                        "# TYPE smarthome_json_arena_high_water_bytes gauge\n"
+                        "smarthome_json_arena_high_water_bytes %lu\n"
+                        "# HELP smarthome_json_arena_exhausted_total Parser allocations refused for a full arena.\n"
+                        "# TYPE smarthome_json_arena_exhausted_total counter\n"
+                        "smarthome_json_arena_exhausted_total %lu\n",
+                        (unsigned long)arena.size, (unsigned long)arena.high_water, (unsigned long)arena.exhausted);
+    }
+    if (family == 9) {
+        return format_task_allocations(buffer, len);
+    }
+    return -1;
+}
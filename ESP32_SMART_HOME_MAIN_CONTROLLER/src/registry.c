@@ -0,0 +1,291 @@
+/**
+ * @file registry.c
+ * @brief This file contains the implementation of the station registry for the ESP32 Smart Home Main Controller project.
+ *
+ * Stations are stored in a fixed array of slots addressed by the FNV-1a hash of their ID, with linear probing on
+ * collisions. Stations are never removed, so there are no tombstones and a probe ends at the first free slot; with at
+ * most half of the slots in use a probe is short. A slot is published by storing its hash last, after the ID, and the
+ * ID never changes afterwards, so lookups from any task only need an acquire load per probed slot.
+ *
+ * The mutable part of an entry is guarded by a per-entry sequence counter that is odd while a write is in progress.
+ * Writers serialize on a spinlock critical section; readers copy the entry and retry if a write overlapped the copy.
+ * Every completed write, and the publication of a new slot, also bumps the registry version.
+ *
+ * The main functionalities provided by this file include:
+ * - Registering stations by ID and binding them to the free plugs matching their capabilities, again whenever a
+ *   station reports different capabilities.
+ * - Telling which station each plug is bound to, and which station owns the controller state.
+ * - Finding stations by ID in constant time without allocating.
+ * - Recording readings, setpoints and the connection state per station.
+ * - Taking consistent snapshots of one slot for scans of the whole registry.
+ *
+ * Dependencies:
+ * - registry.h: Registry types and function declarations.
+ * - shelly_control.h: Plugs a station can be bound to.
+ * - state.h: Default setpoints of new stations.
+ * - freertos/FreeRTOS.h: Spinlock critical sections.
+ * - esp_log.h: ESP32 logging functions.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "registry.h"
+#include "shelly_control.h"
+#include "state.h"
+
+static const char *TAG = "REGISTRY";
+
+_Static_assert((REGISTRY_CAPACITY & (REGISTRY_CAPACITY - 1)) == 0, "REGISTRY_CAPACITY must be a power of two");
+_Static_assert(REGISTRY_MAX_STATIONS < REGISTRY_CAPACITY, "the registry needs a free slot to end every probe");
+
+/**
+ * @brief One slot of the table.
+ */
+typedef struct {
+    uint32_t hash;              ///< Hash of the ID, or 0 while the slot is free; stored last when registering.
+    uint32_t sequence;          ///< Odd while the record is being written.
+    station_record_t record;
+} registry_entry_t;
+
+static registry_entry_t entries[REGISTRY_CAPACITY];
+static int station_count = 0;
+static uint8_t bound_plugs = 0;             ///< Plugs bound to any station; TCP server task only.
+static int plug_station[SHELLY_PLUG_COUNT] = { [0 ... SHELLY_PLUG_COUNT - 1] = -1 };  ///< Slot bound to each plug, or -1.
+static portMUX_TYPE writer_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t version = 0;                ///< Bumped after every write, with a release store.
+
+static const struct {
+    const char *name;
+    uint8_t flag;
+} cap_names[] = {
+    { "temp", REGISTRY_CAP_TEMPERATURE },
+    { "hum", REGISTRY_CAP_HUMIDITY },
+    { "lux", REGISTRY_CAP_LUX },
+    { "heat", REGISTRY_CAP_HEATER },
+    { "dehum", REGISTRY_CAP_DEHUMIDIFIER },
+};
+
+
+static uint32_t registry_hash(const char *id) {
+    uint32_t hash = 2166136261u;
+    while (*id) {
+        hash = (hash ^ (uint8_t)*id++) * 16777619u;
+    }
+    return hash ? hash : 1;  // 0 marks a free slot
+}
+
+
+/**
+ * Returns the slot holding @p id, or the free slot that ends its probe sequence.
+ */
+static int registry_probe(const char *id, uint32_t hash) {
+    int slot = hash & (REGISTRY_CAPACITY - 1);
+    for (;;) {
+        uint32_t stored = __atomic_load_n(&entries[slot].hash, __ATOMIC_ACQUIRE);
+        if (stored == 0 || (stored == hash && strcmp(entries[slot].record.id, id) == 0)) {
+            return slot;
+        }
+        slot = (slot + 1) & (REGISTRY_CAPACITY - 1);
+    }
+}
+
+
+static void write_begin(registry_entry_t *entry) {
+    portENTER_CRITICAL(&writer_lock);
+    __atomic_store_n(&entry->sequence, entry->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+
+static void write_end(registry_entry_t *entry) {
+    __atomic_store_n(&entry->sequence, entry->sequence + 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&version, 1, __ATOMIC_RELEASE);
+    portEXIT_CRITICAL(&writer_lock);
+}
+
+
+/**
+ * Binds the plugs of the zone's capabilities that no other station claimed yet to @p slot.
+ */
+static uint8_t registry_bind(int slot, uint8_t caps) {
+    uint8_t plugs = 0;
+    if (caps & REGISTRY_CAP_HEATER) plugs |= 1u << SHELLY_HEATER;
+    if (caps & REGISTRY_CAP_DEHUMIDIFIER) plugs |= 1u << SHELLY_DEHUMIDIFIER;
+    plugs &= ~bound_plugs;
+    bound_plugs |= plugs;
+    for (int plug = 0; plug < SHELLY_PLUG_COUNT; plug++) {
+        if (plugs & (1u << plug)) __atomic_store_n(&plug_station[plug], slot, __ATOMIC_RELAXED);
+    }
+    return plugs;
+}
+
+
+static void registry_unbind(uint8_t plugs) {
+    bound_plugs &= ~plugs;
+    for (int plug = 0; plug < SHELLY_PLUG_COUNT; plug++) {
+        if (plugs & (1u << plug)) __atomic_store_n(&plug_station[plug], -1, __ATOMIC_RELAXED);
+    }
+}
+
+
+uint8_t registry_parse_caps(const char *caps) {
+    uint8_t flags = 0;
+    while (*caps && *caps != ';') {
+        size_t len = strcspn(caps, ",;");
+        for (size_t i = 0; i < sizeof(cap_names) / sizeof(cap_names[0]); i++) {
+            if (strlen(cap_names[i].name) == len && strncmp(caps, cap_names[i].name, len) == 0) {
+                flags |= cap_names[i].flag;
+            }
+        }
+        caps += len;
+        if (*caps == ',') caps++;
+    }
+    return flags;
+}
+
+
+int registry_register(const char *id, uint8_t caps) {
+    size_t len = strlen(id);
+    if (len == 0 || len >= REGISTRY_ID_LEN) {
+        return -1;
+    }
+
+    uint32_t hash = registry_hash(id);
+    int slot = registry_probe(id, hash);
+    registry_entry_t *entry = &entries[slot];
+
+    if (entry->hash != 0) {
+        // Release the old plugs first, so the station keeps those its new capabilities still claim
+        uint8_t old_plugs = entry->record.plugs;
+        registry_unbind(old_plugs);
+        uint8_t plugs = registry_bind(slot, caps);
+
+        write_begin(entry);
+        entry->record.caps = caps;
+        __atomic_store_n(&entry->record.plugs, plugs, __ATOMIC_RELAXED);
+        write_end(entry);
+        if (plugs != old_plugs) {
+            ESP_LOGI(TAG, "📇 Station '%s' rebound (caps 0x%02x, plugs 0x%02x)", id, caps, plugs);
+        }
+        return slot;
+    }
+
+    if (station_count >= REGISTRY_MAX_STATIONS) {
+        ESP_LOGW(TAG, "⚠️ Registry full, station '%s' not registered", id);
+        return -1;
+    }
+
+    uint8_t plugs = registry_bind(slot, caps);
+
+    controller_state_t state;
+    state_read(&state);
+
+    write_begin(entry);
+    memset(&entry->record, 0, sizeof(entry->record));
+    memcpy(entry->record.id, id, len + 1);
+    entry->record.caps = caps;
+    entry->record.plugs = plugs;
+    entry->record.sp_temperature = state.sp_temperature;
+    entry->record.sp_humidity = state.sp_humidity;
+    write_end(entry);
+    __atomic_store_n(&entry->hash, hash, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&version, 1, __ATOMIC_RELEASE);  // Scans from before the slot was published missed it
+    __atomic_store_n(&station_count, station_count + 1, __ATOMIC_RELAXED);
+
+    ESP_LOGI(TAG, "📇 Registered station '%s' in slot %d (caps 0x%02x, plugs 0x%02x)", id, slot, caps, plugs);
+    return slot;
+}
+
+
+int registry_find(const char *id) {
+    int slot = registry_probe(id, registry_hash(id));
+    return __atomic_load_n(&entries[slot].hash, __ATOMIC_ACQUIRE) != 0 ? slot : -1;
+}
+
+
+void registry_set_online(int slot, bool online) {
+    if (slot < 0 || slot >= REGISTRY_CAPACITY) return;
+    registry_entry_t *entry = &entries[slot];
+    write_begin(entry);
+    entry->record.online = online;
+    write_end(entry);
+}
+
+
+void registry_record(int slot, const telemetry_t *reading, uint32_t now) {
+    if (slot < 0 || slot >= REGISTRY_CAPACITY) return;
+    registry_entry_t *entry = &entries[slot];
+    write_begin(entry);
+    entry->record.reading = *reading;
+    entry->record.reading_valid = true;
+    entry->record.updated = now;
+    // The station reports the setpoints it runs on, like apply_telemetry() takes them for the controller state
+    if (reading->fields & TELEMETRY_HAS_SP_TEMPERATURE) {
+        entry->record.sp_temperature = reading->sp_temperature;
+    }
+    if (reading->fields & TELEMETRY_HAS_SP_HUMIDITY) {
+        entry->record.sp_humidity = reading->sp_humidity;
+    }
+    write_end(entry);
+}
+
+
+void registry_set_setpoints(int slot, int16_t sp_temperature, int16_t sp_humidity) {
+    if (slot < 0 || slot >= REGISTRY_CAPACITY) return;
+    registry_entry_t *entry = &entries[slot];
+    write_begin(entry);
+    entry->record.sp_temperature = sp_temperature;
+    entry->record.sp_humidity = sp_humidity;
+    write_end(entry);
+}
+
+
+uint8_t registry_plugs(int slot) {
+    // A single byte, rewritten only when the station registers again
+    return slot >= 0 && slot < REGISTRY_CAPACITY ? __atomic_load_n(&entries[slot].record.plugs, __ATOMIC_RELAXED) : 0;
+}
+
+
+int registry_plug_station(int plug) {
+    return plug >= 0 && plug < SHELLY_PLUG_COUNT ? __atomic_load_n(&plug_station[plug], __ATOMIC_RELAXED) : -1;
+}
+
+
+int registry_owner(void) {
+    for (int plug = 0; plug < SHELLY_PLUG_COUNT; plug++) {
+        int slot = registry_plug_station(plug);
+        if (slot >= 0) return slot;
+    }
+    return -1;
+}
+
+
+int registry_count(void) {
+    return __atomic_load_n(&station_count, __ATOMIC_RELAXED);
+}
+
+
+uint32_t registry_version(void) {
+    return __atomic_load_n(&version, __ATOMIC_ACQUIRE);
+}
+
+
+bool registry_read(int slot, station_record_t *out) {
+    if (slot < 0 || slot >= REGISTRY_CAPACITY) return false;
+    registry_entry_t *entry = &entries[slot];
+    if (__atomic_load_n(&entry->hash, __ATOMIC_ACQUIRE) == 0) {
+        return false;
+    }
+
+    uint32_t begin, end;
+    do {
+        begin = __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE);
+        memcpy(out, &entry->record, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        end = __atomic_load_n(&entry->sequence, __ATOMIC_RELAXED);
+    } while ((begin & 1) || begin != end);
+    return true;
+}
@@ -0,0 +1,535 @@
+/**
+ * @file rules.c
+ * @brief This file contains the implementation of the automation rule engine for the ESP32 Smart Home Main Controller project.
+ *
+ * Rule sets are written as JSON and compiled into a fixed table of rules with integer thresholds in the units of the
+ * controller state. Compiling also records, for every input signal, a bit mask of the rules that read it. Every plug
+ * has its own set of signals, taken from the registry record of the station bound to it, so a plug is only ever
+ * switched on the readings and setpoints of its own zone. On every pass the evaluating task compares the registry
+ * version and the minute of the day with the last pass; only if one of them moved are the signals refreshed, and only
+ * the rules of a plug depending on a signal of its zone whose value or validity changed are evaluated again. The cost
+ * of a sample therefore depends on the rules it affects, not on the size of the rule set.
+ *
+ * The main functionalities provided by this file include:
+ * - Compiling JSON rule sets into the evaluation table, with an error message for the first invalid rule.
+ * - Persisting the rule set in NVS and falling back to default rules that mirror the station's hysteresis control.
+ * - Incrementally evaluating threshold rules with hysteresis, lux conditions and time windows.
+ * - Publishing a switch command on the bus when the combined output of a plug's rules changes.
+ *
+ * Dependencies:
+ * - rules.h: Rule engine declarations.
+ * - registry.h: Readings and setpoints of the station bound to each plug.
+ * - shelly_control.h: Shelly plug names.
+ * - bus.h: Publish/subscribe bus for the switch commands.
+ * - metrics.h: Rule evaluation counter.
+ * - cJSON.h: JSON parsing library.
+ * - json_arena.h: Arena holding the parse tree.
+ * - nvs.h: Non-volatile storage of the rule set.
+ * - freertos/semphr.h: FreeRTOS mutex functions.
+ * - dlog.h: Deferred logging for the switching messages.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "cJSON.h"
+#include "json_arena.h"
+#include "rules.h"
+#include "registry.h"
+#include "shelly_control.h"
+#include "bus.h"
+#include "metrics.h"
+#include "dlog.h"
+
+static const char *TAG = "RULES";
+
+#define RULES_NVS_NAMESPACE "smarthome"
+#define RULES_NVS_KEY "rules"
+#define RULES_CLOCK_VALID_YEAR 2024     ///< Before SNTP sets the clock, time conditions never hold.
+
+/**
+ * @brief Default rules: the station's heater and dehumidifier hysteresis around the setpoints.
+ */
+static const char default_rules[] =
+    "{\"rules\":["
+    "{\"actuator\":\"heater\",\"signal\":\"temperature\",\"below\":\"sp_temperature\",\"hysteresis\":1.0},"
+    "{\"actuator\":\"dehumidifier\",\"signal\":\"humidity\",\"above\":\"sp_humidity\",\"hysteresis\":2.0}"
+    "]}";
+
+/**
+ * @brief Input signals of the rules.
+ */
+typedef enum {
+    RULE_SIGNAL_TEMPERATURE,
+    RULE_SIGNAL_HUMIDITY,
+    RULE_SIGNAL_LUX,
+    RULE_SIGNAL_SP_TEMPERATURE,
+    RULE_SIGNAL_SP_HUMIDITY,
+    RULE_SIGNAL_TIME,               ///< Local minute of the day.
+    RULE_SIGNAL_COUNT,
+    RULE_SIGNAL_NONE = RULE_SIGNAL_COUNT
+} rule_signal_t;
+
+static const struct {
+    const char *name;
+    int32_t scale;                  ///< Factor from the units written in rules to the units of the state.
+} signal_info[RULE_SIGNAL_COUNT] = {
+    [RULE_SIGNAL_TEMPERATURE] = { "temperature", 100 },
+    [RULE_SIGNAL_HUMIDITY] = { "humidity", 100 },
+    [RULE_SIGNAL_LUX] = { "lux", 1 },
+    [RULE_SIGNAL_SP_TEMPERATURE] = { "sp_temperature", 100 },
+    [RULE_SIGNAL_SP_HUMIDITY] = { "sp_humidity", 100 },
+    [RULE_SIGNAL_TIME] = { "time", 1 },
+};
+
+/**
+ * @brief Condition under which a rule applies: min <= signal <= max, or outside max..min if min > max.
+ */
+typedef struct {
+    uint8_t signal;
+    int32_t min;
+    int32_t max;
+} rule_condition_t;
+
+/**
+ * @brief One compiled rule.
+ */
+typedef struct {
+    uint8_t actuator;               ///< shelly_plug_t switched by the rule.
+    uint8_t signal;                 ///< Signal compared with the threshold.
+    uint8_t ref_signal;             ///< Signal the threshold follows, or RULE_SIGNAL_NONE for a constant.
+    bool above;                     ///< On above the threshold rather than below it.
+    int32_t threshold;              ///< Constant threshold, or offset added to ref_signal.
+    int32_t hysteresis;             ///< Half width of the band around the threshold.
+    uint8_t condition_count;
+    rule_condition_t conditions[RULES_MAX_CONDITIONS];
+} rule_t;
+
+/**
+ * @brief Compiled rule set.
+ */
+typedef struct {
+    uint8_t count;
+    rule_t rules[RULES_MAX];
+    uint32_t dependents[RULE_SIGNAL_COUNT];     ///< Rules reading each signal, one bit per rule.
+    uint32_t actuator_rules[SHELLY_PLUG_COUNT]; ///< Rules switching each actuator, one bit per rule.
+} rules_table_t;
+
+// Handover from rules_set_json() to the evaluating task; protected by rules_mutex
+static SemaphoreHandle_t rules_mutex;
+static StaticSemaphore_t rules_mutex_buffer;
+static rules_table_t pending;
+static bool pending_valid = false;
+static rules_table_t compiled;              ///< Scratch table of rules_set_json(), so a rejected set leaves pending intact.
+static char source[RULES_JSON_MAX];         ///< JSON of the rule set last installed.
+
+// Evaluation state; only touched by the task calling rules_poll()
+static rules_table_t table;
+static int32_t signals[SHELLY_PLUG_COUNT][RULE_SIGNAL_COUNT];  ///< Signals of the zone bound to each plug.
+static uint32_t signals_valid[SHELLY_PLUG_COUNT];   ///< One bit per signal of the zone that currently has a value.
+static uint32_t rules_on;                   ///< One bit per rule whose output is on.
+static uint32_t seen_registry_version;
+static int32_t seen_minute = -2;
+static bool outputs[SHELLY_PLUG_COUNT];
+static uint32_t outputs_sent;               ///< One bit per plug whose output under the current rule set was published.
+static bool publish_failed = false;         ///< A switch command did not fit on the bus; retried on the next pass.
+
+
+static int find_signal(const char *name) {
+    for (int s = 0; s < RULE_SIGNAL_COUNT; s++) {
+        if (strcmp(name, signal_info[s].name) == 0) return s;
+    }
+    return -1;
+}
+
+
+static int find_actuator(const char *name) {
+    for (int a = 0; a < SHELLY_PLUG_COUNT; a++) {
+        if (strcmp(name, shelly_plug_name(a)) == 0) return a;
+    }
+    return -1;
+}
+
+
+static int32_t scaled(double value, int signal) {
+    double v = value * signal_info[signal].scale;
+    return (int32_t)(v < 0 ? v - 0.5 : v + 0.5);
+}
+
+
+static bool parse_clock(const cJSON *item, int32_t *minute) {
+    unsigned hours, minutes;
+    char end;
+    if (!cJSON_IsString(item) || sscanf(item->valuestring, "%u:%u%c", &hours, &minutes, &end) != 2 ||
+        hours > 23 || minutes > 59) {
+        return false;
+    }
+    *minute = hours * 60 + minutes;
+    return true;
+}
+
+
+static bool compile_condition(const cJSON *json, rule_condition_t *condition, char *error, size_t error_len) {
+    const cJSON *signal = cJSON_GetObjectItemCaseSensitive(json, "signal");
+    int s = cJSON_IsString(signal) ? find_signal(signal->valuestring) : -1;
+    if (s < 0) {
+        snprintf(error, error_len, "condition needs a known signal");
+        return false;
+    }
+    condition->signal = s;
+
+    if (s == RULE_SIGNAL_TIME) {
+        if (!parse_clock(cJSON_GetObjectItemCaseSensitive(json, "from"), &condition->min) ||
+            !parse_clock(cJSON_GetObjectItemCaseSensitive(json, "to"), &condition->max)) {
+            snprintf(error, error_len, "time condition needs \"from\" and \"to\" as HH:MM");
+            return false;
+        }
+        // "to" is exclusive; from == to covers the whole day
+        condition->max = (condition->max + 24 * 60 - 1) % (24 * 60);
+        return true;
+    }
+
+    const cJSON *min = cJSON_GetObjectItemCaseSensitive(json, "min");
+    const cJSON *max = cJSON_GetObjectItemCaseSensitive(json, "max");
+    if ((!min && !max) || (min && !cJSON_IsNumber(min)) || (max && !cJSON_IsNumber(max))) {
+        snprintf(error, error_len, "%s condition needs a numeric \"min\" or \"max\"", signal_info[s].name);
+        return false;
+    }
+    condition->min = min ? scaled(min->valuedouble, s) : INT32_MIN;
+    condition->max = max ? scaled(max->valuedouble, s) : INT32_MAX;
+    if (condition->min > condition->max) {
+        snprintf(error, error_len, "%s condition has \"min\" above \"max\"", signal_info[s].name);
+        return false;
+    }
+    return true;
+}
+
+
+static bool compile_rule(const cJSON *json, rule_t *rule, char *error, size_t error_len) {
+    const cJSON *actuator = cJSON_GetObjectItemCaseSensitive(json, "actuator");
+    int a = cJSON_IsString(actuator) ? find_actuator(actuator->valuestring) : -1;
+    if (a < 0) {
+        snprintf(error, error_len, "unknown actuator");
+        return false;
+    }
+
+    const cJSON *signal = cJSON_GetObjectItemCaseSensitive(json, "signal");
+    int s = cJSON_IsString(signal) ? find_signal(signal->valuestring) : -1;
+    if (s < 0 || s == RULE_SIGNAL_TIME) {
+        snprintf(error, error_len, "unknown signal");
+        return false;
+    }
+
+    const cJSON *below = cJSON_GetObjectItemCaseSensitive(json, "below");
+    const cJSON *above = cJSON_GetObjectItemCaseSensitive(json, "above");
+    const cJSON *threshold = below ? below : above;
+    if ((below != NULL) == (above != NULL) || !(cJSON_IsNumber(threshold) || cJSON_IsString(threshold))) {
+        snprintf(error, error_len, "rule needs either \"below\" or \"above\"");
+        return false;
+    }
+
+    *rule = (rule_t){ .actuator = a, .signal = s, .above = above != NULL, .ref_signal = RULE_SIGNAL_NONE };
+    const cJSON *offset = cJSON_GetObjectItemCaseSensitive(json, "offset");
+    if (cJSON_IsString(threshold)) {
+        int ref = find_signal(threshold->valuestring);
+        if (ref < 0 || ref == RULE_SIGNAL_TIME || signal_info[ref].scale != signal_info[s].scale) {
+            snprintf(error, error_len, "threshold signal \"%s\" unknown or in other units", threshold->valuestring);
+            return false;
+        }
+        rule->ref_signal = ref;
+        rule->threshold = cJSON_IsNumber(offset) ? scaled(offset->valuedouble, s) : 0;
+    } else {
+        rule->threshold = scaled(threshold->valuedouble, s);
+    }
+
+    const cJSON *hysteresis = cJSON_GetObjectItemCaseSensitive(json, "hysteresis");
+    rule->hysteresis = cJSON_IsNumber(hysteresis) ? scaled(hysteresis->valuedouble, s) : 0;
+    if (rule->hysteresis < 0) {
+        snprintf(error, error_len, "negative hysteresis");
+        return false;
+    }
+
+    const cJSON *when = cJSON_GetObjectItemCaseSensitive(json, "when");
+    if (when && (!cJSON_IsArray(when) || cJSON_GetArraySize(when) > RULES_MAX_CONDITIONS)) {
+        snprintf(error, error_len, "\"when\" must be an array of at most %d conditions", RULES_MAX_CONDITIONS);
+        return false;
+    }
+    const cJSON *condition;
+    cJSON_ArrayForEach(condition, when) {
+        if (!compile_condition(condition, &rule->conditions[rule->condition_count++], error, error_len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool compile_root(const cJSON *root, rules_table_t *out, char *error, size_t error_len) {
+    const cJSON *rules = cJSON_GetObjectItemCaseSensitive(root, "rules");
+    if (!cJSON_IsArray(rules)) {
+        snprintf(error, error_len, "expected {\"rules\":[...]}");
+        return false;
+    }
+    if (cJSON_GetArraySize(rules) > RULES_MAX) {
+        snprintf(error, error_len, "more than %d rules", RULES_MAX);
+        return false;
+    }
+
+    const cJSON *item;
+    cJSON_ArrayForEach(item, rules) {
+        rule_t *rule = &out->rules[out->count];
+        char reason[80];
+        if (!compile_rule(item, rule, reason, sizeof(reason))) {
+            snprintf(error, error_len, "rule %u: %s", (unsigned)out->count, reason);
+            return false;
+        }
+
+        uint32_t bit = 1u << out->count;
+        out->dependents[rule->signal] |= bit;
+        if (rule->ref_signal != RULE_SIGNAL_NONE) {
+            out->dependents[rule->ref_signal] |= bit;
+        }
+        for (int c = 0; c < rule->condition_count; c++) {
+            out->dependents[rule->conditions[c].signal] |= bit;
+        }
+        out->actuator_rules[rule->actuator] |= bit;
+        out->count++;
+    }
+    return true;
+}
+
+
+static bool rules_compile(const char *json, rules_table_t *out, char *error, size_t error_len) {
+    memset(out, 0, sizeof(*out));
+
+    // The parse tree lives in the JSON arena and is dropped as a whole when the scope ends
+    json_arena_begin();
+    cJSON *root = cJSON_Parse(json);
+    bool ok = compile_root(root, out, error, error_len);
+    cJSON_Delete(root);
+    if (!json_arena_end()) {
+        snprintf(error, error_len, "rule set needs more than %d bytes of parser memory", JSON_ARENA_SIZE);
+        return false;
+    }
+    return ok;
+}
+
+
+static bool rule_applies(const rule_t *rule) {
+    const int32_t *zone = signals[rule->actuator];
+    for (int c = 0; c < rule->condition_count; c++) {
+        const rule_condition_t *condition = &rule->conditions[c];
+        if (!(signals_valid[rule->actuator] & (1u << condition->signal))) return false;
+
+        int32_t value = zone[condition->signal];
+        bool inside = condition->min <= condition->max
+                          ? value >= condition->min && value <= condition->max
+                          : value >= condition->min || value <= condition->max;  // Window across midnight
+        if (!inside) return false;
+    }
+    return true;
+}
+
+
+static bool rule_evaluate(const rule_t *rule, bool on) {
+    const int32_t *zone = signals[rule->actuator];
+    uint32_t inputs = 1u << rule->signal;
+    if (rule->ref_signal != RULE_SIGNAL_NONE) inputs |= 1u << rule->ref_signal;
+    if ((signals_valid[rule->actuator] & inputs) != inputs || !rule_applies(rule)) {
+        return false;
+    }
+
+    int32_t threshold = rule->threshold + (rule->ref_signal != RULE_SIGNAL_NONE ? zone[rule->ref_signal] : 0);
+    int32_t value = zone[rule->signal];
+    if (rule->above) {
+        return on ? value >= threshold - rule->hysteresis : value > threshold + rule->hysteresis;
+    }
+    return on ? value <= threshold + rule->hysteresis : value < threshold - rule->hysteresis;
+}
+
+
+static void signal_set(int plug, int signal, int32_t value, bool valid, uint32_t *changed) {
+    uint32_t bit = 1u << signal;
+    if (valid == ((signals_valid[plug] & bit) != 0) && (!valid || signals[plug][signal] == value)) {
+        return;
+    }
+    signals[plug][signal] = value;
+    signals_valid[plug] = valid ? signals_valid[plug] | bit : signals_valid[plug] & ~bit;
+    *changed |= bit;
+}
+
+
+/**
+ * Refreshes the signals of the zone bound to @p plug and returns the signals whose value or validity changed. A plug
+ * without a station, or whose station has not reported yet, only has the time of day.
+ */
+static uint32_t zone_refresh(int plug, int32_t minute, bool *reading_valid) {
+    station_record_t station = { 0 };
+    bool bound = registry_read(registry_plug_station(plug), &station);
+    *reading_valid = bound && station.reading_valid;
+
+    uint32_t changed = 0;
+    signal_set(plug, RULE_SIGNAL_TEMPERATURE, station.reading.temperature, *reading_valid, &changed);
+    signal_set(plug, RULE_SIGNAL_HUMIDITY, station.reading.humidity, *reading_valid, &changed);
+    signal_set(plug, RULE_SIGNAL_LUX, station.reading.lux, *reading_valid, &changed);
+    signal_set(plug, RULE_SIGNAL_SP_TEMPERATURE, station.sp_temperature, bound, &changed);
+    signal_set(plug, RULE_SIGNAL_SP_HUMIDITY, station.sp_humidity, bound, &changed);
+    signal_set(plug, RULE_SIGNAL_TIME, minute, minute >= 0, &changed);
+    return changed;
+}
+
+
+static int32_t minute_of_day(void) {
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    return local.tm_year + 1900 >= RULES_CLOCK_VALID_YEAR ? local.tm_hour * 60 + local.tm_min : -1;
+}
+
+
+void rules_init(void) {
+    rules_mutex = xSemaphoreCreateMutexStatic(&rules_mutex_buffer);
+
+    char error[96];
+    nvs_handle_t nvs;
+    size_t len = sizeof(source) - 1;
+    if (nvs_open(RULES_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        esp_err_t err = nvs_get_blob(nvs, RULES_NVS_KEY, source, &len);
+        nvs_close(nvs);
+        if (err == ESP_OK) {
+            source[len] = '\0';
+            if (rules_compile(source, &pending, error, sizeof(error))) {
+                pending_valid = true;
+                ESP_LOGI(TAG, "📜 Loaded %u rules from NVS", (unsigned)pending.count);
+                return;
+            }
+            ESP_LOGE(TAG, "❌ Stored rules rejected (%s), using the defaults", error);
+        }
+    }
+
+    strcpy(source, default_rules);
+    pending_valid = rules_compile(source, &pending, error, sizeof(error));
+    ESP_LOGI(TAG, "📜 Using %u default rules", (unsigned)pending.count);
+}
+
+
+void rules_poll(void) {
+    bool reload = false;
+    if (xSemaphoreTake(rules_mutex, 0) == pdTRUE) {
+        if (pending_valid) {
+            memcpy(&table, &pending, sizeof(table));
+            pending_valid = false;
+            reload = true;
+        }
+        xSemaphoreGive(rules_mutex);
+    }
+
+    uint32_t version = registry_version();
+    int32_t minute = minute_of_day();
+    if (!reload && !publish_failed && version == seen_registry_version && minute == seen_minute) {
+        return;
+    }
+    seen_registry_version = version;
+    seen_minute = minute;
+
+    // A new rule set starts from all rules off and evaluates everything once
+    uint32_t dirty = 0;
+    if (reload) {
+        rules_on = 0;
+        outputs_sent = 0;
+        dirty = table.count == RULES_MAX ? UINT32_MAX : (1u << table.count) - 1;
+    }
+    bool readings_valid[SHELLY_PLUG_COUNT];
+    for (int a = 0; a < SHELLY_PLUG_COUNT; a++) {
+        uint32_t changed = zone_refresh(a, minute, &readings_valid[a]);
+        for (int s = 0; s < RULE_SIGNAL_COUNT; s++) {
+            if (changed & (1u << s)) dirty |= table.dependents[s] & table.actuator_rules[a];
+        }
+    }
+
+    uint32_t evaluated = 0;
+    while (dirty) {
+        int r = __builtin_ctz(dirty);
+        dirty &= dirty - 1;
+        bool on = rule_evaluate(&table.rules[r], (rules_on >> r) & 1);
+        rules_on = on ? rules_on | (1u << r) : rules_on & ~(1u << r);
+        evaluated++;
+    }
+    metrics_add(METRIC_RULE_EVALUATIONS, evaluated);
+
+    // A plug is left alone until its zone has something to decide on; a command the bus could not take is
+    // published again on the next pass
+    publish_failed = false;
+    for (int a = 0; a < SHELLY_PLUG_COUNT; a++) {
+        if (!readings_valid[a]) continue;
+        bool on = (rules_on & table.actuator_rules[a]) != 0;
+        if (on != outputs[a] || !(outputs_sent & (1u << a))) {
+            DLOGI(TAG, "⚙️ Rules switch the %s %s", shelly_plug_name(a), on ? "ON" : "OFF");
+            outputs[a] = on;
+            bus_msg_t *msg = bus_alloc(BUS_TOPIC_ACTUATOR);
+            if (msg) {
+                msg->actuator.plug = a;
+                msg->actuator.on = on;
+            }
+            if (msg && bus_publish(msg) != 0) {
+                outputs_sent |= 1u << a;
+            } else {
+                outputs_sent &= ~(1u << a);
+                publish_failed = true;
+            }
+        }
+    }
+}
+
+
+esp_err_t rules_set_json(const char *json, char *error, size_t error_len) {
+    size_t len = strlen(json);
+    if (len >= RULES_JSON_MAX) {
+        snprintf(error, error_len, "rule set larger than %d bytes", RULES_JSON_MAX - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!rules_mutex) {
+        snprintf(error, error_len, "rule engine not started");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(rules_mutex, portMAX_DELAY);
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (rules_compile(json, &compiled, error, error_len)) {
+        nvs_handle_t nvs;
+        err = nvs_open(RULES_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+        if (err == ESP_OK) {
+            err = nvs_set_blob(nvs, RULES_NVS_KEY, json, len);
+            if (err == ESP_OK) err = nvs_commit(nvs);
+            nvs_close(nvs);
+        }
+        if (err == ESP_OK) {
+            memcpy(&pending, &compiled, sizeof(pending));
+            memcpy(source, json, len + 1);
+            pending_valid = true;
+            ESP_LOGI(TAG, "📜 Installed %u rules", (unsigned)pending.count);
+        } else {
+            snprintf(error, error_len, "NVS write failed: %s", esp_err_to_name(err));
+        }
+    }
+    xSemaphoreGive(rules_mutex);
+    return err;
+}
+
+
+size_t rules_get_json(char *buffer, size_t len) {
+    xSemaphoreTake(rules_mutex, portMAX_DELAY);
+    size_t n = strlen(source);
+    if (n >= len) n = len - 1;
+    memcpy(buffer, source, n);
+    buffer[n] = '\0';
+    xSemaphoreGive(rules_mutex);
+    return n;
+}
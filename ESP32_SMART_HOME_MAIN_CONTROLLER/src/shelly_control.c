@@ -0,0 +1,305 @@
+/**
+ * @file shelly_control.c
+ * @brief This file contains the implementation of the Shelly plug actuator for the ESP32 Smart Home Main Controller project.
+ *
+ * The functions provided in this file allow for switching Shelly plugs without blocking the publisher of the commands.
+ * Every plug has a worker task subscribed to BUS_TOPIC_ACTUATOR and a persistent keep-alive HTTP client, so the plugs
+ * are switched concurrently and the connection setup is paid once instead of for every command. Every request is a
+ * POST of a constant JSON-RPC body to the plug's /rpc endpoint, so the client keeps the URL it was created with and
+ * the controller formats nothing per request; esp_http_client still allocates its header strings on every request.
+ *
+ * Each plug also caches the last commanded and the last confirmed state. A worker only acts on the latest of the
+ * commands queued for its plug, and only if it changes the commanded state, so steady-state telemetry causes no Shelly
+ * traffic at all. When a worker has been idle for a while it polls Switch.GetStatus and re-asserts the commanded state
+ * if the plug drifted, for example because it was toggled by hand. A command the plug did not confirm stays pending
+ * and is sent again every SHELLY_RETRY_MS until it goes through, since the rules only publish output changes.
+ *
+ * The main functionalities provided by this file include:
+ * - Starting one actuator worker task per plug, subscribed to the switch commands on the bus.
+ * - Acting on state transitions only, and only on the latest command per plug.
+ * - Sending Switch.Set requests over a reused connection and reconnecting after errors.
+ * - Retrying unconfirmed commands and periodically reconciling the commanded state with the state reported by the plug.
+ *
+ * Dependencies:
+ * - freertos/FreeRTOS.h: FreeRTOS functions.
+ * - freertos/task.h: FreeRTOS task functions.
+ * - freertos/queue.h: FreeRTOS queue functions.
+ * - esp_http_client.h: ESP32 HTTP client functions.
+ * - esp_log.h: ESP32 logging functions.
+ * - shelly_control.h: Shelly device control declarations.
+ * - bus.h: Switch command subscription.
+ * - metrics.h: Request counters, latency histogram and stack registration.
+ * - esp_timer.h: Microsecond timestamps.
+ * - trace.h: Cycle-counter trace points.
+ * - dlog.h: Deferred logging for the per-request messages.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "shelly_control.h"
+#include "bus.h"
+#include "metrics.h"
+#include "trace.h"
+#include "dlog.h"
+
+static const char *TAG = "SHELLY";
+
+#define SHELLY_TASK_STACK 4096
+#define SHELLY_TASK_PRIORITY 4       ///< Below the TCP server, so ingest always wins.
+#define SHELLY_TIMEOUT_MS 3000
+#define SHELLY_ATTEMPTS 2            ///< A stale keep-alive connection fails once, then reconnects.
+#define SHELLY_RECONCILE_MS 60000    ///< Idle time after which the plug state is polled.
+#define SHELLY_RETRY_MS 10000        ///< Time after which a command the plug did not confirm is sent again.
+
+// JSON-RPC bodies posted to http://<plug>/rpc
+#define SHELLY_RPC_ON "{\"id\":1,\"method\":\"Switch.Set\",\"params\":{\"id\":0,\"on\":true}}"
+#define SHELLY_RPC_OFF "{\"id\":1,\"method\":\"Switch.Set\",\"params\":{\"id\":0,\"on\":false}}"
+#define SHELLY_RPC_STATUS "{\"id\":1,\"method\":\"Switch.GetStatus\",\"params\":{\"id\":0}}"
+#define SHELLY_RESPONSE_SIZE 256
+#define SHELLY_QUEUE_LEN 4           ///< Switch commands a worker can fall behind.
+
+const char* heaterIP = "192.168.10.199";
+const char* humidifierIP = "192.168.10.201";
+
+/**
+ * @brief Worker state of one plug.
+ */
+typedef struct {
+    shelly_plug_t plug;
+    const char *name;
+    const char **ip;
+    QueueHandle_t commands;             ///< Subscription to BUS_TOPIC_ACTUATOR.
+    esp_http_client_handle_t client;    ///< Keep-alive client reused for every request to this plug.
+    portMUX_TYPE lock;                  ///< Protects the cached states below.
+    bool commanded;                     ///< Last state commanded on the bus.
+    bool commanded_valid;               ///< False until the first command.
+    bool pending;                       ///< The commanded state was not confirmed by the plug yet; retried.
+    bool confirmed;                     ///< Last state reported by the plug.
+    bool confirmed_valid;               ///< False until the plug answered at least once.
+    char response[SHELLY_RESPONSE_SIZE];
+    int response_len;
+    StaticTask_t task_buffer;
+    StackType_t task_stack[SHELLY_TASK_STACK];
+} shelly_worker_t;
+
+static shelly_worker_t workers[SHELLY_PLUG_COUNT] = {
+    [SHELLY_HEATER] = {
+        .plug = SHELLY_HEATER, .name = "heater", .ip = &heaterIP, .lock = portMUX_INITIALIZER_UNLOCKED,
+    },
+    [SHELLY_DEHUMIDIFIER] = {
+        .plug = SHELLY_DEHUMIDIFIER, .name = "dehumidifier", .ip = &humidifierIP, .lock = portMUX_INITIALIZER_UNLOCKED,
+    },
+};
+
+
+static esp_err_t shelly_http_event(esp_http_client_event_t *evt) {
+    shelly_worker_t *worker = evt->user_data;
+
+    if (evt->event_id == HTTP_EVENT_ON_DATA) {
+        int space = (int)sizeof(worker->response) - 1 - worker->response_len;
+        int len = evt->data_len < space ? evt->data_len : space;
+        memcpy(worker->response + worker->response_len, evt->data, len);
+        worker->response_len += len;
+        worker->response[worker->response_len] = '\0';
+    }
+    return ESP_OK;
+}
+
+
+static bool shelly_request(shelly_worker_t *worker, const char *rpc) {
+    for (int attempt = 1; attempt <= SHELLY_ATTEMPTS; attempt++) {
+        worker->response_len = 0;
+        worker->response[0] = '\0';
+
+        esp_http_client_set_post_field(worker->client, rpc, strlen(rpc));
+        int64_t start = esp_timer_get_time();
+        TRACE_BEGIN(TRACE_SHELLY);
+        esp_err_t err = esp_http_client_perform(worker->client);
+        TRACE_END(TRACE_SHELLY);
+        metrics_inc(METRIC_SHELLY_REQUESTS);
+        metrics_observe(METRIC_SHELLY_LATENCY_MS, (uint32_t)((esp_timer_get_time() - start) / 1000));
+        if (err == ESP_OK) {
+            int status = esp_http_client_get_status_code(worker->client);
+            if (status == 200) {
+                return true;
+            }
+            DLOGE(TAG, "❌ %s answered HTTP %d", worker->name, status);
+            metrics_inc(METRIC_SHELLY_FAILURES);
+            return false;
+        }
+        metrics_inc(METRIC_SHELLY_FAILURES);
+
+        // Drop the connection so the next attempt opens a fresh one
+        esp_http_client_close(worker->client);
+        DLOGW(TAG, "⚠️ %s request failed (%s), attempt %d/%d",
+                 worker->name, esp_err_to_name(err), attempt, SHELLY_ATTEMPTS);
+    }
+    return false;
+}
+
+
+static void shelly_switch(shelly_worker_t *worker, bool turnOn) {
+    bool ok = shelly_request(worker, turnOn ? SHELLY_RPC_ON : SHELLY_RPC_OFF);
+
+    portENTER_CRITICAL(&worker->lock);
+    if (ok) {
+        worker->confirmed = turnOn;
+        worker->confirmed_valid = true;
+    }
+    if (worker->commanded == turnOn) {
+        // Keep the command and retry it; the rules will not publish it again
+        worker->pending = !ok;
+    }
+    portEXIT_CRITICAL(&worker->lock);
+
+    if (ok) {
+        DLOGI(TAG, "✅ %s switched %s", worker->name, turnOn ? "ON" : "OFF");
+    }
+}
+
+
+static void shelly_reconcile(shelly_worker_t *worker) {
+    if (!shelly_request(worker, SHELLY_RPC_STATUS)) {
+        return;
+    }
+
+    const char *output = strstr(worker->response, "\"output\":");
+    if (!output) {
+        ESP_LOGE(TAG, "❌ Unexpected %s status: %s", worker->name, worker->response);
+        return;
+    }
+    bool on = strncmp(output + 9, "true", 4) == 0;
+
+    portENTER_CRITICAL(&worker->lock);
+    bool commanded = worker->commanded;
+    bool drifted = worker->commanded_valid && commanded != on;
+    worker->confirmed = on;
+    worker->confirmed_valid = true;
+    portEXIT_CRITICAL(&worker->lock);
+
+    if (drifted) {
+        DLOGW(TAG, "⚠️ %s is %s but was commanded %s, switching back",
+                 worker->name, on ? "ON" : "OFF", commanded ? "ON" : "OFF");
+        shelly_switch(worker, commanded);
+    }
+}
+
+
+/**
+ * Takes every queued command and returns the latest one for this worker's plug.
+ */
+static bool shelly_latest_command(shelly_worker_t *worker, const bus_msg_t *msg, bool *turnOn) {
+    bool found = false;
+    do {
+        if (msg->actuator.plug == worker->plug) {
+            *turnOn = msg->actuator.on;
+            found = true;
+        }
+        bus_release(msg);
+    } while (xQueueReceive(worker->commands, &msg, 0) == pdTRUE);
+    return found;
+}
+
+
+static void shelly_worker_task(void *pvParameters) {
+    shelly_worker_t *worker = pvParameters;
+    const bus_msg_t *msg;
+    bool turnOn;
+
+    while (1) {
+        portENTER_CRITICAL(&worker->lock);
+        bool pending = worker->pending;
+        bool commanded = worker->commanded;
+        portEXIT_CRITICAL(&worker->lock);
+
+        TickType_t wait = pdMS_TO_TICKS(pending ? SHELLY_RETRY_MS : SHELLY_RECONCILE_MS);
+        if (xQueueReceive(worker->commands, &msg, wait) != pdTRUE) {
+            if (pending) {
+                DLOGW(TAG, "⚠️ Retrying %s switch %s", worker->name, commanded ? "ON" : "OFF");
+                shelly_switch(worker, commanded);
+            } else {
+                shelly_reconcile(worker);
+            }
+            continue;
+        }
+        if (!shelly_latest_command(worker, msg, &turnOn)) {
+            continue;
+        }
+
+        portENTER_CRITICAL(&worker->lock);
+        bool changed = !worker->commanded_valid || worker->commanded != turnOn || worker->pending;
+        worker->commanded = turnOn;
+        worker->commanded_valid = true;
+        portEXIT_CRITICAL(&worker->lock);
+
+        if (changed) {
+            shelly_switch(worker, turnOn);
+        }
+    }
+}
+
+
+void shelly_control_start(void) {
+    for (int i = 0; i < SHELLY_PLUG_COUNT; i++) {
+        shelly_worker_t *worker = &workers[i];
+        char url[64];
+        snprintf(url, sizeof(url), "http://%s/rpc", *worker->ip);
+
+        esp_http_client_config_t config = {
+            .url = url,
+            .method = HTTP_METHOD_POST,
+            .timeout_ms = SHELLY_TIMEOUT_MS,
+            .keep_alive_enable = true,
+            .event_handler = shelly_http_event,
+            .user_data = worker,
+        };
+        worker->client = esp_http_client_init(&config);
+        if (worker->client) {
+            esp_http_client_set_header(worker->client, "Content-Type", "application/json");
+        }
+        // Subscribe only a worker that will run, so the rule engine never waits for one that does not drain its queue
+        if (worker->client) {
+            worker->commands = bus_subscribe(BUS_TOPIC_ACTUATOR, worker->name, SHELLY_QUEUE_LEN);
+        }
+        if (!worker->client || !worker->commands) {
+            ESP_LOGE(TAG, "❌ Unable to set up the %s worker", worker->name);
+            continue;
+        }
+
+        char task_name[16];
+        snprintf(task_name, sizeof(task_name), "shelly_%d", i);
+        TaskHandle_t task = xTaskCreateStatic(shelly_worker_task, task_name, SHELLY_TASK_STACK, worker,
+                                              SHELLY_TASK_PRIORITY, worker->task_stack, &worker->task_buffer);
+        if (!task) {
+            ESP_LOGE(TAG, "❌ Unable to start the %s worker", worker->name);
+        }
+        metrics_register_task(task, SHELLY_TASK_STACK);
+    }
+}
+
+
+bool shelly_get_state(shelly_plug_t plug, bool *on) {
+    if (plug >= SHELLY_PLUG_COUNT) {
+        return false;
+    }
+    shelly_worker_t *worker = &workers[plug];
+
+    portENTER_CRITICAL(&worker->lock);
+    bool valid = worker->confirmed_valid;
+    *on = worker->confirmed;
+    portEXIT_CRITICAL(&worker->lock);
+    return valid;
+}
+
+
+const char *shelly_plug_name(shelly_plug_t plug) {
+    return plug < SHELLY_PLUG_COUNT ? workers[plug].name : NULL;
+}
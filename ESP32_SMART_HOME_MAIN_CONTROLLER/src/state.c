@@ -0,0 +1,80 @@
+/**
+ * @file state.c
+ * @brief This file contains the implementation of the shared controller state for the ESP32 Smart Home Main Controller project.
+ *
+ * The state is protected by a sequence counter that is odd while a write is in progress. Writers take a spinlock
+ * critical section, which also keeps them from being preempted halfway, and bump the counter before and after
+ * copying the new state in. Readers copy the state between two reads of the counter and retry if it was odd or
+ * changed, so a reader on the other core spins for at most the duration of one small copy.
+ *
+ * The main functionalities provided by this file include:
+ * - Taking consistent, lock-free snapshots of the state.
+ * - Applying modifications atomically and bumping the version only on real changes.
+ *
+ * Dependencies:
+ * - state.h: State type and function declarations.
+ * - freertos/FreeRTOS.h: Spinlock critical sections.
+ * - string.h: String manipulation functions.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include "state.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static controller_state_t state = {
+    .sp_temperature = 2500,     // Default setpoint temperature: 25.00°C.
+    .sp_humidity = 5000,        // Default setpoint humidity: 50.00%RH.
+};
+static uint32_t sequence = 0;   ///< Odd while a write is in progress; version is sequence / 2.
+static portMUX_TYPE writer_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+uint32_t state_read(controller_state_t *out) {
+    uint32_t begin, end;
+    do {
+        begin = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE);
+        memcpy(out, &state, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        end = __atomic_load_n(&sequence, __ATOMIC_RELAXED);
+    } while ((begin & 1) || begin != end);
+    return begin >> 1;
+}
+
+
+uint32_t state_version(void) {
+    return __atomic_load_n(&sequence, __ATOMIC_ACQUIRE) >> 1;
+}
+
+
+bool state_update(state_update_fn fn, const void *arg) {
+    controller_state_t next;
+    bool changed;
+
+    portENTER_CRITICAL(&writer_lock);
+    memcpy(&next, &state, sizeof(next));
+    fn(&next, arg);
+    changed = memcmp(&next, &state, sizeof(next)) != 0;
+    if (changed) {
+        __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memcpy(&state, &next, sizeof(state));
+        __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELEASE);
+    }
+    portEXIT_CRITICAL(&writer_lock);
+    return changed;
+}
+
+
+static void set_setpoints(controller_state_t *state, const void *arg) {
+    const int16_t *setpoints = arg;
+    state->sp_temperature = setpoints[0];
+    state->sp_humidity = setpoints[1];
+}
+
+
+bool state_set_setpoints(int16_t sp_temperature, int16_t sp_humidity) {
+    const int16_t setpoints[2] = { sp_temperature, sp_humidity };
+    return state_update(set_setpoints, setpoints);
+}
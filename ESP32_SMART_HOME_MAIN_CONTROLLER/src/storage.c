@@ -0,0 +1,176 @@
+/**
+ * @file storage.c
+ * @brief This file contains the implementation of the sample storage task for the ESP32 Smart Home Main Controller project.
+ *
+ * The functions provided in this file allow for persisting the samples published on the bus without involving the
+ * task that received them. The telemetry log is written only by the storage task and read by the uplink, so a mutex
+ * guards it against the two; the history has its own lock.
+ *
+ * The main functionalities provided by this file include:
+ * - Mounting the telemetry log and restoring the newest sample at startup.
+ * - Recording published samples in the history and appending them to the log.
+ * - Writing a partial batch once it is old enough, even when no further sample arrives.
+ * - Notifying the uplink whenever the log flushed.
+ * - Reading flushed log records for the uplink.
+ *
+ * Dependencies:
+ * - storage.h: Storage task declarations.
+ * - bus.h: Sample topic subscription.
+ * - telemetry_store.h: Log-structured telemetry persistence on flash.
+ * - history.h: In-RAM time-series history and its clock.
+ * - json_parser.h: Applying the restored sample to the controller state.
+ * - uplink.h: Store-and-forward uplink, told about every flush of the log.
+ * - freertos/semphr.h: FreeRTOS mutex functions.
+ * - esp_log.h: ESP32 logging functions.
+ * - metrics.h: Stack registration.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "storage.h"
+#include "bus.h"
+#include "history.h"
+#include "json_parser.h"
+#include "uplink.h"
+#include "metrics.h"
+
+static const char *TAG = "STORAGE";
+
+#define STORAGE_TASK_STACK 4096
+#define STORAGE_TASK_PRIORITY 4         ///< Below the TCP server, so ingest always wins.
+
+static telemetry_store_flash_t store_flash;         ///< Flash backend of the telemetry log.
+static telemetry_store_t store;                     ///< Telemetry log; written by the storage task, read by the uplink.
+static StaticSemaphore_t store_lock_buffer;
+static SemaphoreHandle_t store_lock = NULL;         ///< Guards the store against concurrent reads.
+static bool store_ready = false;
+static QueueHandle_t samples = NULL;                ///< Subscription to BUS_TOPIC_SAMPLE.
+static StackType_t task_stack[STORAGE_TASK_STACK];
+static StaticTask_t task_buffer;
+
+
+static void store_restore(void) {
+    if (telemetry_store_partition_init(&store_flash) != ESP_OK ||
+        telemetry_store_mount(&store, &store_flash) != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Telemetry log unavailable, samples will not be persisted");
+        return;
+    }
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    store_ready = true;
+    xSemaphoreGive(store_lock);
+
+    // Show the last known readings until the first station reports
+    telemetry_record_t last;
+    if (telemetry_store_last(&store, &last)) {
+        telemetry_t telemetry = {
+            .temperature = last.temperature,
+            .humidity = last.humidity,
+            .lux = last.lux,
+            .heater = (last.flags & TELEMETRY_RECORD_HEATER) != 0,
+            .dehumidifier = (last.flags & TELEMETRY_RECORD_DEHUMIDIFIER) != 0,
+            .fields = TELEMETRY_REQUIRED,
+        };
+        apply_telemetry(&telemetry);
+        ESP_LOGI(TAG, "📀 Restored last sample from boot %u", last.boot);
+    }
+}
+
+
+static void store_sample(const bus_sample_t *sample) {
+    const telemetry_t *telemetry = &sample->telemetry;
+    history_add(telemetry->temperature, telemetry->humidity, telemetry->lux);
+    if (!store_ready) {
+        return;
+    }
+
+    telemetry_record_t record = {
+        .uptime = sample->uptime,
+        .temperature = telemetry->temperature,
+        .humidity = telemetry->humidity,
+        .lux = telemetry->lux,
+        .flags = (telemetry->heater ? TELEMETRY_RECORD_HEATER : 0) |
+                 (telemetry->dehumidifier ? TELEMETRY_RECORD_DEHUMIDIFIER : 0),
+    };
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    uint32_t flushes = store.stats.flushes;
+    telemetry_store_append(&store, &record);
+    bool flushed = store.stats.flushes != flushes;
+    xSemaphoreGive(store_lock);
+    if (flushed) {
+        uplink_notify();
+    }
+}
+
+
+/**
+ * Writes the partial batch once its oldest record is TELEMETRY_STORE_FLUSH_AFTER_S old. The storage task is the
+ * only writer, so it may look at the batch without the lock.
+ */
+static TickType_t store_flush_aged(void) {
+    uint32_t due = store_ready ? telemetry_store_flush_due(&store) : UINT32_MAX;
+    if (due == UINT32_MAX) {
+        return portMAX_DELAY;
+    }
+    uint32_t now = history_now();
+    if (now < due) {
+        return pdMS_TO_TICKS((due - now) * 1000);
+    }
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    telemetry_store_flush(&store);
+    xSemaphoreGive(store_lock);
+    uplink_notify();
+    return portMAX_DELAY;
+}
+
+
+static void storage_task(void *pvParameters) {
+    const bus_msg_t *msg;
+    TickType_t wait = portMAX_DELAY;
+
+    while (1) {
+        if (xQueueReceive(samples, &msg, wait) != pdTRUE) {
+            wait = store_flush_aged();
+            continue;
+        }
+
+        // Only the zone owning the controller state is kept; the registry holds the latest reading of the others
+        if (msg->sample.owner) {
+            store_sample(&msg->sample);
+        }
+        bus_release(msg);
+        wait = store_flush_aged();
+    }
+}
+
+
+void storage_start(void) {
+    store_lock = xSemaphoreCreateMutexStatic(&store_lock_buffer);
+    store_restore();
+
+    samples = bus_subscribe(BUS_TOPIC_SAMPLE, "storage", STORAGE_QUEUE_LEN);
+    TaskHandle_t task = NULL;
+    if (samples) {
+        task = xTaskCreateStatic(storage_task, "storage", STORAGE_TASK_STACK, NULL, STORAGE_TASK_PRIORITY,
+                                 task_stack, &task_buffer);
+    }
+    if (!task) {
+        ESP_LOGE(TAG, "❌ Unable to start the storage task, samples will not be recorded");
+    }
+    metrics_register_task(task, STORAGE_TASK_STACK);
+}
+
+
+size_t telemetry_log_read(uint64_t *cursor, telemetry_record_t *out, size_t max) {
+    if (!store_lock) return 0;
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    size_t count = store_ready ? telemetry_store_read(&store, cursor, out, max) : 0;
+    xSemaphoreGive(store_lock);
+    return count;
+}
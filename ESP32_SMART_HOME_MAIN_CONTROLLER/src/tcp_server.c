@@ -3,181 +3,647 @@
  * @brief This file contains the implementation of the TCP server and related functions for the ESP32 module.
  *
  * The functions provided in this file allow for initializing and running a TCP server, handling incoming TCP connections,
- * sending and receiving TCP messages, and controlling devices such as the heater and humidifier via HTTP requests.
+ * sending and receiving TCP messages, and queueing commands for devices such as the heater and humidifier.
  *
  * The main functionalities provided by this file include:
  * - Initializing and running a TCP server.
- * - Handling incoming TCP connections and messages.
+ * - Multiplexing many station connections from a single select() event loop.
+ * - Splitting each station's byte stream into complete messages with a per-connection ring-buffer framer.
+ * - Handling incoming TCP connections and messages, as JSON lines or negotiated binary frames.
+ * - Tracking each connection's handshake state and closing connections that miss the handshake deadline.
+ * - Resuming a reconnecting station's session from the token in its first data frame.
+ * - Publishing every accepted reading on the bus for the storage task and any other subscriber.
  * - Sending and receiving TCP messages.
- * - Controlling devices via HTTP requests.
+ * - Recording every reading in the station registry; readings of the station owning the controller state also update it.
+ * - Delivering the setpoints published on the bus to their station and matching the acknowledgments by request ID.
+ * - Running the automation rules, which switch the Shelly plugs, after every pass of the event loop.
  *
  * Dependencies:
  * - esp_log.h: ESP32 logging functions.
- * - esp_http_client.h: ESP32 HTTP client functions.
- * - cJSON.h: JSON parsing library.
  * - wifi.h: Wi-Fi initialization and event handling functions.
  * - json_parser.h: JSON parsing helper functions.
+ * - telemetry_frame.h: Binary telemetry frame decoder.
  * - globals.h: Global variables and definitions.
  * - handshake.h: Handshake functions.
+ * - http_server.h: Dashboard push notification.
+ * - history.h: Sample timestamps.
+ * - bus.h: Publish/subscribe bus for samples and setpoints.
+ * - framer.h: Ring-buffer message framer.
  * - tcp_server.h: TCP server function declarations.
- * - shelly_control.h: Shelly device control functions.
+ * - rules.h: Automation rule engine.
+ * - registry.h: Station registry.
+ * - metrics.h: Runtime counters, latency histograms and stack registration.
+ * - trace.h: Cycle-counter trace points.
+ * - dlog.h: Deferred logging for the per-message log lines.
+ * - sdkconfig.h: lwIP connection limits.
  *
  * @note This file is part of the ESP32 Smart Home Main Controller project.
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <sys/select.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <errno.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
-#include "cJSON.h"
 #include "wifi.h"
 #include "json_parser.h"
+#include "telemetry_frame.h"
 #include "globals.h"
 #include "handshake.h"
+#include "http_server.h"
+#include "history.h"
+#include "bus.h"
 #include "tcp_server.h"
-#include "esp_http_client.h"
-#include "shelly_control.h"
+#include "rules.h"
+#include "registry.h"
+#include "metrics.h"
+#include "trace.h"
+#include "dlog.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
 
-#define PORT 8080
 static const char *TAG = "TCP_SERVER";
 
-const char* heaterIP = "192.168.10.199";
-const char* humidifierIP = "192.168.10.201";
+// Every station connection is an active lwIP PCB next to 12 HTTP sockets and 2 keep-alive clients each for the plugs and the uplink
+#if defined(CONFIG_LWIP_MAX_ACTIVE_TCP) && CONFIG_LWIP_MAX_ACTIVE_TCP < TCP_MAX_STATIONS + 16
+#error "CONFIG_LWIP_MAX_ACTIVE_TCP is too small for TCP_MAX_STATIONS station connections"
+#endif
 
+static station_conn_t stations[TCP_MAX_STATIONS];   ///< Connection slots, one per station.
+static char frame_scratch[FRAMER_CAPACITY];         ///< Linear copy of a message that wraps around a ring.
 
-void sanitize_input(char *input) {
-    size_t len = strlen(input);
-    while (len > 0 && (input[len - 1] == '\n' || input[len - 1] == '\r' || input[len - 1] == '}')) {
-        input[--len] = '\0'; 
+#define TCP_TASK_STACK 4096
+#define TCP_TASK_PRIORITY 5                 ///< Above every other controller task: ingest always wins.
+
+static StackType_t task_stack[TCP_TASK_STACK];
+static StaticTask_t task_buffer;
+
+#define TCP_COMMAND_QUEUE_LEN 8             ///< Setpoints waiting for the TCP task, and commands awaiting an ACK.
+#define TCP_COMMAND_POLL_MS 50              ///< Longest time a queued command waits for the select() loop.
+#define TCP_COMMAND_ACK_TIMEOUT_MS 3000     ///< Time the station gets to acknowledge before a resend.
+#define TCP_COMMAND_MAX_ATTEMPTS 3          ///< Sends per command before it is given up.
+
+// A station resuming its session must still find the setpoints sent while it was away
+_Static_assert(TCP_COMMAND_HOLD_MS >= HANDSHAKE_SESSION_TTL_MS, "held commands must outlive a resumable session");
+
+/**
+ * @brief Station command made from a BUS_TOPIC_SETPOINT message.
+ */
+typedef struct {
+    uint32_t id;            ///< Request ID echoed by the station in its acknowledgment; the message ID.
+    int station;            ///< Registry slot of the station, or -1 for the station behind client_sock.
+    QueueHandle_t ack_queue; ///< Queue sent the ID once acknowledged, or NULL.
+    char message[48];       ///< Message to send, including the trailing newline.
+} tcp_command_t;
+
+/**
+ * @brief Command sent to a station and awaiting its acknowledgment. Only touched by the TCP server task.
+ */
+typedef struct {
+    tcp_command_t command;
+    bool used;              ///< The slot holds a command.
+    int sock;               ///< Connection the command was sent to, or -1 while it waits for its station.
+    int attempts;           ///< Number of times the command was sent.
+    TickType_t deadline;    ///< Tick count at which the command is resent or given up.
+    int64_t first_sent_at;  ///< esp_timer time of the first send, in microseconds.
+} pending_command_t;
+
+static QueueHandle_t setpoint_queue = NULL;            ///< Subscription to BUS_TOPIC_SETPOINT.
+static pending_command_t pending[TCP_COMMAND_QUEUE_LEN];
+
+static bool send_all(int sock, const char *message, size_t *sent) {
+    size_t total = strlen(message);
+    *sent = 0;
+
+    while (*sent < total) {
+        int written = send(sock, message + *sent, total - *sent, 0);
+        if (written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                DLOGW(TAG, "⚠️ Socket %d not draining, message dropped", sock);
+            } else {
+                DLOGE(TAG, "❌ Send failed: errno %d", errno);
+            }
+            return false;
+        }
+        *sent += written;
     }
+    return true;
 }
 
 
-void send_http_request(const char* deviceIP, bool turnOn) {
-    char url[128];
-    snprintf(url, sizeof(url), "http://%s/rpc/Switch.Set?id=0&on=%s", deviceIP, turnOn ? "true" : "false");
+bool send_station_message(station_conn_t *conn, const char *message) {
+    if (conn->sock < 0 || conn->send_broken) return false;
+    size_t sent;
+    if (send_all(conn->sock, message, &sent)) {
+        return true;
+    }
+    if (sent > 0) {
+        // The next message would be glued to the cut-off line; the station resumes its session on a new connection
+        DLOGW(TAG, "⚠️ Message cut off after %u bytes on socket %d, closing", (unsigned)sent, conn->sock);
+        conn->send_broken = true;
+    }
+    return false;
+}
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .timeout_ms = 5000,
-    };
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    esp_err_t err = esp_http_client_perform(client);
-    esp_http_client_cleanup(client);
+static station_conn_t *command_target(int station) {
+    for (int i = 0; i < TCP_MAX_STATIONS; i++) {
+        if (stations[i].sock < 0) continue;
+        if (station < 0 ? stations[i].sock == client_sock
+                        : stations[i].state == STATION_READY && stations[i].station == station) {
+            return &stations[i];
+        }
+    }
+    return NULL;
+}
+
 
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "✅ HTTP GET successful: %s", url);
+/**
+ * Parks a command until its station is connected, for at most TCP_COMMAND_HOLD_MS.
+ */
+static void command_hold(pending_command_t *slot) {
+    slot->sock = -1;
+    slot->deadline = xTaskGetTickCount() + pdMS_TO_TICKS(TCP_COMMAND_HOLD_MS);
+}
+
+
+static void command_send(pending_command_t *slot, station_conn_t *conn) {
+    slot->sock = conn->sock;
+    slot->attempts++;
+    slot->deadline = xTaskGetTickCount() + pdMS_TO_TICKS(TCP_COMMAND_ACK_TIMEOUT_MS);
+    DLOGI(TAG, "📤 Sending command %lu to socket %d (attempt %d/%d)",
+             (unsigned long)slot->command.id, conn->sock, slot->attempts, TCP_COMMAND_MAX_ATTEMPTS);
+    send_station_message(conn, slot->command.message);
+}
+
+
+static void command_complete(pending_command_t *slot) {
+    metrics_observe(METRIC_SETPOINT_RTT_MS, (uint32_t)((esp_timer_get_time() - slot->first_sent_at) / 1000));
+    DLOGI(TAG, "✅ Command %lu acknowledged by socket %d", (unsigned long)slot->command.id, slot->sock);
+    if (slot->command.ack_queue) {
+        xQueueSend(slot->command.ack_queue, &slot->command.id, 0);
+    }
+    slot->used = false;
+    slot->sock = -1;
+}
+
+
+/**
+ * Matches an acknowledgment to the command it answers. "SETPOINTS_ACK:<id>" names the command;
+ * a bare "SETPOINTS_ACK" from older station firmware answers the oldest command sent to that station.
+ */
+static void command_ack(station_conn_t *conn, const char *ack) {
+    pending_command_t *match = NULL;
+
+    if (*ack == ':') {
+        uint32_t id = strtoul(ack + 1, NULL, 10);
+        for (int i = 0; i < TCP_COMMAND_QUEUE_LEN; i++) {
+            if (pending[i].sock == conn->sock && pending[i].command.id == id) {
+                match = &pending[i];
+                break;
+            }
+        }
     } else {
-        ESP_LOGE(TAG, "❌ HTTP GET failed: %s", esp_err_to_name(err));
+        for (int i = 0; i < TCP_COMMAND_QUEUE_LEN; i++) {
+            if (pending[i].sock == conn->sock &&
+                (!match || (int32_t)(pending[i].command.id - match->command.id) < 0)) {
+                match = &pending[i];
+            }
+        }
+    }
+
+    if (match) {
+        command_complete(match);
+    } else {
+        ESP_LOGW(TAG, "⚠️ Unmatched acknowledgment 'SETPOINTS_ACK%s' on socket %d", ack, conn->sock);
+    }
+}
+
+
+/**
+ * Drops the commands still waiting for @p station; setpoints are absolute, so a newer command replaces them. This
+ * also keeps a station that stays away from filling the table with held commands.
+ */
+static void commands_supersede(int station) {
+    for (int i = 0; i < TCP_COMMAND_QUEUE_LEN; i++) {
+        if (station >= 0 && pending[i].used && pending[i].sock < 0 && pending[i].command.station == station) {
+            DLOGI(TAG, "📥 Command %lu replaced by newer setpoints", (unsigned long)pending[i].command.id);
+            pending[i].used = false;
+        }
     }
 }
 
 
-void send_tcp_message(const char *message) {
-    if (client_sock < 0) return;
+static void commands_poll(void) {
+    TickType_t now = xTaskGetTickCount();
 
-    int to_write = strlen(message);
-    while (to_write > 0) {
-        int written = send(client_sock, message + (strlen(message) - to_write), to_write, 0);
-        if (written < 0) {
-            ESP_LOGE(TAG, "❌ Send failed: errno %d", errno);
-            return;
+    // Send waiting commands whose station is back, resend the ones not acknowledged in time, or give up on them
+    for (int i = 0; i < TCP_COMMAND_QUEUE_LEN; i++) {
+        pending_command_t *slot = &pending[i];
+        if (!slot->used) continue;
+
+        station_conn_t *target = command_target(slot->command.station);
+        if (slot->sock < 0 && target) {
+            command_send(slot, target);
+            continue;
+        }
+        if ((int32_t)(now - slot->deadline) < 0) continue;
+
+        if (slot->sock < 0) {
+            DLOGE(TAG, "❌ Command %lu expired, station did not connect", (unsigned long)slot->command.id);
+            metrics_inc(METRIC_SETPOINT_ACK_TIMEOUTS);
+            slot->used = false;
+        } else if (slot->attempts >= TCP_COMMAND_MAX_ATTEMPTS || !target) {
+            DLOGE(TAG, "❌ Command %lu not acknowledged after %d attempts",
+                     (unsigned long)slot->command.id, slot->attempts);
+            metrics_inc(METRIC_SETPOINT_ACK_TIMEOUTS);
+            slot->used = false;
+            slot->sock = -1;
+        } else {
+            command_send(slot, target);
+        }
+    }
+
+    // Take newly published setpoints while there is room to track them
+    for (int i = 0; i < TCP_COMMAND_QUEUE_LEN; i++) {
+        pending_command_t *slot = &pending[i];
+        if (slot->used) continue;
+        const bus_msg_t *msg;
+        if (!setpoint_queue || xQueueReceive(setpoint_queue, &msg, 0) != pdTRUE) break;
+
+        const bus_setpoint_t *setpoint = &msg->setpoint;
+        commands_supersede(setpoint->station);
+        slot->command.id = msg->id;
+        slot->command.station = setpoint->station;
+        slot->command.ack_queue = setpoint->ack_queue;
+        snprintf(slot->command.message, sizeof(slot->command.message), "temp=%.2f&humidity=%.2f&id=%lu\n",
+                 setpoint->sp_temperature / 100.0, setpoint->sp_humidity / 100.0, (unsigned long)msg->id);
+        bus_release(msg);
+
+        slot->used = true;
+        slot->attempts = 0;
+        slot->first_sent_at = esp_timer_get_time();
+        station_conn_t *target = command_target(slot->command.station);
+        if (target) {
+            command_send(slot, target);
+        } else {
+            command_hold(slot);
         }
-        to_write -= written;
     }
 }
 
 
-void send_tcp_message_with_ack(const char *message, bool *ackReceived) {
-    const int maxRetries = 3;
-    *ackReceived = false;
+static void commands_drop(const station_conn_t *conn) {
+    for (int i = 0; i < TCP_COMMAND_QUEUE_LEN; i++) {
+        if (!pending[i].used || pending[i].sock != conn->sock) continue;
+
+        // A station that can resume its session, or another connection of its station, gets the command again
+        if (conn->session_token || pending[i].command.station >= 0) {
+            DLOGI(TAG, "📥 Command %lu held until the station is back", (unsigned long)pending[i].command.id);
+            command_hold(&pending[i]);
+        } else {
+            DLOGW(TAG, "⚠️ Command %lu dropped, station disconnected", (unsigned long)pending[i].command.id);
+            pending[i].used = false;
+            pending[i].sock = -1;
+        }
+    }
+}
+
+
+static void handle_telemetry(station_conn_t *conn, const telemetry_t *telemetry) {
+    TRACE_BEGIN(TRACE_TELEMETRY);
+    metrics_inc(METRIC_FRAMES_PARSED);
+    uint32_t now = history_now();
+    registry_record(conn->station, telemetry, now);
+    bool owner = conn->station >= 0 && conn->station == registry_owner();
+
+    // Publish once; storage and any other subscriber take it from here without holding up the event loop
+    bus_msg_t *msg = bus_alloc(BUS_TOPIC_SAMPLE);
+    if (msg) {
+        msg->sample.station = conn->station;
+        msg->sample.owner = owner;
+        msg->sample.uptime = now;
+        msg->sample.telemetry = *telemetry;
+        bus_publish(msg);
+    }
+
+    // The rules read every zone from the registry; only the owner's zone drives the controller state
+    if (!owner) {
+        DLOGI(TAG, "📇 Reading of station in slot %d recorded", conn->station);
+        TRACE_END(TRACE_TELEMETRY);
+        return;
+    }
+
+    if (apply_telemetry(telemetry)) {
+        http_server_notify_update();
+    }
+
+    // Deferred records carry machine words only, so the centi-units are split instead of printed with %f
+    int temperature = telemetry->temperature < 0 ? -telemetry->temperature : telemetry->temperature;
+    DLOGI(TAG, "🌡 Temp: %s%d.%02d°C, 💧 Humidity: %d.%02d%%, ☀️ Lux: %u, 🔥 Heater: %s, ❄️ Dehumidifier: %s",
+          telemetry->temperature < 0 ? "-" : "", temperature / 100, temperature % 100,
+          telemetry->humidity / 100, telemetry->humidity % 100, telemetry->lux,
+          telemetry->heater ? "ON" : "OFF",
+          telemetry->dehumidifier ? "ON" : "OFF");
+    TRACE_END(TRACE_TELEMETRY);
+}
+
+
+bool handle_received_data(station_conn_t *conn, const char* data, size_t len) {
+    ESP_LOGD(TAG, "📥 Full JSON received: %s", data);
+
+    telemetry_t telemetry;
+    TRACE_BEGIN(TRACE_PARSE);
+    bool parsed = parse_telemetry(data, len, &telemetry);
+    TRACE_END(TRACE_PARSE);
+    if (!parsed) {
+        DLOGE(TAG, "❌ JSON parsing failed!");
+        metrics_inc(METRIC_PARSE_ERRORS);
+        return false;
+    }
+
+    if ((telemetry.fields & TELEMETRY_REQUIRED) != TELEMETRY_REQUIRED) {
+        DLOGW(TAG, "⚠️ Incomplete telemetry (fields 0x%02x), ignoring", telemetry.fields);
+        metrics_inc(METRIC_PARSE_ERRORS);
+        return false;
+    }
+
+    handle_telemetry(conn, &telemetry);
+    return true;
+}
+
+
+static bool handle_received_frame(station_conn_t *conn, const uint8_t *frame, size_t len) {
+    telemetry_t telemetry;
+    uint16_t seq;
+    TRACE_BEGIN(TRACE_PARSE);
+    bool decoded = telemetry_frame_decode(frame, len, &telemetry, &seq);
+    TRACE_END(TRACE_PARSE);
+    if (!decoded) {
+        DLOGE(TAG, "❌ Invalid binary frame (%u bytes) on socket %d", (unsigned)len, conn->sock);
+        metrics_inc(METRIC_PARSE_ERRORS);
+        return false;
+    }
+
+    if (conn->seq_valid && seq != (uint16_t)(conn->last_seq + 1)) {
+        DLOGW(TAG, "⚠️ Frame sequence jumped from %u to %u on socket %d",
+                 conn->last_seq, seq, conn->sock);
+    }
+    conn->last_seq = seq;
+    conn->seq_valid = true;
+
+    handle_telemetry(conn, &telemetry);
+    return true;
+}
+
 
-    for (int retries = 0; retries < maxRetries; retries++) {
-        send_tcp_message(message);
+static void station_close(station_conn_t *conn) {
+    ESP_LOGI(TAG, "🔌 Station on socket %d disconnected", conn->sock);
 
-        char ack_buffer[32];
-        int ack_len = recv(client_sock, ack_buffer, sizeof(ack_buffer) - 1, 0);
-        if (ack_len > 0) {
-            ack_buffer[ack_len] = '\0';
-            if (strncmp(ack_buffer, "ACK\n", 4) == 0) {
-                *ackReceived = true;
-                return;
+    if (client_sock == conn->sock) {
+        // Hand the legacy client role to another ready station, if any
+        client_sock = -1;
+        for (int i = 0; i < TCP_MAX_STATIONS; i++) {
+            if (&stations[i] != conn && stations[i].sock >= 0 && stations[i].state == STATION_READY) {
+                client_sock = stations[i].sock;
+                break;
             }
         }
-        vTaskDelay(pdMS_TO_TICKS(500));
     }
-}
 
+    commands_drop(conn);
+    handshake_suspend(conn, esp_timer_get_time());
+    if (conn->station >= 0) {
+        bool online = false;
+        for (int i = 0; i < TCP_MAX_STATIONS; i++) {
+            if (&stations[i] != conn && stations[i].sock >= 0 && stations[i].station == conn->station) {
+                online = true;
+            }
+        }
+        registry_set_online(conn->station, online);
+        conn->station = -1;
+    }
+    close(conn->sock);
+    conn->sock = -1;
+    conn->binary_frames = false;
+}
 
-void handle_received_data(const char* data) {
-    static char json_buffer[512] = {0};  
-    static size_t json_index = 0;
 
-    size_t data_len = strlen(data);
-    if (json_index + data_len >= sizeof(json_buffer)) {
-        ESP_LOGE(TAG, "⚠️ JSON buffer overflow! Resetting.");
-        json_index = 0;
+static void stations_poll(void) {
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < TCP_MAX_STATIONS; i++) {
+        if (stations[i].sock >= 0 && (stations[i].send_broken || handshake_check_deadline(&stations[i], now))) {
+            station_close(&stations[i]);
+        }
     }
+}
 
-    strncat(json_buffer, data, sizeof(json_buffer) - json_index - 1);
-    json_index += data_len;
 
-    // Check if complete JSON is received
-    if (json_buffer[0] != '{' || json_buffer[json_index - 1] != '}') {
-        ESP_LOGW(TAG, "⚠️ Waiting for full JSON...");
+static void station_accept(int listen_sock) {
+    struct sockaddr_in client_addr;
+    socklen_t addr_len = sizeof(client_addr);
+    int sock = accept(listen_sock, (struct sockaddr *)&client_addr, &addr_len);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "❌ Accept failed: errno %d", errno);
         return;
     }
 
-    ESP_LOGI(TAG, "📥 Full JSON received: %s", json_buffer);
+    station_conn_t *conn = NULL;
+    for (int i = 0; i < TCP_MAX_STATIONS; i++) {
+        if (stations[i].sock < 0) {
+            conn = &stations[i];
+            break;
+        }
+    }
+    if (!conn) {
+        ESP_LOGW(TAG, "⚠️ All %d station slots in use, rejecting connection", TCP_MAX_STATIONS);
+        size_t sent;
+        send_all(sock, "ERROR:SERVER_FULL\n", &sent);
+        close(sock);
+        return;
+    }
 
-    cJSON *json = cJSON_Parse(json_buffer);
-    if (!json) {
-        ESP_LOGE(TAG, "❌ JSON parsing failed!");
-        json_index = 0;
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+    conn->sock = sock;
+    conn->send_broken = false;
+    handshake_start(conn, esp_timer_get_time());
+    conn->first_frame_seen = false;
+    conn->seq_valid = false;
+    framer_init(&conn->rx);
+    ESP_LOGI(TAG, "✅ Client connected from %s on socket %d", inet_ntoa(client_addr.sin_addr), sock);
+}
+
+
+/**
+ * Records how long the station took from accept to its first accepted telemetry, which covers the
+ * handshake and the station's first send: the time telemetry is blank after a reconnect.
+ */
+static void station_first_frame(station_conn_t *conn) {
+    if (!conn->first_frame_seen) {
+        conn->first_frame_seen = true;
+        metrics_observe(METRIC_FIRST_FRAME_MS, (uint32_t)((esp_timer_get_time() - conn->accepted_at) / 1000));
+    }
+}
+
+
+/**
+ * Returns the telemetry payload of a "DATA:" or "DATA;tok=<token>:" message and stores the token, or 0 if
+ * the message carries none. Returns NULL for any other message.
+ */
+static const char *telemetry_payload(const char *message, uint32_t *token) {
+    *token = 0;
+    if (strncmp(message, "DATA:", 5) == 0) {
+        return message + 5;
+    }
+    if (strncmp(message, "DATA;tok=", 9) == 0) {
+        char *end;
+        *token = strtoul(message + 9, &end, 16);
+        return *end == ':' ? end + 1 : NULL;
+    }
+    return NULL;
+}
+
+
+static bool station_resume(station_conn_t *conn, uint32_t token) {
+    // The station usually reconnects before its old connection is noticed dead; that one is stale now
+    for (int i = 0; i < TCP_MAX_STATIONS; i++) {
+        if (&stations[i] != conn && stations[i].sock >= 0 && stations[i].session_token == token) {
+            station_close(&stations[i]);
+        }
+    }
+
+    if (!handshake_resume(conn, token, esp_timer_get_time())) {
+        return false;
+    }
+    client_sock = conn->sock;
+    return true;
+}
+
+
+/**
+ * Closes the other connections of a station that just completed the handshake; they are stale. Stations
+ * without an ID all share the legacy entry, so their connections are left alone.
+ */
+static void station_claim(station_conn_t *conn) {
+    bool legacy = conn->station == registry_find(REGISTRY_LEGACY_ID);
+    for (int i = 0; i < TCP_MAX_STATIONS && !legacy; i++) {
+        if (&stations[i] != conn && stations[i].sock >= 0 && stations[i].station == conn->station) {
+            station_close(&stations[i]);
+        }
+    }
+    client_sock = conn->sock;
+}
+
+
+static void station_dispatch(station_conn_t *conn, framer_frame_t *frame) {
+    if (frame->binary) {
+        if (conn->state != STATION_READY || !conn->binary_frames) {
+            DLOGW(TAG, "⚠️ Binary frame on socket %d without negotiated format, ignoring", conn->sock);
+            return;
+        }
+        if (handle_received_frame(conn, (const uint8_t *)frame->data, frame->len)) {
+            station_first_frame(conn);
+            send_station_message(conn, "ACK\n");
+        }
         return;
     }
 
-    json_index = 0;
+    uint32_t token;
+    const char *payload = telemetry_payload(frame->data, &token);
 
-    cJSON *temp = cJSON_GetObjectItem(json, "temperature");
-    cJSON *hum = cJSON_GetObjectItem(json, "humidity");
-    cJSON *lux = cJSON_GetObjectItem(json, "lux");
-    cJSON *heater = cJSON_GetObjectItem(json, "heater");
-    cJSON *dehumidifier = cJSON_GetObjectItem(json, "dehumidifier");
+    if (conn->state != STATION_READY) {
+        if (!payload || !token) {
+            if (performHandshake(conn, frame->data)) {
+                station_claim(conn);
+            }
+            return;
+        }
+        if (!station_resume(conn, token)) {
+            // The station falls back to a full handshake on this connection
+            send_station_message(conn, "ERROR:SESSION_UNKNOWN\n");
+            return;
+        }
+    }
 
-    if (cJSON_IsNumber(temp) && cJSON_IsNumber(hum) &&
-        cJSON_IsNumber(lux) && cJSON_IsBool(heater) && cJSON_IsBool(dehumidifier)) {
-        
-        temperature = temp->valuedouble;
-        humidity = hum->valuedouble;
-        lux = lux->valueint;
+    if (payload) {
+        if (handle_received_data(conn, payload, frame->len - (payload - frame->data))) {
+            station_first_frame(conn);
+        }
+        send_station_message(conn, "ACK\n");
+    } else if (strncmp(frame->data, "SETPOINTS_ACK", 13) == 0) {
+        command_ack(conn, frame->data + 13);
+    }
+}
 
-        ESP_LOGI(TAG, "🌡 Temp: %.2f°C, 💧 Humidity: %.2f%%, ☀️ Lux: %d, 🔥 Heater: %s, ❄️ Dehumidifier: %s",
-                 temperature, humidity, lux,
-                 heater->valueint ? "ON" : "OFF",
-                 dehumidifier->valueint ? "ON" : "OFF");
 
-        send_http_request(heaterIP, heater->valueint);
-        send_http_request(humidifierIP, dehumidifier->valueint);
+static void station_receive(station_conn_t *conn) {
+    size_t space;
+    char *dst = framer_write_ptr(&conn->rx, &space);
+
+    TRACE_BEGIN(TRACE_RECV);
+    int len = recv(conn->sock, dst, space, 0);
+    TRACE_END(TRACE_RECV);
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (len <= 0) {
+        station_close(conn);
+        return;
+    }
+    framer_commit(&conn->rx, len);
+
+    uint32_t overflows = conn->rx.overflows;
+    framer_frame_t frame;
+    for (;;) {
+        TRACE_BEGIN(TRACE_FRAMER);
+        bool more = framer_next(&conn->rx, frame_scratch, &frame);
+        TRACE_END(TRACE_FRAMER);
+        if (!more) break;
+
+        station_dispatch(conn, &frame);
+        if (conn->state == STATION_FAILED || conn->send_broken) {
+            station_close(conn);
+            return;
+        }
     }
 
-    cJSON_Delete(json);
+    if (conn->rx.overflows != overflows) {
+        metrics_add(METRIC_FRAMER_OVERFLOWS, conn->rx.overflows - overflows);
+        DLOGE(TAG, "⚠️ Message larger than %d bytes dropped on socket %d (%u total)",
+                 FRAMER_CAPACITY, conn->sock, (unsigned)conn->rx.overflows);
+    }
 }
 
 
-void tcp_server_task(void *pvParameters) {
+static void tcp_server_task(void *pvParameters) {
     struct sockaddr_in server_addr = {
         .sin_addr.s_addr = htonl(INADDR_ANY),
         .sin_family = AF_INET,
-        .sin_port = htons(PORT),
+        .sin_port = htons(TCP_SERVER_PORT),
     };
 
+    for (int i = 0; i < TCP_MAX_STATIONS; i++) {
+        stations[i].sock = -1;
+        stations[i].station = -1;
+    }
+    for (int i = 0; i < TCP_COMMAND_QUEUE_LEN; i++) {
+        pending[i].sock = -1;
+    }
+    setpoint_queue = bus_subscribe(BUS_TOPIC_SETPOINT, "tcp_server", TCP_COMMAND_QUEUE_LEN);
+
     int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
     if (listen_sock < 0) {
         ESP_LOGE(TAG, "❌ Unable to create socket: errno %d", errno);
@@ -185,46 +651,60 @@ void tcp_server_task(void *pvParameters) {
     }
     ESP_LOGI(TAG, "✅ Socket created");
 
+    int reuse = 1;
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
     if (bind(listen_sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) != 0) {
         ESP_LOGE(TAG, "❌ Bind failed: errno %d", errno);
         close(listen_sock);
         vTaskDelete(NULL);
     }
 
-    if (listen(listen_sock, 1) != 0) {
+    if (listen(listen_sock, 4) != 0) {
         ESP_LOGE(TAG, "❌ Listen failed: errno %d", errno);
         close(listen_sock);
         vTaskDelete(NULL);
     }
-    ESP_LOGI(TAG, "🎧 Listening on port %d", PORT);
+    ESP_LOGI(TAG, "🎧 Listening on port %d for up to %d stations", TCP_SERVER_PORT, TCP_MAX_STATIONS);
 
     while (1) {
-        struct sockaddr_in client_addr;
-        socklen_t addr_len = sizeof(client_addr);
-        client_sock = accept(listen_sock, (struct sockaddr *)&client_addr, &addr_len);
-        if (client_sock < 0) {
-            ESP_LOGE(TAG, "❌ Accept failed: errno %d", errno);
-            continue;
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(listen_sock, &read_fds);
+        int max_fd = listen_sock;
+
+        for (int i = 0; i < TCP_MAX_STATIONS; i++) {
+            if (stations[i].sock >= 0) {
+                FD_SET(stations[i].sock, &read_fds);
+                if (stations[i].sock > max_fd) max_fd = stations[i].sock;
+            }
         }
-        ESP_LOGI(TAG, "✅ Client connected");
-        performHandshake();
 
-        char rx_buffer[128];
-        while (1) {
-            int len = recv(client_sock, rx_buffer, sizeof(rx_buffer) - 1, 0);
-            if (len <= 0) break;
+        // Wake up regularly to pick up queued commands, resend unacknowledged ones and expire handshakes
+        struct timeval timeout = { .tv_sec = 0, .tv_usec = TCP_COMMAND_POLL_MS * 1000 };
+        int ready = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
+        commands_poll();
+        stations_poll();
+        if (ready < 0) {
+            if (errno != EINTR) {
+                ESP_LOGE(TAG, "❌ Select failed: errno %d", errno);
+                vTaskDelay(pdMS_TO_TICKS(100));
+            }
+            continue;
+        }
 
-            rx_buffer[len] = '\0';
-            sanitize_input(rx_buffer);
+        if (FD_ISSET(listen_sock, &read_fds)) {
+            station_accept(listen_sock);
+        }
 
-            if (strncmp(rx_buffer, "DATA:", 5) == 0) {
-                handle_received_data(rx_buffer + 5);
-                send_tcp_message("ACK\n");
+        for (int i = 0; i < TCP_MAX_STATIONS; i++) {
+            if (stations[i].sock >= 0 && FD_ISSET(stations[i].sock, &read_fds)) {
+                station_receive(&stations[i]);
             }
         }
 
-        close(client_sock);
-        client_sock = -1;
+        // Act on this pass's telemetry, setpoint changes from the HTTP task and the time of day
+        rules_poll();
     }
 
     close(listen_sock);
@@ -232,54 +712,12 @@ void tcp_server_task(void *pvParameters) {
 }
 
 
-void send_setpoints_with_ack(const char *setpoints) {
-    const int maxRetries = 5;
-    int retries = 0;
-    bool ackReceived = false;
-
-    while (retries < maxRetries && !ackReceived) {
-        send_tcp_message(setpoints);
-
-        char ack_buffer[32];
-        int ack_len = recv(client_sock, ack_buffer, sizeof(ack_buffer) - 1, 0);
-        if (ack_len > 0) {
-            ack_buffer[ack_len] = '\0';
-            if (strncmp(ack_buffer, "SETPOINTS_ACK\n", 14) == 0) {
-                ackReceived = true;
-                ESP_LOGI(TAG, "Setpoints acknowledgment received");
-            } else {
-                ESP_LOGE(TAG, "Unexpected response: %s", ack_buffer);
-            }
-        } else {
-            ESP_LOGE(TAG, "Failed to receive setpoints acknowledgment. Retrying...");
-        }
-        retries++;
-    }
-
-    if (!ackReceived) {
-        ESP_LOGE(TAG, "Failed to receive setpoints acknowledgment after retries");
+void tcp_server_start(void) {
+    TaskHandle_t task = xTaskCreateStatic(tcp_server_task, "tcp_server", TCP_TASK_STACK, NULL, TCP_TASK_PRIORITY,
+                                          task_stack, &task_buffer);
+    if (!task) {
+        ESP_LOGE(TAG, "❌ Unable to start the TCP server");
     }
+    metrics_register_task(task, TCP_TASK_STACK);
 }
 
-
-void send_data_to_web_server(const char* data) {
-    esp_http_client_config_t config = {
-        .url = "http://192.168.10.206/update", // Replace with your actual web server URL or IP address
-        .method = HTTP_METHOD_POST,
-        .timeout_ms = 5000,
-    };
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    esp_http_client_set_post_field(client, data, strlen(data));
-    esp_err_t err = esp_http_client_perform(client);
-
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "HTTP POST Status = %d, content_length = %lld",
-                 esp_http_client_get_status_code(client),
-                 esp_http_client_get_content_length(client));
-    } else {
-        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
-    }
-
-    esp_http_client_cleanup(client);
-}
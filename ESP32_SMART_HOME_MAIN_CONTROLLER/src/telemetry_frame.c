@@ -0,0 +1,63 @@
+/**
+ * @file telemetry_frame.c
+ * @brief This file contains the implementation of the binary telemetry frame decoder for the ESP32 Smart Home Main Controller project.
+ *
+ * The functions provided in this file allow for validating and decoding the fixed-size binary frames that
+ * stations send after negotiating "fmt=bin1" during the handshake.
+ *
+ * The main functionalities provided by this file include:
+ * - Computing the CRC-16/CCITT-FALSE checksum of a frame.
+ * - Decoding a frame into the same telemetry structure the JSON parser produces.
+ *
+ * Dependencies:
+ * - telemetry_frame.h: Frame layout and function declarations.
+ * - json_parser.h: Telemetry structure.
+ * - framer.h: Binary frame magic byte and length offset the framer relies on.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include "telemetry_frame.h"
+#include "framer.h"
+
+_Static_assert(TELEMETRY_FRAME_MAGIC == FRAMER_BINARY_MAGIC, "framer must recognize telemetry frames");
+_Static_assert(FRAMER_BINARY_LEN_OFFSET == 2, "framer must read the telemetry frame length");
+
+
+static uint16_t read_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+
+uint16_t telemetry_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+
+bool telemetry_frame_decode(const uint8_t *frame, size_t len, telemetry_t *out, uint16_t *seq) {
+    if (len != TELEMETRY_FRAME_SIZE || frame[0] != TELEMETRY_FRAME_MAGIC ||
+        frame[1] != TELEMETRY_FRAME_VERSION || frame[2] != TELEMETRY_FRAME_SIZE) {
+        return false;
+    }
+    if (telemetry_crc16(frame, TELEMETRY_FRAME_SIZE - 2) != read_u16(&frame[TELEMETRY_FRAME_SIZE - 2])) {
+        return false;
+    }
+
+    *seq = read_u16(&frame[4]);
+    out->heater = (frame[3] & TELEMETRY_FLAG_HEATER) != 0;
+    out->dehumidifier = (frame[3] & TELEMETRY_FLAG_DEHUMIDIFIER) != 0;
+    out->temperature = (int16_t)read_u16(&frame[6]);
+    out->humidity = (int16_t)read_u16(&frame[8]);
+    out->lux = read_u16(&frame[10]);
+    out->sp_temperature = (int16_t)read_u16(&frame[12]);
+    out->sp_humidity = (int16_t)read_u16(&frame[14]);
+    out->fields = TELEMETRY_REQUIRED | TELEMETRY_HAS_SP_TEMPERATURE | TELEMETRY_HAS_SP_HUMIDITY;
+    return true;
+}
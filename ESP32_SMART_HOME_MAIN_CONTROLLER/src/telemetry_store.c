@@ -0,0 +1,321 @@
+/**
+ * @file telemetry_store.c
+ * @brief This file contains the implementation of the log-structured telemetry store for the ESP32 Smart Home Main Controller project.
+ *
+ * The storage area is divided into segments of one flash sector. Slot 0 of a segment holds its header, the other
+ * slots hold 16-byte records. Segment i always carries a sequence number s with (s - 1) % segment_count == i, so the
+ * log is a ring that is appended to in order and the newest segment is the one with the highest valid sequence
+ * number. Because writes only ever go to blank slots after the last written one, a reset can at worst leave one
+ * partially written batch behind, which the record CRCs reveal on the next mount.
+ *
+ * The main functionalities provided by this file include:
+ * - Mounting the store: locating the newest segment, resuming after its last written slot and counting boots.
+ * - Batching appended records in RAM and writing each batch with a single flash write.
+ * - Rotating to the next segment, erasing it only if it is not blank and carrying its erase count forward.
+ * - Reading the log in order from a cursor, skipping records with a bad CRC.
+ *
+ * Dependencies:
+ * - telemetry_store.h: Store types and function declarations.
+ * - telemetry_frame.h: CRC-16 shared with the binary telemetry frames.
+ * - esp_log.h: ESP32 logging functions.
+ * - string.h: String manipulation functions.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include "telemetry_store.h"
+#include "telemetry_frame.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "STORE";
+
+#define SEGMENT_MAGIC 0x474F4C54u       ///< "TLOG"
+#define SEGMENT_VERSION 1
+#define SLOT_SIZE 16
+
+/**
+ * @brief Header in slot 0 of every segment.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;               ///< Position of the segment in the log, starting at 1.
+    uint32_t erase_count;       ///< Times this sector was erased by the store.
+    uint16_t version;
+    uint16_t crc;               ///< CRC-16 over the preceding bytes.
+} segment_header_t;
+
+_Static_assert(sizeof(segment_header_t) == SLOT_SIZE, "segment header must fill one slot");
+_Static_assert(sizeof(telemetry_record_t) == SLOT_SIZE, "record must fill one slot");
+
+
+static size_t slot_offset(const telemetry_store_t *store, uint32_t segment, uint32_t slot) {
+    return (size_t)segment * store->flash->sector_size + (size_t)slot * SLOT_SIZE;
+}
+
+
+static uint32_t segment_of(const telemetry_store_t *store, uint32_t seq) {
+    return (seq - 1) % store->segment_count;
+}
+
+
+static bool is_blank(const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        if (bytes[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+
+static bool record_valid(const telemetry_record_t *record) {
+    return telemetry_crc16((const uint8_t *)record, offsetof(telemetry_record_t, crc)) == record->crc;
+}
+
+
+static bool header_read(const telemetry_store_t *store, uint32_t segment, segment_header_t *header) {
+    if (store->flash->read(store->flash->ctx, slot_offset(store, segment, 0), header, sizeof(*header)) != ESP_OK) {
+        return false;
+    }
+    return header->magic == SEGMENT_MAGIC && header->version == SEGMENT_VERSION &&
+           telemetry_crc16((const uint8_t *)header, offsetof(segment_header_t, crc)) == header->crc;
+}
+
+
+static esp_err_t sector_is_blank(const telemetry_store_t *store, uint32_t segment, bool *blank) {
+    uint8_t chunk[256];
+    *blank = true;
+    for (size_t done = 0; done < store->flash->sector_size && *blank; done += sizeof(chunk)) {
+        esp_err_t err = store->flash->read(store->flash->ctx, slot_offset(store, segment, 0) + done, chunk, sizeof(chunk));
+        if (err != ESP_OK) return err;
+        *blank = is_blank(chunk, sizeof(chunk));
+    }
+    return ESP_OK;
+}
+
+
+static esp_err_t segment_open(telemetry_store_t *store, uint32_t seq) {
+    uint32_t segment = segment_of(store, seq);
+
+    // Carry the wear count of the sector forward; a sector without a valid header starts from zero
+    segment_header_t old;
+    uint32_t erase_count = header_read(store, segment, &old) ? old.erase_count : 0;
+
+    bool blank;
+    esp_err_t err = sector_is_blank(store, segment, &blank);
+    if (err != ESP_OK) return err;
+    if (!blank) {
+        err = store->flash->erase(store->flash->ctx, slot_offset(store, segment, 0), store->flash->sector_size);
+        if (err != ESP_OK) return err;
+        erase_count++;
+        store->stats.erases++;
+    }
+
+    segment_header_t header = {
+        .magic = SEGMENT_MAGIC,
+        .seq = seq,
+        .erase_count = erase_count,
+        .version = SEGMENT_VERSION,
+    };
+    header.crc = telemetry_crc16((const uint8_t *)&header, offsetof(segment_header_t, crc));
+    err = store->flash->write(store->flash->ctx, slot_offset(store, segment, 0), &header, sizeof(header));
+    if (err != ESP_OK) return err;
+
+    store->active = segment;
+    store->active_seq = seq;
+    store->active_erases = erase_count;
+    store->write_index = 0;
+    return ESP_OK;
+}
+
+
+/**
+ * Scans the written slots of a segment. Sets *end to the first blank slot and *last to the newest valid record.
+ */
+static esp_err_t segment_scan(telemetry_store_t *store, uint32_t segment, uint32_t *end,
+                              telemetry_record_t *last, bool *has_last, uint32_t *valid) {
+    telemetry_record_t records[16];
+    *end = store->records_per_segment;
+
+    for (uint32_t slot = 0; slot < store->records_per_segment; slot += 16) {
+        uint32_t count = store->records_per_segment - slot < 16 ? store->records_per_segment - slot : 16;
+        esp_err_t err = store->flash->read(store->flash->ctx, slot_offset(store, segment, slot + 1),
+                                           records, count * SLOT_SIZE);
+        if (err != ESP_OK) return err;
+
+        for (uint32_t i = 0; i < count; i++) {
+            if (is_blank(&records[i], SLOT_SIZE)) {
+                *end = slot + i;
+                return ESP_OK;
+            }
+            if (record_valid(&records[i])) {
+                *last = records[i];
+                *has_last = true;
+                (*valid)++;
+            } else {
+                store->stats.corrupt++;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+
+esp_err_t telemetry_store_mount(telemetry_store_t *store, const telemetry_store_flash_t *flash) {
+    memset(store, 0, sizeof(*store));
+    store->flash = flash;
+    if (flash->sector_size < 2 * SLOT_SIZE || flash->sector_size % 256 != 0 || flash->size / flash->sector_size < 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    store->segment_count = flash->size / flash->sector_size;
+    store->records_per_segment = flash->sector_size / SLOT_SIZE - 1;
+
+    bool found = false;
+    uint32_t newest = 0;
+    for (uint32_t segment = 0; segment < store->segment_count; segment++) {
+        segment_header_t header;
+        if (header_read(store, segment, &header) && header.seq > newest && segment_of(store, header.seq) == segment) {
+            newest = header.seq;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        ESP_LOGI(TAG, "📀 No log found, formatting %u segments", (unsigned)store->segment_count);
+        store->boot = 1;
+        return segment_open(store, 1);
+    }
+
+    segment_header_t header;
+    header_read(store, segment_of(store, newest), &header);
+    store->active = segment_of(store, newest);
+    store->active_seq = newest;
+    store->active_erases = header.erase_count;
+
+    esp_err_t err = segment_scan(store, store->active, &store->write_index,
+                                 &store->last, &store->has_last, &store->stats.recovered);
+    if (err != ESP_OK) return err;
+
+    if (!store->has_last && newest > 1 && header_read(store, segment_of(store, newest - 1), &header) &&
+        header.seq == newest - 1) {
+        // Active segment was opened but not written yet; the newest record is in the one before
+        uint32_t end, ignored = 0;
+        err = segment_scan(store, segment_of(store, newest - 1), &end, &store->last, &store->has_last, &ignored);
+        if (err != ESP_OK) return err;
+    }
+
+    store->boot = store->has_last ? (uint16_t)(store->last.boot + 1) : 1;
+    ESP_LOGI(TAG, "📀 Log mounted: segment %u (seq %u), %u records recovered, %u corrupt, boot %u",
+             (unsigned)store->active, (unsigned)store->active_seq, (unsigned)store->stats.recovered,
+             (unsigned)store->stats.corrupt, (unsigned)store->boot);
+    return ESP_OK;
+}
+
+
+esp_err_t telemetry_store_flush(telemetry_store_t *store) {
+    uint32_t done = 0;
+    esp_err_t err = ESP_OK;
+
+    while (done < store->batched) {
+        if (store->write_index == store->records_per_segment) {
+            err = segment_open(store, store->active_seq + 1);
+            if (err != ESP_OK) break;
+        }
+
+        uint32_t space = store->records_per_segment - store->write_index;
+        uint32_t count = store->batched - done < space ? store->batched - done : space;
+        err = store->flash->write(store->flash->ctx, slot_offset(store, store->active, store->write_index + 1),
+                                  &store->batch[done], count * SLOT_SIZE);
+        // Slots of a failed write may be partially programmed; never reuse them
+        store->write_index += count;
+        done += count;
+        if (err != ESP_OK) break;
+        store->stats.flushes++;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Flash write failed (%s), %u records lost", esp_err_to_name(err),
+                 (unsigned)(store->batched - done));
+    }
+    store->batched = 0;
+    return err;
+}
+
+
+esp_err_t telemetry_store_append(telemetry_store_t *store, const telemetry_record_t *record) {
+    telemetry_record_t *slot = &store->batch[store->batched++];
+    *slot = *record;
+    slot->boot = store->boot;
+    slot->reserved = 0xFF;
+    slot->crc = telemetry_crc16((const uint8_t *)slot, offsetof(telemetry_record_t, crc));
+
+    store->last = *slot;
+    store->has_last = true;
+    store->stats.appended++;
+
+    if (store->batched == TELEMETRY_STORE_BATCH ||
+        slot->uptime - store->batch[0].uptime >= TELEMETRY_STORE_FLUSH_AFTER_S) {
+        return telemetry_store_flush(store);
+    }
+    return ESP_OK;
+}
+
+
+uint32_t telemetry_store_flush_due(const telemetry_store_t *store) {
+    return store->batched ? store->batch[0].uptime + TELEMETRY_STORE_FLUSH_AFTER_S : UINT32_MAX;
+}
+
+
+size_t telemetry_store_read(telemetry_store_t *store, uint64_t *cursor, telemetry_record_t *out, size_t max) {
+    uint32_t oldest = store->active_seq >= store->segment_count ? store->active_seq - store->segment_count + 1 : 1;
+    uint32_t seq = (uint32_t)(*cursor / store->records_per_segment);
+    uint32_t slot = (uint32_t)(*cursor % store->records_per_segment);
+    if (seq < oldest || seq > store->active_seq || (seq == store->active_seq && slot > store->write_index)) {
+        seq = oldest;   // Past the end only if the log was formatted since the cursor was taken
+        slot = 0;
+    }
+
+    size_t n = 0;
+    while (n < max && seq <= store->active_seq) {
+        uint32_t segment = segment_of(store, seq);
+        uint32_t end = seq == store->active_seq ? store->write_index : store->records_per_segment;
+
+        segment_header_t header;
+        if (slot < end && header_read(store, segment, &header) && header.seq == seq) {
+            uint32_t count = end - slot < max - n ? end - slot : (uint32_t)(max - n);
+            if (store->flash->read(store->flash->ctx, slot_offset(store, segment, slot + 1),
+                                   &out[n], count * SLOT_SIZE) != ESP_OK) {
+                break;
+            }
+            size_t base = n;
+            for (uint32_t i = 0; i < count; i++) {
+                if (record_valid(&out[base + i])) {
+                    out[n++] = out[base + i];
+                } else {
+                    store->stats.corrupt++;
+                }
+            }
+            slot += count;
+        } else {
+            slot = end;
+        }
+
+        if (slot == end && seq < store->active_seq) {
+            seq++;
+            slot = 0;
+        } else if (slot == end) {
+            break;
+        }
+    }
+
+    *cursor = (uint64_t)seq * store->records_per_segment + slot;
+    return n;
+}
+
+
+bool telemetry_store_last(const telemetry_store_t *store, telemetry_record_t *record) {
+    if (store->has_last) {
+        *record = store->last;
+    }
+    return store->has_last;
+}
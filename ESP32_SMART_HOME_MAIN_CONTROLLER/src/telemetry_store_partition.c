@@ -0,0 +1,54 @@
+/**
+ * @file telemetry_store_partition.c
+ * @brief This file contains the esp_partition flash backend of the telemetry store for the ESP32 Smart Home Main Controller project.
+ *
+ * The main functionalities provided by this file include:
+ * - Locating the "telemetry" data partition declared in partitions.csv.
+ * - Forwarding the store's read, write and erase calls to the partition.
+ *
+ * Dependencies:
+ * - telemetry_store.h: Store types and function declarations.
+ * - esp_partition.h: ESP32 partition API.
+ * - esp_log.h: ESP32 logging functions.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include "telemetry_store.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+
+static const char *TAG = "STORE";
+
+
+static esp_err_t partition_read(void *ctx, size_t offset, void *buf, size_t len) {
+    return esp_partition_read(ctx, offset, buf, len);
+}
+
+
+static esp_err_t partition_write(void *ctx, size_t offset, const void *buf, size_t len) {
+    return esp_partition_write(ctx, offset, buf, len);
+}
+
+
+static esp_err_t partition_erase(void *ctx, size_t offset, size_t len) {
+    return esp_partition_erase_range(ctx, offset, len);
+}
+
+
+esp_err_t telemetry_store_partition_init(telemetry_store_flash_t *flash) {
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                TELEMETRY_STORE_PARTITION_SUBTYPE, "telemetry");
+    if (!partition) {
+        ESP_LOGE(TAG, "❌ No telemetry partition; check partitions.csv");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    flash->ctx = (void *)partition;
+    flash->size = partition->size - partition->size % partition->erase_size;
+    flash->sector_size = partition->erase_size;
+    flash->read = partition_read;
+    flash->write = partition_write;
+    flash->erase = partition_erase;
+    return ESP_OK;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file trace.c
+ * @brief This file contains the implementation of the cycle-counter trace buffer for the ESP32 Smart Home Main Controller project.
+ *
+ * Every core has its own ring of fixed-size events. A writer reserves a slot with one atomic add on the ring head
+ * and publishes it by storing the slot's sequence number last, so tasks and interrupts on the same core can
+ * record concurrently without a lock and a reader can tell complete slots from overwritten or half-written ones.
+ * Every event records the 32-bit CPU cycle counter and the 64-bit esp_timer time. While dumping, the timer tells
+ * roughly how many cycles passed since the previous event and the counter supplies the exact low 32 bits, so the
+ * cycle count is unwrapped correctly across gaps of any length. Timestamps are exported as the esp_timer time of a
+ * core's first event plus the cycles since then: cycle resolution, on a timebase shared by both cores.
+ *
+ * The traced tasks are not pinned, so a section may begin on one core and end on the other. The dump therefore puts
+ * the events of both rings into one process with the recording task as the thread, which keeps every begin/end pair
+ * on the same track, and reports the recording core as an event argument.
+ *
+ * The main functionalities provided by this file include:
+ * - Recording begin/end events with cycle timestamps.
+ * - Dumping the rings as Chrome trace_event JSON in bounded chunks.
+ *
+ * Dependencies:
+ * - trace.h: Trace declarations.
+ * - freertos/FreeRTOS.h: Core count and current core.
+ * - freertos/task.h: Current task handle.
+ * - esp_cpu.h: CPU cycle counter.
+ * - esp_timer.h: 64-bit microsecond timestamps.
+ * - stdio.h: Formatting.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include "trace.h"
+
+#ifdef CONFIG_SMARTHOME_TRACE
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+
+#define TRACE_EVENTS CONFIG_SMARTHOME_TRACE_EVENTS
+#define TRACE_EVENT_JSON_MAX 112     ///< Longest JSON rendering of one event, including the separator.
+
+_Static_assert((TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0, "CONFIG_SMARTHOME_TRACE_EVENTS must be a power of two");
+
+typedef struct {
+    int64_t us;             ///< esp_timer time when the event was recorded.
+    uint32_t cycles;        ///< CPU cycle counter when the event was recorded.
+    uint32_t seq;           ///< Event index + 1 once the slot is complete, 0 while it is being written.
+    uint32_t task;          ///< Recording task, used as the trace thread ID.
+    uint8_t point;          ///< trace_point_t.
+    uint8_t begin;          ///< 1 for begin, 0 for end.
+} trace_event_t;
+
+typedef struct {
+    uint32_t head;          ///< Free-running index of the next event.
+    trace_event_t events[TRACE_EVENTS];
+} trace_ring_t;
+
+static trace_ring_t rings[portNUM_PROCESSORS];
+static bool paused = false;
+
+static const char *const point_names[TRACE_POINT_COUNT] = {
+    [TRACE_RECV] = "recv",
+    [TRACE_FRAMER] = "framer",
+    [TRACE_PARSE] = "parse",
+    [TRACE_TELEMETRY] = "telemetry",
+    [TRACE_SHELLY] = "shelly",
+};
+
+
+void trace_record(trace_point_t point, bool begin) {
+    if (__atomic_load_n(&paused, __ATOMIC_RELAXED)) return;
+
+    uint32_t cycles = esp_cpu_get_cycle_count();
+    int64_t us = esp_timer_get_time();
+    trace_ring_t *ring = &rings[xPortGetCoreID()];
+    uint32_t index = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+    trace_event_t *event = &ring->events[index & (TRACE_EVENTS - 1)];
+
+    __atomic_store_n(&event->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    event->us = us;
+    event->cycles = cycles;
+    event->task = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+    event->point = point;
+    event->begin = begin;
+    __atomic_store_n(&event->seq, index + 1, __ATOMIC_RELEASE);
+}
+
+
+static void cursor_select_core(trace_cursor_t *cursor, uint32_t core) {
+    cursor->core = core;
+    cursor->started = false;
+    if (core < portNUM_PROCESSORS) {
+        cursor->end = __atomic_load_n(&rings[core].head, __ATOMIC_ACQUIRE);
+        cursor->index = cursor->end > TRACE_EVENTS ? cursor->end - TRACE_EVENTS : 0;
+    }
+}
+
+
+void trace_dump_begin(trace_cursor_t *cursor) {
+    __atomic_store_n(&paused, true, __ATOMIC_RELAXED);
+    cursor->opened = false;
+    cursor->first = true;
+    cursor->done = false;
+    cursor_select_core(cursor, 0);
+}
+
+
+static int format_event(trace_cursor_t *cursor, const trace_event_t *event, char *buffer, size_t len) {
+    if (!cursor->started) {
+        cursor->anchor_us = event->us;
+        cursor->cycles = 0;
+        cursor->started = true;
+    } else {
+        // The timer estimate is off by far less than half the counter range, so the signed correction picks the
+        // right wrap; it may be negative for an event preempted between reading the clocks and reserving its slot
+        int64_t estimate = (event->us - cursor->last_us) * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+        uint32_t expected = cursor->last_cycles + (uint32_t)estimate;
+        cursor->cycles += estimate + (int32_t)(event->cycles - expected);
+    }
+    cursor->last_us = event->us;
+    cursor->last_cycles = event->cycles;
+
+    int64_t ns = cursor->anchor_us * 1000 + cursor->cycles * 1000 / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    int n = snprintf(buffer, len,
+                     "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld.%03d,\"pid\":0,\"tid\":%lu,\"args\":{\"core\":%lu}}",
+                     cursor->first ? "" : ",", point_names[event->point], event->begin ? 'B' : 'E',
+                     (long long)(ns / 1000), (int)(ns % 1000), (unsigned long)event->task,
+                     (unsigned long)cursor->core);
+    cursor->first = false;
+    return n;
+}
+
+
+size_t trace_dump_next(trace_cursor_t *cursor, char *buffer, size_t len) {
+    size_t n = 0;
+
+    if (cursor->done) return 0;
+    if (!cursor->opened) {
+        n += snprintf(buffer, len, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+        cursor->opened = true;
+    }
+
+    while (cursor->core < portNUM_PROCESSORS && len - n > TRACE_EVENT_JSON_MAX) {
+        if (cursor->index == cursor->end) {
+            cursor_select_core(cursor, cursor->core + 1);
+            continue;
+        }
+
+        uint32_t index = cursor->index++;
+        const trace_event_t *slot = &rings[cursor->core].events[index & (TRACE_EVENTS - 1)];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        trace_event_t event = *slot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (seq != index + 1 || __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq ||
+            event.point >= TRACE_POINT_COUNT) {
+            continue;  // Overwritten, or still being written when recording was paused
+        }
+        n += format_event(cursor, &event, buffer + n, len - n);
+    }
+
+    if (cursor->core >= portNUM_PROCESSORS && len - n > 2) {
+        n += snprintf(buffer + n, len - n, "]}");
+        cursor->done = true;
+    }
+    return n;
+}
+
+
+void trace_dump_end(void) {
+    __atomic_store_n(&paused, false, __ATOMIC_RELAXED);
+}
+
+#endif // CONFIG_SMARTHOME_TRACE
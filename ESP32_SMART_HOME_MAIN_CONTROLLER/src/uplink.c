@@ -0,0 +1,340 @@
+/**
+ * @file uplink.c
+ * @brief This file contains the implementation of the store-and-forward uplink for the ESP32 Smart Home Main Controller project.
+ *
+ * The uplink task reads the telemetry log from its cursor, packs the records into delta-encoded batches and hands
+ * them to a small pool of worker tasks that post them over keep-alive connections. Batches are tracked by the log
+ * range they cover; the committed cursor advances over the contiguous run of acknowledged batches, so posts that
+ * complete out of order during a replay never skip a batch that is still in flight or failed.
+ *
+ * The main functionalities provided by this file include:
+ * - Restoring and periodically saving the uplink cursor in NVS.
+ * - Batching log records into one post per log flush or interval.
+ * - Replaying a backlog with a bounded number of posts in flight.
+ * - Rewinding to the oldest unacknowledged batch and backing off exponentially while the upstream is down.
+ *
+ * Dependencies:
+ * - freertos/FreeRTOS.h, freertos/task.h, freertos/queue.h: Tasks and queues.
+ * - esp_http_client.h: ESP32 HTTP client functions.
+ * - esp_log.h: ESP32 logging functions.
+ * - esp_timer.h: Microsecond timestamps.
+ * - nvs.h: Non-volatile storage of the cursor.
+ * - uplink.h: Uplink declarations.
+ * - uplink_codec.h: Batch encoding.
+ * - storage.h: Locked access to the telemetry log.
+ * - metrics.h: Post counters, latency histogram and stack registration.
+ * - dlog.h: Deferred logging for the per-post messages.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "uplink.h"
+#include "uplink_codec.h"
+#include "storage.h"
+#include "metrics.h"
+#include "dlog.h"
+
+static const char *TAG = "UPLINK";
+
+#define UPLINK_TASK_STACK 4096
+#define UPLINK_TASK_PRIORITY 3          ///< Below the Shelly workers; forwarding is never urgent.
+#define UPLINK_TIMEOUT_MS 5000
+#define UPLINK_RETRY_MIN_MS 2000        ///< First backoff after a failed post.
+#define UPLINK_RETRY_MAX_MS 300000      ///< Longest backoff while the upstream stays down.
+#define UPLINK_CURSOR_SAVE_MS 60000     ///< Shortest time between cursor writes to NVS.
+#define UPLINK_NVS_NAMESPACE "smarthome"
+#define UPLINK_NVS_KEY "uplink_cursor"
+#define UPLINK_KICK -1                  ///< Event job index of uplink_notify().
+#define UPLINK_EVENT_QUEUE_LEN (UPLINK_IN_FLIGHT + 4)   ///< Every job's result plus a kick, so workers never block on it for long.
+
+const char *uplinkURL = CONFIG_SMARTHOME_UPLINK_URL;
+
+typedef enum {
+    JOB_FREE,
+    JOB_BUSY,       ///< Handed to a worker.
+    JOB_DONE,       ///< Acknowledged, waiting for the batches before it.
+} uplink_job_state_t;
+
+/**
+ * @brief One batch and the log range it covers. Only the uplink task changes the state.
+ */
+typedef struct {
+    uplink_job_state_t state;
+    uint64_t start;         ///< Log cursor of the first record.
+    uint64_t end;           ///< Log cursor after the last record.
+    size_t count;
+    size_t len;
+    uint8_t body[UPLINK_CODEC_SIZE(UPLINK_BATCH_RECORDS)];
+} uplink_job_t;
+
+/**
+ * @brief Event sent to the uplink task.
+ */
+typedef struct {
+    int job;                ///< Index of the finished job, or UPLINK_KICK.
+    bool ok;
+} uplink_event_t;
+
+static uplink_job_t jobs[UPLINK_IN_FLIGHT];
+static QueueHandle_t work_queue = NULL;     ///< Job indices for the workers.
+static QueueHandle_t event_queue = NULL;    ///< Finished jobs and kicks for the uplink task.
+static StaticQueue_t work_queue_buffer;
+static StaticQueue_t event_queue_buffer;
+static int work_slots[UPLINK_IN_FLIGHT];
+static uplink_event_t event_slots[UPLINK_EVENT_QUEUE_LEN];
+static StackType_t worker_stacks[UPLINK_IN_FLIGHT][UPLINK_TASK_STACK];
+static StaticTask_t worker_buffers[UPLINK_IN_FLIGHT];
+static StackType_t task_stack[UPLINK_TASK_STACK];
+static StaticTask_t task_buffer;
+
+// Uplink task state
+static telemetry_record_t records[UPLINK_BATCH_RECORDS];
+static uint64_t committed;                  ///< Everything before this cursor was acknowledged.
+static uint64_t next;                       ///< Cursor of the next batch to read.
+static uint64_t saved;                      ///< Cursor last written to NVS.
+static int64_t saved_at;
+static bool failed = false;                 ///< A post failed; rewind once the posts in flight are done.
+static int64_t retry_at = 0;                ///< esp_timer time before which nothing is posted.
+static uint32_t backoff_ms = UPLINK_RETRY_MIN_MS;
+
+
+static void cursor_load(void) {
+    nvs_handle_t nvs;
+    size_t len = sizeof(committed);
+    if (nvs_open(UPLINK_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        if (nvs_get_blob(nvs, UPLINK_NVS_KEY, &committed, &len) != ESP_OK || len != sizeof(committed)) {
+            committed = 0;
+        }
+        nvs_close(nvs);
+    }
+    next = saved = committed;
+    saved_at = esp_timer_get_time();
+}
+
+
+static void cursor_save(int64_t now) {
+    if (committed == saved || now - saved_at < (int64_t)UPLINK_CURSOR_SAVE_MS * 1000) {
+        return;
+    }
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(UPLINK_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, UPLINK_NVS_KEY, &committed, sizeof(committed));
+        if (err == ESP_OK) err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Saving the uplink cursor failed: %s", esp_err_to_name(err));
+    }
+    saved = committed;
+    saved_at = now;
+}
+
+
+static esp_err_t uplink_http_event(esp_http_client_event_t *evt) {
+    return ESP_OK;  // The response body carries nothing the uplink needs
+}
+
+
+static void uplink_worker_task(void *pvParameters) {
+    esp_http_client_config_t config = {
+        .url = uplinkURL,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = UPLINK_TIMEOUT_MS,
+        .keep_alive_enable = true,
+        .event_handler = uplink_http_event,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        ESP_LOGE(TAG, "❌ Invalid uplink URL '%s'", uplinkURL);
+        vTaskDelete(NULL);
+        return;
+    }
+    esp_http_client_set_header(client, "Content-Type", UPLINK_CODEC_CONTENT_TYPE);
+
+    int index;
+    while (1) {
+        xQueueReceive(work_queue, &index, portMAX_DELAY);
+        uplink_job_t *job = &jobs[index];
+
+        esp_http_client_set_post_field(client, (const char *)job->body, (int)job->len);
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = esp_http_client_perform(client);
+        metrics_inc(METRIC_UPLINK_POSTS);
+        metrics_observe(METRIC_UPLINK_LATENCY_MS, (uint32_t)((esp_timer_get_time() - start) / 1000));
+
+        int status = err == ESP_OK ? esp_http_client_get_status_code(client) : 0;
+        uplink_event_t event = { .job = index, .ok = status >= 200 && status < 300 };
+        if (event.ok) {
+            metrics_add(METRIC_UPLINK_SAMPLES, job->count);
+            metrics_add(METRIC_UPLINK_BYTES, job->len);
+            DLOGI(TAG, "📡 Posted %u samples in %u bytes", (unsigned)job->count, (unsigned)job->len);
+        } else {
+            metrics_inc(METRIC_UPLINK_FAILURES);
+            esp_http_client_close(client);
+            if (err != ESP_OK) {
+                DLOGW(TAG, "⚠️ Uplink post failed: %s", esp_err_to_name(err));
+            } else {
+                DLOGW(TAG, "⚠️ Upstream answered HTTP %d", status);
+            }
+        }
+        xQueueSend(event_queue, &event, portMAX_DELAY);
+    }
+}
+
+
+static void uplink_finish(const uplink_event_t *event, int64_t now) {
+    uplink_job_t *job = &jobs[event->job];
+    if (event->ok) {
+        job->state = JOB_DONE;
+        if (backoff_ms > UPLINK_RETRY_MIN_MS) {
+            ESP_LOGI(TAG, "✅ Upstream reachable again");
+        }
+        backoff_ms = UPLINK_RETRY_MIN_MS;
+        retry_at = 0;
+        return;
+    }
+
+    job->state = JOB_FREE;
+    if (!failed) {
+        ESP_LOGW(TAG, "⚠️ Upstream unreachable, retrying in %lu ms", (unsigned long)backoff_ms);
+        retry_at = now + (int64_t)backoff_ms * 1000;
+        backoff_ms = backoff_ms * 2 < UPLINK_RETRY_MAX_MS ? backoff_ms * 2 : UPLINK_RETRY_MAX_MS;
+    }
+    failed = true;
+}
+
+
+/**
+ * Advances the committed cursor over acknowledged batches that follow it, and rewinds to it once a failed
+ * batch has no posts in flight after it any more.
+ */
+static void uplink_commit(int64_t now) {
+    for (bool advanced = true; advanced;) {
+        advanced = false;
+        for (int i = 0; i < UPLINK_IN_FLIGHT; i++) {
+            if (jobs[i].state == JOB_DONE && jobs[i].start == committed) {
+                committed = jobs[i].end;
+                jobs[i].state = JOB_FREE;
+                advanced = true;
+            }
+        }
+    }
+
+    if (failed) {
+        for (int i = 0; i < UPLINK_IN_FLIGHT; i++) {
+            if (jobs[i].state == JOB_BUSY) return;
+        }
+        // Batches acknowledged after the failed one are posted again; the upstream drops the duplicates
+        for (int i = 0; i < UPLINK_IN_FLIGHT; i++) {
+            jobs[i].state = JOB_FREE;
+        }
+        next = committed;
+        failed = false;
+    }
+    cursor_save(now);
+}
+
+
+static void uplink_dispatch(int64_t now) {
+    if (failed || now < retry_at) {
+        return;
+    }
+
+    for (int i = 0; i < UPLINK_IN_FLIGHT; i++) {
+        uplink_job_t *job = &jobs[i];
+        if (job->state != JOB_FREE) continue;
+
+        uint64_t cursor = next;
+        size_t count = telemetry_log_read(&cursor, records, UPLINK_BATCH_RECORDS);
+        if (count == 0) {
+            return;
+        }
+        if (cursor < next) {
+            ESP_LOGW(TAG, "⚠️ Log position %llu is past the end of the telemetry log, forwarding from its start",
+                     (unsigned long long)next);
+        }
+
+        job->start = next;
+        job->end = cursor;
+        job->count = count;
+        job->len = uplink_encode(records, count, job->body, sizeof(job->body));
+        job->state = JOB_BUSY;
+        next = cursor;
+        xQueueSend(work_queue, &i, portMAX_DELAY);
+    }
+}
+
+
+static void uplink_task(void *pvParameters) {
+    const TickType_t interval = pdMS_TO_TICKS(CONFIG_SMARTHOME_UPLINK_INTERVAL_S * 1000);
+    uplink_event_t event;
+
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        TickType_t wait = interval;
+        if (retry_at > now && pdMS_TO_TICKS((retry_at - now) / 1000) < wait) {
+            wait = pdMS_TO_TICKS((retry_at - now) / 1000) + 1;
+        }
+
+        if (xQueueReceive(event_queue, &event, wait) == pdTRUE) {
+            do {
+                if (event.job != UPLINK_KICK) {
+                    uplink_finish(&event, esp_timer_get_time());
+                }
+            } while (xQueueReceive(event_queue, &event, 0) == pdTRUE);
+        }
+
+        now = esp_timer_get_time();
+        uplink_commit(now);
+        uplink_dispatch(now);
+    }
+}
+
+
+void uplink_start(void) {
+    if (uplinkURL[0] == '\0') {
+        ESP_LOGI(TAG, "📡 No uplink URL configured, uplink disabled");
+        return;
+    }
+
+    cursor_load();
+    work_queue = xQueueCreateStatic(UPLINK_IN_FLIGHT, sizeof(int), (uint8_t *)work_slots, &work_queue_buffer);
+    event_queue = xQueueCreateStatic(UPLINK_EVENT_QUEUE_LEN, sizeof(uplink_event_t), (uint8_t *)event_slots,
+                                     &event_queue_buffer);
+
+    for (int i = 0; i < UPLINK_IN_FLIGHT; i++) {
+        char task_name[16];
+        snprintf(task_name, sizeof(task_name), "uplink_%d", i);
+        TaskHandle_t task = xTaskCreateStatic(uplink_worker_task, task_name, UPLINK_TASK_STACK, NULL,
+                                              UPLINK_TASK_PRIORITY, worker_stacks[i], &worker_buffers[i]);
+        if (!task) {
+            ESP_LOGE(TAG, "❌ Unable to start uplink worker %d", i);
+        }
+        metrics_register_task(task, UPLINK_TASK_STACK);
+    }
+    TaskHandle_t task = xTaskCreateStatic(uplink_task, "uplink", UPLINK_TASK_STACK, NULL, UPLINK_TASK_PRIORITY,
+                                          task_stack, &task_buffer);
+    if (!task) {
+        ESP_LOGE(TAG, "❌ Unable to start the uplink");
+        return;
+    }
+    metrics_register_task(task, UPLINK_TASK_STACK);
+    ESP_LOGI(TAG, "📡 Forwarding samples to %s from log position %llu", uplinkURL, (unsigned long long)committed);
+}
+
+
+void uplink_notify(void) {
+    if (event_queue) {
+        uplink_event_t event = { .job = UPLINK_KICK };
+        xQueueSend(event_queue, &event, 0);  // A full queue wakes the task anyway
+    }
+}
@@ -0,0 +1,127 @@
+/**
+ * @file uplink_codec.c
+ * @brief This file contains the implementation of the uplink batch codec for the ESP32 Smart Home Main Controller project.
+ *
+ * The functions provided in this file allow for packing runs of telemetry log records into the delta and varint
+ * encoded batches described in uplink_codec.h, and for unpacking them again on the receiving side.
+ *
+ * The main functionalities provided by this file include:
+ * - Writing and reading LEB128 varints and zigzag-mapped signed differences.
+ * - Encoding records into a batch.
+ * - Validating and decoding a batch.
+ *
+ * Dependencies:
+ * - uplink_codec.h: Batch format and function declarations.
+ * - telemetry_store.h: Log record structure.
+ *
+ * @note This file is part of the ESP32 Smart Home Main Controller project.
+ */
+
+#include <string.h>
+#include "uplink_codec.h"
+
+#define TAG_BOOT 0x80
+#define TAG_FLAGS (TELEMETRY_RECORD_HEATER | TELEMETRY_RECORD_DEHUMIDIFIER)
+
+
+static size_t put_varint(uint8_t *out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+
+static bool get_varint(const uint8_t **in, const uint8_t *end, uint32_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*in == end) return false;
+        uint8_t byte = *(*in)++;
+        *value |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+
+size_t uplink_encode(const telemetry_record_t *records, size_t count, uint8_t *out, size_t len) {
+    if (len < UPLINK_CODEC_SIZE(count)) {
+        return 0;
+    }
+
+    size_t n = 0;
+    out[n++] = UPLINK_CODEC_MAGIC;
+    out[n++] = UPLINK_CODEC_VERSION;
+    n += put_varint(out + n, (uint32_t)count);
+
+    telemetry_record_t prev = { 0 };
+    for (size_t i = 0; i < count; i++) {
+        const telemetry_record_t *record = &records[i];
+        bool new_boot = i == 0 || record->boot != prev.boot || record->uptime < prev.uptime;
+
+        out[n++] = (record->flags & TAG_FLAGS) | (new_boot ? TAG_BOOT : 0);
+        if (new_boot) {
+            n += put_varint(out + n, record->boot);
+            n += put_varint(out + n, record->uptime);
+        } else {
+            n += put_varint(out + n, record->uptime - prev.uptime);
+        }
+        n += put_varint(out + n, zigzag(record->temperature - prev.temperature));
+        n += put_varint(out + n, zigzag(record->humidity - prev.humidity));
+        n += put_varint(out + n, zigzag((int32_t)record->lux - prev.lux));
+        prev = *record;
+    }
+    return n;
+}
+
+
+bool uplink_decode(const uint8_t *in, size_t len, telemetry_record_t *out, size_t max, size_t *count) {
+    const uint8_t *end = in + len;
+    uint32_t total;
+    *count = 0;
+    if (len < 2 || in[0] != UPLINK_CODEC_MAGIC || in[1] != UPLINK_CODEC_VERSION) {
+        return false;
+    }
+    in += 2;
+    if (!get_varint(&in, end, &total) || total > max) {
+        return false;
+    }
+
+    telemetry_record_t prev = { 0 };
+    for (uint32_t i = 0; i < total; i++) {
+        if (in == end) return false;
+        uint8_t tag = *in++;
+        uint32_t boot = prev.boot, uptime, temperature, humidity, lux;
+        if (i == 0 && !(tag & TAG_BOOT)) return false;
+        if ((tag & TAG_BOOT) && !get_varint(&in, end, &boot)) return false;
+        if (!get_varint(&in, end, &uptime) || !get_varint(&in, end, &temperature) ||
+            !get_varint(&in, end, &humidity) || !get_varint(&in, end, &lux)) {
+            return false;
+        }
+
+        telemetry_record_t *record = &out[i];
+        memset(record, 0, sizeof(*record));
+        record->boot = (uint16_t)boot;
+        record->uptime = (tag & TAG_BOOT) ? uptime : prev.uptime + uptime;
+        record->temperature = (int16_t)(prev.temperature + unzigzag(temperature));
+        record->humidity = (int16_t)(prev.humidity + unzigzag(humidity));
+        record->lux = (uint16_t)(prev.lux + unzigzag(lux));
+        record->flags = tag & TAG_FLAGS;
+        prev = *record;
+    }
+    *count = total;
+    return in == end;
+}
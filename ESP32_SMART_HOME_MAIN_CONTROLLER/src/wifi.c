@@ -9,6 +9,7 @@
  * - Initializing the Wi-Fi interface.
  * - Connecting to a Wi-Fi network.
  * - Handling Wi-Fi events.
+ * - Setting the clock over SNTP once connected, for the time windows of the automation rules.
  *
  * Dependencies:
  * - esp_wifi.h: ESP32 Wi-Fi functions.
@@ -16,6 +17,8 @@
  * - esp_log.h: ESP32 logging functions.
  * - nvs_flash.h: ESP32 non-volatile storage functions.
  * - lwip/inet.h: LwIP internet address functions.
+ * - esp_sntp.h: SNTP client.
+ * - metrics.h: Reconnect counter.
  *
  * @note This file is part of the ESP32 Smart Home Main Controller project.
  */
@@ -25,6 +28,10 @@
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "lwip/inet.h"
+#include "esp_sntp.h"
+#include <stdlib.h>
+#include <time.h>
+#include "metrics.h"
 
 #define WIFI_SSID "TN_24GHz_F3908D"
 #define WIFI_PASS "UP7ADFCFXJ"
@@ -37,16 +44,26 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         ESP_LOGI(TAG, "Disconnected from Wi-Fi, retrying...");
+        metrics_inc(METRIC_WIFI_RECONNECTS);
         esp_wifi_connect();
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "Got IP: %s", ip4addr_ntoa((const ip4_addr_t*)&event->ip_info.ip));
+
+        if (!esp_sntp_enabled()) {
+            esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+            esp_sntp_setservername(0, CONFIG_SMARTHOME_SNTP_SERVER);
+            esp_sntp_init();
+        }
     }
 }
 
 
 void wifi_init(void) {
     ESP_ERROR_CHECK(nvs_flash_init());
+
+    setenv("TZ", CONFIG_SMARTHOME_TIMEZONE, 1);
+    tzset();
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
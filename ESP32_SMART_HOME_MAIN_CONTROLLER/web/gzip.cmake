@@ -0,0 +1,11 @@
+# Compresses one file with gzip so it can be embedded in the firmware image.
+#
+# Usage: cmake -DIN=<file> -DOUT=<file.gz> -P gzip.cmake
+
+cmake_minimum_required(VERSION 3.19)
+
+if(NOT IN OR NOT OUT)
+    message(FATAL_ERROR "gzip.cmake needs -DIN=<file> and -DOUT=<file.gz>")
+endif()
+
+file(ARCHIVE_CREATE OUTPUT ${OUT} PATHS ${IN} FORMAT raw COMPRESSION GZip COMPRESSION_LEVEL 9)
@@ -29,11 +29,19 @@ extern char password[32];   ///< Wi-Fi password.
 extern const char* serverIP;   ///< Server IP address.
 extern const int serverPort;   ///< Server port number;
 
+// Station identity announced in the handshake
+extern const char* stationID;          ///< Station ID the controller registers this station's zone under.
+extern const char* stationCaps;        ///< Sensors and plugs of this station's zone.
+
 // Create a SoftwareSerial object for ESP8266 communication
 extern SoftwareSerial espSerial;  ///< SoftwareSerial interface for communication with the ESP8266.
 
 // Global variables
 extern bool handshake_done;            ///< Indicates if the handshake with the server is completed.
+extern bool binaryFrames;              ///< Indicates if the server accepted binary telemetry frames during the handshake.
+extern uint16_t frameSeq;              ///< Sequence number of the next binary telemetry frame.
+extern char sessionToken[9];           ///< Session token issued by the server during the handshake, or empty.
+extern bool resumePending;             ///< The connection was reopened; the next data frame presents the session token.
 extern bool serialBusy;                ///< Indicates if the serial communication is currently busy.
 extern bool connected;                 ///< Indicates if the system is connected to the Wi-Fi network.
 extern String latestResponse;          ///< Stores the latest response received from the ESP8266.
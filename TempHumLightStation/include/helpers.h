@@ -79,8 +79,8 @@ void handleSetpoints(const String& data);
  *
  * @param buffer The buffer to store the JSON string.
  * @param len The length of the buffer.
- * @param temperature The temperature reading (in tenths of degrees Celsius).
- * @param humidity The humidity reading (in tenths of percent relative humidity).
+ * @param temperature The temperature reading (in hundredths of degrees Celsius).
+ * @param humidity The humidity reading (in hundredths of percent relative humidity).
  * @param light The light intensity reading (in lux).
  */
 void formatSensorData(char* buffer, size_t len, int16_t temperature, int16_t humidity, uint16_t light);
@@ -142,6 +142,8 @@ void updateAutomationStates();
 
 /**
  * @brief Sends sensor data to the server.
+ *
+ * Sends a binary telemetry frame if the server accepted it during the handshake, JSON otherwise.
  */
 void sendSensorData();
 
@@ -0,0 +1,55 @@
+/**
+ * @file telemetry_frame.h
+ * @brief This file contains the declarations for the compact binary telemetry frame for the TempHumLightStation project.
+ *
+ * When the ESP32 accepts "fmt=bin1" during the handshake, sensor data is sent as a fixed-size 18-byte frame
+ * instead of the DATA: JSON line, which takes a fraction of the time over the 9600-baud link to the ESP8266.
+ * All values are little-endian integers in centi-units:
+ *
+ * - Byte 0: magic byte 0xB5
+ * - Byte 1: version (1)
+ * - Byte 2: frame length in bytes (18)
+ * - Byte 3: flags, bit 0 heater, bit 1 dehumidifier
+ * - Bytes 4-5: sequence number
+ * - Bytes 6-7: temperature in hundredths of degrees Celsius
+ * - Bytes 8-9: humidity in hundredths of percent RH
+ * - Bytes 10-11: light intensity in lux
+ * - Bytes 12-13: temperature setpoint in hundredths of degrees Celsius
+ * - Bytes 14-15: humidity setpoint in hundredths of percent RH
+ * - Bytes 16-17: CRC-16/CCITT-FALSE over bytes 0-15
+ *
+ * The layout must match telemetry_frame.h of the ESP32 Smart Home Main Controller.
+ *
+ * Dependencies:
+ * - Arduino.h: Arduino core functions.
+ *
+ * @note This file is part of the TempHumLightStation project.
+ */
+
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <Arduino.h>
+
+#define TELEMETRY_FRAME_MAGIC 0xB5        ///< First byte of every binary frame.
+#define TELEMETRY_FRAME_VERSION 1         ///< Frame layout version.
+#define TELEMETRY_FRAME_SIZE 18           ///< Size of a version 1 frame in bytes.
+#define TELEMETRY_FRAME_OPTION "fmt=bin1" ///< Handshake option that negotiates binary frames.
+
+#define TELEMETRY_FLAG_HEATER       0x01
+#define TELEMETRY_FLAG_DEHUMIDIFIER 0x02
+
+// Function declarations
+
+/**
+ * @brief Encodes the sensor data into a binary telemetry frame.
+ *
+ * @param frame The buffer to store the frame; must hold TELEMETRY_FRAME_SIZE bytes.
+ * @param seq The frame sequence number.
+ * @param temperature The temperature reading (in hundredths of degrees Celsius).
+ * @param humidity The humidity reading (in hundredths of percent relative humidity).
+ * @param light The light intensity reading (in lux).
+ */
+void encodeTelemetryFrame(uint8_t* frame, uint16_t seq, int16_t temperature, int16_t humidity, uint16_t light);
+
+#endif // TELEMETRY_FRAME_H
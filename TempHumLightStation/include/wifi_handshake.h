@@ -48,16 +48,19 @@ bool performHandshake();
  * @brief Attempts to perform a handshake with the ESP32 server.
  *
  * This function sends a handshake message to the ESP32 server and waits for a response.
- * If the handshake is successful, it sets the handshake_done flag to true.
+ * If the handshake is successful, it sets the handshake_done flag to true, and sets binaryFrames
+ * if the server echoed the offered binary frame option.
  *
+ * @param offerBinary True to append the binary frame option to the handshake message.
  * @return True if the handshake is successful, false otherwise.
  */
-bool attemptHandshake();
+bool attemptHandshake(bool offerBinary);
 
 /**
  * @brief Waits for a handshake response from the ESP32 server.
  *
  * This function waits for a handshake response from the ESP32 server within a specified timeout period.
+ * The session token carried in the response as ";tok=<8 hex digits>" is stored in sessionToken.
  *
  * @return True if the handshake response is received, false otherwise.
  */
@@ -67,21 +70,42 @@ bool waitForHandshakeResponse();
  * @brief Sends a TCP message to the server.
  *
  * This function sends a TCP message to the server. If the message is not acknowledged,
- * it retries up to three times. If the handshake fails, it performs the handshake again.
+ * it retries up to three times. The first message after a reconnect is sent as "DATA;tok=<token>:" to
+ * resume the session; if the server rejects the token, the handshake is performed again.
  *
  * @param message The message to send.
  */
 void sendTCPMessage(const char* message);
 
+/**
+ * @brief Sends a binary telemetry frame to the server.
+ *
+ * Like sendTCPMessage(), but sends the frame as-is without the DATA: prefix.
+ *
+ * @param frame The frame to send.
+ * @param len The frame length in bytes.
+ */
+void sendTCPFrame(const uint8_t* frame, size_t len);
+
+/**
+ * @brief Sends data to the server, retrying up to three times until it is acknowledged.
+ *
+ * @param data The bytes to send.
+ * @param len The number of bytes.
+ */
+void sendWithRetries(const uint8_t* data, size_t len);
+
 /**
  * @brief Attempts to send a TCP message to the server.
  *
  * This function attempts to send a TCP message to the server and waits for an acknowledgment.
+ * The length is passed to AT+CIPSEND explicitly, so the data may be binary.
  *
- * @param fullMessage The full message to send.
+ * @param data The bytes to send.
+ * @param len The number of bytes.
  * @return True if the message is acknowledged, false otherwise.
  */
-bool attemptSendMessage(const char* fullMessage);
+bool attemptSendMessage(const uint8_t* data, size_t len);
 
 /**
  * @brief Receives and processes TCP messages from the server.
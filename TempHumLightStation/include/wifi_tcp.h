@@ -52,7 +52,8 @@ void initializeWiFiAndTCP();
  * @brief Establishes a TCP connection with the ESP8266.
  *
  * This function sends the command to start a TCP connection with the specified server IP and port.
- * If the connection fails, it retries once before returning the result.
+ * If the connection fails, it retries once before returning the result. If the server issued a session
+ * token, the next data frame presents it so the session resumes without a new handshake.
  *
  * @return True if the connection is successful, false otherwise.
  */
@@ -23,6 +23,10 @@
 // Global Variable Definitions
 bool connected = false;            ///< Indicates if the system is connected to the Wi-Fi network.
 bool handshake_done = false;       ///< Indicates if the handshake with the server is completed.
+bool binaryFrames = false;         ///< Indicates if the server accepted binary telemetry frames during the handshake.
+uint16_t frameSeq = 0;             ///< Sequence number of the next binary telemetry frame.
+char sessionToken[9] = "";         ///< Session token issued by the server during the handshake, or empty.
+bool resumePending = false;        ///< The connection was reopened; the next data frame presents the session token.
 bool serialBusy = false;           ///< Indicates if the serial communication is currently busy.
 String latestResponse = "";        ///< Stores the latest response received from the ESP8266.
 String accumulatedResponse = "";   ///< Stores the accumulated responses from the ESP8266.
@@ -33,6 +37,10 @@ char password[32];   ///< Wi-Fi password.
 const char* serverIP = "192.168.10.206";    ///< Server IP address.
 const int serverPort = 8080;                ///< Server port number;
 
+// Station identity
+const char* stationID = "station1";                     ///< Station ID; lowercase letters, digits, '_' and '-'.
+const char* stationCaps = "temp,hum,lux,heat,dehum";    ///< Sensors and plugs of this station's zone.
+
 // Sensor data
 int16_t globalTemperature = 0;      ///< Global variable to store the temperature reading.
 int16_t globalHumidity = 0;         ///< Global variable to store the humidity reading.
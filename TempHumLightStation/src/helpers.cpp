@@ -12,6 +12,7 @@
  * - Checking the TCP connection status with the ESP8266.
  * - Handling incoming data and extracting temperature and humidity setpoints.
  * - Generating a JSON string for sensor data with safe formatting.
+ * - Sending sensor data as a binary frame or JSON, depending on the handshake.
  *
  * Dependencies:
  * - helpers.h: Header file containing the declarations of the helper functions.
@@ -19,6 +20,7 @@
  * - automation.h: Header file containing the declarations of automation functions.
  * - sensor.h: Header file containing the declarations of sensor functions.
  * - wifi_tcp.h: Header file containing the declarations of Wi-Fi TCP functions.
+ * - telemetry_frame.h: Header file containing the binary telemetry frame definitions.
  *
  * @note This file is part of the TempHumLightStation project.
  */
@@ -32,6 +34,7 @@
 #include "../include/i2c.h"
 #include "../include/wifi_handshake.h"
 #include "../include/wifi_commands.h"
+#include "../include/telemetry_frame.h"
 
 #include <Arduino.h>
 #include <string.h>
@@ -148,16 +151,29 @@ void handleSetpoints(const String &data) {
 }
 
 
+static void formatCenti(char *buffer, size_t len, int16_t value) {
+    // AVR snprintf has no %f support, so format the fixed-point value as integers
+    long absolute = value < 0 ? -(long)value : value;
+    snprintf(buffer, len, "%s%ld.%02ld", value < 0 ? "-" : "", absolute / 100, absolute % 100);
+}
+
+
 void formatSensorData(char *buffer, size_t len, int16_t temperature, int16_t humidity, uint16_t light) {
+    char temperatureStr[8], humidityStr[8], spTemperatureStr[8], spHumidityStr[8];
+    formatCenti(temperatureStr, sizeof(temperatureStr), temperature);
+    formatCenti(humidityStr, sizeof(humidityStr), humidity);
+    formatCenti(spTemperatureStr, sizeof(spTemperatureStr), SP_TEMP);
+    formatCenti(spHumidityStr, sizeof(spHumidityStr), SP_HUM);
+
     snprintf(buffer, len,
-        "{\"temperature\":%.2f,\"humidity\":%.2f,\"lux\":%u,\"heater\":%s,\"dehumidifier\":%s,\"sp_temperature\":%.2f,\"sp_humidity\":%.2f}\n",
-        temperature / 100.0, 
-        humidity / 100.0, 
-        light, 
+        "{\"temperature\":%s,\"humidity\":%s,\"lux\":%u,\"heater\":%s,\"dehumidifier\":%s,\"sp_temperature\":%s,\"sp_humidity\":%s}",
+        temperatureStr,
+        humidityStr,
+        light,
         GetHeaterState() ? "true" : "false",
         GetDehumidifierState() ? "true" : "false",
-        SP_TEMP / 100.0, 
-        SP_HUM / 100.0
+        spTemperatureStr,
+        spHumidityStr
     );
 }
 
@@ -238,7 +254,15 @@ void updateAutomationStates() {
 
 void sendSensorData() {
     // Use the global variables for sensor data
-    char sensorData[128];
+    // A resumed connection presents the session token in a JSON frame first
+    if (binaryFrames && !resumePending) {
+        uint8_t frame[TELEMETRY_FRAME_SIZE];
+        encodeTelemetryFrame(frame, frameSeq++, globalTemperature, globalHumidity, globalLight);
+        sendTCPFrame(frame, sizeof(frame));  // Send sensor data to the server
+        return;
+    }
+
+    char sensorData[144];
     formatSensorData(sensorData, sizeof(sensorData), globalTemperature, globalHumidity, globalLight);
 
     sendTCPMessage(sensorData);  // Send sensor data to the server
@@ -0,0 +1,50 @@
+/**
+ * @file telemetry_frame.cpp
+ * @brief This file contains the implementation of the binary telemetry frame encoder for the TempHumLightStation project.
+ *
+ * The main functionalities provided by this file include:
+ * - Packing the sensor readings, actuator states and setpoints into a fixed-size frame.
+ * - Protecting the frame with a CRC-16/CCITT-FALSE checksum.
+ *
+ * Dependencies:
+ * - telemetry_frame.h: Header file containing the frame layout and function declarations.
+ * - globals.h: Header file containing the declarations of global variables.
+ * - automation.h: Header file containing the declarations of automation functions.
+ * - util/crc16.h: AVR CRC helpers.
+ *
+ * @note This file is part of the TempHumLightStation project.
+ */
+
+#include "../include/telemetry_frame.h"
+#include "../include/globals.h"
+#include "../include/automation.h"
+
+#include <util/crc16.h>
+
+
+static void writeU16(uint8_t *p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+
+void encodeTelemetryFrame(uint8_t *frame, uint16_t seq, int16_t temperature, int16_t humidity, uint16_t light) {
+    frame[0] = TELEMETRY_FRAME_MAGIC;
+    frame[1] = TELEMETRY_FRAME_VERSION;
+    frame[2] = TELEMETRY_FRAME_SIZE;
+    frame[3] = (GetHeaterState() ? TELEMETRY_FLAG_HEATER : 0) |
+               (GetDehumidifierState() ? TELEMETRY_FLAG_DEHUMIDIFIER : 0);
+    writeU16(&frame[4], seq);
+    writeU16(&frame[6], temperature);
+    writeU16(&frame[8], humidity);
+    writeU16(&frame[10], light);
+    writeU16(&frame[12], SP_TEMP);
+    writeU16(&frame[14], SP_HUM);
+
+    // _crc_xmodem_update is the MSB-first 0x1021 step; seeding it with 0xFFFF gives CCITT-FALSE
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < TELEMETRY_FRAME_SIZE - 2; i++) {
+        crc = _crc_xmodem_update(crc, frame[i]);
+    }
+    writeU16(&frame[TELEMETRY_FRAME_SIZE - 2], crc);
+}
@@ -6,7 +6,8 @@
  * checking if the ESP8266 is ready, sending TCP messages, and receiving TCP messages.
  *
  * The main functionalities provided by this file include:
- * - Performing a handshake with the ESP32 server.
+ * - Performing a handshake with the ESP32 server and negotiating the telemetry format.
+ * - Storing the session token issued by the server and presenting it after a reconnect.
  * - Checking if the ESP8266 is ready.
  * - Sending TCP messages.
  * - Receiving TCP messages.
@@ -17,6 +18,7 @@
  * - helpers.h: Header file containing the declarations of helper functions.
  * - wifi_commands.h: Header file containing the declarations of Wi-Fi command functions.
  * - wifi_tcp.h: Header file containing the declarations of Wi-Fi TCP functions.
+ * - telemetry_frame.h: Header file containing the binary telemetry frame definitions.
  * - SoftwareSerial.h: Library for software-based serial communication.
  *
  * @note This file is part of the TempHumLightStation project.
@@ -27,6 +29,7 @@
 #include "../include/helpers.h"
 #include "../include/wifi_commands.h"
 #include "../include/wifi_tcp.h"
+#include "../include/telemetry_frame.h"
 #include <SoftwareSerial.h>
 
 extern SoftwareSerial espSerial;
@@ -39,11 +42,14 @@ bool performHandshake() {
     if (handshake_done) return true;
 
     handshake_done = false;
+    sessionToken[0] = '\0';
+    resumePending = false;
     int handshakeRetries = 0;
     const int maxRetries = 5;
 
     while (!handshake_done && handshakeRetries < maxRetries) {
-        if (!attemptHandshake()) {
+        // Offer binary frames first; fall back to plain JSON if the server does not answer
+        if (!attemptHandshake(handshakeRetries == 0)) {
             handshakeRetries++;
             delay(3000);
         }
@@ -57,7 +63,7 @@ bool performHandshake() {
 }
 
 
-bool attemptHandshake() {
+bool attemptHandshake(bool offerBinary) {
     while (serialBusy);
     serialBusy = true;
 
@@ -73,12 +79,18 @@ bool attemptHandshake() {
         }
     }
 
-    espSerial.println("AT+CIPSEND=26");
+    char handshakeMessage[96];
+    snprintf(handshakeMessage, sizeof(handshakeMessage), "HANDSHAKE:ARDUINO_READY;id=%s;caps=%s%s\n",
+             stationID, stationCaps, offerBinary ? ";" TELEMETRY_FRAME_OPTION : "");
+    char cipsendCommand[32];
+    snprintf(cipsendCommand, sizeof(cipsendCommand), "AT+CIPSEND=%d", (int)strlen(handshakeMessage));
+
+    espSerial.println(cipsendCommand);
     delay(500);
 
     if (!waitForResponse(">", 4000)) {
         Serial.println("[ESP8266] ❌ No `>` prompt. Retrying CIPSEND...");
-        espSerial.println("AT+CIPSEND=26");
+        espSerial.println(cipsendCommand);
         if (!waitForResponse(">", 4000)) {
             Serial.println("[ESP8266] ❌ CIPSEND failed again. Closing connection...");
             espSerial.println("AT+CIPCLOSE");
@@ -89,7 +101,7 @@ bool attemptHandshake() {
         }
     }
 
-    espSerial.print("HANDSHAKE:ARDUINO_READY\n");
+    espSerial.print(handshakeMessage);
     delay(1000);
 
     bool success = waitForHandshakeResponse();
@@ -112,7 +124,17 @@ bool waitForHandshakeResponse() {
             }
 
             if (strstr(handshakeResponse, "HANDSHAKE:ESP32_READY")) {
-                Serial.println("[ESP8266] ✅ Handshake successful!");
+                binaryFrames = strstr(handshakeResponse, TELEMETRY_FRAME_OPTION) != NULL;
+
+                // Keep the session token, if any, to skip the handshake after the link drops
+                const char *token = strstr(handshakeResponse, ";tok=");
+                sessionToken[0] = '\0';
+                if (token && strspn(token + 5, "0123456789abcdef") >= 8) {
+                    strncpy(sessionToken, token + 5, 8);
+                    sessionToken[8] = '\0';
+                }
+                Serial.println(binaryFrames ? "[ESP8266] ✅ Handshake successful! Using binary frames."
+                                            : "[ESP8266] ✅ Handshake successful! Using JSON.");
                 handshake_done = true;
                 connected = true;
                 return true;
@@ -144,14 +166,39 @@ void sendTCPMessage(const char* message) {
         return;
     }
 
+    char fullMessage[176];
+    if (resumePending) {
+        snprintf(fullMessage, sizeof(fullMessage), "DATA;tok=%s:%s\n", sessionToken, message);
+    } else {
+        snprintf(fullMessage, sizeof(fullMessage), "DATA:%s\n", message);
+    }
+    sendWithRetries(reinterpret_cast<const uint8_t*>(fullMessage), strlen(fullMessage));
+}
+
+
+void sendTCPFrame(const uint8_t* frame, size_t len) {
+    if (!checkConnection()) {
+        connectToTCPServer();
+    }
+    if (!handshake_done) {
+        performHandshake();
+    }
+
+    if (!connected || !handshake_done) {
+        return;
+    }
+
+    sendWithRetries(frame, len);
+}
+
+
+void sendWithRetries(const uint8_t* data, size_t len) {
     const int maxRetries = 3;
     int retries = 0;
     bool ackReceived = false;
-    char fullMessage[128];
-    snprintf(fullMessage, sizeof(fullMessage), "DATA:%s\n", message);
 
-    while (retries < maxRetries && !ackReceived) {
-        if (attemptSendMessage(fullMessage)) {
+    while (retries < maxRetries && !ackReceived && handshake_done) {
+        if (attemptSendMessage(data, len)) {
             ackReceived = true;
         } else {
             retries++;
@@ -160,7 +207,7 @@ void sendTCPMessage(const char* message) {
 }
 
 
-bool attemptSendMessage(const char* fullMessage) {
+bool attemptSendMessage(const uint8_t* data, size_t len) {
     while (serialBusy);
     serialBusy = true;
 
@@ -171,26 +218,32 @@ bool attemptSendMessage(const char* fullMessage) {
     }
 
     char cipsendCommand[32];
-    snprintf(cipsendCommand, sizeof(cipsendCommand), "AT+CIPSEND=%d", strlen(fullMessage));
+    snprintf(cipsendCommand, sizeof(cipsendCommand), "AT+CIPSEND=%d", (int)len);
 
     espSerial.println(cipsendCommand);
     if (!waitForResponse(">", 2000)) {
         Serial.println("[ESP8266] ❌ Failed to get `>` prompt, retrying...");
+        connected = false;  // Let checkConnection() ask AT+CIPSTATUS and reconnect if the link dropped
         serialBusy = false;
         return false;
     }
 
-    espSerial.print(fullMessage);
+    espSerial.write(data, len);
     delay(1500);
 
     char response[64];
     getResponse(response, sizeof(response));
 
     if (strstr(response, "ACK")) {
+        resumePending = false;
         serialBusy = false;
         return true;
-    } else if (strstr(response, "ERROR:HANDSHAKE_FAILED")) {
-        performHandshake();
+    } else if (strstr(response, "ERROR:SESSION_UNKNOWN") || strstr(response, "ERROR:HANDSHAKE_FAILED")) {
+        // The session is gone; performHandshakeIfNeeded() starts over with a full handshake
+        Serial.println("[ESP8266] ❌ Session not resumed, handshaking again...");
+        sessionToken[0] = '\0';
+        resumePending = false;
+        handshake_done = false;
     }
 
     serialBusy = false;
@@ -227,6 +280,14 @@ void processIncomingMessage() {
 
     if (accumulatedResponse.indexOf("temp=") >= 0 && accumulatedResponse.indexOf("&humidity=") >= 0) {
         handleSetpoints(accumulatedResponse);
+
+        // Echo the request ID so the controller can match the ACK; older controllers send none
+        char ackMessage[32] = "SETPOINTS_ACK\n";
+        int idIndex = accumulatedResponse.indexOf("&id=");
+        if (idIndex >= 0) {
+            snprintf(ackMessage, sizeof(ackMessage), "SETPOINTS_ACK:%lu\n",
+                     strtoul(accumulatedResponse.c_str() + idIndex + 4, NULL, 10));
+        }
         accumulatedResponse = "";
 
         while (serialBusy);
@@ -238,13 +299,15 @@ void processIncomingMessage() {
             return;
         }
 
-        espSerial.println("AT+CIPSEND=14");
-        if (!sendATCommand("AT+CIPSEND=14", 1000)) {
+        char cipsendCommand[32];
+        snprintf(cipsendCommand, sizeof(cipsendCommand), "AT+CIPSEND=%d", (int)strlen(ackMessage));
+        espSerial.println(cipsendCommand);
+        if (!waitForResponse(">", 2000)) {
             serialBusy = false;
             return;
         }
 
-        espSerial.print("SETPOINTS_ACK\n");
+        espSerial.print(ackMessage);
         delay(500);
         espSerial.find("SEND OK");
         serialBusy = false;
@@ -67,6 +67,11 @@
          success = waitForResponse("CONNECT", 8000);
      }
  
+     // With a session token the server lets the next data frame resume the session instead of a new handshake
+     if (success && sessionToken[0] != '\0') {
+         resumePending = true;
+     }
+ 
      serialBusy = false;
      return success;
  }
\ No newline at end of file